@@ -0,0 +1,645 @@
+/**
+ * mini-grep 벤치마크 (mini-grep-bench)
+ *
+ * 기능:
+ * - 합성 트리 생성 (파일 수, 크기 분포, 매칭 비율, 깊이/분기 수, 시드 고정 -> 항상 같은 트리)
+ * - single-mini-grep / mini-grep 을 스레드 수 x warm/cold 캐시 조합으로 반복 실행
+ * - 조합마다 median / p95 / min 시간, files/s, GB/s 를 JSON Lines (또는 CSV) 로 출력
+ * - --baseline: 이전 결과와 median 비교, 허용치보다 느려지면 종료 코드 3 (회귀 검사용)
+ *
+ * 빌드:
+ *   gcc -O2 mini-grep-bench.c -o mini-grep-bench -lm
+ *
+ * 실행:
+ *   ./mini-grep-bench --files=40000 --threads=1,2,4,8 > result.jsonl
+ *   ./mini-grep-bench --baseline=result.jsonl          # 같은 조건으로 다시 재서 비교
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_RUNS      1000
+#define MAX_THREAD_SET 64
+#define MARKER_NAME   ".mini-grep-bench"   // 이 파일이 있는 디렉터리만 지우고 다시 만듦
+
+// -------------------- 설정 --------------------
+typedef enum {
+    SIZE_FIXED = 0,        // 모든 파일이 평균 크기
+    SIZE_EXP   = 1,        // 지수 분포 (작은 파일이 많음)
+    SIZE_PARETO = 2        // 파레토 (alpha 1.5, 드물게 아주 큰 파일)
+} SizeDist;
+
+typedef struct {
+    const char *root;
+    long files;
+    int depth;
+    int fanout;
+    long mean_size;
+    SizeDist dist;
+    double match_rate;     // 키워드가 들어 있는 파일 비율
+    int match_lines;       // 매칭 파일 하나에 넣는 키워드 줄 수
+    const char *keyword;
+    uint64_t seed;
+    int reuse;             // 같은 설정으로 만든 트리가 있으면 그대로 사용
+
+    const char *mini;      // 실행 파일 경로
+    const char *single;
+    const char *extra;     // mini-grep 추가 인자 (공백으로 구분)
+    int threads[MAX_THREAD_SET];
+    int nthreads;
+    int runs;
+    int warm, cold;
+    int csv;
+    const char *baseline;
+    double tolerance;      // 회귀 판정: median 이 baseline 보다 이 비율 이상 느리면
+} BenchConfig;
+
+// 생성된 트리 정보 (검증 + 처리량 계산용)
+typedef struct {
+    long files;
+    long dirs;
+    long matched_files;
+    long long bytes;
+} TreeInfo;
+
+// -------------------- 난수 (xorshift64*, 시드 고정) --------------------
+static uint64_t rng_state;
+
+static uint64_t rng_next(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ULL;
+}
+
+// [0, 1)
+static double rng_unit(void) {
+    return (double)(rng_next() >> 11) / 9007199254740992.0;
+}
+
+static long file_size_sample(const BenchConfig *c) {
+    double u = rng_unit();
+    double v;
+    switch (c->dist) {
+    case SIZE_EXP:
+        v = -(double)c->mean_size * log(1.0 - u);
+        break;
+    case SIZE_PARETO: {
+        // 평균 = xm * a / (a - 1), a = 1.5 -> xm = mean / 3
+        double xm = (double)c->mean_size / 3.0;
+        v = xm / pow(1.0 - u, 1.0 / 1.5);
+        if (v > (double)c->mean_size * 4096) v = (double)c->mean_size * 4096;   // 꼬리 상한
+        break;
+    }
+    default:
+        v = (double)c->mean_size;
+        break;
+    }
+    return v < 1 ? 1 : (long)v;
+}
+
+// -------------------- 트리 생성 --------------------
+static const char *const words[] = {
+    "static", "int", "return", "const", "char", "void", "struct", "size_t", "buffer",
+    "length", "count", "index", "value", "result", "error", "thread", "queue", "worker",
+    "lock", "file", "path", "line", "data", "offset", "begin", "end", "next", "prev",
+    "the", "of", "and", "to", "in", "is", "for", "with", "on", "this", "that", "from",
+};
+#define NWORDS (sizeof(words) / sizeof(words[0]))
+
+// 대상 확장자 (두 실행 파일 모두 .c .h .txt .py .md 만 검색)
+static const char *const exts[] = { ".c", ".h", ".txt", ".py", ".md" };
+
+static int mkdir_p(const char *path) {
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s", path);
+    for (char *p = tmp + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        if (mkdir(tmp, 0755) != 0 && errno != EEXIST) return -1;
+        *p = '/';
+    }
+    return (mkdir(tmp, 0755) != 0 && errno != EEXIST) ? -1 : 0;
+}
+
+static int rm_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw) {
+    (void)st;
+    (void)ftw;
+    return (flag == FTW_DP ? rmdir(path) : unlink(path)) != 0 ? -1 : 0;
+}
+
+// 파일 하나: 단어로 채운 줄 + 매칭 파일이면 그중 몇 줄에 키워드
+static int write_file(const char *path, long size, int matching, const BenchConfig *c) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) return -1;
+
+    // 키워드를 넣을 줄 위치 (평균 줄 길이 60바이트 기준)
+    long nlines = size / 60 + 1;
+    long marks[64];
+    int nmarks = matching ? (c->match_lines < 64 ? c->match_lines : 64) : 0;
+    for (int i = 0; i < nmarks; i++) marks[i] = (long)(rng_next() % (uint64_t)nlines);
+
+    long written = 0, line = 0;
+    int inserted = 0;
+    char buf[256];
+    while (written < size) {
+        size_t len = 0;
+        int has_kw = 0;
+        for (int i = 0; i < nmarks; i++) has_kw |= marks[i] == line;
+
+        size_t target = 20 + rng_next() % 80;
+        while (len < target) {
+            const char *w = (has_kw && len >= target / 2) ? c->keyword : words[rng_next() % NWORDS];
+            if (w == c->keyword) {
+                has_kw = 0;
+                inserted++;
+            }
+            size_t wl = strlen(w);
+            if (len + wl + 2 > sizeof(buf)) break;
+            memcpy(buf + len, w, wl);
+            len += wl;
+            buf[len++] = ' ';
+        }
+        buf[len - 1] = '\n';
+        fwrite(buf, 1, len, fp);
+        written += (long)len;
+        line++;
+    }
+    // 줄 수 추정이 빗나가 키워드가 하나도 안 들어갔으면 마지막에 한 줄 추가 (매칭 파일 수 일치용)
+    if (nmarks > 0 && inserted == 0) fprintf(fp, "%s\n", c->keyword);
+    return fclose(fp);
+}
+
+// 설정 요약 (같으면 --reuse 로 다시 쓸 수 있음)
+static void tree_signature(const BenchConfig *c, char *out, size_t n) {
+    snprintf(out, n, "files=%ld depth=%d fanout=%d size=%ld dist=%d match=%.6f lines=%d kw=%s seed=%llu\n",
+             c->files, c->depth, c->fanout, c->mean_size, (int)c->dist, c->match_rate,
+             c->match_lines, c->keyword, (unsigned long long)c->seed);
+}
+
+static int tree_read_info(const BenchConfig *c, TreeInfo *info) {
+    char marker[4096], sig[512], line[512];
+    snprintf(marker, sizeof(marker), "%s/%s", c->root, MARKER_NAME);
+    FILE *fp = fopen(marker, "r");
+    if (!fp) return -1;
+
+    tree_signature(c, sig, sizeof(sig));
+    int ok = fgets(line, sizeof(line), fp) && strcmp(line, sig) == 0 &&
+             fscanf(fp, "%ld %ld %ld %lld", &info->files, &info->dirs, &info->matched_files, &info->bytes) == 4;
+    fclose(fp);
+    return ok ? 0 : -1;
+}
+
+static int tree_generate(const BenchConfig *c, TreeInfo *info) {
+    char path[4096];
+    struct stat st;
+
+    if (c->reuse && tree_read_info(c, info) == 0) {
+        fprintf(stderr, "기존 트리 사용: %s\n", c->root);
+        return 0;
+    }
+
+    // 다른 디렉터리를 실수로 지우지 않도록 표식 파일이 있을 때만 삭제
+    if (stat(c->root, &st) == 0) {
+        snprintf(path, sizeof(path), "%s/%s", c->root, MARKER_NAME);
+        if (access(path, F_OK) != 0) {
+            fprintf(stderr, "에러: %s 가 이미 있고 벤치마크 트리가 아닙니다 (%s 없음)\n", c->root, MARKER_NAME);
+            return -1;
+        }
+        if (nftw(c->root, rm_entry, 64, FTW_DEPTH | FTW_PHYS) != 0) {
+            fprintf(stderr, "에러: 기존 트리를 지울 수 없습니다: %s\n", strerror(errno));
+            return -1;
+        }
+    }
+
+    // 디렉터리: 깊이 depth, 디렉터리마다 fanout 개 (BFS 번호 -> 경로 "d3/d1/d0")
+    long ndirs = 1, level = 1;
+    for (int d = 0; d < c->depth; d++) {
+        level *= c->fanout;
+        ndirs += level;
+        if (ndirs > 1000000) {
+            fprintf(stderr, "에러: 디렉터리가 너무 많습니다 (--depth / --fanout 을 줄여 주세요)\n");
+            return -1;
+        }
+    }
+    char **dirs = (char**)calloc((size_t)ndirs, sizeof(char*));
+    if (!dirs) {
+        perror("calloc");
+        exit(1);
+    }
+    dirs[0] = strdup(c->root);
+    for (long i = 1; i < ndirs; i++) {
+        long parent = (i - 1) / c->fanout;
+        snprintf(path, sizeof(path), "%s/d%ld", dirs[parent], (i - 1) % c->fanout);
+        dirs[i] = strdup(path);
+        if (!dirs[i]) {
+            perror("strdup");
+            exit(1);
+        }
+    }
+    for (long i = 0; i < ndirs; i++) {
+        if (mkdir_p(dirs[i]) != 0) {
+            fprintf(stderr, "에러: 디렉터리를 만들 수 없습니다: %s (%s)\n", dirs[i], strerror(errno));
+            return -1;
+        }
+    }
+
+    memset(info, 0, sizeof(*info));
+    info->dirs = ndirs;
+    rng_state = c->seed ? c->seed : 1;
+    for (long i = 0; i < c->files; i++) {
+        long d = (long)(rng_next() % (uint64_t)ndirs);
+        long size = file_size_sample(c);
+        int matching = rng_unit() < c->match_rate;
+        snprintf(path, sizeof(path), "%s/f%07ld%s", dirs[d], i, exts[rng_next() % 5]);
+        if (write_file(path, size, matching, c) != 0) {
+            fprintf(stderr, "에러: 파일을 쓸 수 없습니다: %s (%s)\n", path, strerror(errno));
+            return -1;
+        }
+        if (stat(path, &st) == 0) info->bytes += st.st_size;
+        info->files++;
+        info->matched_files += matching && c->match_lines > 0;
+    }
+    for (long i = 0; i < ndirs; i++) free(dirs[i]);
+    free(dirs);
+
+    char sig[512];
+    tree_signature(c, sig, sizeof(sig));
+    snprintf(path, sizeof(path), "%s/%s", c->root, MARKER_NAME);
+    FILE *fp = fopen(path, "w");
+    if (!fp) return -1;
+    fprintf(fp, "%s%ld %ld %ld %lld\n", sig, info->files, info->dirs, info->matched_files, info->bytes);
+    fclose(fp);
+    return 0;
+}
+
+// -------------------- 캐시 비우기 (cold) --------------------
+// root 면 drop_caches (페이지 캐시 + dentry/inode), 아니면 파일마다 posix_fadvise(DONTNEED)
+// (fadvise 는 파일 내용만 내보냄, 디렉터리 메타데이터는 남음 -> 결과에 방식 표시)
+static int fadvise_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw) {
+    (void)st;
+    (void)ftw;
+    if (flag != FTW_F) return 0;
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+    return 0;
+}
+
+static const char *drop_caches(const char *root) {
+    sync();
+    int fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+    if (fd >= 0) {
+        int ok = write(fd, "3\n", 2) == 2;
+        close(fd);
+        if (ok) return "drop_caches";
+    }
+    nftw(root, fadvise_entry, 64, FTW_PHYS);
+    return "fadvise";
+}
+
+// -------------------- 실행 / 측정 --------------------
+// argv 실행 후 경과 시간(초), 실패하면 -1 (종료 코드 0 = 매칭 있음, 1 = 없음 은 정상)
+static double run_once(char *const argv[]) {
+    struct timespec a, b;
+    clock_gettime(CLOCK_MONOTONIC, &a);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+    if (pid == 0) {
+        int devnull = open("/dev/null", O_WRONLY);
+        if (devnull >= 0) {
+            dup2(devnull, STDOUT_FILENO);
+            dup2(devnull, STDERR_FILENO);
+        }
+        execv(argv[0], argv);
+        _exit(127);
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+    clock_gettime(CLOCK_MONOTONIC, &b);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) > 1) return -1;
+    return (double)(b.tv_sec - a.tv_sec) + (double)(b.tv_nsec - a.tv_nsec) / 1e9;
+}
+
+// mini-grep -l 결과 줄 수 = 매칭 파일 수인지 확인 (벤치마크하는 빌드가 맞는 결과를 내는지)
+static long count_matched_files(const BenchConfig *c) {
+    char cmd[8192];
+    snprintf(cmd, sizeof(cmd), "'%s' -l '%s' '%s'", c->mini, c->root, c->keyword);
+    FILE *fp = popen(cmd, "r");
+    if (!fp) return -1;
+    long n = 0;
+    int ch;
+    while ((ch = fgetc(fp)) != EOF) n += ch == '\n';
+    pclose(fp);
+    return n;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    const char *tool;
+    int threads;           // single 은 1
+    const char *cache;     // "warm" / "cold"
+    const char *cold_method;
+    int runs;
+    double median, p95, min;
+} BenchResult;
+
+static int measure(const BenchConfig *c, char *const argv[], int cold, BenchResult *r) {
+    double t[MAX_RUNS];
+    r->cold_method = "";
+
+    if (!cold && run_once(argv) < 0) return -1;      // warm: 캐시 채우기용 1회 (기록 안 함)
+    for (int i = 0; i < c->runs; i++) {
+        if (cold) r->cold_method = drop_caches(c->root);
+        t[i] = run_once(argv);
+        if (t[i] < 0) return -1;
+    }
+    qsort(t, (size_t)c->runs, sizeof(double), cmp_double);
+
+    int n = c->runs;
+    r->runs = n;
+    r->min = t[0];
+    r->median = (n % 2) ? t[n / 2] : (t[n / 2 - 1] + t[n / 2]) / 2;
+    int rank = (95 * n + 99) / 100;         // nearest-rank: ceil(0.95 n)
+    r->p95 = t[rank - 1];
+    return 0;
+}
+
+// -------------------- baseline 비교 --------------------
+// 이전 출력(JSON Lines)에서 "key":값 을 꺼냄 (이 프로그램이 쓴 형식만 가정)
+static int json_field(const char *line, const char *key, char *out, size_t n) {
+    char pat[64];
+    snprintf(pat, sizeof(pat), "\"%s\":", key);
+    const char *p = strstr(line, pat);
+    if (!p) return -1;
+    p += strlen(pat);
+    if (*p == '"') p++;
+    size_t i = 0;
+    while (*p && *p != '"' && *p != ',' && *p != '}' && i + 1 < n) out[i++] = *p++;
+    out[i] = '\0';
+    return 0;
+}
+
+// 같은 (tool, threads, cache) 의 baseline median, 없으면 -1
+static double baseline_median(const char *file, const BenchResult *r) {
+    FILE *fp = fopen(file, "r");
+    if (!fp) return -1;
+
+    char line[4096], v[64];
+    double found = -1;
+    while (fgets(line, sizeof(line), fp)) {
+        if (json_field(line, "tool", v, sizeof(v)) != 0 || strcmp(v, r->tool) != 0) continue;
+        if (json_field(line, "cache", v, sizeof(v)) != 0 || strcmp(v, r->cache) != 0) continue;
+        if (json_field(line, "threads", v, sizeof(v)) != 0 || atoi(v) != r->threads) continue;
+        if (json_field(line, "median_s", v, sizeof(v)) == 0) found = atof(v);
+    }
+    fclose(fp);
+    return found;
+}
+
+// -------------------- 출력 --------------------
+static int report(const BenchConfig *c, const TreeInfo *ti, const BenchResult *r) {
+    double base = c->baseline ? baseline_median(c->baseline, r) : -1;
+    int regressed = base > 0 && r->median > base * (1.0 + c->tolerance);
+
+    if (c->csv) {
+        printf("%s,%d,%s,%s,%d,%ld,%lld,%.6f,%.6f,%.6f,%.1f,%.4f,%.6f,%d\n",
+               r->tool, r->threads, r->cache, r->cold_method, r->runs, ti->files, ti->bytes,
+               r->median, r->p95, r->min, (double)ti->files / r->median,
+               (double)ti->bytes / r->median / 1e9, base, regressed);
+    } else {
+        printf("{\"tool\":\"%s\",\"threads\":%d,\"cache\":\"%s\",\"cold_method\":\"%s\",\"runs\":%d,"
+               "\"files\":%ld,\"bytes\":%lld,\"median_s\":%.6f,\"p95_s\":%.6f,\"min_s\":%.6f,"
+               "\"files_per_s\":%.1f,\"gb_per_s\":%.4f",
+               r->tool, r->threads, r->cache, r->cold_method, r->runs, ti->files, ti->bytes,
+               r->median, r->p95, r->min, (double)ti->files / r->median,
+               (double)ti->bytes / r->median / 1e9);
+        if (c->baseline) printf(",\"baseline_median_s\":%.6f,\"regression\":%s", base, regressed ? "true" : "false");
+        printf("}\n");
+    }
+    fflush(stdout);
+
+    if (regressed) {
+        fprintf(stderr, "회귀: %s -j %d (%s) median %.3fs -> %.3fs (+%.1f%%)\n", r->tool, r->threads,
+                r->cache, base, r->median, (r->median / base - 1.0) * 100);
+    }
+    return regressed;
+}
+
+// -------------------- main --------------------
+static int parse_threads(const char *s, BenchConfig *c) {
+    c->nthreads = 0;
+    while (*s) {
+        char *endp;
+        long v = strtol(s, &endp, 10);
+        if (endp == s || v < 1 || v > 4096 || c->nthreads == MAX_THREAD_SET) return -1;
+        c->threads[c->nthreads++] = (int)v;
+        s = endp;
+        if (*s == ',') s++;
+        else if (*s) return -1;
+    }
+    return c->nthreads > 0 ? 0 : -1;
+}
+
+static void print_usage(const char *prog) {
+    printf("사용법: %s [옵션]\n", prog);
+    printf("\n트리 생성:\n");
+    printf("  --root=DIR            트리 위치 (기본: /tmp/mini-grep-bench, 표식 파일이 있으면 지우고 다시 만듦)\n");
+    printf("  --files=N             파일 수 (기본: 20000)\n");
+    printf("  --depth=D             디렉터리 깊이 (기본: 3)\n");
+    printf("  --fanout=F            디렉터리마다 하위 디렉터리 수 (기본: 8)\n");
+    printf("  --size=BYTES          평균 파일 크기 (기본: 8192)\n");
+    printf("  --size-dist=fixed|exp|pareto  크기 분포 (기본: exp)\n");
+    printf("  --match-rate=R        키워드가 들어 있는 파일 비율 0~1 (기본: 0.01)\n");
+    printf("  --match-lines=N       매칭 파일 하나의 키워드 줄 수 (기본: 1)\n");
+    printf("  --keyword=K           검색 키워드 (기본: NEEDLE)\n");
+    printf("  --seed=N              난수 시드 (기본: 1, 같으면 같은 트리)\n");
+    printf("  --reuse               같은 설정의 트리가 있으면 다시 만들지 않음\n");
+    printf("\n측정:\n");
+    printf("  --mini=PATH           mini-grep 실행 파일 (기본: ./mini-grep)\n");
+    printf("  --single=PATH         single-mini-grep 실행 파일 (기본: ./single-mini-grep, none = 생략)\n");
+    printf("  --extra=\"ARGS\"        mini-grep 에 붙일 인자 (예: \"--scheduler=steal --io-uring\")\n");
+    printf("  --threads=1,2,4       mini-grep -j 목록 (기본: 1, 2, 4, ... CPU 수)\n");
+    printf("  --runs=N              조합마다 반복 횟수 (기본: 5)\n");
+    printf("  --cache=warm|cold|both  캐시 상태 (기본: warm, cold 는 root면 drop_caches, 아니면 fadvise)\n");
+    printf("  --format=json|csv     출력 형식 (기본: json, 한 줄에 조합 하나)\n");
+    printf("  --baseline=FILE       이전 JSON 결과와 median 비교, 느려지면 종료 코드 3\n");
+    printf("  --tolerance=R         회귀로 보는 비율 (기본: 0.10 = 10%%)\n");
+}
+
+int main(int argc, char *argv[]) {
+    BenchConfig c;
+    memset(&c, 0, sizeof(c));
+    c.root = "/tmp/mini-grep-bench";
+    c.files = 20000;
+    c.depth = 3;
+    c.fanout = 8;
+    c.mean_size = 8192;
+    c.dist = SIZE_EXP;
+    c.match_rate = 0.01;
+    c.match_lines = 1;
+    c.keyword = "NEEDLE";
+    c.seed = 1;
+    c.mini = "./mini-grep";
+    c.single = "./single-mini-grep";
+    c.extra = "";
+    c.runs = 5;
+    c.warm = 1;
+    c.tolerance = 0.10;
+
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu < 1) ncpu = 1;
+    for (long t = 1; t < ncpu && c.nthreads < MAX_THREAD_SET - 1; t *= 2) c.threads[c.nthreads++] = (int)t;
+    c.threads[c.nthreads++] = (int)ncpu;
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = strchr(a, '=');
+        v = v ? v + 1 : "";
+        int bad = 0;
+
+        if (strncmp(a, "--root=", 7) == 0) c.root = v;
+        else if (strncmp(a, "--files=", 8) == 0) bad = (c.files = atol(v)) < 1;
+        else if (strncmp(a, "--depth=", 8) == 0) bad = (c.depth = atoi(v)) < 0 || c.depth > 16;
+        else if (strncmp(a, "--fanout=", 9) == 0) bad = (c.fanout = atoi(v)) < 1;
+        else if (strncmp(a, "--size=", 7) == 0) bad = (c.mean_size = atol(v)) < 1;
+        else if (strncmp(a, "--size-dist=", 12) == 0) {
+            if (strcmp(v, "fixed") == 0) c.dist = SIZE_FIXED;
+            else if (strcmp(v, "exp") == 0) c.dist = SIZE_EXP;
+            else if (strcmp(v, "pareto") == 0) c.dist = SIZE_PARETO;
+            else bad = 1;
+        }
+        else if (strncmp(a, "--match-rate=", 13) == 0) bad = (c.match_rate = atof(v)) < 0 || c.match_rate > 1;
+        else if (strncmp(a, "--match-lines=", 14) == 0) bad = (c.match_lines = atoi(v)) < 0;
+        else if (strncmp(a, "--keyword=", 10) == 0) bad = *(c.keyword = v) == '\0' || strchr(v, '\'') != NULL;
+        else if (strncmp(a, "--seed=", 7) == 0) c.seed = strtoull(v, NULL, 10);
+        else if (strcmp(a, "--reuse") == 0) c.reuse = 1;
+        else if (strncmp(a, "--mini=", 7) == 0) c.mini = v;
+        else if (strncmp(a, "--single=", 9) == 0) c.single = strcmp(v, "none") == 0 ? NULL : v;
+        else if (strncmp(a, "--extra=", 8) == 0) c.extra = v;
+        else if (strncmp(a, "--threads=", 10) == 0) bad = parse_threads(v, &c) != 0;
+        else if (strncmp(a, "--runs=", 7) == 0) bad = (c.runs = atoi(v)) < 1 || c.runs > MAX_RUNS;
+        else if (strncmp(a, "--cache=", 8) == 0) {
+            c.warm = strcmp(v, "warm") == 0 || strcmp(v, "both") == 0;
+            c.cold = strcmp(v, "cold") == 0 || strcmp(v, "both") == 0;
+            bad = !c.warm && !c.cold;
+        }
+        else if (strncmp(a, "--format=", 9) == 0) {
+            c.csv = strcmp(v, "csv") == 0;
+            bad = !c.csv && strcmp(v, "json") != 0;
+        }
+        else if (strncmp(a, "--baseline=", 11) == 0) c.baseline = v;
+        else if (strncmp(a, "--tolerance=", 12) == 0) bad = (c.tolerance = atof(v)) < 0;
+        else if (strcmp(a, "-h") == 0 || strcmp(a, "--help") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        } else {
+            bad = 1;
+        }
+        if (bad) {
+            fprintf(stderr, "에러: 잘못된 옵션: %s\n", a);
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (access(c.mini, X_OK) != 0) {
+        fprintf(stderr, "에러: mini-grep 실행 파일이 없습니다: %s (--mini)\n", c.mini);
+        return 1;
+    }
+    if (c.single && access(c.single, X_OK) != 0) {
+        fprintf(stderr, "경고: single-mini-grep 실행 파일이 없어 생략합니다: %s\n", c.single);
+        c.single = NULL;
+    }
+
+    TreeInfo ti;
+    fprintf(stderr, "트리 생성: %s (%ld개 파일)\n", c.root, c.files);
+    if (tree_generate(&c, &ti) != 0) return 1;
+
+    // 측정 전에 결과가 맞는지 확인 (틀린 빌드의 속도는 의미 없음)
+    long got = count_matched_files(&c);
+    if (got != ti.matched_files) {
+        fprintf(stderr, "에러: 매칭 파일 수가 다릅니다 (예상 %ld, mini-grep %ld)\n", ti.matched_files, got);
+        return 2;
+    }
+
+    if (c.csv) {
+        printf("tool,threads,cache,cold_method,runs,files,bytes,median_s,p95_s,min_s,files_per_s,gb_per_s,"
+               "baseline_median_s,regression\n");
+    } else {
+        printf("{\"tree\":{\"root\":\"%s\",\"files\":%ld,\"dirs\":%ld,\"bytes\":%lld,\"matched_files\":%ld,"
+               "\"depth\":%d,\"fanout\":%d,\"mean_size\":%ld,\"size_dist\":\"%s\",\"match_rate\":%.6f,"
+               "\"seed\":%llu},\"extra\":\"%s\",\"cpus\":%ld}\n",
+               c.root, ti.files, ti.dirs, ti.bytes, ti.matched_files, c.depth, c.fanout, c.mean_size,
+               c.dist == SIZE_FIXED ? "fixed" : c.dist == SIZE_EXP ? "exp" : "pareto", c.match_rate,
+               (unsigned long long)c.seed, c.extra, ncpu);
+    }
+
+    // mini-grep 인자: [mini, -j, N, extra..., root, keyword]
+    char *extra_copy = strdup(c.extra);
+    char *margv[64];
+    char jbuf[16];
+    int mn = 0;
+    margv[mn++] = (char*)c.mini;
+    margv[mn++] = "-j";
+    margv[mn++] = jbuf;
+    for (char *tok = strtok(extra_copy, " "); tok && mn < 60; tok = strtok(NULL, " ")) margv[mn++] = tok;
+    margv[mn++] = (char*)c.root;
+    margv[mn++] = (char*)c.keyword;
+    margv[mn] = NULL;
+
+    char *sargv[] = { (char*)c.single, (char*)c.root, (char*)c.keyword, NULL };
+
+    int regressions = 0;
+    for (int cold = 0; cold <= 1; cold++) {
+        if ((cold && !c.cold) || (!cold && !c.warm)) continue;
+        BenchResult r;
+        r.cache = cold ? "cold" : "warm";
+
+        if (c.single) {
+            r.tool = "single-mini-grep";
+            r.threads = 1;
+            if (measure(&c, sargv, cold, &r) != 0) {
+                fprintf(stderr, "에러: 실행 실패: %s\n", c.single);
+                return 1;
+            }
+            regressions += report(&c, &ti, &r);
+        }
+        for (int i = 0; i < c.nthreads; i++) {
+            snprintf(jbuf, sizeof(jbuf), "%d", c.threads[i]);
+            r.tool = "mini-grep";
+            r.threads = c.threads[i];
+            if (measure(&c, margv, cold, &r) != 0) {
+                fprintf(stderr, "에러: 실행 실패: %s -j %d\n", c.mini, c.threads[i]);
+                return 1;
+            }
+            regressions += report(&c, &ti, &r);
+        }
+    }
+    free(extra_copy);
+
+    return regressions > 0 ? 3 : 0;
+}
@@ -0,0 +1,3792 @@
+/**
+ * mini-grep 검색 라이브러리 (mini-grep-lib.h)
+ *
+ * mini-grep / single-mini-grep 이 같이 쓰는 검색 코어 (커널, 매처 최적화는 여기서 한 번만)
+ * 다른 프로그램에 넣어 프로세스를 띄우지 않고 검색할 때도 이 헤더 하나만 포함
+ *
+ * 기능:
+ * - SIMD 부분 문자열 검색 (SSE2/AVX2/NEON, 런타임 선택), 대소문자 무시 (-i)
+ * - 다중 패턴 (Aho-Corasick), 확장 정규식 (-E, DFA), 단어 단위 (-w)
+ * - 파일 통째로 읽기 (mmap / read), 쓸 수 있는 CPU 수 (affinity + cgroup quota)
+ * - 트리 탐색: work-stealing 스케줄러 (MgStealPool) + 디렉터리별 경로 블록 (MgPathBlock),
+ *   mini-grep --scheduler=steal 과 mg_search_tree 가 같은 구현
+ * - 공개 API: 컴파일된 패턴 (mg_compile), 버퍼 검색 (mg_next_match / mg_next_span),
+ *   병렬 트리 검색 + 결과 callback (mg_search_tree)
+ *
+ * 사용:
+ *   #define _GNU_SOURCE
+ *   #include "mini-grep-lib.h"    // 함수는 모두 static (포함한 파일 안에서 인라인), 빌드 명령에 파일 추가 없음
+ *   gcc app.c -o app -pthread
+ *   이름은 모두 mg_ / Mg / MG_ 로 시작 (내부 함수도 포함한 파일의 이름과 겹치지 않게)
+ *
+ * 예:
+ *   const char *pat = "TODO", *err;
+ *   size_t len = 4;
+ *   MgPattern *p = mg_compile(&pat, &len, 1, MG_IGNORE_CASE, &err);
+ *   MgCursor cur = { 0, 0 };
+ *   MgMatch mm;
+ *   while (mg_next_match(p, buf, buf_len, &cur, &mm)) {
+ *       printf("%zu: %.*s\n", mm.line_num, (int)mm.line_len, buf + mm.line_off);
+ *   }
+ *   mg_free(p);
+ */
+
+#ifndef MINI_GREP_LIB_H
+#define MINI_GREP_LIB_H
+
+#ifndef _GNU_SOURCE
+#error "mini-grep-lib.h: 시스템 헤더보다 먼저 _GNU_SOURCE 를 정의해야 합니다 (memrchr, fstatat)"
+#endif
+
+#include <stdio.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+
+// 공개 함수: 포함한 파일이 일부만 써도 경고 없게
+#define MG_API static __attribute__((unused))
+
+// 할당 실패 시 *err 로 돌려주는 메시지 (라이브러리는 출력하거나 종료하지 않음)
+#define MG_ERR_NOMEM "메모리가 부족합니다"
+
+// -------------------- 부분 문자열 검색 커널 (SIMD) --------------------
+// 키워드의 첫 바이트와 마지막 바이트가 동시에 일치하는 위치만 후보로 골라
+// memcmp로 확인 (후보가 드물어서 대부분의 바이트는 벡터 비교 2번으로 통과)
+// - x86: SSE2 (항상 사용 가능), AVX2 (런타임 감지)
+// - ARM (Raspberry Pi 5 등): NEON
+// - 그 외: memchr 기반 스칼라
+typedef const char *(*mg_find_fn)(const char *hay, size_t n, const char *needle, size_t m);
+
+// needle 길이 m >= 2 가정 (m < 2 는 find_keyword에서 처리)
+static const char *mg_find_scalar(const char *hay, size_t n, const char *needle, size_t m) {
+    if (n < m) return NULL;
+
+    const char *p = hay;
+    const char *last = hay + n - m;     // 후보 시작 위치의 최댓값
+
+    while (p <= last) {
+        p = (const char*)memchr(p, needle[0], (size_t)(last - p) + 1);
+        if (!p) return NULL;
+        if (p[m - 1] == needle[m - 1] && memcmp(p + 1, needle + 1, m - 2) == 0) {
+            return p;
+        }
+        p++;
+    }
+    return NULL;
+}
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#include <immintrin.h>
+
+static const char *mg_find_sse2(const char *hay, size_t n, const char *needle, size_t m) {
+    if (n < m) return NULL;
+
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last  = _mm_set1_epi8(needle[m - 1]);
+    size_t i = 0;
+
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        __m128i bf = _mm_loadu_si128((const __m128i*)(hay + i));
+        __m128i bl = _mm_loadu_si128((const __m128i*)(hay + i + m - 1));
+        unsigned mask = (unsigned)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(bf, first), _mm_cmpeq_epi8(bl, last)));
+
+        while (mask) {
+            unsigned bit = (unsigned)__builtin_ctz(mask);
+            if (memcmp(hay + i + bit + 1, needle + 1, m - 2) == 0) {
+                return hay + i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    // 나머지 꼬리 부분은 스칼라로
+    return mg_find_scalar(hay + i, n - i, needle, m);
+}
+
+__attribute__((target("avx2")))
+static const char *mg_find_avx2(const char *hay, size_t n, const char *needle, size_t m) {
+    if (n < m) return NULL;
+
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last  = _mm256_set1_epi8(needle[m - 1]);
+    size_t i = 0;
+
+    for (; i + m - 1 + 32 <= n; i += 32) {
+        __m256i bf = _mm256_loadu_si256((const __m256i*)(hay + i));
+        __m256i bl = _mm256_loadu_si256((const __m256i*)(hay + i + m - 1));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(bf, first), _mm256_cmpeq_epi8(bl, last)));
+
+        while (mask) {
+            unsigned bit = (unsigned)__builtin_ctz(mask);
+            if (memcmp(hay + i + bit + 1, needle + 1, m - 2) == 0) {
+                return hay + i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    return mg_find_sse2(hay + i, n - i, needle, m);
+}
+#endif
+
+#if defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+
+static const char *mg_find_neon(const char *hay, size_t n, const char *needle, size_t m) {
+    if (n < m) return NULL;
+
+    const uint8x16_t first = vdupq_n_u8((uint8_t)needle[0]);
+    const uint8x16_t last  = vdupq_n_u8((uint8_t)needle[m - 1]);
+    size_t i = 0;
+
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        uint8x16_t bf = vld1q_u8((const uint8_t*)(hay + i));
+        uint8x16_t bl = vld1q_u8((const uint8_t*)(hay + i + m - 1));
+        uint8x16_t eq = vandq_u8(vceqq_u8(bf, first), vceqq_u8(bl, last));
+
+        // movemask 대용: 바이트당 4비트짜리 64비트 마스크
+        uint64_t mask = vget_lane_u64(
+            vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+
+        while (mask) {
+            unsigned bit = (unsigned)__builtin_ctzll(mask) >> 2;
+            if (memcmp(hay + i + bit + 1, needle + 1, m - 2) == 0) {
+                return hay + i + bit;
+            }
+            mask &= ~(0xFULL << (bit * 4));
+        }
+    }
+
+    return mg_find_scalar(hay + i, n - i, needle, m);
+}
+#endif
+
+// ---- 대소문자 무시 (-i) ----
+// 파일 버퍼를 소문자로 복사하지 않고 그대로 검색: needle은 미리 소문자로 바꿔 두고
+// 후보 조건(첫/끝 바이트)을 대문자·소문자 두 값과 동시에 비교한 뒤 fold 표로 확인
+static uint8_t mg_fold_table[256];    // ASCII 대문자 -> 소문자, 나머지 바이트는 그대로
+
+static inline uint8_t mg_ascii_upper(uint8_t c) {
+    return (c >= 'a' && c <= 'z') ? (uint8_t)(c - 32) : c;
+}
+
+// a[0..n) 를 fold 한 결과가 lower[0..n) 와 같은지
+static inline int mg_icase_eq(const char *a, const char *lower, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (mg_fold_table[(uint8_t)a[i]] != (uint8_t)lower[i]) return 0;
+    }
+    return 1;
+}
+
+// needle은 소문자, 길이 m >= 1
+static const char *mg_find_icase_scalar(const char *hay, size_t n, const char *needle, size_t m) {
+    if (n < m) return NULL;
+
+    const uint8_t first = (uint8_t)needle[0], last = (uint8_t)needle[m - 1];
+    for (size_t i = 0; i + m <= n; i++) {
+        if (mg_fold_table[(uint8_t)hay[i]] == first && mg_fold_table[(uint8_t)hay[i + m - 1]] == last &&
+            (m <= 2 || mg_icase_eq(hay + i + 1, needle + 1, m - 2))) {
+            return hay + i;
+        }
+    }
+    return NULL;
+}
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+static const char *mg_find_icase_sse2(const char *hay, size_t n, const char *needle, size_t m) {
+    if (n < m) return NULL;
+
+    const __m128i f_lo = _mm_set1_epi8(needle[0]);
+    const __m128i f_up = _mm_set1_epi8((char)mg_ascii_upper((uint8_t)needle[0]));
+    const __m128i l_lo = _mm_set1_epi8(needle[m - 1]);
+    const __m128i l_up = _mm_set1_epi8((char)mg_ascii_upper((uint8_t)needle[m - 1]));
+    size_t i = 0;
+
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        __m128i bf = _mm_loadu_si128((const __m128i*)(hay + i));
+        __m128i bl = _mm_loadu_si128((const __m128i*)(hay + i + m - 1));
+        __m128i ef = _mm_or_si128(_mm_cmpeq_epi8(bf, f_lo), _mm_cmpeq_epi8(bf, f_up));
+        __m128i el = _mm_or_si128(_mm_cmpeq_epi8(bl, l_lo), _mm_cmpeq_epi8(bl, l_up));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(ef, el));
+
+        while (mask) {
+            unsigned bit = (unsigned)__builtin_ctz(mask);
+            if (m <= 2 || mg_icase_eq(hay + i + bit + 1, needle + 1, m - 2)) {
+                return hay + i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    return mg_find_icase_scalar(hay + i, n - i, needle, m);
+}
+
+__attribute__((target("avx2")))
+static const char *mg_find_icase_avx2(const char *hay, size_t n, const char *needle, size_t m) {
+    if (n < m) return NULL;
+
+    const __m256i f_lo = _mm256_set1_epi8(needle[0]);
+    const __m256i f_up = _mm256_set1_epi8((char)mg_ascii_upper((uint8_t)needle[0]));
+    const __m256i l_lo = _mm256_set1_epi8(needle[m - 1]);
+    const __m256i l_up = _mm256_set1_epi8((char)mg_ascii_upper((uint8_t)needle[m - 1]));
+    size_t i = 0;
+
+    for (; i + m - 1 + 32 <= n; i += 32) {
+        __m256i bf = _mm256_loadu_si256((const __m256i*)(hay + i));
+        __m256i bl = _mm256_loadu_si256((const __m256i*)(hay + i + m - 1));
+        __m256i ef = _mm256_or_si256(_mm256_cmpeq_epi8(bf, f_lo), _mm256_cmpeq_epi8(bf, f_up));
+        __m256i el = _mm256_or_si256(_mm256_cmpeq_epi8(bl, l_lo), _mm256_cmpeq_epi8(bl, l_up));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(ef, el));
+
+        while (mask) {
+            unsigned bit = (unsigned)__builtin_ctz(mask);
+            if (m <= 2 || mg_icase_eq(hay + i + bit + 1, needle + 1, m - 2)) {
+                return hay + i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    return mg_find_icase_sse2(hay + i, n - i, needle, m);
+}
+#endif
+
+#if defined(__aarch64__) || defined(__ARM_NEON)
+static const char *mg_find_icase_neon(const char *hay, size_t n, const char *needle, size_t m) {
+    if (n < m) return NULL;
+
+    const uint8x16_t f_lo = vdupq_n_u8((uint8_t)needle[0]);
+    const uint8x16_t f_up = vdupq_n_u8(mg_ascii_upper((uint8_t)needle[0]));
+    const uint8x16_t l_lo = vdupq_n_u8((uint8_t)needle[m - 1]);
+    const uint8x16_t l_up = vdupq_n_u8(mg_ascii_upper((uint8_t)needle[m - 1]));
+    size_t i = 0;
+
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        uint8x16_t bf = vld1q_u8((const uint8_t*)(hay + i));
+        uint8x16_t bl = vld1q_u8((const uint8_t*)(hay + i + m - 1));
+        uint8x16_t eq = vandq_u8(vorrq_u8(vceqq_u8(bf, f_lo), vceqq_u8(bf, f_up)),
+                                 vorrq_u8(vceqq_u8(bl, l_lo), vceqq_u8(bl, l_up)));
+        uint64_t mask = vget_lane_u64(
+            vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+
+        while (mask) {
+            unsigned bit = (unsigned)__builtin_ctzll(mask) >> 2;
+            if (m <= 2 || mg_icase_eq(hay + i + bit + 1, needle + 1, m - 2)) {
+                return hay + i + bit;
+            }
+            mask &= ~(0xFULL << (bit * 4));
+        }
+    }
+
+    return mg_find_icase_scalar(hay + i, n - i, needle, m);
+}
+#endif
+
+static mg_find_fn mg_find_impl = mg_find_scalar;
+static mg_find_fn mg_find_icase_impl = mg_find_icase_scalar; // -i 용, mg_find_impl 과 같은 ISA
+static const char *mg_find_impl_name = "scalar";
+static void mg_find_set_init(void); // Aho-Corasick 절에서 정의
+
+// 시작 시 1번 호출: CPU에 맞는 커널 선택
+static void mg_find_init(void) {
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        mg_find_impl = mg_find_avx2;
+        mg_find_icase_impl = mg_find_icase_avx2;
+        mg_find_impl_name = "avx2";
+    } else {
+        mg_find_impl = mg_find_sse2;
+        mg_find_icase_impl = mg_find_icase_sse2;
+        mg_find_impl_name = "sse2";
+    }
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+    mg_find_impl = mg_find_neon;
+    mg_find_icase_impl = mg_find_icase_neon;
+    mg_find_impl_name = "neon";
+#endif
+    for (int c = 0; c < 256; c++) {
+        mg_fold_table[c] = (uint8_t)((c >= 'A' && c <= 'Z') ? c + 32 : c);
+    }
+    mg_find_set_init();
+}
+
+// hay[0..n) 에서 needle[0..m) 의 첫 위치, 없으면 NULL
+// icase: needle 이 이미 소문자로 바뀌어 있어야 함 (mg_matcher_init / mg_re_compile)
+static inline const char *mg_find_keyword(const char *hay, size_t n, const char *needle, size_t m, int icase) {
+    if (m == 0) return hay;                                 // strstr(line, "") 과 동일하게 모든 줄 매칭
+    if (icase) return mg_find_icase_impl(hay, n, needle, m);
+    if (m == 1) return (const char*)memchr(hay, needle[0], n);
+    return mg_find_impl(hay, n, needle, m);
+}
+
+// [from, to) 의 줄바꿈 개수, 마지막 줄바꿈 위치는 *last_nl 에 (없으면 그대로)
+static size_t mg_count_newlines(const char *from, const char *to, const char **last_nl) {
+    size_t cnt = 0;
+    const char *p = from;
+
+    while (p < to && (p = (const char*)memchr(p, '\n', (size_t)(to - p))) != NULL) {
+        cnt++;
+        *last_nl = p;
+        p++;
+    }
+    return cnt;
+}
+
+// -------------------- 파일 읽기 (mmap / 통째로 read) --------------------
+// 줄 단위 fgets 대신 파일 전체를 한 번에 메모리로 가져와서 버퍼 단위로 검색
+// 작은 파일은 재사용 버퍼에 read (mmap/munmap 비용이 더 큼), 큰 파일은 mmap
+#define MG_MMAP_THRESHOLD (256 * 1024)
+
+typedef struct {
+    const char *data;
+    size_t len;
+    int mapped;            // 1이면 munmap 필요
+} MgFileBuf;
+
+static int mg_buf_reserve(char **buf, size_t *cap, size_t need) {
+    if (need <= *cap) return 0;
+
+    size_t new_cap = *cap ? *cap : 64 * 1024;
+    while (new_cap < need) new_cap *= 2;
+
+    char *nb = (char*)realloc(*buf, new_cap);
+    if (!nb) return -1;
+    *buf = nb;
+    *cap = new_cap;
+    return 0;
+}
+
+// 성공 0, 실패 -1
+// *buf / *cap : 호출자가 재사용하는 read 버퍼 (필요하면 늘림)
+static int mg_file_load(int fd, off_t size, char **buf, size_t *cap, MgFileBuf *fb) {
+    fb->data = NULL;
+    fb->len = 0;
+    fb->mapped = 0;
+
+    if (size >= MG_MMAP_THRESHOLD) {
+        void *p = mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            posix_madvise(p, (size_t)size, POSIX_MADV_SEQUENTIAL);
+            fb->data = (const char*)p;
+            fb->len = (size_t)size;
+            fb->mapped = 1;
+            return 0;
+        }
+        // mmap 실패 시 read로 대체
+    }
+
+    // size + 1 만큼 잡아두면 보통 read 2번(데이터 + EOF)으로 끝남
+    // size가 0으로 보고되는 특수 파일도 EOF까지 읽음
+    size_t len = 0;
+    if (mg_buf_reserve(buf, cap, (size > 0 ? (size_t)size : 0) + 1) != 0) return -1;
+
+    while (1) {
+        if (len == *cap && mg_buf_reserve(buf, cap, *cap * 2) != 0) return -1;
+
+        ssize_t r = read(fd, *buf + len, *cap - len);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (r == 0) break;
+        len += (size_t)r;
+    }
+
+    fb->data = *buf;
+    fb->len = len;
+    return 0;
+}
+
+static void mg_file_release(MgFileBuf *fb) {
+    if (fb->mapped) {
+        munmap((void*)fb->data, fb->len);
+    }
+    fb->data = NULL;
+    fb->len = 0;
+    fb->mapped = 0;
+}
+
+// 앞부분 MG_BINARY_PROBE 바이트 안에 NUL이 있으면 바이너리로 보고 건너뜀 (grep과 같은 판정)
+// 큰 파일은 mmap이라 앞 페이지만 읽힘
+#define MG_BINARY_PROBE 8192
+
+static inline int mg_is_binary(const MgFileBuf *fb) {
+    return memchr(fb->data, '\0', fb->len < MG_BINARY_PROBE ? fb->len : MG_BINARY_PROBE) != NULL;
+}
+
+// -------------------- 다중 패턴 매처 (Aho-Corasick) --------------------
+// -e 여러 개 / -f 파일로 받은 패턴을 파일 1회 통과로 모두 찾음
+// - 바이트를 "패턴에 나오는 바이트 + 나머지 1개" 클래스로 압축 -> 전이 표가 작아서 캐시에 머묾
+// - 실패 링크를 미리 반영한 완전한 DFA 표: 바이트마다 표 조회 1번, 분기 없음
+// - 시작 상태에서는 패턴 첫 바이트가 나올 때까지 SIMD로 건너뜀
+typedef struct {
+    uint32_t *delta;       // [state * nclasses + class] -> 다음 상태
+    uint32_t *out_len;     // 이 상태에서 끝나는 가장 긴 패턴 길이 (0 = 없음)
+    int32_t  *out_pat;     // 그 패턴 번호
+    uint8_t cls[256];      // 바이트 -> 클래스 (패턴에 없는 바이트는 모두 0)
+    int nclasses;
+    uint32_t nstates;
+    size_t max_len;        // 가장 긴 패턴 길이
+
+    uint8_t is_start[256]; // 패턴 첫 바이트 여부
+    uint8_t start_set[4];  // 첫 바이트 종류가 4개 이하일 때 SIMD 건너뛰기용
+    int nstart;
+    // 첫 바이트가 더 많을 때: 바이트 b가 후보 <=> (nib_lo[b & 15] & nib_hi[b >> 4]) != 0
+    // (pshufb/tbl 2번으로 16/32바이트를 한 번에 판정, 오탐은 is_start로 다시 확인)
+    uint8_t nib_lo[16];
+    uint8_t nib_hi[16];
+} MgAhoCorasick;
+
+#define MG_AC_NONE UINT32_MAX
+
+// set[0..4) 중 하나와 같은 첫 바이트 위치 (set은 중복으로 4칸 채워져 있음)
+static const uint8_t *mg_find_any4_scalar(const uint8_t *p, const uint8_t *end, const uint8_t *set) {
+    for (; p < end; p++) {
+        uint8_t c = *p;
+        if (c == set[0] || c == set[1] || c == set[2] || c == set[3]) return p;
+    }
+    return NULL;
+}
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+static const uint8_t *mg_find_any4(const uint8_t *p, const uint8_t *end, const uint8_t *set) {
+    const __m128i v0 = _mm_set1_epi8((char)set[0]);
+    const __m128i v1 = _mm_set1_epi8((char)set[1]);
+    const __m128i v2 = _mm_set1_epi8((char)set[2]);
+    const __m128i v3 = _mm_set1_epi8((char)set[3]);
+
+    for (; end - p >= 16; p += 16) {
+        __m128i b = _mm_loadu_si128((const __m128i*)p);
+        __m128i eq = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(b, v0), _mm_cmpeq_epi8(b, v1)),
+                                  _mm_or_si128(_mm_cmpeq_epi8(b, v2), _mm_cmpeq_epi8(b, v3)));
+        unsigned mask = (unsigned)_mm_movemask_epi8(eq);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return mg_find_any4_scalar(p, end, set);
+}
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+static const uint8_t *mg_find_any4(const uint8_t *p, const uint8_t *end, const uint8_t *set) {
+    const uint8x16_t v0 = vdupq_n_u8(set[0]);
+    const uint8x16_t v1 = vdupq_n_u8(set[1]);
+    const uint8x16_t v2 = vdupq_n_u8(set[2]);
+    const uint8x16_t v3 = vdupq_n_u8(set[3]);
+
+    for (; end - p >= 16; p += 16) {
+        uint8x16_t b = vld1q_u8(p);
+        uint8x16_t eq = vorrq_u8(vorrq_u8(vceqq_u8(b, v0), vceqq_u8(b, v1)),
+                                 vorrq_u8(vceqq_u8(b, v2), vceqq_u8(b, v3)));
+        uint64_t mask = vget_lane_u64(
+            vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        if (mask) return p + (__builtin_ctzll(mask) >> 2);
+    }
+    return mg_find_any4_scalar(p, end, set);
+}
+#else
+#define mg_find_any4 mg_find_any4_scalar
+#endif
+
+// 임의의 바이트 집합 건너뛰기 (nibble 표 방식), 후보 위치 반환 (is_start로 재확인 필요)
+typedef const uint8_t *(*mg_find_set_fn)(const uint8_t *p, const uint8_t *end,
+                                      const uint8_t *lo, const uint8_t *hi);
+
+static const uint8_t *mg_find_set_scalar(const uint8_t *p, const uint8_t *end,
+                                      const uint8_t *lo, const uint8_t *hi) {
+    for (; p < end; p++) {
+        if (lo[*p & 15] & hi[*p >> 4]) return p;
+    }
+    return NULL;
+}
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+__attribute__((target("avx2")))
+static const uint8_t *mg_find_set_avx2(const uint8_t *p, const uint8_t *end,
+                                    const uint8_t *lo, const uint8_t *hi) {
+    const __m256i tlo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)lo));
+    const __m256i thi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)hi));
+    const __m256i low4 = _mm256_set1_epi8(0x0F);
+    const __m256i zero = _mm256_setzero_si256();
+
+    for (; end - p >= 32; p += 32) {
+        __m256i b = _mm256_loadu_si256((const __m256i*)p);
+        __m256i l = _mm256_shuffle_epi8(tlo, _mm256_and_si256(b, low4));
+        __m256i h = _mm256_shuffle_epi8(thi, _mm256_and_si256(_mm256_srli_epi16(b, 4), low4));
+        __m256i hit = _mm256_cmpeq_epi8(_mm256_and_si256(l, h), zero);
+        unsigned mask = ~(unsigned)_mm256_movemask_epi8(hit);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return mg_find_set_scalar(p, end, lo, hi);
+}
+#elif defined(__aarch64__)
+static const uint8_t *mg_find_set_neon(const uint8_t *p, const uint8_t *end,
+                                    const uint8_t *lo, const uint8_t *hi) {
+    const uint8x16_t tlo = vld1q_u8(lo);
+    const uint8x16_t thi = vld1q_u8(hi);
+    const uint8x16_t low4 = vdupq_n_u8(0x0F);
+
+    for (; end - p >= 16; p += 16) {
+        uint8x16_t b = vld1q_u8(p);
+        uint8x16_t l = vqtbl1q_u8(tlo, vandq_u8(b, low4));
+        uint8x16_t h = vqtbl1q_u8(thi, vshrq_n_u8(b, 4));
+        uint8x16_t hit = vtstq_u8(l, h);
+        uint64_t mask = vget_lane_u64(
+            vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hit), 4)), 0);
+        if (mask) return p + (__builtin_ctzll(mask) >> 2);
+    }
+    return mg_find_set_scalar(p, end, lo, hi);
+}
+#endif
+
+static mg_find_set_fn mg_find_set_impl = mg_find_set_scalar;
+
+// mg_find_init() 에서 함께 호출
+static void mg_find_set_init(void) {
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+    if (__builtin_cpu_supports("avx2")) mg_find_set_impl = mg_find_set_avx2;
+#elif defined(__aarch64__)
+    mg_find_set_impl = mg_find_set_neon;
+#endif
+}
+
+// 시작 상태에서 다음 후보(패턴 첫 바이트) 위치까지 건너뛰기, 없으면 NULL
+static inline const uint8_t *mg_ac_skip(const MgAhoCorasick *ac, const uint8_t *p, const uint8_t *end) {
+    if (ac->nstart <= 4) return mg_find_any4(p, end, ac->start_set);
+
+    while ((p = mg_find_set_impl(p, end, ac->nib_lo, ac->nib_hi)) != NULL) {
+        if (ac->is_start[*p]) return p;
+        p++;    // nibble 표의 오탐
+    }
+    return NULL;
+}
+
+static void mg_ac_free(MgAhoCorasick *ac);
+
+// icase: 패턴이 소문자로 들어옴 (대문자도 같은 바이트 클래스로)
+// 메모리가 부족하면 -1 (ac 는 빈 상태, mg_ac_free 해도 됨)
+static int mg_ac_build(MgAhoCorasick *ac, const char *const *pats, const size_t *lens, int npats, int icase) {
+    memset(ac, 0, sizeof(*ac));
+
+    // 1) 바이트 클래스
+    int nc = 1;
+    for (int i = 0; i < npats; i++) {
+        for (size_t j = 0; j < lens[i]; j++) {
+            uint8_t b = (uint8_t)pats[i][j];
+            if (ac->cls[b] == 0) ac->cls[b] = (uint8_t)nc++;
+        }
+        if (lens[i] > ac->max_len) ac->max_len = lens[i];
+        if (lens[i] > 0) ac->is_start[(uint8_t)pats[i][0]] = 1;
+    }
+    // -i: 패턴은 소문자로 들어옴 -> 대문자를 같은 클래스로 묶어서 표 크기는 그대로
+    if (icase) {
+        for (int c = 'a'; c <= 'z'; c++) {
+            ac->cls[c - 32] = ac->cls[c];
+            ac->is_start[c - 32] = ac->is_start[c];
+        }
+    }
+    ac->nclasses = nc;
+
+    for (int b = 0; b < 256; b++) {
+        if (!ac->is_start[b]) continue;
+        if (ac->nstart < 4) ac->start_set[ac->nstart] = (uint8_t)b;
+        ac->nstart++;
+    }
+    for (int i = ac->nstart; i < 4 && ac->nstart > 0; i++) {
+        ac->start_set[i] = ac->start_set[0];     // 빈 칸은 첫 바이트로 채움
+    }
+
+    // nibble 표: 상위 nibble 값마다 비트 하나 (8개 넘으면 비트를 공유 -> 오탐만 늘어남)
+    for (int b = 0; b < 256; b++) {
+        if (!ac->is_start[b]) continue;
+        uint8_t bit = (uint8_t)(1u << ((b >> 4) & 7));
+        ac->nib_hi[b >> 4] |= bit;
+        ac->nib_lo[b & 15] |= bit;
+    }
+
+    // 2) trie (상태 수 상한 = 전체 패턴 길이 + 1)
+    size_t max_states = 1;
+    for (int i = 0; i < npats; i++) max_states += lens[i];
+
+    ac->delta   = (uint32_t*)malloc(max_states * (size_t)nc * sizeof(uint32_t));
+    ac->out_len = (uint32_t*)calloc(max_states, sizeof(uint32_t));
+    ac->out_pat = (int32_t*)malloc(max_states * sizeof(int32_t));
+    uint32_t *fail  = (uint32_t*)calloc(max_states, sizeof(uint32_t));
+    uint32_t *queue = (uint32_t*)malloc(max_states * sizeof(uint32_t));
+    if (!ac->delta || !ac->out_len || !ac->out_pat || !fail || !queue) {
+        mg_ac_free(ac);
+        memset(ac, 0, sizeof(*ac));
+        free(fail);
+        free(queue);
+        return -1;
+    }
+    for (size_t i = 0; i < max_states * (size_t)nc; i++) ac->delta[i] = MG_AC_NONE;
+    for (size_t i = 0; i < max_states; i++) ac->out_pat[i] = -1;
+
+    uint32_t nstates = 1;
+    for (int i = 0; i < npats; i++) {
+        uint32_t st = 0;
+        for (size_t j = 0; j < lens[i]; j++) {
+            uint32_t *slot = &ac->delta[(size_t)st * nc + ac->cls[(uint8_t)pats[i][j]]];
+            if (*slot == MG_AC_NONE) *slot = nstates++;
+            st = *slot;
+        }
+        if (ac->out_pat[st] < 0) {       // 중복 패턴은 앞 번호 유지
+            ac->out_pat[st] = i;
+            ac->out_len[st] = (uint32_t)lens[i];
+        }
+    }
+    ac->nstates = nstates;
+
+    // 3) BFS로 실패 링크 계산 + 빠진 전이를 채워 DFA로
+    size_t qh = 0, qt = 0;
+    for (int c = 0; c < nc; c++) {
+        uint32_t *slot = &ac->delta[c];
+        if (*slot == MG_AC_NONE) {
+            *slot = 0;
+        } else {
+            fail[*slot] = 0;
+            queue[qt++] = *slot;
+        }
+    }
+    while (qh < qt) {
+        uint32_t u = queue[qh++];
+        // 자기 패턴이 없으면 실패 링크 쪽의 가장 긴 출력을 물려받음 (자기 것이 있으면 그게 가장 김)
+        if (ac->out_len[u] == 0) {
+            ac->out_len[u] = ac->out_len[fail[u]];
+            ac->out_pat[u] = ac->out_pat[fail[u]];
+        }
+        for (int c = 0; c < nc; c++) {
+            uint32_t *slot = &ac->delta[(size_t)u * nc + c];
+            uint32_t via_fail = ac->delta[(size_t)fail[u] * nc + c];
+            if (*slot == MG_AC_NONE) {
+                *slot = via_fail;
+            } else {
+                fail[*slot] = via_fail;
+                queue[qt++] = *slot;
+            }
+        }
+    }
+
+    free(fail);
+    free(queue);
+    return 0;
+}
+
+static void mg_ac_free(MgAhoCorasick *ac) {
+    free(ac->delta);
+    free(ac->out_len);
+    free(ac->out_pat);
+}
+
+// 가장 먼저 "끝나는" 매칭의 시작 위치 (줄 단위 판정용), 없으면 NULL
+static const char *mg_ac_find(const MgAhoCorasick *ac, const char *hay, size_t n, size_t *mlen) {
+    const uint8_t *p = (const uint8_t*)hay;
+    const uint8_t *end = p + n;
+    const uint32_t *delta = ac->delta;
+    const int nc = ac->nclasses;
+    uint32_t st = 0;
+
+    while (p < end) {
+        if (st == 0) {
+            p = mg_ac_skip(ac, p, end);
+            if (!p) return NULL;
+        }
+        st = delta[(size_t)st * nc + ac->cls[*p]];
+        p++;
+        if (ac->out_len[st]) {
+            *mlen = ac->out_len[st];
+            return (const char*)p - ac->out_len[st];
+        }
+    }
+    return NULL;
+}
+
+// hay[0..n) 에서 가장 왼쪽(같으면 가장 긴) 매칭 (강조 출력용)
+// 더 왼쪽에서 시작하는 매칭은 best 시작 + max_len 안에서 끝나야 하므로 거기까지만 더 봄
+static int mg_ac_next_span(const MgAhoCorasick *ac, const char *hay, size_t n,
+                        size_t *off, size_t *len, int *pat) {
+    const uint8_t *base = (const uint8_t*)hay;
+    const uint8_t *p = base;
+    const uint8_t *end = base + n;
+    const int nc = ac->nclasses;
+    uint32_t st = 0;
+    size_t best_s = SIZE_MAX, best_e = 0;
+    int best_pat = -1;
+
+    while (p < end) {
+        if (st == 0 && best_pat < 0) {
+            p = mg_ac_skip(ac, p, end);
+            if (!p) break;
+        }
+        st = ac->delta[(size_t)st * nc + ac->cls[*p]];
+        p++;
+
+        size_t e = (size_t)(p - base);
+        if (ac->out_len[st]) {
+            size_t s = e - ac->out_len[st];
+            if (s < best_s || (s == best_s && e > best_e)) {
+                best_s = s;
+                best_e = e;
+                best_pat = ac->out_pat[st];
+            }
+        }
+        if (best_pat >= 0 && e >= best_s + ac->max_len) break;
+    }
+
+    if (best_pat < 0) return 0;
+    *off = best_s;
+    *len = best_e - best_s;
+    *pat = best_pat;
+    return 1;
+}
+
+// -------------------- 정규식 (-E, DFA) --------------------
+// POSIX ERE (grep -E) 를 backtracking 없이 DFA로 실행 -> 입력 길이에 선형 시간
+// - 파싱: 패턴 -> AST, AST -> Thompson NFA (정방향 + 역방향)
+// - NFA -> DFA는 시작 시 미리 모두 만듦 (worker들이 lock 없이 표만 읽음)
+// - 바이트는 문자 집합 경계로 클래스 분할 -> 전이 표 = 상태 수 x 클래스 수
+// - 패턴에서 "모든 매칭에 반드시 들어가는 리터럴"을 뽑아 SIMD/Aho-Corasick 로 먼저 찾고
+//   그 후보 줄에서만 DFA 실행
+// - 바이트 단위 (LC_ALL=C 의 grep 과 동일), 역참조 / 단어 경계(\b, \<) 는 미지원
+#define MG_RE_DUP_MAX      255    // {n,m} 상한 (POSIX RE_DUP_MAX)
+#define MG_RE_MAX_NODES    200000 // NFA 노드 상한
+#define MG_RE_MAX_STATES   20000  // DFA 상태 상한 (넘으면 에러)
+#define MG_RE_LIT_MAX      64     // prefilter 리터럴 최대 길이
+#define MG_RE_REQ_MAX      16     // prefilter 리터럴 최대 개수 (alternation)
+
+typedef uint64_t MgReSet[4];      // 256비트 바이트 집합
+
+typedef enum {
+    MG_RA_SET = 0,  // 바이트 집합 1개 (리터럴 / . / [...])
+    MG_RA_EMPTY,
+    MG_RA_BOL,      // ^
+    MG_RA_EOL,      // $
+    MG_RA_CAT,
+    MG_RA_ALT,
+    MG_RA_REP       // a{min,max}, max < 0 이면 무한
+} MgReAstOp;
+
+typedef struct {
+    uint8_t op;
+    int a, b;
+    int min, max;
+    int set;
+} MgReAst;
+
+typedef enum {
+    MG_RN_SET = 0,  // 바이트 1개 소비
+    MG_RN_SPLIT,
+    MG_RN_BOL,
+    MG_RN_EOL,
+    MG_RN_MATCH
+} MgReNodeOp;
+
+typedef struct {
+    uint8_t op;
+    int set;
+    int out, out1;
+} MgReNode;
+
+typedef struct {
+    MgReNode *nodes;
+    int n, cap;
+    int start;
+    int nomem;              // mg_re_new_node 가 -1 을 돌려준 이유가 메모리 부족
+} MgReProg;
+
+#define MG_RE_ACC      1u   // 이 상태에서 매칭 끝
+#define MG_RE_ACC_EOL  2u   // 줄 끝이라면 매칭 끝 ($ 포함, MG_RE_ACC 이면 항상 설정)
+
+typedef struct {
+    uint32_t *delta;        // [state * nclass + class] -> 다음 상태, 상태 0 = dead
+    uint8_t  *acc;          // MG_RE_ACC / MG_RE_ACC_EOL
+    uint32_t nstates;
+    uint32_t start_bol;     // 줄 시작에서의 시작 상태
+    uint32_t start_mid;     // 줄 중간에서의 시작 상태
+
+    // start_mid 에서 벗어나는 바이트가 적으면 그 바이트까지 SIMD로 건너뜀 (mg_ac_skip 과 같은 nibble 표)
+    int has_skip;
+    uint8_t is_escape[256];
+    uint8_t skip_lo[16];
+    uint8_t skip_hi[16];
+} MgReDfa;
+
+#define MG_RE_SKIP_MAX 32   // 벗어나는 바이트가 이보다 많으면 건너뛰기 안 함
+
+typedef struct {
+    MgReSet *sets;
+    int nsets;
+    uint8_t cls[256];
+    uint32_t nclass;
+
+    MgReDfa line;           // 정방향, 비고정: 줄 안 어딘가에 매칭이 있는지
+    MgReDfa anch;           // 정방향, 시작 고정: 주어진 위치에서 가장 긴 매칭
+    MgReDfa back;           // 역방향, 비고정: 매칭이 시작될 수 있는 위치
+
+    // prefilter (nlits == 0 이면 없음)
+    char *lits[MG_RE_REQ_MAX];
+    size_t lit_lens[MG_RE_REQ_MAX];
+    int nlits;
+    MgAhoCorasick lit_ac;   // nlits > 1 일 때
+
+    int literal_only;       // 패턴 전체가 리터럴 (lits 가 곧 패턴) -> 정규식 실행 불필요
+    int icase;              // -i 로 컴파일 (lits 는 소문자)
+} MgRegex;
+
+// --- 파서 ---
+typedef struct {
+    const char *p, *end;
+    MgReAst *ast;
+    int n, cap;
+    MgReSet *sets;
+    int nsets, setcap;
+    int has_anchor;
+    int icase;              // -i: 문자 / 대괄호 집합에 대소문자 짝을 함께 넣음
+    const char *err;
+} MgReParser;
+
+// 새 노드 번호, 메모리가 부족하면 -1 + ps->err (아래 파서 함수들도 -1 이면 ps->err 설정됨)
+static int mg_re_new_ast(MgReParser *ps, int op, int a, int b) {
+    if (ps->n == ps->cap) {
+        int cap = ps->cap ? ps->cap * 2 : 64;
+        MgReAst *na = (MgReAst*)realloc(ps->ast, (size_t)cap * sizeof(MgReAst));
+        if (!na) {
+            ps->err = MG_ERR_NOMEM;
+            return -1;
+        }
+        ps->ast = na;
+        ps->cap = cap;
+    }
+    MgReAst *x = &ps->ast[ps->n];
+    x->op = (uint8_t)op;
+    x->a = a;
+    x->b = b;
+    x->min = x->max = 0;
+    x->set = -1;
+    return ps->n++;
+}
+
+static int mg_re_new_set(MgReParser *ps) {
+    if (ps->nsets == ps->setcap) {
+        int cap = ps->setcap ? ps->setcap * 2 : 16;
+        MgReSet *ns = (MgReSet*)realloc(ps->sets, (size_t)cap * sizeof(MgReSet));
+        if (!ns) {
+            ps->err = MG_ERR_NOMEM;
+            return -1;
+        }
+        ps->sets = ns;
+        ps->setcap = cap;
+    }
+    memset(ps->sets[ps->nsets], 0, sizeof(MgReSet));
+    return ps->nsets++;
+}
+
+static inline void mg_reset_add(uint64_t *s, int c) { s[(uint8_t)c >> 6] |= 1ull << ((uint8_t)c & 63); }
+static inline int mg_reset_has(const uint64_t *s, int c) { return (int)((s[(uint8_t)c >> 6] >> ((uint8_t)c & 63)) & 1); }
+
+static void mg_reset_negate(uint64_t *s) {
+    for (int i = 0; i < 4; i++) s[i] = ~s[i];
+    s['\n' >> 6] &= ~(1ull << ('\n' & 63));     // 어떤 집합도 줄바꿈은 매칭하지 않음
+}
+
+static inline int mg_re_is_postfix(char c) {
+    return c == '*' || c == '+' || c == '?' || c == '{';
+}
+
+static int mg_re_set_node(MgReParser *ps, int set) {
+    if (set < 0) return -1;
+    int x = mg_re_new_ast(ps, MG_RA_SET, -1, -1);
+    if (x >= 0) ps->ast[x].set = set;
+    return x;
+}
+
+// -i: 집합에 든 ASCII 글자의 대/소문자 짝을 함께 추가
+static void mg_reset_fold(uint64_t *s) {
+    for (int c = 'a'; c <= 'z'; c++) {
+        if (mg_reset_has(s, c) || mg_reset_has(s, c - 32)) {
+            mg_reset_add(s, c);
+            mg_reset_add(s, c - 32);
+        }
+    }
+}
+
+static int mg_re_char_node(MgReParser *ps, int c) {
+    int s = mg_re_new_set(ps);
+    if (s < 0) return -1;
+    mg_reset_add(ps->sets[s], c);
+    if (ps->icase) mg_reset_fold(ps->sets[s]);
+    return mg_re_set_node(ps, s);
+}
+
+// --- -i 의 UTF-8 처리 ---
+// 대소문자 짝이 1:1 인 문자(Latin-1, Latin Extended-A, 그리스, 키릴)만 지원
+// 짝이 있는 문자는 "원래 바이트열 | 짝의 바이트열" 로 파싱 (바이트 단위 DFA 그대로 사용)
+static uint32_t mg_utf8_case_mate(uint32_t cp) {
+    if (cp >= 0xC0 && cp <= 0xDE && cp != 0xD7) return cp + 0x20;      // À-Þ -> à-þ
+    if (cp >= 0xE0 && cp <= 0xFE && cp != 0xF7) return cp - 0x20;
+    if (cp == 0xFF) return 0x178;                                       // ÿ <-> Ÿ
+    if (cp == 0x178) return 0xFF;
+    if ((cp >= 0x100 && cp <= 0x12F) || (cp >= 0x132 && cp <= 0x137) ||
+        (cp >= 0x14A && cp <= 0x177)) {
+        return cp ^ 1;                                                  // 짝수 = 대문자
+    }
+    if ((cp >= 0x139 && cp <= 0x148) || (cp >= 0x179 && cp <= 0x17E)) {
+        return (cp & 1) ? cp + 1 : cp - 1;                              // 홀수 = 대문자
+    }
+    if (cp >= 0x391 && cp <= 0x3A9 && cp != 0x3A2) return cp + 0x20;    // Α-Ω -> α-ω
+    if (cp >= 0x3B1 && cp <= 0x3C9 && cp != 0x3C2) return cp - 0x20;    // (ς 는 짝 없음)
+    if (cp >= 0x400 && cp <= 0x40F) return cp + 0x50;                   // Ѐ-Џ -> ѐ-џ
+    if (cp >= 0x450 && cp <= 0x45F) return cp - 0x50;
+    if (cp >= 0x410 && cp <= 0x42F) return cp + 0x20;                   // А-Я -> а-я
+    if (cp >= 0x430 && cp <= 0x44F) return cp - 0x20;
+    return 0;
+}
+
+// 2바이트 UTF-8 문자만 해석 (위 범위는 모두 U+0080..U+07FF), 아니면 0
+static int mg_utf8_decode2(const char *p, const char *end, uint32_t *cp) {
+    uint8_t c0 = (uint8_t)p[0];
+    if (c0 < 0xC2 || c0 > 0xDF || p + 1 >= end) return 0;
+    uint8_t c1 = (uint8_t)p[1];
+    if ((c1 & 0xC0) != 0x80) return 0;
+    *cp = ((uint32_t)(c0 & 0x1F) << 6) | (c1 & 0x3F);
+    return 2;
+}
+
+// 바이트 2개를 이은 AST
+static int mg_re_pair_node(MgReParser *ps, uint8_t b0, uint8_t b1) {
+    int a = mg_re_char_node(ps, b0);
+    int b = mg_re_char_node(ps, b1);
+    if (a < 0 || b < 0) return -1;
+    return mg_re_new_ast(ps, MG_RA_CAT, a, b);
+}
+
+// ps->p - 1 에서 시작하는 문자가 짝 있는 UTF-8 문자면 (원래 | 짝) 노드, 아니면 -1 (ps->err 이면 실패)
+static int mg_re_utf8_fold_node(MgReParser *ps) {
+    const char *p = ps->p - 1;
+    uint32_t cp, mate;
+    if (!mg_utf8_decode2(p, ps->end, &cp) || (mate = mg_utf8_case_mate(cp)) == 0) return -1;
+
+    int a = mg_re_pair_node(ps, (uint8_t)p[0], (uint8_t)p[1]);
+    int b = mg_re_pair_node(ps, (uint8_t)(0xC0 | (mate >> 6)), (uint8_t)(0x80 | (mate & 0x3F)));
+    ps->p++;
+    if (a < 0 || b < 0) return -1;
+    return mg_re_new_ast(ps, MG_RA_ALT, a, b);
+}
+
+// [:name:] -> 집합에 추가, 모르는 이름이면 -1
+static int mg_re_add_class(uint64_t *s, const char *name, size_t n) {
+    static const struct { const char *name; int (*fn)(int); } classes[] = {
+        {"alpha", isalpha}, {"digit", isdigit}, {"alnum", isalnum}, {"upper", isupper},
+        {"lower", islower}, {"space", isspace}, {"blank", isblank}, {"punct", ispunct},
+        {"print", isprint}, {"graph", isgraph}, {"cntrl", iscntrl}, {"xdigit", isxdigit},
+    };
+    for (size_t i = 0; i < sizeof(classes) / sizeof(classes[0]); i++) {
+        if (strlen(classes[i].name) == n && memcmp(classes[i].name, name, n) == 0) {
+            for (int c = 0; c < 128; c++) {
+                if (classes[i].fn(c)) mg_reset_add(s, c);
+            }
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static void mg_re_add_word(uint64_t *s) {
+    mg_re_add_class(s, "alnum", 5);
+    mg_reset_add(s, '_');
+}
+
+// '[' 다음부터 ']' 까지
+static int mg_re_parse_bracket(MgReParser *ps) {
+    int set = mg_re_new_set(ps);
+    int negate = 0;
+    if (set < 0) return -1;
+
+    if (ps->p < ps->end && *ps->p == '^') {
+        negate = 1;
+        ps->p++;
+    }
+
+    int first = 1;
+    while (ps->p < ps->end && (*ps->p != ']' || first)) {
+        first = 0;
+        int lo;
+
+        if (ps->p[0] == '[' && ps->p + 1 < ps->end && ps->p[1] == ':') {
+            const char *name = ps->p + 2;
+            const char *close = name;
+            while (close + 1 < ps->end && !(close[0] == ':' && close[1] == ']')) close++;
+            if (close + 1 >= ps->end) {
+                ps->err = "대괄호 '[' 가 닫히지 않았습니다";
+                return -1;
+            }
+            if (mg_re_add_class(ps->sets[set], name, (size_t)(close - name)) != 0) {
+                ps->err = "알 수 없는 문자 클래스 [:이름:]";
+                return -1;
+            }
+            ps->p = close + 2;
+            continue;
+        }
+        if (ps->p[0] == '[' && ps->p + 4 < ps->end && (ps->p[1] == '.' || ps->p[1] == '=') &&
+            ps->p[3] == ps->p[1] && ps->p[4] == ']') {
+            lo = (uint8_t)ps->p[2];     // [.x.] / [=x=] : 한 글자만 지원
+            ps->p += 5;
+        } else {
+            lo = (uint8_t)*ps->p++;
+        }
+
+        // 범위 a-z ('-' 가 마지막이면 리터럴)
+        if (ps->p + 1 < ps->end && ps->p[0] == '-' && ps->p[1] != ']') {
+            int hi = (uint8_t)ps->p[1];
+            ps->p += 2;
+            if (hi < lo) {
+                ps->err = "잘못된 문자 범위";
+                return -1;
+            }
+            for (int c = lo; c <= hi; c++) mg_reset_add(ps->sets[set], c);
+        } else {
+            mg_reset_add(ps->sets[set], lo);
+        }
+    }
+    if (ps->p >= ps->end) {
+        ps->err = "대괄호 '[' 가 닫히지 않았습니다";
+        return -1;
+    }
+    ps->p++;    // ']'
+
+    if (ps->icase) mg_reset_fold(ps->sets[set]);  // [^a] 는 a, A 둘 다 제외
+    if (negate) mg_reset_negate(ps->sets[set]);
+    return mg_re_set_node(ps, set);
+}
+
+// {n} {n,} {,m} {n,m}, 형식이 아니면 0 (GNU grep처럼 '{' 를 리터럴로)
+static int mg_re_parse_interval(MgReParser *ps, int *min, int *max) {
+    const char *q = ps->p + 1;
+    long lo = -1, hi;
+
+    if (q < ps->end && *q >= '0' && *q <= '9') {
+        lo = 0;
+        for (; q < ps->end && *q >= '0' && *q <= '9'; q++) {
+            if (lo <= MG_RE_DUP_MAX) lo = lo * 10 + (*q - '0');
+        }
+    }
+    if (q < ps->end && *q == ',') {
+        q++;
+        hi = -1;
+        if (q < ps->end && *q >= '0' && *q <= '9') {
+            hi = 0;
+            for (; q < ps->end && *q >= '0' && *q <= '9'; q++) {
+                if (hi <= MG_RE_DUP_MAX) hi = hi * 10 + (*q - '0');
+            }
+        }
+        if (lo < 0) lo = 0;
+    } else {
+        if (lo < 0) return 0;
+        hi = lo;
+    }
+    if (q >= ps->end || *q != '}') return 0;
+
+    if (lo > MG_RE_DUP_MAX || hi > MG_RE_DUP_MAX || (hi >= 0 && hi < lo)) {
+        ps->err = "잘못된 반복 횟수 {n,m}";
+        return -1;
+    }
+    ps->p = q + 1;
+    *min = (int)lo;
+    *max = (int)hi;
+    return 1;
+}
+
+static int mg_re_parse_alt(MgReParser *ps, int depth);
+
+static int mg_re_parse_atom(MgReParser *ps, int depth) {
+    int c = (uint8_t)*ps->p++;
+
+    switch (c) {
+    case '(': {
+        int x = mg_re_parse_alt(ps, depth + 1);
+        if (x < 0) return -1;
+        if (ps->p >= ps->end || *ps->p != ')') {
+            ps->err = "괄호 '(' 가 닫히지 않았습니다";
+            return -1;
+        }
+        ps->p++;
+        return x;
+    }
+    case '.': {
+        int s = mg_re_new_set(ps);
+        if (s < 0) return -1;
+        mg_reset_negate(ps->sets[s]);
+        return mg_re_set_node(ps, s);
+    }
+    case '[':
+        return mg_re_parse_bracket(ps);
+    case '^':
+        ps->has_anchor = 1;
+        return mg_re_new_ast(ps, MG_RA_BOL, -1, -1);
+    case '$':
+        ps->has_anchor = 1;
+        return mg_re_new_ast(ps, MG_RA_EOL, -1, -1);
+    case '\\': {
+        if (ps->p >= ps->end) {
+            ps->err = "패턴이 '\\' 로 끝납니다";
+            return -1;
+        }
+        int e = (uint8_t)*ps->p++;
+        if (e >= '1' && e <= '9') {
+            ps->err = "역참조(\\1 ~ \\9)는 지원하지 않습니다";
+            return -1;
+        }
+        if (e == 'b' || e == 'B' || e == '<' || e == '>' || e == '`' || e == '\'') {
+            ps->err = "단어/버퍼 경계(\\b, \\<, \\> 등)는 지원하지 않습니다";
+            return -1;
+        }
+        if (e == 'w' || e == 'W' || e == 's' || e == 'S') {
+            int s = mg_re_new_set(ps);
+            if (s < 0) return -1;
+            if (e == 'w' || e == 'W') mg_re_add_word(ps->sets[s]);
+            else mg_re_add_class(ps->sets[s], "space", 5);
+            if (e == 'W' || e == 'S') mg_reset_negate(ps->sets[s]);
+            return mg_re_set_node(ps, s);
+        }
+        return mg_re_char_node(ps, e);
+    }
+    default:
+        if (ps->icase && c >= 0xC2) {
+            int x = mg_re_utf8_fold_node(ps);
+            if (x >= 0) return x;
+            if (ps->err) return -1;
+        }
+        return mg_re_char_node(ps, c);
+    }
+}
+
+static int mg_re_parse_cat(MgReParser *ps, int depth) {
+    int left = -1;
+
+    while (ps->p < ps->end && *ps->p != '|' && !(*ps->p == ')' && depth > 0)) {
+        int x;
+        // 앞에 반복할 대상이 없는 * + ? { 는 리터럴 (GNU grep -E 와 동일)
+        if (left < 0 && mg_re_is_postfix(*ps->p)) {
+            x = mg_re_char_node(ps, (uint8_t)*ps->p++);
+        } else {
+            x = mg_re_parse_atom(ps, depth);
+        }
+        if (x < 0) return -1;
+
+        while (ps->p < ps->end && mg_re_is_postfix(*ps->p)) {
+            int min, max;
+            if (*ps->p == '{') {
+                int r = mg_re_parse_interval(ps, &min, &max);
+                if (r < 0) return -1;
+                if (r == 0) break;      // 리터럴 '{' -> 다음 atom
+            } else {
+                char op = *ps->p++;
+                min = (op == '+') ? 1 : 0;
+                max = (op == '?') ? 1 : -1;
+            }
+            int rep = mg_re_new_ast(ps, MG_RA_REP, x, -1);
+            if (rep < 0) return -1;
+            ps->ast[rep].min = min;
+            ps->ast[rep].max = max;
+            x = rep;
+        }
+
+        left = (left < 0) ? x : mg_re_new_ast(ps, MG_RA_CAT, left, x);
+        if (left < 0) return -1;
+    }
+    return left < 0 ? mg_re_new_ast(ps, MG_RA_EMPTY, -1, -1) : left;
+}
+
+static int mg_re_parse_alt(MgReParser *ps, int depth) {
+    int left = mg_re_parse_cat(ps, depth);
+    while (left >= 0 && ps->p < ps->end && *ps->p == '|') {
+        ps->p++;
+        int right = mg_re_parse_cat(ps, depth);
+        if (right < 0) return -1;
+        left = mg_re_new_ast(ps, MG_RA_ALT, left, right);
+    }
+    return left;
+}
+
+// --- AST -> NFA ---
+static int mg_re_new_node(MgReProg *pg, int op, int set, int out, int out1) {
+    if (pg->n == pg->cap) {
+        if (pg->n >= MG_RE_MAX_NODES) return -1;
+        int cap = pg->cap ? pg->cap * 2 : 256;
+        MgReNode *nn = (MgReNode*)realloc(pg->nodes, (size_t)cap * sizeof(MgReNode));
+        if (!nn) {
+            pg->nomem = 1;
+            return -1;
+        }
+        pg->nodes = nn;
+        pg->cap = cap;
+    }
+    MgReNode *nd = &pg->nodes[pg->n];
+    nd->op = (uint8_t)op;
+    nd->set = set;
+    nd->out = out;
+    nd->out1 = out1;
+    return pg->n++;
+}
+
+// 뒤에서부터 만듦: x 를 매칭한 뒤 next 로 이어지는 진입 노드 반환 (-1 = 노드 상한 초과 / pg->nomem)
+// reverse 이면 역방향 NFA (연결 순서를 뒤집고 ^ <-> $ 교환)
+static int mg_re_emit(MgReProg *pg, const MgReAst *ast, int x, int next, int reverse) {
+    const MgReAst *a = &ast[x];
+
+    switch (a->op) {
+    case MG_RA_SET:
+        return mg_re_new_node(pg, MG_RN_SET, a->set, next, -1);
+    case MG_RA_EMPTY:
+        return next;
+    case MG_RA_BOL:
+    case MG_RA_EOL: {
+        int bol = (a->op == MG_RA_BOL) != (reverse != 0);
+        return mg_re_new_node(pg, bol ? MG_RN_BOL : MG_RN_EOL, -1, next, -1);
+    }
+    case MG_RA_CAT: {
+        int first = reverse ? a->b : a->a;
+        int second = reverse ? a->a : a->b;
+        int tail = mg_re_emit(pg, ast, second, next, reverse);
+        return tail < 0 ? -1 : mg_re_emit(pg, ast, first, tail, reverse);
+    }
+    case MG_RA_ALT: {
+        int l = mg_re_emit(pg, ast, a->a, next, reverse);
+        int r = l < 0 ? -1 : mg_re_emit(pg, ast, a->b, next, reverse);
+        return r < 0 ? -1 : mg_re_new_node(pg, MG_RN_SPLIT, -1, l, r);
+    }
+    default: {  // MG_RA_REP
+        int cur = next;
+        int min = a->min;
+
+        if (a->max < 0) {
+            // x* (min > 0 이면 x+ 로 1개 소비)
+            int loop = mg_re_new_node(pg, MG_RN_SPLIT, -1, -1, next);
+            if (loop < 0) return -1;
+            int body = mg_re_emit(pg, ast, a->a, loop, reverse);
+            if (body < 0) return -1;
+            pg->nodes[loop].out = body;
+            cur = loop;
+            if (min > 0) {
+                cur = body;
+                min--;
+            }
+        } else {
+            // (x(x(x)?)?)? : 선택적 반복 max - min 개
+            for (int i = 0; i < a->max - a->min; i++) {
+                int body = mg_re_emit(pg, ast, a->a, cur, reverse);
+                if (body < 0) return -1;
+                cur = mg_re_new_node(pg, MG_RN_SPLIT, -1, body, next);
+                if (cur < 0) return -1;
+            }
+        }
+        for (int i = 0; i < min; i++) {
+            cur = mg_re_emit(pg, ast, a->a, cur, reverse);
+            if (cur < 0) return -1;
+        }
+        return cur;
+    }
+    }
+}
+
+// --- 필수 리터럴 분석 (prefilter) ---
+// 노드마다: exact = 정확히 이 문자열만 매칭, pre/suf = 모든 매칭의 접두사/접미사,
+// req = 모든 매칭이 이 중 하나는 포함하는 리터럴 집합 (0개 = 없음)
+typedef struct {
+    char s[MG_RE_LIT_MAX];
+    uint8_t n;
+} MgReLit;
+
+typedef struct {
+    int exact;
+    MgReLit ex, pre, suf;
+    MgReLit req[MG_RE_REQ_MAX];
+    int nreq;
+} MgReLitInfo;
+
+static void mg_relit_cat(MgReLit *dst, const MgReLit *a, const MgReLit *b, int keep_tail) {
+    char tmp[MG_RE_LIT_MAX * 2];
+    size_t n = (size_t)a->n + b->n;
+    memcpy(tmp, a->s, a->n);
+    memcpy(tmp + a->n, b->s, b->n);
+    size_t skip = (keep_tail && n > MG_RE_LIT_MAX) ? n - MG_RE_LIT_MAX : 0;
+    if (n - skip > MG_RE_LIT_MAX) n = MG_RE_LIT_MAX + skip;
+    memcpy(dst->s, tmp + skip, n - skip);
+    dst->n = (uint8_t)(n - skip);
+}
+
+// 집합 점수: 가장 짧은 리터럴 길이가 길수록, 같으면 개수가 적을수록 좋음
+static long mg_relit_score(const MgReLit *req, int nreq) {
+    if (nreq == 0) return -1;
+    int shortest = MG_RE_LIT_MAX;
+    for (int i = 0; i < nreq; i++) {
+        if (req[i].n < shortest) shortest = req[i].n;
+    }
+    return shortest == 0 ? -1 : (long)shortest * 64 - nreq;
+}
+
+static void mg_relit_offer(MgReLitInfo *info, const MgReLit *req, int nreq) {
+    if (mg_relit_score(req, nreq) > mg_relit_score(info->req, info->nreq)) {
+        if (req != info->req) memmove(info->req, req, (size_t)nreq * sizeof(MgReLit));
+        info->nreq = nreq;
+    }
+}
+
+static void mg_re_analyze(const MgReAst *ast, const MgReSet *sets, int n, int icase, MgReLitInfo *info) {
+    // 자식 노드는 항상 부모보다 앞 번호 -> 번호 순서대로 계산
+    for (int i = 0; i < n; i++) {
+        const MgReAst *a = &ast[i];
+        MgReLitInfo *o = &info[i];
+        memset(o, 0, sizeof(*o));
+
+        switch (a->op) {
+        case MG_RA_SET: {
+            int cnt = 0, ch = 0, first = 0;
+            for (int c = 0; c < 256 && cnt < 3; c++) {
+                if (mg_reset_has(sets[a->set], c)) {
+                    if (cnt++ == 0) first = c;
+                    ch = c;
+                }
+            }
+            // -i: {A, a} 는 리터럴 'a' (prefilter 도 대소문자 무시 커널로 찾음)
+            if (icase && cnt == 2 && first >= 'A' && first <= 'Z' && ch == first + 32) cnt = 1;
+            if (cnt == 1) {
+                o->exact = 1;
+                o->ex.s[0] = (char)ch;
+                o->ex.n = 1;
+                o->pre = o->suf = o->ex;
+                o->req[0] = o->ex;
+                o->nreq = 1;
+            }
+            break;
+        }
+        case MG_RA_EMPTY:
+        case MG_RA_BOL:
+        case MG_RA_EOL:
+            o->exact = 1;       // 폭 0
+            break;
+        case MG_RA_CAT: {
+            const MgReLitInfo *l = &info[a->a], *r = &info[a->b];
+            o->exact = l->exact && r->exact && (size_t)l->ex.n + r->ex.n <= MG_RE_LIT_MAX;
+            if (o->exact) mg_relit_cat(&o->ex, &l->ex, &r->ex, 0);
+            if (l->exact) mg_relit_cat(&o->pre, &l->ex, &r->pre, 0);
+            else o->pre = l->pre;
+            if (r->exact) mg_relit_cat(&o->suf, &l->suf, &r->ex, 1);
+            else o->suf = r->suf;
+
+            MgReLit mid;
+            mg_relit_cat(&mid, &l->suf, &r->pre, 0);
+            mg_relit_offer(o, l->req, l->nreq);
+            mg_relit_offer(o, r->req, r->nreq);
+            mg_relit_offer(o, &mid, 1);
+            mg_relit_offer(o, &o->pre, 1);
+            mg_relit_offer(o, &o->suf, 1);
+            if (o->exact) mg_relit_offer(o, &o->ex, 1);
+            break;
+        }
+        case MG_RA_ALT: {
+            const MgReLitInfo *l = &info[a->a], *r = &info[a->b];
+            if (l->nreq > 0 && r->nreq > 0 && l->nreq + r->nreq <= MG_RE_REQ_MAX) {
+                memcpy(o->req, l->req, (size_t)l->nreq * sizeof(MgReLit));
+                memcpy(o->req + l->nreq, r->req, (size_t)r->nreq * sizeof(MgReLit));
+                o->nreq = l->nreq + r->nreq;
+            }
+            break;
+        }
+        default:    // MG_RA_REP: 1번 이상 반복이면 자식의 접두사/접미사/필수 리터럴 유지
+            if (a->min >= 1) {
+                const MgReLitInfo *c = &info[a->a];
+                o->exact = c->exact && a->min == 1 && a->max == 1;
+                o->ex = c->ex;
+                o->pre = c->pre;
+                o->suf = c->suf;
+                memcpy(o->req, c->req, (size_t)c->nreq * sizeof(MgReLit));
+                o->nreq = c->nreq;
+            }
+            break;
+        }
+    }
+}
+
+// --- NFA -> DFA ---
+typedef struct {
+    int *stack;
+    uint32_t *mark;
+    uint32_t gen;
+    int *out;
+    int nout;
+} MgReWork;
+
+// seeds 에서 바이트 소비 없이 갈 수 있는 노드들 (SET / MATCH / 보류 중인 EOL) -> w->out
+static void mg_re_closure(const MgReProg *pg, MgReWork *w, const int *seeds, int nseeds, int bol, int eol) {
+    int sp = 0;
+    w->gen++;
+    w->nout = 0;
+    for (int i = 0; i < nseeds; i++) w->stack[sp++] = seeds[i];
+
+    while (sp > 0) {
+        int x = w->stack[--sp];
+        if (w->mark[x] == w->gen) continue;
+        w->mark[x] = w->gen;
+
+        const MgReNode *nd = &pg->nodes[x];
+        switch (nd->op) {
+        case MG_RN_SPLIT:
+            w->stack[sp++] = nd->out;
+            w->stack[sp++] = nd->out1;
+            break;
+        case MG_RN_BOL:
+            if (bol) w->stack[sp++] = nd->out;
+            break;
+        case MG_RN_EOL:
+            if (eol) w->stack[sp++] = nd->out;
+            else w->out[w->nout++] = x;
+            break;
+        default:
+            w->out[w->nout++] = x;
+            break;
+        }
+    }
+}
+
+static int mg_re_cmp_int(const void *a, const void *b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    int *pool;              // 상태별 NFA 노드 집합을 이어 붙인 것
+    size_t pool_len, pool_cap;
+    size_t *off;            // 상태 i 의 집합 = pool[off[i] .. off[i+1])
+    uint8_t *bol;
+    uint32_t *table;        // 해시 -> 상태 번호 + 1 (0 = 빈 칸)
+    size_t table_size;
+    uint32_t state_cap;     // d->delta / d->acc 할당 크기 (상태 수)
+    int nomem;              // mg_re_dfa_intern 이 UINT32_MAX 를 돌려준 이유가 메모리 부족
+} MgReDfaBuilder;
+
+static uint64_t mg_re_hash_set(const int *s, int n, int bol) {
+    uint64_t h = 1469598103934665603ull ^ (uint64_t)bol;
+    for (int i = 0; i < n; i++) {
+        h ^= (uint64_t)(uint32_t)s[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// 집합 (정렬됨) 에 해당하는 상태 번호, 없으면 새로 추가 (상한 초과 / 메모리 부족 시 UINT32_MAX)
+static uint32_t mg_re_dfa_intern(MgReDfa *d, MgReDfaBuilder *b, const int *s, int n, int bol, uint32_t nclass) {
+    size_t mask = b->table_size - 1;
+    size_t h = (size_t)mg_re_hash_set(s, n, bol) & mask;
+
+    for (;; h = (h + 1) & mask) {
+        uint32_t id = b->table[h];
+        if (id == 0) break;
+        id--;
+        size_t len = b->off[id + 1] - b->off[id];
+        if (len == (size_t)n && b->bol[id] == bol &&
+            (n == 0 || memcmp(b->pool + b->off[id], s, (size_t)n * sizeof(int)) == 0)) {
+            return id;
+        }
+    }
+
+    if (d->nstates >= MG_RE_MAX_STATES) return UINT32_MAX;
+
+    // 표를 먼저 늘리고 상태를 추가 (실패하면 그대로 두고 UINT32_MAX)
+    if (b->pool_len + (size_t)n > b->pool_cap) {
+        size_t cap = b->pool_cap;
+        while (b->pool_len + (size_t)n > cap) cap = cap ? cap * 2 : 1024;
+        int *np = (int*)realloc(b->pool, cap * sizeof(int));
+        if (!np) {
+            b->nomem = 1;
+            return UINT32_MAX;
+        }
+        b->pool = np;
+        b->pool_cap = cap;
+    }
+    if (d->nstates + 1 > b->state_cap) {
+        uint32_t cap = b->state_cap ? b->state_cap * 2 : 64;
+        uint32_t *nd = (uint32_t*)realloc(d->delta, (size_t)cap * nclass * sizeof(uint32_t));
+        if (nd) d->delta = nd;
+        uint8_t *na = nd ? (uint8_t*)realloc(d->acc, cap) : NULL;
+        if (na) d->acc = na;
+        if (!nd || !na) {
+            b->nomem = 1;
+            return UINT32_MAX;
+        }
+        b->state_cap = cap;
+    }
+    uint32_t id = d->nstates++;
+
+    if (n > 0) memcpy(b->pool + b->pool_len, s, (size_t)n * sizeof(int));
+    b->pool_len += (size_t)n;
+    b->off[id + 1] = b->pool_len;
+    b->bol[id] = (uint8_t)bol;
+    b->table[h] = id + 1;
+    return id;
+}
+
+// 실패하면 -1 + *err (상태 수 초과 / 메모리 부족), d 는 mg_re_dfa_free 로 해제
+static int mg_re_dfa_build(MgReDfa *d, const MgReProg *pg, const MgRegex *re, int anchored, const char **err) {
+    const uint32_t nc = re->nclass;
+    int rep[256];           // 클래스 -> 대표 바이트
+    for (int c = 255; c >= 0; c--) rep[re->cls[c]] = c;
+
+    MgReWork w;
+    w.stack = (int*)malloc(((size_t)pg->n * 3 + 16) * sizeof(int));  // 노드마다 1번 확장, 최대 2개 push + seed
+    w.mark  = (uint32_t*)calloc((size_t)pg->n, sizeof(uint32_t));
+    w.out   = (int*)malloc(((size_t)pg->n + 1) * sizeof(int));
+    w.gen = 0;
+    int *seeds = (int*)malloc(((size_t)pg->n + 1) * sizeof(int));
+
+    MgReDfaBuilder b;
+    memset(&b, 0, sizeof(b));
+    b.table_size = 1;
+    while (b.table_size < (size_t)MG_RE_MAX_STATES * 2) b.table_size <<= 1;
+    b.table = (uint32_t*)calloc(b.table_size, sizeof(uint32_t));
+    b.off   = (size_t*)calloc((size_t)MG_RE_MAX_STATES + 1, sizeof(size_t));
+    b.bol   = (uint8_t*)calloc((size_t)MG_RE_MAX_STATES, 1);
+    b.nomem = !w.stack || !w.mark || !w.out || !seeds || !b.table || !b.off || !b.bol;
+
+    memset(d, 0, sizeof(*d));
+    int ok = !b.nomem && mg_re_dfa_intern(d, &b, NULL, 0, 0, nc) != UINT32_MAX; // 상태 0 = dead (빈 집합)
+    if (ok) {
+        mg_re_closure(pg, &w, &pg->start, 1, 1, 0);
+        qsort(w.out, (size_t)w.nout, sizeof(int), mg_re_cmp_int);
+        d->start_bol = mg_re_dfa_intern(d, &b, w.out, w.nout, 1, nc);
+        mg_re_closure(pg, &w, &pg->start, 1, 0, 0);
+        qsort(w.out, (size_t)w.nout, sizeof(int), mg_re_cmp_int);
+        d->start_mid = mg_re_dfa_intern(d, &b, w.out, w.nout, 0, nc);
+        ok = d->start_bol != UINT32_MAX && d->start_mid != UINT32_MAX;
+    }
+
+    // BFS: 새 상태가 생길 때마다 뒤에 붙으므로 번호 순서대로 처리하면 됨
+    for (uint32_t st = 0; st < d->nstates && ok; st++) {
+        for (uint32_t k = 0; k < nc; k++) {
+            int nseeds = 0;
+            for (size_t i = b.off[st]; i < b.off[st + 1]; i++) {
+                const MgReNode *nd = &pg->nodes[b.pool[i]];
+                if (nd->op == MG_RN_SET && mg_reset_has(re->sets[nd->set], rep[k])) seeds[nseeds++] = nd->out;
+            }
+            if (!anchored && st != 0) seeds[nseeds++] = pg->start;   // 비고정: 아무 위치에서나 새로 시작
+
+            mg_re_closure(pg, &w, seeds, nseeds, 0, 0);
+            qsort(w.out, (size_t)w.nout, sizeof(int), mg_re_cmp_int);
+            uint32_t next = mg_re_dfa_intern(d, &b, w.out, w.nout, 0, nc);
+            if (next == UINT32_MAX) {
+                ok = 0;
+                break;
+            }
+            d->delta[(size_t)st * nc + k] = next;
+        }
+
+        // 매칭 여부: MATCH 포함 / 줄 끝이라면 ($ 통과) MATCH 도달
+        const int *set = b.pool + b.off[st];
+        int n = (int)(b.off[st + 1] - b.off[st]);
+        uint8_t acc = 0;
+        for (int i = 0; i < n; i++) {
+            if (pg->nodes[set[i]].op == MG_RN_MATCH) acc = MG_RE_ACC | MG_RE_ACC_EOL;
+        }
+        if (!acc) {
+            mg_re_closure(pg, &w, set, n, b.bol[st], 1);
+            for (int i = 0; i < w.nout; i++) {
+                if (pg->nodes[w.out[i]].op == MG_RN_MATCH) acc = MG_RE_ACC_EOL;
+            }
+        }
+        d->acc[st] = acc;
+    }
+
+    free(w.stack);
+    free(w.mark);
+    free(w.out);
+    free(seeds);
+    free(b.pool);
+    free(b.off);
+    free(b.bol);
+    free(b.table);
+    if (!ok) *err = b.nomem ? MG_ERR_NOMEM : "정규식이 너무 복잡합니다 (DFA 상태 수 초과)";
+    return ok ? 0 : -1;
+}
+
+// start_mid 에 머무는 바이트 = 건너뛰어도 되는 바이트 ('\n' 은 줄 처리 때문에 항상 멈춤)
+static void mg_re_dfa_build_skip(MgReDfa *d, const MgRegex *re) {
+    const uint32_t *row = d->delta + (size_t)d->start_mid * re->nclass;
+    int nescape = 0;
+
+    if (d->acc[d->start_mid] & MG_RE_ACC) return;
+    for (int b = 0; b < 256; b++) {
+        if (b == '\n' || row[re->cls[b]] != d->start_mid) {
+            d->is_escape[b] = 1;
+            nescape++;
+            uint8_t bit = (uint8_t)(1u << ((b >> 4) & 7));
+            d->skip_hi[b >> 4] |= bit;
+            d->skip_lo[b & 15] |= bit;
+        }
+    }
+    d->has_skip = nescape <= MG_RE_SKIP_MAX;
+}
+
+static void mg_re_dfa_free(MgReDfa *d) {
+    free(d->delta);
+    free(d->acc);
+}
+
+// 바이트 클래스: 모든 바이트 집합의 경계로 256바이트를 분할
+static void mg_re_build_classes(MgRegex *re) {
+    uint8_t map[256];
+    memset(re->cls, 0, sizeof(re->cls));
+    uint32_t nc = 1;
+
+    for (int s = 0; s < re->nsets; s++) {
+        // (기존 클래스, 이 집합 포함 여부) 쌍마다 새 클래스
+        int remap[2][256];
+        memset(remap, -1, sizeof(remap));
+        uint32_t next = 0;
+        for (int c = 0; c < 256; c++) {
+            int in = mg_reset_has(re->sets[s], c);
+            int *slot = &remap[in][re->cls[c]];
+            if (*slot < 0) *slot = (int)next++;
+            map[c] = (uint8_t)*slot;
+        }
+        memcpy(re->cls, map, sizeof(map));
+        nc = next;
+    }
+    re->nclass = nc;
+}
+
+// patterns 를 alternation 으로 묶어 컴파일, 실패하면 -1 + *err
+static int mg_re_compile(MgRegex *re, const char *const *pats, const size_t *lens, int npats, int icase,
+                      const char **err) {
+    memset(re, 0, sizeof(*re));
+    re->icase = icase;
+
+    MgReParser ps;
+    memset(&ps, 0, sizeof(ps));
+    ps.icase = icase;
+    int root = -1;
+
+    for (int i = 0; i < npats; i++) {
+        ps.p = pats[i];
+        ps.end = pats[i] + lens[i];
+        int x = mg_re_parse_alt(&ps, 0);
+        if (x >= 0 && ps.p < ps.end) {
+            ps.err = "짝이 맞지 않는 ')'";
+            x = -1;
+        }
+        if (x < 0) {
+            *err = ps.err;
+            free(ps.ast);
+            free(ps.sets);
+            return -1;
+        }
+        root = (root < 0) ? x : mg_re_new_ast(&ps, MG_RA_ALT, root, x);
+        if (root < 0) {
+            *err = ps.err;
+            free(ps.ast);
+            free(ps.sets);
+            return -1;
+        }
+    }
+
+    re->sets = ps.sets;
+    re->nsets = ps.nsets;
+    mg_re_build_classes(re);
+
+    // prefilter 리터럴 + 패턴 전체가 리터럴인지 (모든 갈래가 exact, 앵커 없음)
+    MgReLitInfo *info = (MgReLitInfo*)malloc((size_t)ps.n * sizeof(MgReLitInfo));
+    if (!info) {
+        *err = MG_ERR_NOMEM;
+        free(ps.ast);
+        return -1;
+    }
+    mg_re_analyze(ps.ast, re->sets, ps.n, icase, info);
+
+    const MgReLitInfo *top = &info[root];
+    int all_exact = !ps.has_anchor;
+    {
+        // 최상위 alternation 갈래들을 따라가며 exact 확인
+        int stack[64], sp = 0, nbranch = 0;
+        stack[sp++] = root;
+        while (sp > 0 && all_exact) {
+            int x = stack[--sp];
+            if (ps.ast[x].op == MG_RA_ALT && sp + 2 <= 64) {
+                stack[sp++] = ps.ast[x].b;
+                stack[sp++] = ps.ast[x].a;
+            } else if (!info[x].exact || info[x].ex.n == 0 || ++nbranch > MG_RE_REQ_MAX) {
+                all_exact = 0;
+            }
+        }
+    }
+    if (all_exact && top->nreq > 0) re->literal_only = 1;
+
+    if (mg_relit_score(top->req, top->nreq) > 0) {
+        for (int i = 0; i < top->nreq; i++) {
+            re->lits[i] = (char*)malloc((size_t)top->req[i].n + 1);
+            if (!re->lits[i]) {
+                re->nlits = i;          // 만든 것까지 mg_re_free 가 해제
+                re->literal_only = 0;
+                *err = MG_ERR_NOMEM;
+                free(info);
+                free(ps.ast);
+                return -1;
+            }
+            memcpy(re->lits[i], top->req[i].s, top->req[i].n);
+            re->lits[i][top->req[i].n] = '\0';
+            re->lit_lens[i] = top->req[i].n;
+        }
+        re->nlits = top->nreq;
+    } else {
+        re->literal_only = 0;
+    }
+    free(info);
+
+    if (re->literal_only) {
+        free(ps.ast);
+        return 0;
+    }
+    if (re->nlits > 1 &&
+        mg_ac_build(&re->lit_ac, (const char *const *)re->lits, re->lit_lens, re->nlits, icase) != 0) {
+        *err = MG_ERR_NOMEM;
+        free(ps.ast);
+        return -1;
+    }
+
+    // NFA 2개 (정방향 / 역방향) -> DFA 3개
+    MgReProg fwd = { NULL, 0, 0, 0, 0 }, rev = { NULL, 0, 0, 0, 0 };
+    int ok = 1;
+    int mf = mg_re_new_node(&fwd, MG_RN_MATCH, -1, -1, -1);
+    int mr = mg_re_new_node(&rev, MG_RN_MATCH, -1, -1, -1);
+    fwd.start = mf < 0 ? -1 : mg_re_emit(&fwd, ps.ast, root, mf, 0);
+    rev.start = mr < 0 ? -1 : mg_re_emit(&rev, ps.ast, root, mr, 1);
+    free(ps.ast);
+
+    if (fwd.start < 0 || rev.start < 0) {
+        *err = (fwd.nomem || rev.nomem) ? MG_ERR_NOMEM : "정규식이 너무 큽니다 (반복 횟수를 줄여 주세요)";
+        ok = 0;
+    } else if (mg_re_dfa_build(&re->line, &fwd, re, 0, err) != 0 ||
+               mg_re_dfa_build(&re->anch, &fwd, re, 1, err) != 0 ||
+               mg_re_dfa_build(&re->back, &rev, re, 0, err) != 0) {
+        ok = 0;
+    } else {
+        mg_re_dfa_build_skip(&re->line, re);
+    }
+    free(fwd.nodes);
+    free(rev.nodes);
+    return ok ? 0 : -1;
+}
+
+static void mg_re_free(MgRegex *re) {
+    mg_re_dfa_free(&re->line);
+    mg_re_dfa_free(&re->anch);
+    mg_re_dfa_free(&re->back);
+    for (int i = 0; i < re->nlits; i++) free(re->lits[i]);
+    if (re->nlits > 1 && !re->literal_only) mg_ac_free(&re->lit_ac);
+    free(re->sets);
+}
+
+// --- 실행 ---
+// line[0..len) ('\n' 미포함) 안에 매칭이 있는지
+static int mg_re_line_match(const MgRegex *re, const char *line, size_t len) {
+    const MgReDfa *d = &re->line;
+    const uint32_t nc = re->nclass;
+    const uint8_t *p = (const uint8_t*)line;
+    const uint8_t *end = p + len;
+    uint32_t st = d->start_bol;
+
+    if (d->acc[st] & MG_RE_ACC) return 1;
+    while (p < end) {
+        st = d->delta[(size_t)st * nc + re->cls[*p++]];
+        if (d->acc[st] & MG_RE_ACC) return 1;
+    }
+    return (d->acc[st] & MG_RE_ACC_EOL) != 0;
+}
+
+// prefilter 없이 버퍼 전체를 DFA로: 매칭 줄 안의 위치 반환 (hay 는 줄 시작)
+static const char *mg_re_scan(const MgRegex *re, const char *hay, size_t n) {
+    const MgReDfa *d = &re->line;
+    const uint32_t nc = re->nclass;
+    const uint8_t *p = (const uint8_t*)hay;
+    const uint8_t *end = p + n;
+    uint32_t st = d->start_bol;
+
+    if (n > 0 && (d->acc[st] & MG_RE_ACC)) return hay;
+    while (p < end) {
+        if (st == d->start_mid && d->has_skip) {
+            while ((p = mg_find_set_impl(p, end, d->skip_lo, d->skip_hi)) != NULL && !d->is_escape[*p]) p++;
+            if (!p) {
+                p = end;
+                break;
+            }
+        }
+        uint8_t c = *p;
+        if (c == '\n') {
+            if (d->acc[st] & MG_RE_ACC_EOL) return (const char*)p;
+            st = d->start_bol;
+            p++;
+            if (p < end && (d->acc[st] & MG_RE_ACC)) return (const char*)p;
+            continue;
+        }
+        st = d->delta[(size_t)st * nc + re->cls[c]];
+        p++;
+        if (d->acc[st] & MG_RE_ACC) return (const char*)p - 1;
+    }
+    // 줄바꿈 없이 끝나는 마지막 줄
+    if (n > 0 && end[-1] != '\n' && (d->acc[st] & MG_RE_ACC_EOL)) return (const char*)end - 1;
+    return NULL;
+}
+
+// 매칭 줄 안의 위치 반환 (hay 는 줄 시작), *mlen 은 0 (줄 판정만)
+static const char *mg_re_find(const MgRegex *re, const char *hay, size_t n, size_t *mlen) {
+    *mlen = 0;
+    if (re->nlits == 0) return mg_re_scan(re, hay, n);
+
+    const char *pos = hay;
+    const char *end = hay + n;
+    while (pos < end) {
+        size_t l;
+        const char *lit = (re->nlits == 1)
+            ? mg_find_keyword(pos, (size_t)(end - pos), re->lits[0], re->lit_lens[0], re->icase)
+            : mg_ac_find(&re->lit_ac, pos, (size_t)(end - pos), &l);
+        if (!lit) return NULL;
+
+        const char *ls = (const char*)memrchr(pos, '\n', (size_t)(lit - pos));
+        ls = ls ? ls + 1 : pos;
+        const char *le = (const char*)memchr(lit, '\n', (size_t)(end - lit));
+        if (!le) le = end;
+
+        if (mg_re_line_match(re, ls, (size_t)(le - ls))) return lit;
+        pos = le + 1;
+    }
+    return NULL;
+}
+
+// line[from..) 에서 시작하는 가장 긴 매칭의 끝, 없으면 -1
+static long mg_re_longest(const MgRegex *re, const char *line, size_t len, size_t from) {
+    const MgReDfa *d = &re->anch;
+    const uint32_t nc = re->nclass;
+    uint32_t st = (from == 0) ? d->start_bol : d->start_mid;
+    long best = -1;
+
+    if (d->acc[st] & (from == len ? MG_RE_ACC_EOL : MG_RE_ACC)) best = (long)from;
+    for (size_t i = from; i < len; i++) {
+        st = d->delta[(size_t)st * nc + re->cls[(uint8_t)line[i]]];
+        if (st == 0) break;
+        if (d->acc[st] & (i + 1 == len ? MG_RE_ACC_EOL : MG_RE_ACC)) best = (long)(i + 1);
+    }
+    return best;
+}
+
+// 강조용: 역방향 DFA로 "여기서 시작하는 매칭이 있다" 위치를 줄마다 한 번 표시 (worker별 버퍼)
+static _Thread_local uint8_t *mg_re_marks;
+static _Thread_local size_t mg_re_marks_cap;
+static _Thread_local const char *mg_re_marks_line;
+
+// 메모리가 부족하면 -1 (표시 없음 -> mg_re_next_span 이 모든 위치를 확인)
+static int mg_re_mark_starts(const MgRegex *re, const char *line, size_t len) {
+    if (len + 1 > mg_re_marks_cap) {
+        uint8_t *nm = (uint8_t*)realloc(mg_re_marks, (len + 1) * 2);
+        if (!nm) {
+            mg_re_marks_line = NULL;
+            return -1;
+        }
+        mg_re_marks = nm;
+        mg_re_marks_cap = (len + 1) * 2;
+    }
+    const MgReDfa *d = &re->back;
+    const uint32_t nc = re->nclass;
+    uint32_t st = d->start_bol;     // 역방향의 "시작" = 줄 끝
+
+    mg_re_marks[len] = (uint8_t)(d->acc[st] & (len == 0 ? MG_RE_ACC_EOL : MG_RE_ACC));
+    for (size_t i = len; i-- > 0;) {
+        st = d->delta[(size_t)st * nc + re->cls[(uint8_t)line[i]]];
+        mg_re_marks[i] = (uint8_t)(d->acc[st] & (i == 0 ? MG_RE_ACC_EOL : MG_RE_ACC));
+    }
+    mg_re_marks_line = line;
+    return 0;
+}
+
+// line[from..len) 의 가장 왼쪽-가장 긴 (빈 문자열 아닌) 매칭
+// 같은 줄은 from == 0 으로 먼저 호출해야 함 (시작 위치 표시를 그때 계산)
+static int mg_re_next_span(const MgRegex *re, const char *line, size_t len, size_t from,
+                        size_t *off, size_t *mlen) {
+    int marked = (from == 0 || mg_re_marks_line != line) ? mg_re_mark_starts(re, line, len) == 0 : 1;
+
+    for (size_t i = from; i < len; i++) {
+        if (marked && !mg_re_marks[i]) continue;
+        long e = mg_re_longest(re, line, len, i);
+        if (e > (long)i) {
+            *off = i;
+            *mlen = (size_t)e - i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// worker 종료 시 호출
+static void mg_re_thread_cleanup(void) {
+    free(mg_re_marks);
+    mg_re_marks = NULL;
+    mg_re_marks_cap = 0;
+    mg_re_marks_line = NULL;
+}
+
+// -------------------- 패턴 매처 --------------------
+// 패턴 1개: SIMD 부분 문자열 커널, 여러 개: Aho-Corasick, -E: 정규식 DFA
+// (-E 라도 패턴이 전부 리터럴이면 앞의 두 경로를 그대로 사용)
+// -i: 패턴을 소문자로 바꿔 두고 각 경로가 파일 버퍼를 그대로 대소문자 무시로 검색
+// -w: 매칭된 후보 구간에서만 단어 경계를 확인 (mg_matcher_next_span)
+// 옵션은 MgMatcher 마다 따로 (전역 상태 없음) -> 한 프로세스에서 서로 다른 패턴을 동시에 써도 됨
+enum {
+    MG_EXTENDED    = 1,    // -E: 확장 정규식
+    MG_IGNORE_CASE = 2,    // -i
+    MG_WORD        = 4     // -w
+};
+
+typedef enum {
+    MG_MATCH_LITERAL = 0,
+    MG_MATCH_MULTI   = 1,
+    MG_MATCH_REGEX   = 2
+} MgMatchKind;
+
+typedef struct {
+    MgMatchKind kind;
+    int icase;
+    int word;
+    const char *const *pats;
+    const size_t *lens;
+    int npats;
+    MgAhoCorasick ac;
+    int use_regex;          // -E 로 컴파일했는지 (re 해제용)
+    MgRegex re;
+    char *fold_buf;         // -i: 소문자로 바꾼 (또는 정규식으로 이스케이프한) 패턴 저장소
+    const char **fold_pats;
+    size_t *fold_lens;
+} MgMatcher;
+
+// -i 인데 리터럴 패턴에 비ASCII 바이트가 있으면 UTF-8 대소문자 짝을 정규식 파서에 맡기도록
+// ERE 로 이스케이프 (짝이 없는 문자뿐이면 mg_re_compile 이 다시 리터럴 경로로 돌려줌)
+// 반환: 1 = 정규식으로 컴파일해야 함, -1 = 메모리 부족
+static int mg_matcher_fold_patterns(MgMatcher *m, const char *const *pats, const size_t *lens, int npats) {
+    int utf8 = 0;
+    size_t total = 0;
+    for (int i = 0; i < npats; i++) {
+        total += lens[i] * 2 + 1;
+        for (size_t j = 0; j < lens[i]; j++) {
+            if ((uint8_t)pats[i][j] >= 0x80) utf8 = 1;
+        }
+    }
+
+    m->fold_buf = (char*)malloc(total);
+    m->fold_pats = (const char**)malloc((size_t)npats * sizeof(char*));
+    m->fold_lens = (size_t*)malloc((size_t)npats * sizeof(size_t));
+    if (!m->fold_buf || !m->fold_pats || !m->fold_lens) return -1;
+
+    char *w = m->fold_buf;
+    for (int i = 0; i < npats; i++) {
+        m->fold_pats[i] = w;
+        for (size_t j = 0; j < lens[i]; j++) {
+            uint8_t c = (uint8_t)pats[i][j];
+            if (utf8) {
+                if (c && strchr("\\.[]()*+?{}|^$", c)) *w++ = '\\';
+                *w++ = (char)c;
+            } else {
+                *w++ = (char)mg_fold_table[c];
+            }
+        }
+        m->fold_lens[i] = (size_t)(w - m->fold_pats[i]);
+        *w++ = '\0';
+    }
+    return utf8;
+}
+
+// flags: MG_EXTENDED | MG_IGNORE_CASE | MG_WORD, 실패하면 -1 + *err (정규식 문법 오류, MG_ERR_NOMEM)
+// 실패하면 m 은 이미 해제된 상태 (mg_matcher_free 하지 않음)
+// pats / lens 는 MgMatcher 를 쓰는 동안 그대로 있어야 함 (복사하지 않음)
+static void mg_matcher_free(MgMatcher *m);
+
+static int mg_matcher_init(MgMatcher *m, const char *const *pats, const size_t *lens, int npats,
+                        int flags, const char **err) {
+    memset(m, 0, sizeof(*m));
+    m->pats = pats;
+    m->lens = lens;
+    m->npats = npats;
+    m->kind = MG_MATCH_LITERAL;
+    m->icase = (flags & MG_IGNORE_CASE) != 0;
+    m->word = (flags & MG_WORD) != 0;
+    int extended = (flags & MG_EXTENDED) != 0;
+
+    if (m->icase && !extended) {
+        extended = mg_matcher_fold_patterns(m, pats, lens, npats);
+        if (extended < 0) {
+            *err = MG_ERR_NOMEM;
+            mg_matcher_free(m);
+            return -1;
+        }
+        pats = m->fold_pats;
+        lens = m->fold_lens;
+        m->pats = pats;
+        m->lens = lens;
+    }
+
+    if (extended) {
+        m->use_regex = 1;
+        if (mg_re_compile(&m->re, pats, lens, npats, m->icase, err) != 0) {
+            mg_matcher_free(m);
+            return -1;
+        }
+        if (!m->re.literal_only) {
+            m->kind = MG_MATCH_REGEX;
+            return 0;
+        }
+        m->pats = (const char *const *)m->re.lits;
+        m->lens = m->re.lit_lens;
+        m->npats = npats = m->re.nlits;
+    }
+
+    if (npats == 1) return 0;
+
+    // 빈 패턴이 있으면 모든 줄이 매칭 -> 빈 문자열 리터럴 하나와 동일
+    for (int i = 0; i < npats; i++) {
+        if (m->lens[i] == 0) {
+            m->pats += i;
+            m->lens += i;
+            m->npats = 1;
+            return 0;
+        }
+    }
+
+    if (mg_ac_build(&m->ac, m->pats, m->lens, npats, m->icase) != 0) {
+        *err = MG_ERR_NOMEM;
+        mg_matcher_free(m);
+        return -1;
+    }
+    m->kind = MG_MATCH_MULTI;
+    return 0;
+}
+
+static void mg_matcher_free(MgMatcher *m) {
+    if (m->kind == MG_MATCH_MULTI) mg_ac_free(&m->ac);
+    if (m->use_regex) mg_re_free(&m->re);
+    free(m->fold_buf);
+    free(m->fold_pats);
+    free(m->fold_lens);
+}
+
+// 어떤 패턴이든 처음 매칭되는 위치 (줄 판정용), *mlen 은 매칭 길이
+static inline const char *mg_matcher_find(const MgMatcher *m, const char *hay, size_t n, size_t *mlen) {
+    if (m->kind == MG_MATCH_MULTI) return mg_ac_find(&m->ac, hay, n, mlen);
+    if (m->kind == MG_MATCH_REGEX) return mg_re_find(&m->re, hay, n, mlen);
+
+    *mlen = m->lens[0];
+    return mg_find_keyword(hay, n, m->pats[0], m->lens[0], m->icase);
+}
+
+// line[from..len) 에서 다음 매칭 구간 (단어 경계 확인 전)
+static int mg_matcher_span(const MgMatcher *m, const char *line, size_t len, size_t from,
+                        size_t *off, size_t *mlen, int *pat) {
+    const char *hay = line + from;
+    size_t n = len - from;
+    *pat = 0;
+
+    if (m->kind == MG_MATCH_REGEX) return mg_re_next_span(&m->re, line, len, from, off, mlen);
+    if (m->kind == MG_MATCH_MULTI) {
+        if (!mg_ac_next_span(&m->ac, hay, n, off, mlen, pat)) return 0;
+        *off += from;
+        return 1;
+    }
+
+    if (m->lens[0] == 0) return 0;      // 빈 패턴은 강조할 것이 없음
+    const char *hit = mg_find_keyword(hay, n, m->pats[0], m->lens[0], m->icase);
+    if (!hit) return 0;
+    *off = (size_t)(hit - line);
+    *mlen = m->lens[0];
+    return 1;
+}
+
+// -w 의 단어 문자: ASCII 영숫자, '_', 비ASCII 바이트 (UTF-8 글자는 통째로 단어의 일부)
+static inline int mg_is_word_byte(uint8_t c) {
+    return c >= 0x80 || c == '_' || (c >= '0' && c <= '9') || (uint8_t)((c | 0x20) - 'a') < 26;
+}
+
+static inline int mg_word_bounded(const char *line, size_t len, size_t off, size_t mlen) {
+    return (off == 0 || !mg_is_word_byte((uint8_t)line[off - 1])) &&
+           (off + mlen == len || !mg_is_word_byte((uint8_t)line[off + mlen]));
+}
+
+// 강조 출력용: line[from..len) 에서 다음 매칭 구간 (*off 는 줄 기준) 과 패턴 번호
+// 한 줄은 from = 0 부터 앞으로만 진행하며 호출
+// -w: 경계에 놓이지 않은 구간은 시작 위치 + 1 부터 다시 찾음 (후보에서만 확인)
+static int mg_matcher_next_span(const MgMatcher *m, const char *line, size_t len, size_t from,
+                             size_t *off, size_t *mlen, int *pat) {
+    while (mg_matcher_span(m, line, len, from, off, mlen, pat)) {
+        if (!m->word || mg_word_bounded(line, len, *off, *mlen)) return 1;
+        from = *off + 1;
+    }
+    return 0;
+}
+
+// pos(줄 시작, 그 줄 번호 *line_num) 부터 end 까지에서 다음 매칭 줄 [*line_start, *line_end) ('\n' 미포함)
+// 줄 경계는 매칭 위치 주변에서만 찾음, 못 찾으면 0
+// 반환 후 *pos / *line_num 은 마지막으로 본 줄 (찾았으면 매칭 줄) 의 시작과 번호
+static int mg_matcher_next_line(const MgMatcher *m, const char **pos, const char *end, size_t *line_num,
+                             const char **line_start, const char **line_end) {
+    const char *p = *pos;
+    size_t num = *line_num;
+
+    while (p < end) {
+        size_t mlen;
+        const char *hit = mg_matcher_find(m, p, (size_t)(end - p), &mlen);
+        if (!hit) break;
+
+        // hit 이전 줄들을 건너뛰면서 줄 번호 갱신 + 줄 시작 위치 찾기
+        const char *last_nl = NULL;
+        num += mg_count_newlines(p, hit, &last_nl);
+        const char *ls = last_nl ? last_nl + 1 : p;
+
+        const char *le = (const char*)memchr(hit, '\n', (size_t)(end - hit));
+        if (!le) le = end;
+
+        // 키워드가 줄바꿈을 포함하면 줄 단위 매칭이 아님 -> 다음 줄부터 다시
+        // -w: 후보 줄에서만 단어 경계 확인 (경계에 놓인 매칭이 하나도 없으면 다음 줄)
+        size_t woff, wlen;
+        int wpat;
+        if (hit + mlen > le ||
+            (m->word && !mg_matcher_next_span(m, ls, (size_t)(le - ls), 0, &woff, &wlen, &wpat))) {
+            p = le + 1;
+            num++;
+            continue;
+        }
+
+        *pos = ls;
+        *line_num = num;
+        *line_start = ls;
+        *line_end = le;
+        return 1;
+    }
+
+    *pos = p;
+    *line_num = num;
+    return 0;
+}
+
+// -------------------- 파일 필터 (--type / --include / --exclude) --------------------
+// mini-grep 의 옵션과 mg_search_tree 의 opts.filter 가 같은 필터 (시작 시 1번 컴파일, 이후 worker는 읽기만 함, lock 없음)
+// - 확장자 집합: --type 과 "*.ext" 형태의 --include 는 해시 집합 1번 조회로 판정
+// - 나머지 glob: *, ?, [...] 만 지원하는 작은 matcher (항목 이름 기준)
+// - --exclude 는 파일과 디렉터리 모두에 적용, "build/" 처럼 '/' 로 끝나면 디렉터리만
+//   제외된 디렉터리는 작업으로 만들지 않으므로 아래로 내려가지 않음
+// 아무것도 지정하지 않으면 기존 기본값 (.c .txt .h .py .md)
+// 추가 함수는 실패하면 -1 + errno (ENOMEM, 모르는 --type 이름 / 가득 찬 집합은 EINVAL)
+#define MG_EXT_SET_SIZE 256        // 확장자 해시 집합 칸 수 (2의 거듭제곱)
+#define MG_DEFAULT_EXTS "c txt h py md"    // 확장자 필터가 없을 때 검색하는 확장자 (공백으로 구분)
+
+typedef struct {
+    const char *pat;
+    int dir_only;                  // '/' 로 끝난 --exclude
+    size_t len;                    // dir_only 이면 '/' 를 뺀 길이
+} MgGlobPat;
+
+typedef struct {
+    const char *exts[MG_EXT_SET_SIZE]; // '.' 뒤 문자열 (NULL = 빈 칸)
+    int next;                       // 확장자 개수
+    MgGlobPat *includes;
+    int ninclude;
+    MgGlobPat *excludes;
+    int nexclude;
+    int any_selector;               // --type / --include 가 하나라도 있었는지
+} MgFileFilter;
+
+typedef struct {
+    const char *name;
+    const char *exts;              // 공백으로 구분
+} MgFileType;
+
+static const MgFileType mg_file_types[] = {
+    { "c",        "c h" },
+    { "cpp",      "cpp cc cxx c++ hpp hh hxx h++ h inl" },
+    { "rust",     "rs" },
+    { "go",       "go" },
+    { "py",       "py pyi" },
+    { "java",     "java" },
+    { "kotlin",   "kt kts" },
+    { "js",       "js mjs cjs jsx" },
+    { "ts",       "ts tsx mts cts" },
+    { "sh",       "sh bash zsh" },
+    { "md",       "md markdown" },
+    { "txt",      "txt" },
+    { "json",     "json" },
+    { "yaml",     "yaml yml" },
+    { "toml",     "toml" },
+    { "cmake",    "cmake" },
+    { "html",     "html htm" },
+    { "css",      "css scss" },
+};
+#define MG_NUM_FILE_TYPES (sizeof(mg_file_types) / sizeof(mg_file_types[0]))
+
+static uint32_t mg_ext_hash(const char *s, size_t n) {
+    uint32_t h = 2166136261u;      // FNV-1a
+    for (size_t i = 0; i < n; i++) {
+        h ^= (uint8_t)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int mg_ext_set_has(const MgFileFilter *f, const char *ext, size_t n) {
+    uint32_t i = mg_ext_hash(ext, n) & (MG_EXT_SET_SIZE - 1);
+    while (f->exts[i]) {
+        if (strncmp(f->exts[i], ext, n) == 0 && f->exts[i][n] == '\0') return 1;
+        i = (i + 1) & (MG_EXT_SET_SIZE - 1);
+    }
+    return 0;
+}
+
+// 성공 0, 집합이 가득 차거나 메모리가 없으면 -1
+static int mg_ext_set_add(MgFileFilter *f, const char *ext, size_t n) {
+    if (mg_ext_set_has(f, ext, n)) return 0;
+    if (f->next >= MG_EXT_SET_SIZE / 2) {            // 채움률 50% 유지
+        errno = EINVAL;
+        return -1;
+    }
+
+    char *copy = (char*)malloc(n + 1);
+    if (!copy) return -1;
+    memcpy(copy, ext, n);
+    copy[n] = '\0';
+
+    uint32_t i = mg_ext_hash(ext, n) & (MG_EXT_SET_SIZE - 1);
+    while (f->exts[i]) i = (i + 1) & (MG_EXT_SET_SIZE - 1);
+    f->exts[i] = copy;
+    f->next++;
+    return 0;
+}
+
+// 공백으로 구분된 확장자 목록 추가
+static int mg_ext_set_add_list(MgFileFilter *f, const char *list) {
+    while (*list) {
+        size_t n = strcspn(list, " ");
+        if (n > 0 && mg_ext_set_add(f, list, n) != 0) return -1;
+        list += n;
+        while (*list == ' ') list++;
+    }
+    return 0;
+}
+
+// [...] 하나 비교, *pp 는 '[' 다음 -> 성공하면 ']' 다음으로
+// 닫는 ']' 가 없으면 -1 (호출자가 '[' 를 글자 그대로 비교)
+static int mg_glob_class(const char **pp, const char *end, unsigned char c) {
+    const char *p = *pp;
+    int neg = 0, hit = 0;
+    if (p < end && (*p == '!' || *p == '^')) {
+        neg = 1;
+        p++;
+    }
+    int first = 1;
+    while (p < end && (*p != ']' || first)) {
+        unsigned char lo = (unsigned char)*p, hi = lo;
+        if (p + 2 < end && p[1] == '-' && p[2] != ']') {
+            hi = (unsigned char)p[2];
+            p += 2;
+        }
+        if (c >= lo && c <= hi) hit = 1;
+        p++;
+        first = 0;
+    }
+    if (p >= end) return -1;
+    *pp = p + 1;
+    return hit != neg;
+}
+
+// pat[0..plen) 가 name 전체와 맞는지 ('*' 는 마지막 '*' 위치로만 되돌아가는 선형 탐색)
+static int mg_glob_match(const char *pat, size_t plen, const char *name) {
+    const char *p = pat, *pend = pat + plen;
+    const char *s = name;
+    const char *star_p = NULL, *star_s = NULL;
+
+    while (*s) {
+        if (p < pend && *p == '*') {
+            star_p = ++p;
+            star_s = s;
+            continue;
+        }
+        if (p < pend) {
+            if (*p == '?') {
+                p++;
+                s++;
+                continue;
+            }
+            if (*p == '[') {
+                const char *q = p + 1;
+                int r = mg_glob_class(&q, pend, (unsigned char)*s);
+                if (r == 1) {
+                    p = q;
+                    s++;
+                    continue;
+                }
+                if (r == -1 && *s == '[') {
+                    p++;
+                    s++;
+                    continue;
+                }
+            } else if (*p == *s) {
+                p++;
+                s++;
+                continue;
+            }
+        }
+        if (!star_p) return 0;
+        p = star_p;         // 마지막 '*' 가 한 글자 더 먹은 것으로 보고 다시
+        s = ++star_s;
+    }
+    while (p < pend && *p == '*') p++;
+    return p == pend;
+}
+
+static int mg_glob_push(MgGlobPat **arr, int *n, const char *pat) {
+    MgGlobPat *na = (MgGlobPat*)realloc(*arr, (size_t)(*n + 1) * sizeof(MgGlobPat));
+    if (!na) return -1;
+    *arr = na;
+    MgGlobPat *g = &na[(*n)++];
+    g->pat = pat;
+    g->len = strlen(pat);
+    g->dir_only = g->len > 1 && pat[g->len - 1] == '/';
+    if (g->dir_only) g->len--;
+    return 0;
+}
+
+// --type NAME, 모르는 이름이면 -1 (EINVAL)
+MG_API int mg_filter_add_type(MgFileFilter *f, const char *name) {
+    for (size_t i = 0; i < MG_NUM_FILE_TYPES; i++) {
+        if (strcmp(mg_file_types[i].name, name) == 0) {
+            f->any_selector = 1;
+            return mg_ext_set_add_list(f, mg_file_types[i].exts);
+        }
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+// --include GLOB: "*.ext" (다른 메타 문자 없음) 는 확장자 집합으로
+// pat 은 복사하지 않음 (필터를 쓰는 동안 살아 있어야 함)
+MG_API int mg_filter_add_include(MgFileFilter *f, const char *pat) {
+    f->any_selector = 1;
+    if (pat[0] == '*' && pat[1] == '.' && pat[2] && strpbrk(pat + 2, "*?[.") == NULL &&
+        mg_ext_set_add(f, pat + 2, strlen(pat + 2)) == 0) {
+        return 0;
+    }
+    return mg_glob_push(&f->includes, &f->ninclude, pat);
+}
+
+MG_API int mg_filter_add_exclude(MgFileFilter *f, const char *pat) {
+    return mg_glob_push(&f->excludes, &f->nexclude, pat);
+}
+
+// 옵션 처리 후 1번: 아무것도 고르지 않았으면 기본 확장자 목록
+MG_API int mg_filter_finish(MgFileFilter *f) {
+    return f->any_selector ? 0 : mg_ext_set_add_list(f, MG_DEFAULT_EXTS);
+}
+
+MG_API void mg_filter_free(MgFileFilter *f) {
+    for (int i = 0; i < MG_EXT_SET_SIZE; i++) free((char*)f->exts[i]);
+    free(f->includes);
+    free(f->excludes);
+}
+
+static int mg_filter_excluded(const MgFileFilter *f, const char *name, int is_dir) {
+    for (int i = 0; i < f->nexclude; i++) {
+        const MgGlobPat *g = &f->excludes[i];
+        if (g->dir_only && !is_dir) continue;
+        if (mg_glob_match(g->pat, g->len, name)) return 1;
+    }
+    return 0;
+}
+
+// 검색 대상 파일인지 (항목 이름 기준)
+static int mg_name_selected(const MgFileFilter *f, const char *name) {
+    const char *ext = strrchr(name, '.');
+    if (ext && mg_ext_set_has(f, ext + 1, strlen(ext + 1))) return 1;
+    for (int i = 0; i < f->ninclude; i++) {
+        if (mg_glob_match(f->includes[i].pat, f->includes[i].len, name)) return 1;
+    }
+    return 0;
+}
+
+// 이름으로 고른 검색 대상 파일인지 (--exclude 먼저, all: 확장자 / --include 와 관계없이 모두)
+static int mg_filter_target(const MgFileFilter *f, const char *name, int all) {
+    if (f->nexclude > 0 && mg_filter_excluded(f, name, 0)) return 0;
+    return all || mg_name_selected(f, name);
+}
+
+// 내려가지 않을 디렉터리인지
+static inline int mg_filter_excluded_dir(const MgFileFilter *f, const char *name) {
+    return f->nexclude > 0 && mg_filter_excluded(f, name, 1);
+}
+
+// -------------------- 방문한 디렉터리 (symlink 고리 / bind mount 중복) --------------------
+// 디렉터리를 열 때마다 (st_dev, st_ino) 를 탐색 하나의 집합에 넣고, 이미 다른 경로로 읽은 디렉터리면 건너뜀
+// -> --follow 의 symlink 고리가 끝나고, bind mount 로 두 번 보이는 트리도 한 번만 검색
+// shard 64개 (shard마다 lock + 열린 주소법 표) -> 여러 worker가 동시에 넣어도 경합이 거의 없음
+// owner: mini-grep --daemon 의 캐시 노드 (같은 노드가 다시 읽는 것은 중복이 아님), 그 밖에는 NULL
+#define MG_VISIT_SHARDS 64
+
+typedef struct {
+    dev_t dev;
+    ino_t ino;
+    const void *owner;
+    int used;              // 0 = 빈 칸, 1 = 사용 중, 2 = 지워진 칸 (--daemon)
+} MgVisitKey;
+
+typedef struct {
+    _Alignas(64) pthread_mutex_t lock;
+    MgVisitKey *slots;
+    size_t cap;            // 2의 거듭제곱 (0 = 아직 없음)
+    size_t count;
+    size_t tombs;          // 지워진 칸 수
+} MgVisitShard;
+
+typedef struct {
+    MgVisitShard shards[MG_VISIT_SHARDS];
+} MgVisitSet;
+
+static void mg_visit_init(MgVisitSet *vs) {
+    for (int i = 0; i < MG_VISIT_SHARDS; i++) {
+        MgVisitShard *sh = &vs->shards[i];
+        pthread_mutex_init(&sh->lock, NULL);
+        sh->slots = NULL;
+        sh->cap = sh->count = sh->tombs = 0;
+    }
+}
+
+static void mg_visit_free(MgVisitSet *vs) {
+    for (int i = 0; i < MG_VISIT_SHARDS; i++) {
+        free(vs->shards[i].slots);
+        pthread_mutex_destroy(&vs->shards[i].lock);
+    }
+}
+
+static uint64_t mg_visit_hash(dev_t dev, ino_t ino) {
+    uint64_t h = (uint64_t)ino * 0x9E3779B97F4A7C15ULL ^ (uint64_t)dev * 0xC2B2AE3D27D4EB4FULL;
+    return h ^ (h >> 29);
+}
+
+// (dev, ino) 가 있으면 그 칸, 없으면 넣을 칸 (앞에 지워진 칸이 있으면 그 칸)
+// 아래 6비트는 shard 를 고르는 데 썼으므로 표 위치는 그 위 비트로
+static MgVisitKey *mg_visit_slot(MgVisitShard *sh, dev_t dev, ino_t ino, uint64_t h) {
+    size_t mask = sh->cap - 1;
+    MgVisitKey *tomb = NULL;
+    for (size_t i = (size_t)(h >> 6) & mask; ; i = (i + 1) & mask) {
+        MgVisitKey *k = &sh->slots[i];
+        if (k->used == 0) return tomb ? tomb : k;
+        if (k->used == 2) {
+            if (!tomb) tomb = k;
+        } else if (k->dev == dev && k->ino == ino) {
+            return k;
+        }
+    }
+}
+
+// 실패하면 -1 (표는 그대로)
+static int mg_visit_grow(MgVisitShard *sh) {
+    MgVisitKey *old = sh->slots;
+    size_t old_cap = sh->cap;
+    size_t cap = old_cap ? old_cap * 2 : 256;
+    MgVisitKey *slots = (MgVisitKey*)calloc(cap, sizeof(MgVisitKey));
+    if (!slots) return -1;
+    sh->slots = slots;
+    sh->cap = cap;
+    sh->count = sh->tombs = 0;
+    for (size_t i = 0; i < old_cap; i++) {
+        if (old[i].used != 1) continue;
+        *mg_visit_slot(sh, old[i].dev, old[i].ino, mg_visit_hash(old[i].dev, old[i].ino)) = old[i];
+        sh->count++;
+    }
+    free(old);
+    return 0;
+}
+
+// 처음 보는 디렉터리(또는 같은 owner 가 다시 읽음)면 1, 다른 경로로 이미 읽은 디렉터리면 0
+// 표를 늘려야 하는데 메모리가 없으면 -1
+static int mg_visit_claim(MgVisitSet *vs, dev_t dev, ino_t ino, const void *owner) {
+    uint64_t h = mg_visit_hash(dev, ino);
+    MgVisitShard *sh = &vs->shards[h & (MG_VISIT_SHARDS - 1)];
+    int ok = 1;
+
+    pthread_mutex_lock(&sh->lock);
+    if ((sh->count + sh->tombs + 1) * 4 > sh->cap * 3 && mg_visit_grow(sh) != 0) { // 빈 칸이 1/4 이상 남게
+        pthread_mutex_unlock(&sh->lock);
+        return -1;
+    }
+    MgVisitKey *k = mg_visit_slot(sh, dev, ino, h);
+    if (k->used == 1) {
+        ok = owner != NULL && k->owner == owner;
+    } else {
+        if (k->used == 2) sh->tombs--;
+        k->dev = dev;
+        k->ino = ino;
+        k->owner = owner;
+        k->used = 1;
+        sh->count++;
+    }
+    pthread_mutex_unlock(&sh->lock);
+    return ok;
+}
+
+// --daemon: 캐시 노드가 없어지거나 그 경로가 다른 디렉터리로 바뀜 (inode 가 재사용되어도 막히지 않게)
+static __attribute__((unused)) void mg_visit_release(MgVisitSet *vs, dev_t dev, ino_t ino, const void *owner) {
+    uint64_t h = mg_visit_hash(dev, ino);
+    MgVisitShard *sh = &vs->shards[h & (MG_VISIT_SHARDS - 1)];
+
+    pthread_mutex_lock(&sh->lock);
+    if (sh->cap > 0) {
+        MgVisitKey *k = mg_visit_slot(sh, dev, ino, h);
+        if (k->used == 1 && k->owner == owner) {
+            k->used = 2;
+            sh->count--;
+            sh->tombs++;
+        }
+    }
+    pthread_mutex_unlock(&sh->lock);
+}
+
+// -------------------- 디렉터리 항목 분류 (symlink / 파일 시스템 경계) --------------------
+// mini-grep 의 scan_directory 와 mg_search_tree 가 같은 규칙으로 탐색하도록 한 곳에서 판정
+// - 종류는 readdir 의 d_type (항목당 stat 0회), 모르거나 (follow 의) symlink 일 때만 디렉터리 fd 기준 fstatat
+// - symlink 는 follow 일 때만 따라감 (grep -r / rg 와 같음, 명령줄 [경로]는 항상 따라감)
+// - 디렉터리는 열 때 그 fd 로 fstat 1번 -> one_fs 경계 + 방문 집합 (mg_walk_open_dir)
+typedef struct {
+    int follow;            // 탐색 중 만난 symlink 도 따라감
+    int one_fs;            // root_dev 와 다른 파일 시스템(마운트)으로 내려가지 않음
+    dev_t root_dev;        // one_fs: [경로]의 st_dev
+} MgWalkOpts;
+
+typedef enum {
+    MG_WALK_SKIP     = 0,  // . / .., 디렉터리도 일반 파일도 아님, fstatat 실패
+    MG_WALK_DIR      = 1,
+    MG_WALK_FILE     = 2,
+    MG_WALK_SYMLINK  = 3,  // 따라가지 않은 symlink
+    MG_WALK_OTHER_FS = 4,  // one_fs: 다른 파일 시스템
+    MG_WALK_DUP      = 5,  // 이미 다른 경로로 읽은 디렉터리
+    MG_WALK_ERROR    = 6,  // 열 수 없음 (errno)
+    MG_WALK_NOMEM    = 7   // 방문 집합을 늘리지 못함
+} MgWalkResult;
+
+// 디렉터리 path 를 열고 방문 집합에 넣음: 성공하면 MG_WALK_DIR + *fd, *st (그 밖에는 fd 를 닫음)
+static MgWalkResult mg_walk_open_dir(const char *path, const MgWalkOpts *wo, MgVisitSet *vs, const void *owner,
+                                int *fd, struct stat *st) {
+    int dfd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd < 0) return MG_WALK_ERROR;
+    if (fstat(dfd, st) != 0) {
+        close(dfd);
+        return MG_WALK_ERROR;
+    }
+
+    MgWalkResult r = MG_WALK_DIR;
+    if (wo->one_fs && st->st_dev != wo->root_dev) {
+        r = MG_WALK_OTHER_FS;
+    } else {
+        int c = mg_visit_claim(vs, st->st_dev, st->st_ino, owner);
+        if (c <= 0) r = c < 0 ? MG_WALK_NOMEM : MG_WALK_DUP;
+    }
+    if (r != MG_WALK_DIR) {
+        close(dfd);
+        return r;
+    }
+    *fd = dfd;
+    return MG_WALK_DIR;
+}
+
+// 열린 디렉터리 dfd 의 항목 하나: MG_WALK_DIR / MG_WALK_FILE / MG_WALK_SYMLINK / MG_WALK_OTHER_FS / MG_WALK_SKIP
+// reg_stat: DT_REG 도 fstatat (mini-grep 인덱스의 변경 감지용 크기 / 수정 시각)
+// fstatat 으로 얻었으면 *st 를 채우고 *has_st = 1, 호출 횟수는 *stat_calls 에 더함 (NULL 이면 안 셈)
+static MgWalkResult mg_walk_classify(int dfd, const struct dirent *entry, const MgWalkOpts *wo, int reg_stat,
+                                struct stat *st, int *has_st, long long *stat_calls) {
+    const char *name = entry->d_name;
+    *has_st = 0;
+    if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+        return MG_WALK_SKIP;    // 현재 / 부모 디렉토리
+    }
+
+    unsigned char type = entry->d_type;
+    if (type == DT_LNK && !wo->follow) return MG_WALK_SYMLINK;
+
+    if (type == DT_UNKNOWN || type == DT_LNK || (type == DT_REG && reg_stat)) {
+        if (stat_calls) (*stat_calls)++;
+        if (fstatat(dfd, name, st, wo->follow ? 0 : AT_SYMLINK_NOFOLLOW) != 0) return MG_WALK_SKIP;
+        if (S_ISLNK(st->st_mode)) return MG_WALK_SYMLINK;   // d_type 을 몰랐던 symlink (follow 가 아님)
+        // 디렉터리는 열 때 mg_walk_open_dir 에서 확인, 파일은 follow 로 다른 파일 시스템을 가리킬 때만 여기서 걸림
+        if (wo->one_fs && !S_ISDIR(st->st_mode) && st->st_dev != wo->root_dev) return MG_WALK_OTHER_FS;
+        *has_st = 1;
+        return S_ISDIR(st->st_mode) ? MG_WALK_DIR : S_ISREG(st->st_mode) ? MG_WALK_FILE : MG_WALK_SKIP;
+    }
+    return type == DT_DIR ? MG_WALK_DIR : type == DT_REG ? MG_WALK_FILE : MG_WALK_SKIP;
+}
+
+// -------------------- CPU 개수 감지 --------------------
+// cgroup CPU quota (컨테이너 제한) -> 코어 수로 환산, 제한 없으면 0
+// v2: /sys/fs/cgroup/<자기 cgroup>/cpu.max ("quota period" 또는 "max period"), 상위로 올라가며 최솟값
+// v1: cpu.cfs_quota_us / cpu.cfs_period_us
+static int mg_read_quota_pair(const char *path_quota, const char *path_period) {
+    long long quota = -1, period = 0;
+
+    FILE *fp = fopen(path_quota, "r");
+    if (!fp) return 0;
+    if (path_period) {
+        if (fscanf(fp, "%lld", &quota) != 1) quota = -1;
+        fclose(fp);
+        fp = fopen(path_period, "r");
+        if (!fp) return 0;
+        if (fscanf(fp, "%lld", &period) != 1) period = 0;
+    } else {
+        if (fscanf(fp, "%lld %lld", &quota, &period) != 2) quota = -1;   // "max ..." 이면 실패 -> 제한 없음
+    }
+    fclose(fp);
+
+    if (quota <= 0 || period <= 0) return 0;
+    return (int)((quota + period - 1) / period);    // 올림: 1.5 CPU -> 2
+}
+
+static int mg_cgroup_cpu_limit(void) {
+    char rel[4096] = "";
+
+    FILE *fp = fopen("/proc/self/cgroup", "r");
+    if (fp) {
+        char line[4096];
+        while (fgets(line, sizeof(line), fp)) {
+            if (strncmp(line, "0::", 3) == 0) {
+                snprintf(rel, sizeof(rel), "%s", line + 3);
+                rel[strcspn(rel, "\n")] = '\0';
+                break;
+            }
+        }
+        fclose(fp);
+    }
+
+    int best = 0;
+    char path[4096 + 64];
+    while (1) {
+        snprintf(path, sizeof(path), "/sys/fs/cgroup%s/cpu.max", strcmp(rel, "/") == 0 ? "" : rel);
+        int lim = mg_read_quota_pair(path, NULL);
+        if (lim > 0 && (best == 0 || lim < best)) best = lim;
+
+        char *slash = strrchr(rel, '/');
+        if (!slash || rel[0] == '\0' || strcmp(rel, "/") == 0) break;
+        *slash = '\0';
+    }
+    if (best > 0) return best;
+
+    static const char *v1_dirs[] = { "/sys/fs/cgroup/cpu", "/sys/fs/cgroup/cpu,cpuacct" };
+    for (size_t i = 0; i < sizeof(v1_dirs) / sizeof(v1_dirs[0]); i++) {
+        char q[256], pr[256];
+        snprintf(q, sizeof(q), "%s/cpu.cfs_quota_us", v1_dirs[i]);
+        snprintf(pr, sizeof(pr), "%s/cpu.cfs_period_us", v1_dirs[i]);
+        int lim = mg_read_quota_pair(q, pr);
+        if (lim > 0) return lim;
+    }
+    return 0;
+}
+
+// 이 프로세스가 실제로 쓸 수 있는 CPU 수
+// = min(affinity mask에 있는 CPU 수, cgroup quota), 실패 시 online CPU 수
+static int mg_detect_cpu_count(void) {
+    int n = 0;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        n = CPU_COUNT(&set);
+    }
+    if (n <= 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        n = online > 0 ? (int)online : 1;
+    }
+
+    int lim = mg_cgroup_cpu_limit();
+    if (lim > 0 && lim < n) n = lim;
+    return n;
+}
+
+// -------------------- 작업 경로 블록 (디렉터리별 arena) --------------------
+// 경로마다 strdup/free 하는 대신, 디렉터리 하나의 항목 이름들을 블록에 이어 붙여 저장
+// - 작업은 (블록, 이름 위치) 핸들만 들고 다님, 전체 경로는 필요할 때 부모를 따라 올라가며 조립
+// - 블록마다 참조 수: 그 블록을 가리키는 작업 수 + 자식 디렉터리 블록 수 (+ 채우는 중이면 1)
+//   -> 0이 되면 블록을 통째로 해제하고 부모 블록 참조도 놓음
+// - 항목이 많은 디렉터리는 블록 크기를 2배씩 늘리며 여러 개로 나눔 (발행된 블록은 움직이지 않음)
+// - 블록마다 붙일 데이터가 있으면 MgPathBlock 을 첫 멤버로 둔 구조체 크기를 hdr 로 (해제 전에 on_free)
+#define MG_PATH_BLOCK_MIN  512
+#define MG_PATH_BLOCK_MAX  (64 * 1024)
+
+typedef struct MgPathBlock {
+    struct MgPathBlock *parent;  // 이 디렉터리 이름이 들어 있는 블록 (NULL = 루트)
+    uint32_t parent_off;         // parent 안에서 이 디렉터리 이름 위치
+    uint32_t used;
+    uint32_t cap;
+    atomic_uint refs;
+    void (*on_free)(struct MgPathBlock *b);     // 해제 직전 (NULL = 없음)
+    char *names;                 // NUL로 끝나는 이름들 (hdr 바로 뒤)
+} MgPathBlock;
+
+// 채우는 쪽의 참조 1개를 가진 새 블록, 메모리가 부족하면 NULL
+static MgPathBlock *mg_path_block_new(size_t hdr, MgPathBlock *parent, uint32_t parent_off, size_t need,
+                                      uint32_t prev_cap, void (*on_free)(MgPathBlock *b)) {
+    size_t cap = prev_cap ? (size_t)prev_cap * 2 : MG_PATH_BLOCK_MIN;
+    if (cap > MG_PATH_BLOCK_MAX) cap = MG_PATH_BLOCK_MAX;
+    if (cap < need) cap = need;
+
+    MgPathBlock *b = (MgPathBlock*)malloc(hdr + cap);
+    if (!b) return NULL;
+    b->parent = parent;
+    b->parent_off = parent_off;
+    b->used = 0;
+    b->cap = (uint32_t)cap;
+    atomic_init(&b->refs, 1);
+    b->on_free = on_free;
+    b->names = (char*)b + hdr;
+    if (parent) atomic_fetch_add_explicit(&parent->refs, 1, memory_order_relaxed);
+    return b;
+}
+
+static inline void mg_path_retain(MgPathBlock *b) {
+    atomic_fetch_add_explicit(&b->refs, 1, memory_order_relaxed);
+}
+
+static void mg_path_release(MgPathBlock *b) {
+    while (b && atomic_fetch_sub_explicit(&b->refs, 1, memory_order_acq_rel) == 1) {
+        MgPathBlock *parent = b->parent;
+        if (b->on_free) b->on_free(b);
+        free(b);
+        b = parent;
+    }
+}
+
+// 이름 하나 추가 후 위치 반환 (b는 채우는 쪽만 씀, 이미 쓴 이름은 다시 건드리지 않음)
+static uint32_t mg_path_block_put(MgPathBlock *b, const char *name, size_t len) {
+    uint32_t off = b->used;
+    memcpy(b->names + off, name, len);
+    b->names[off + len] = '\0';
+    b->used += (uint32_t)len + 1;
+    return off;
+}
+
+// (b, off) 의 전체 경로를 *buf 에 조립, 길이 반환 (메모리가 부족하면 SIZE_MAX, *buf 는 그대로)
+static size_t mg_path_build(const MgPathBlock *b, uint32_t off, char **buf, size_t *cap) {
+    size_t total = 0;
+    const MgPathBlock *cb = b;
+    uint32_t co = off;
+    while (1) {
+        total += strlen(cb->names + co);
+        if (!cb->parent) break;
+        total++;    // '/'
+        co = cb->parent_off;
+        cb = cb->parent;
+    }
+
+    if (total + 1 > *cap) {
+        size_t new_cap = *cap ? *cap : 256;
+        while (new_cap < total + 1) new_cap *= 2;
+        char *nb = (char*)realloc(*buf, new_cap);
+        if (!nb) return SIZE_MAX;
+        *buf = nb;
+        *cap = new_cap;
+    }
+
+    // 뒤에서부터 채움
+    char *p = *buf + total;
+    *p = '\0';
+    cb = b;
+    co = off;
+    while (1) {
+        size_t len = strlen(cb->names + co);
+        p -= len;
+        memcpy(p, cb->names + co, len);
+        if (!cb->parent) break;
+        *--p = '/';
+        co = cb->parent_off;
+        cb = cb->parent;
+    }
+    return total;
+}
+
+// -------------------- Work-stealing 스케줄러 --------------------
+// mg_search_tree 와 mini-grep --scheduler=steal 이 같이 쓰는 작업 분배
+// worker마다 자기 deque를 가짐 (파일용 1개 + 디렉터리용 1개)
+// - owner: bottom 쪽에서 push/pop (LIFO -> 방금 읽은 디렉터리의 자식부터 처리, 캐시 지역성)
+// - thief: 다른 worker deque의 top 쪽에서 절반을 훔쳐옴 (FIFO -> 루트에 가까운 큰 작업)
+// deque마다 lock이 따로 있어서 평소에는 경합이 거의 없고,
+// 전역으로 공유되는 것은 종료 감지용 pending과 sleep 관련 상태뿐
+#define MG_STEAL_MAX          32    // 한 번에 훔쳐오는 최대 작업 수
+#define MG_PENDING_FLUSH_EVERY 64   // 완료 카운트를 전역 pending에 반영하는 주기
+#define MG_TASK_BATCH_MAX     256   // 한 번에 push 하는 최대 작업 수
+
+// 작업 종류: MG_TASK_DIR 이면 디렉터리 deque, 나머지는 파일 deque
+// (MG_TASK_USER 부터는 포함한 쪽이 정의, mini-grep: 큰 파일 조각)
+typedef enum {
+    MG_TASK_FILE = 0,
+    MG_TASK_DIR  = 1,
+    MG_TASK_USER = 2
+} MgTaskKind;
+
+// 탐색 중에 이미 얻은 파일 메타데이터 (있으면 검색할 때 fstat 생략)
+typedef struct {
+    off_t size;            // -1 = 모름 (d_type으로 종류만 확인한 경우)
+    time_t mtime;
+    long mtime_nsec;       // 인덱스의 변경 감지용
+} MgFileMeta;
+
+typedef struct {
+    MgPathBlock *blk;      // 경로 블록 (작업마다 참조 1개, 끝나면 mg_path_release, 없으면 NULL)
+    uint32_t off;          // 블록 안 이름 위치
+    uint32_t seq;          // 부모 디렉터리 안에서의 순번 (mini-grep --sort=path)
+    MgTaskKind kind;
+    union {
+        MgFileMeta meta;   // MG_TASK_FILE
+        void *data;        // MG_TASK_DIR / 사용자 종류: 포함한 쪽의 데이터 (mini-grep: 캐시된 디렉터리, 나눠 검색 중인 파일)
+    };
+} MgTask;
+
+// worker 역할
+// - 검색 worker: 파일 작업 우선, 없으면 디렉터리 작업도 처리 (CPU-bound)
+// - 탐색 전용 worker: 디렉터리 작업만 처리 (opendir/readdir/stat 대기가 긴 I/O-bound)
+typedef enum {
+    MG_ROLE_MATCH = 0,
+    MG_ROLE_WALK  = 1
+} MgWorkerRole;
+
+typedef struct {
+    _Alignas(64) pthread_mutex_t lock;   // deque별 lock (cache line 분리)
+    MgTask *buf;
+    size_t cap;
+    size_t head;           // top (steal 위치)
+    size_t count;
+    atomic_size_t size;    // lock 없이 비어있는지 확인하기 위한 count 사본
+} MgWorkDeque;
+
+typedef struct {
+    MgWorkDeque *deques;   // worker i: [2*i] 파일, [2*i + 1] 디렉터리
+    int n;
+    int *victims;          // 노드 2개 이상: worker마다 n-1개씩 훔칠 순서 (같은 노드 먼저), NULL = self 다음 번호부터
+    int *nlocal;           // victims 중 앞쪽의 같은 노드 worker 수
+    size_t limit;          // 쌓아둘 파일 작업 수 상한 (mg_pool_wait_space, 0 = 무제한)
+    int track_peak;        // peak_files 측정 (파일 작업을 push 할 때마다 전체 개수를 셈)
+    atomic_size_t remote_steals; // 다른 노드 deque에서 훔쳐온 횟수
+
+    atomic_size_t pending; // push 됐지만 아직 완료 처리되지 않은 작업 수
+    atomic_int sleepers;   // sleep_cond 에서 대기 중인 검색 worker 수
+    atomic_int walk_sleepers; // walk_cond 에서 대기 중인 탐색 전용 worker 수
+    atomic_int done;       // 전체 종료 플래그 (mg_pool_cancel 로도 설정)
+    atomic_int space_waiters; // space_cond 에서 대기 중인 탐색 전용 worker 수
+    atomic_size_t peak_files; // 가장 많이 쌓였던 파일 작업 수 (track_peak 일 때만)
+
+    pthread_mutex_t sleep_lock;
+    pthread_cond_t  sleep_cond;
+    pthread_cond_t  walk_cond;
+    pthread_cond_t  space_cond;   // 파일 작업이 limit 아래로 내려감
+} MgStealPool;
+
+#define MG_POOL_FILES(p, i) (&(p)->deques[2 * (i)])
+#define MG_POOL_DIRS(p, i)  (&(p)->deques[2 * (i) + 1])
+
+// cond에서 대기 중인 waiters 중 최대 n개를 깨움, 깨운 수 반환 (lock 잡은 상태)
+static size_t mg_wake_some(pthread_cond_t *cond, size_t waiters, size_t n) {
+    if (waiters == 0 || n == 0) return 0;
+    if (n >= waiters) {
+        pthread_cond_broadcast(cond);
+        return waiters;
+    }
+    for (size_t i = 0; i < n; i++) {
+        pthread_cond_signal(cond);
+    }
+    return n;
+}
+
+static int mg_deque_init(MgWorkDeque *d) {
+    d->cap = 256;
+    d->buf = (MgTask*)calloc(d->cap, sizeof(MgTask));
+    if (!d->buf) return -1;
+    pthread_mutex_init(&d->lock, NULL);
+    d->head = d->count = 0;
+    atomic_init(&d->size, 0);
+    return 0;
+}
+
+static void mg_deque_destroy(MgWorkDeque *d) {
+    for (size_t i = 0; i < d->count; i++) {
+        mg_path_release(d->buf[(d->head + i) % d->cap].blk);
+    }
+    free(d->buf);
+    pthread_mutex_destroy(&d->lock);
+}
+
+// lock 잡은 상태에서 호출, 메모리가 부족하면 -1 (그대로 둠)
+static int mg_deque_grow(MgWorkDeque *d, size_t need) {
+    size_t new_cap = d->cap;
+    while (new_cap < need) new_cap *= 2;
+    if (new_cap == d->cap) return 0;
+
+    MgTask *new_buf = (MgTask*)calloc(new_cap, sizeof(MgTask));
+    if (!new_buf) return -1;
+    for (size_t i = 0; i < d->count; i++) {
+        new_buf[i] = d->buf[(d->head + i) % d->cap];
+    }
+    free(d->buf);
+    d->buf = new_buf;
+    d->cap = new_cap;
+    d->head = 0;
+    return 0;
+}
+
+// 메모리가 부족하면 -1 (하나도 넣지 않음)
+static int mg_deque_push_bottom(MgWorkDeque *d, const MgTask *items, size_t n) {
+    pthread_mutex_lock(&d->lock);
+    if (mg_deque_grow(d, d->count + n) != 0) {
+        pthread_mutex_unlock(&d->lock);
+        return -1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        d->buf[(d->head + d->count + i) % d->cap] = items[i];
+    }
+    d->count += n;
+    atomic_store(&d->size, d->count);
+    pthread_mutex_unlock(&d->lock);
+    return 0;
+}
+
+static int mg_deque_pop_bottom(MgWorkDeque *d, MgTask *out) {
+    if (atomic_load_explicit(&d->size, memory_order_relaxed) == 0) return 0;
+
+    int ok = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->count > 0) {
+        d->count--;
+        *out = d->buf[(d->head + d->count) % d->cap];
+        atomic_store(&d->size, d->count);
+        ok = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+// victim의 top에서 절반(최대 MG_STEAL_MAX)을 가져옴
+// 첫 번째는 out으로, 나머지는 thief 자신의 deque로 (자리를 먼저 확보, 못 하면 1개만)
+static int mg_deque_steal(MgWorkDeque *victim, MgWorkDeque *self, MgTask *out) {
+    if (atomic_load_explicit(&victim->size, memory_order_relaxed) == 0) return 0;
+
+    pthread_mutex_lock(&self->lock);
+    size_t max = mg_deque_grow(self, self->count + MG_STEAL_MAX - 1) == 0 ? MG_STEAL_MAX : 1;
+    pthread_mutex_unlock(&self->lock);
+
+    MgTask stolen[MG_STEAL_MAX];
+    size_t k = 0;
+
+    pthread_mutex_lock(&victim->lock);
+    if (victim->count > 0) {
+        k = (victim->count + 1) / 2;
+        if (k > max) k = max;
+        for (size_t i = 0; i < k; i++) {
+            stolen[i] = victim->buf[victim->head];
+            victim->head = (victim->head + 1) % victim->cap;
+        }
+        victim->count -= k;
+        atomic_store(&victim->size, victim->count);
+    }
+    pthread_mutex_unlock(&victim->lock);
+
+    if (k == 0) return 0;
+
+    *out = stolen[0];
+    if (k > 1) {
+        mg_deque_push_bottom(self, stolen + 1, k - 1);   // 자리는 위에서 확보 (self 에 push 하는 것은 자기뿐)
+    }
+    return 1;
+}
+
+static void mg_pool_destroy(MgStealPool *p);
+
+// node_of: worker i 의 NUMA 노드 (NULL = 구분 없음), limit: mg_pool_wait_space 의 상한
+// 메모리가 부족하면 -1
+static int mg_pool_init(MgStealPool *p, int n, const int *node_of, size_t limit, int track_peak) {
+    memset(p, 0, sizeof(*p));
+    p->n = n;
+    p->limit = limit;
+    p->track_peak = track_peak;
+    p->deques = (MgWorkDeque*)aligned_alloc(64, sizeof(MgWorkDeque) * 2 * (size_t)n);
+    if (!p->deques) return -1;
+    for (int i = 0; i < 2 * n; i++) {
+        if (mg_deque_init(&p->deques[i]) != 0) {
+            for (int j = 0; j < i; j++) mg_deque_destroy(&p->deques[j]);
+            free(p->deques);
+            return -1;
+        }
+    }
+    atomic_init(&p->pending, 0);
+    atomic_init(&p->sleepers, 0);
+    atomic_init(&p->walk_sleepers, 0);
+    atomic_init(&p->done, 0);
+    atomic_init(&p->space_waiters, 0);
+    atomic_init(&p->peak_files, 0);
+    atomic_init(&p->remote_steals, 0);
+    pthread_mutex_init(&p->sleep_lock, NULL);
+    pthread_cond_init(&p->sleep_cond, NULL);
+    pthread_cond_init(&p->walk_cond, NULL);
+    pthread_cond_init(&p->space_cond, NULL);
+
+    // 노드가 나뉘면 훔칠 순서를 미리 정함: 같은 노드 worker -> 다른 노드 worker
+    // (각각 self 다음 번호부터), 다른 노드의 deque는 cache line 과 작업의 메모리가 멀어서 마지막 수단
+    if (node_of && n > 1) {
+        p->victims = (int*)malloc(sizeof(int) * (size_t)n * (size_t)(n - 1));
+        p->nlocal = (int*)malloc(sizeof(int) * (size_t)n);
+        if (!p->victims || !p->nlocal) {
+            mg_pool_destroy(p);
+            return -1;
+        }
+        for (int self = 0; self < n; self++) {
+            int *v = p->victims + (size_t)self * (size_t)(n - 1);
+            int k = 0;
+            for (int i = 1; i < n; i++) {
+                int w = (self + i) % n;
+                if (node_of[w] == node_of[self]) v[k++] = w;
+            }
+            p->nlocal[self] = k;
+            for (int i = 1; i < n; i++) {
+                int w = (self + i) % n;
+                if (node_of[w] != node_of[self]) v[k++] = w;
+            }
+        }
+    }
+    return 0;
+}
+
+static void mg_pool_destroy(MgStealPool *p) {
+    for (int i = 0; i < 2 * p->n; i++) {
+        mg_deque_destroy(&p->deques[i]);
+    }
+    free(p->deques);
+    free(p->victims);
+    free(p->nlocal);
+    pthread_mutex_destroy(&p->sleep_lock);
+    pthread_cond_destroy(&p->sleep_cond);
+    pthread_cond_destroy(&p->walk_cond);
+    pthread_cond_destroy(&p->space_cond);
+}
+
+// 모든 worker deque에 쌓인 파일 작업 수 (lock 없이 읽은 근삿값)
+static size_t mg_pool_files_queued(MgStealPool *p) {
+    size_t n = 0;
+    for (int i = 0; i < p->n; i++) n += atomic_load(&MG_POOL_FILES(p, i)->size);
+    return n;
+}
+
+// 파일 작업을 꺼낸 직후: 상한에 걸려 기다리는 탐색 worker가 있으면 자리가 났을 때 깨움
+// (대기하는 쪽은 space_waiters 를 올린 뒤 개수를 확인하므로 깨우기를 놓치지 않음)
+static int mg_pool_took_file(MgStealPool *p) {
+    if (atomic_load(&p->space_waiters) > 0) {
+        pthread_mutex_lock(&p->sleep_lock);
+        if (mg_pool_files_queued(p) < p->limit) pthread_cond_broadcast(&p->space_cond);
+        pthread_mutex_unlock(&p->sleep_lock);
+    }
+    return 1;
+}
+
+static int mg_pool_has_work(MgStealPool *p, MgWorkerRole role) {
+    for (int i = 0; i < p->n; i++) {
+        if (atomic_load(&MG_POOL_DIRS(p, i)->size) != 0) return 1;
+        if (role == MG_ROLE_MATCH && atomic_load(&MG_POOL_FILES(p, i)->size) != 0) return 1;
+    }
+    return 0;
+}
+
+// 로컬에 모아둔 완료 개수를 전역 pending에 반영
+// pending이 0이 되면 전체 종료
+static void mg_pool_flush_done(MgStealPool *p, size_t *local_done) {
+    if (*local_done == 0) return;
+
+    size_t before = atomic_fetch_sub(&p->pending, *local_done);
+    if (before == *local_done) {
+        pthread_mutex_lock(&p->sleep_lock);
+        atomic_store(&p->done, 1);
+        pthread_cond_broadcast(&p->sleep_cond);
+        pthread_cond_broadcast(&p->walk_cond);
+        pthread_mutex_unlock(&p->sleep_lock);
+    }
+    *local_done = 0;
+}
+
+static void mg_task_drop(const MgTask *items, size_t n) {
+    for (size_t i = 0; i < n; i++) mg_path_release(items[i].blk);
+}
+
+// self의 deque에 배치 push (n <= MG_TASK_BATCH_MAX, 블록 참조는 풀로 넘어감)
+// 후 sleep 중인 worker가 있을 때만 작업 수만큼 깨움
+// 메모리가 부족하면 -1: 넣지 못한 작업은 버리고 완료로 처리
+static int mg_pool_push_batch(MgStealPool *p, int self, const MgTask *items, size_t n) {
+    if (n == 0) return 0;
+    if (atomic_load_explicit(&p->done, memory_order_relaxed)) {
+        mg_task_drop(items, n);     // 취소 뒤의 작업은 버림
+        return 0;
+    }
+
+    MgTask files[MG_TASK_BATCH_MAX];
+    MgTask dirs[MG_TASK_BATCH_MAX];
+    size_t nf = 0, nd = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (items[i].kind == MG_TASK_DIR) dirs[nd++] = items[i];
+        else files[nf++] = items[i];
+    }
+
+    // 작업이 보이기 전에 pending을 먼저 올려야 조기 종료가 생기지 않음
+    atomic_fetch_add(&p->pending, n);
+    size_t lost = 0;
+    if (nf && mg_deque_push_bottom(MG_POOL_FILES(p, self), files, nf) != 0) {
+        mg_task_drop(files, nf);
+        lost += nf;
+        nf = 0;
+    }
+    if (nd && mg_deque_push_bottom(MG_POOL_DIRS(p, self), dirs, nd) != 0) {
+        mg_task_drop(dirs, nd);
+        lost += nd;
+        nd = 0;
+    }
+    int rc = lost ? -1 : 0;
+    mg_pool_flush_done(p, &lost);
+    if (p->track_peak && nf) {
+        size_t queued = mg_pool_files_queued(p);
+        size_t peak = atomic_load_explicit(&p->peak_files, memory_order_relaxed);
+        while (queued > peak && !atomic_compare_exchange_weak(&p->peak_files, &peak, queued)) {}
+    }
+
+    int walk_sleepers = atomic_load(&p->walk_sleepers);
+    int sleepers = atomic_load(&p->sleepers);
+    if (sleepers > 0 || (nd > 0 && walk_sleepers > 0)) {
+        pthread_mutex_lock(&p->sleep_lock);
+        size_t woken = mg_wake_some(&p->walk_cond, (size_t)walk_sleepers, nd);
+        mg_wake_some(&p->sleep_cond, (size_t)sleepers, nf + nd - woken);
+        pthread_mutex_unlock(&p->sleep_lock);
+    }
+    return rc;
+}
+
+// 다른 worker의 종류별 deque에서 훔치기
+// remote = 0: 같은 노드 worker (노드 구분이 없으면 전부, self 다음 번호부터), 1: 다른 노드 worker
+static int mg_pool_steal(MgStealPool *p, int self, MgTaskKind kind, MgTask *out, int remote) {
+    const int *order = NULL;
+    int from = 0, to = p->n - 1;
+    if (p->victims) {
+        order = p->victims + (size_t)self * (size_t)(p->n - 1);
+        if (remote) from = p->nlocal[self];
+        else to = p->nlocal[self];
+    } else if (remote) {
+        return 0;
+    }
+
+    for (int i = from; i < to; i++) {
+        int victim = order ? order[i] : (self + 1 + i) % p->n;
+        int ok = (kind == MG_TASK_DIR)
+            ? mg_deque_steal(MG_POOL_DIRS(p, victim), MG_POOL_DIRS(p, self), out)
+            : mg_deque_steal(MG_POOL_FILES(p, victim), MG_POOL_FILES(p, self), out);
+        if (ok) {
+            if (remote) atomic_fetch_add_explicit(&p->remote_steals, 1, memory_order_relaxed);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 훔치기 순서: 같은 노드의 파일 -> 디렉터리, 그래도 없을 때만 다른 노드의 파일 -> 디렉터리
+static int mg_pool_steal_any(MgStealPool *p, int self, MgWorkerRole role, MgTask *out) {
+    for (int remote = 0; remote <= 1; remote++) {
+        if (role == MG_ROLE_MATCH && mg_pool_steal(p, self, MG_TASK_FILE, out, remote)) return mg_pool_took_file(p);
+        if (mg_pool_steal(p, self, MG_TASK_DIR, out, remote)) return 1;
+    }
+    return 0;
+}
+
+// 대기하지 않는 pop: 자기 deque -> 훔치기, 없으면 0
+static __attribute__((unused)) int mg_pool_try_next(MgStealPool *p, int self, MgWorkerRole role, MgTask *out) {
+    if (atomic_load_explicit(&p->done, memory_order_relaxed)) return 0;
+    if (role == MG_ROLE_MATCH && mg_deque_pop_bottom(MG_POOL_FILES(p, self), out)) return mg_pool_took_file(p);
+    if (mg_deque_pop_bottom(MG_POOL_DIRS(p, self), out)) return 1;
+    return mg_pool_steal_any(p, self, role, out);
+}
+
+// 파일 작업만 대기 없이 pop (상한에 걸린 검색 worker가 직접 검색할 때)
+static __attribute__((unused)) int mg_pool_try_file(MgStealPool *p, int self, MgTask *out) {
+    if (atomic_load_explicit(&p->done, memory_order_relaxed)) return 0;
+    if (mg_deque_pop_bottom(MG_POOL_FILES(p, self), out) ||
+        mg_pool_steal(p, self, MG_TASK_FILE, out, 0) || mg_pool_steal(p, self, MG_TASK_FILE, out, 1)) {
+        return mg_pool_took_file(p);
+    }
+    return 0;
+}
+
+// CPU에 고정된 worker가 자기 deque 버퍼를 다시 할당 -> first-touch 로 worker 노드의 메모리에 놓임
+// (mg_pool_init 은 만든 스레드에서 하므로 처음 버퍼는 그쪽 노드), 이미 작업이 들어 있거나 할당에 실패하면 그대로 둠
+static __attribute__((unused)) void mg_pool_localize(MgStealPool *p, int self) {
+    MgWorkDeque *ds[2] = { MG_POOL_FILES(p, self), MG_POOL_DIRS(p, self) };
+    for (int k = 0; k < 2; k++) {
+        MgWorkDeque *d = ds[k];
+        MgTask *nb = (MgTask*)calloc(d->cap, sizeof(MgTask));
+        if (!nb) continue;
+        pthread_mutex_lock(&d->lock);
+        if (d->count == 0) {
+            free(d->buf);
+            d->buf = nb;
+            d->head = 0;
+            nb = NULL;
+        }
+        pthread_mutex_unlock(&d->lock);
+        free(nb);
+    }
+}
+
+// 탐색 전용 worker: 파일 작업이 limit 아래로 내려갈 때까지 대기 (limit > 0 일 때만 호출)
+static __attribute__((unused)) void mg_pool_wait_space(MgStealPool *p) {
+    pthread_mutex_lock(&p->sleep_lock);
+    atomic_fetch_add(&p->space_waiters, 1);
+    while (!atomic_load(&p->done) && mg_pool_files_queued(p) >= p->limit) {
+        pthread_cond_wait(&p->space_cond, &p->sleep_lock);
+    }
+    atomic_fetch_sub(&p->space_waiters, 1);
+    pthread_mutex_unlock(&p->sleep_lock);
+}
+
+// 작업 n개 완료 처리 (mg_pool_next 의 finished_prev 를 여러 개 한 번에)
+static __attribute__((unused)) void mg_pool_finish(MgStealPool *p, size_t n, size_t *local_done) {
+    *local_done += n;
+    if (*local_done >= MG_PENDING_FLUSH_EVERY) {
+        mg_pool_flush_done(p, local_done);
+    }
+}
+
+// 다음 작업 (out->blk 참조는 호출자가 release), local_done 은 worker별 완료 카운터
+// 반환: 1 = 작업 있음, 0 = 전체 작업 종료 (또는 취소)
+static int mg_pool_next(MgStealPool *p, int self, MgWorkerRole role, MgTask *out,
+                        int finished_prev, size_t *local_done) {
+    if (finished_prev) {
+        (*local_done)++;
+        if (*local_done >= MG_PENDING_FLUSH_EVERY) {
+            mg_pool_flush_done(p, local_done);
+        }
+    }
+
+    while (1) {
+        if (atomic_load_explicit(&p->done, memory_order_relaxed)) return 0;   // 취소됨
+        if (role == MG_ROLE_MATCH && mg_deque_pop_bottom(MG_POOL_FILES(p, self), out)) return mg_pool_took_file(p);
+        if (mg_deque_pop_bottom(MG_POOL_DIRS(p, self), out)) return 1;
+
+        // 로컬 작업 소진 -> sleep 전에 완료 카운트를 반드시 반영해야 종료 감지가 가능
+        mg_pool_flush_done(p, local_done);
+        if (atomic_load(&p->done)) return 0;
+
+        if (mg_pool_steal_any(p, self, role, out)) return 1;
+
+        // 훔칠 것도 없음 -> sleep
+        pthread_cond_t *cond = (role == MG_ROLE_WALK) ? &p->walk_cond : &p->sleep_cond;
+        atomic_int *counter = (role == MG_ROLE_WALK) ? &p->walk_sleepers : &p->sleepers;
+
+        pthread_mutex_lock(&p->sleep_lock);
+        atomic_fetch_add(counter, 1);
+        while (!atomic_load(&p->done) && !mg_pool_has_work(p, role)) {
+            pthread_cond_wait(cond, &p->sleep_lock);
+        }
+        atomic_fetch_sub(counter, 1);
+        pthread_mutex_unlock(&p->sleep_lock);
+
+        if (atomic_load(&p->done)) return 0;
+    }
+}
+
+// 검색 조기 종료: done 을 세우고 모두 깨움
+// deque에 남은 작업은 mg_pool_destroy 에서 정리
+static void mg_pool_cancel(MgStealPool *p) {
+    pthread_mutex_lock(&p->sleep_lock);
+    atomic_store(&p->done, 1);
+    pthread_cond_broadcast(&p->sleep_cond);
+    pthread_cond_broadcast(&p->walk_cond);
+    pthread_cond_broadcast(&p->space_cond);
+    pthread_mutex_unlock(&p->sleep_lock);
+}
+
+// -------------------- 공개 API (mg_*) --------------------
+// 위의 커널 / 매처를 그대로 감싼 얇은 층 (mini-grep 은 매처를 직접, single-mini-grep 은 이 API만 사용)
+// - MgPattern: 컴파일된 패턴, 패턴 복사본을 가지고 있고 여러 스레드에서 동시에 검색해도 됨
+// - mg_next_match: 버퍼에서 다음 매칭 줄과 그 줄의 첫 매칭 위치, mg_next_span: 줄 안의 매칭 구간 (강조용)
+// - mg_search_tree: 디렉터리 트리를 여러 스레드로 검색, 매칭 줄마다 callback
+//   파일 고르기는 위의 MgFileFilter (mg_filter_add_type / mg_filter_add_include / mg_filter_add_exclude, mg_filter_finish, mg_filter_free)
+// - mg_kernel_name: 런타임에 고른 SIMD 커널 이름 (배너 / 로그용)
+// - 정규식 강조용 표가 스레드별로 남음: 직접 만든 스레드에서 검색했으면 끝날 때 mg_thread_done()
+
+typedef struct {
+    MgMatcher m;
+    char *buf;             // 패턴 복사본 (NUL 로 구분해 이어 붙임)
+    const char **pats;
+    size_t *lens;
+} MgPattern;
+
+// 버퍼 검색 위치: 0 으로 채워서 시작 (버퍼 처음, 1번째 줄)
+typedef struct {
+    size_t pos;            // 다음에 검색할 줄의 시작 (buf 기준)
+    size_t line_num;       // 그 줄의 번호 (0 = 1)
+} MgCursor;
+
+// 위치는 모두 buf 기준
+typedef struct {
+    size_t line_num;       // 매칭 줄 번호 (1부터)
+    size_t line_off;       // 줄 시작
+    size_t line_len;       // 줄 길이 ('\n' 미포함)
+    size_t match_off;      // 줄 안 첫 매칭 위치
+    size_t match_len;      // 빈 패턴이나 빈 문자열에 매칭되는 정규식(^ 등)은 0
+    int pat;               // 첫 매칭의 패턴 번호 (-E 는 0)
+} MgMatch;
+
+static pthread_once_t mg_once = PTHREAD_ONCE_INIT;
+
+// CPU에 맞는 커널 선택 (mg_compile 이 부름, 여러 번 / 여러 스레드에서 불러도 1번만)
+MG_API void mg_init(void) {
+    pthread_once(&mg_once, mg_find_init);
+}
+
+// 고른 부분 문자열 검색 커널 이름 ("avx2", "sse2", "neon", "scalar")
+MG_API const char *mg_kernel_name(void) {
+    mg_init();
+    return mg_find_impl_name;
+}
+
+static void mg_free_copies(MgPattern *p) {
+    free(p->buf);
+    free(p->pats);
+    free(p->lens);
+    free(p);
+}
+
+// pats[0..npats) (길이 lens) 를 flags (MG_EXTENDED | MG_IGNORE_CASE | MG_WORD) 로 컴파일
+// 실패하면 NULL + *err (정규식 문법 오류, 메모리 부족 등)
+MG_API MgPattern *mg_compile(const char *const *pats, const size_t *lens, int npats, int flags, const char **err) {
+    if (npats < 1) {
+        *err = "패턴이 없습니다";
+        return NULL;
+    }
+    mg_init();
+
+    size_t total = 0;
+    for (int i = 0; i < npats; i++) total += lens[i] + 1;
+
+    MgPattern *p = (MgPattern*)calloc(1, sizeof(MgPattern));
+    if (p) {
+        p->buf = (char*)malloc(total);
+        p->pats = (const char**)malloc((size_t)npats * sizeof(char*));
+        p->lens = (size_t*)malloc((size_t)npats * sizeof(size_t));
+    }
+    if (!p || !p->buf || !p->pats || !p->lens) {
+        if (p) mg_free_copies(p);
+        *err = MG_ERR_NOMEM;
+        return NULL;
+    }
+
+    char *w = p->buf;
+    for (int i = 0; i < npats; i++) {
+        memcpy(w, pats[i], lens[i]);
+        w[lens[i]] = '\0';
+        p->pats[i] = w;
+        p->lens[i] = lens[i];
+        w += lens[i] + 1;
+    }
+
+    if (mg_matcher_init(&p->m, p->pats, p->lens, npats, flags, err) != 0) {
+        mg_free_copies(p);      // p->m 은 mg_matcher_init 이 이미 해제함
+        return NULL;
+    }
+    return p;
+}
+
+MG_API void mg_free(MgPattern *p) {
+    if (!p) return;
+    mg_matcher_free(&p->m);
+    mg_free_copies(p);
+}
+
+// buf[0..len) 에서 cur 위치부터 다음 매칭 줄, 없으면 0
+MG_API int mg_next_match(const MgPattern *p, const char *buf, size_t len, MgCursor *cur, MgMatch *out) {
+    if (cur->line_num == 0) cur->line_num = 1;
+    if (cur->pos >= len) return 0;
+
+    const char *pos = buf + cur->pos;
+    const char *ls, *le;
+    size_t num = cur->line_num;
+    if (!mg_matcher_next_line(&p->m, &pos, buf + len, &num, &ls, &le)) {
+        cur->pos = len;
+        cur->line_num = num;
+        return 0;
+    }
+
+    size_t off, mlen;
+    int pat;
+    if (!mg_matcher_next_span(&p->m, ls, (size_t)(le - ls), 0, &off, &mlen, &pat)) {
+        off = 0;
+        mlen = 0;
+        pat = 0;
+    }
+
+    out->line_num = num;
+    out->line_off = (size_t)(ls - buf);
+    out->line_len = (size_t)(le - ls);
+    out->match_off = out->line_off + off;
+    out->match_len = mlen;
+    out->pat = pat;
+
+    cur->pos = (size_t)(le - buf) + 1;
+    cur->line_num = num + 1;
+    return 1;
+}
+
+// 매칭 줄 line[from..len) 에서 다음 매칭 구간 (*off 는 줄 기준), 강조 출력은 from = 0 부터 off + mlen 으로 진행
+MG_API int mg_next_span(const MgPattern *p, const char *line, size_t len, size_t from,
+                        size_t *off, size_t *mlen, int *pat) {
+    return mg_matcher_next_span(&p->m, line, len, from, off, mlen, pat);
+}
+
+// 검색한 스레드가 끝날 때 (mg_search_tree 의 worker 는 알아서 부름)
+MG_API void mg_thread_done(void) {
+    mg_re_thread_cleanup();
+}
+
+// ---- 병렬 트리 검색 (mg_search_tree) ----
+// 디렉터리와 파일 모두 작업 하나: mini-grep --scheduler=steal 과 같은 스케줄러 (MgStealPool) + 경로 블록 (MgPathBlock)
+// - worker마다 deque, 디렉터리 하나의 항목은 이름을 블록에 이어 붙이고 모아서 한 번에 push (항목당 malloc 없음)
+// - 스레드 1개면 순서가 매번 같음: 디렉터리마다 파일 -> 하위 디렉터리 (깊이 우선, 각각 readdir 순서)
+// - 항목 분류 / symlink / 방문 집합 / 파일 필터는 mini-grep 과 같은 코드 (mg_walk_open_dir, mg_walk_classify, MgFileFilter)
+// - callback 은 worker 스레드에서 불림: 파일이 다르면 동시에, 한 파일의 줄은 한 스레드에서 순서대로
+typedef struct {
+    const char *path;          // 파일 경로 ([경로]/하위/이름)
+    const struct stat *st;     // 크기 / 수정 시각
+    const char *line;          // 매칭 줄 ('\n' 미포함)
+    size_t len;
+    MgMatch match;             // 위치는 파일 버퍼 기준 (line == 버퍼 + match.line_off)
+    long index;                // 파일 안에서 몇 번째 매칭 줄인지 (0부터, 0 이면 파일 헤더 출력 시점)
+    int worker;                // callback 을 부른 worker 번호 (0부터, worker별 자원용)
+} MgHit;
+
+// 0 이 아니면 검색 전체를 멈춤
+typedef int (*MgHitFn)(void *ctx, const MgHit *hit);
+
+typedef struct {
+    int threads;                        // 0 = 쓸 수 있는 CPU 수 (affinity, cgroup quota), 1 = 호출한 스레드에서 (스레드를 띄우지 않음)
+    const MgFileFilter *filter;         // 검색할 파일 (mg_filter_add_type / _include / _exclude + mg_filter_finish), NULL = MG_DEFAULT_EXTS
+    int binary;                         // 1 = 앞부분에 NUL 이 있는 파일도 검색
+    int follow;                         // 1 = 탐색 중 만난 symlink 도 따라감 (고리 / 중복은 방문 집합이 막음)
+    int one_file_system;                // 1 = root 와 다른 파일 시스템으로 내려가지 않음
+} MgTreeOpts;
+
+typedef struct {
+    long long files;           // 검색한 파일 수
+    long long files_matched;
+    long long lines_matched;
+    long long errors;          // 열지 못한 디렉터리 / 파일
+    long long dirs_dup;        // 이미 다른 경로(symlink / bind mount)로 읽어서 건너뛴 디렉터리
+    long long symlinks_skipped; // follow 가 아니라서 따라가지 않은 symlink
+    long long other_fs;        // one_file_system 으로 건너뛴 항목
+} MgTreeStats;
+
+typedef struct {
+    const MgPattern *p;
+    MgTreeOpts opts;
+    const MgFileFilter *filter; // opts.filter 또는 기본 확장자
+    MgWalkOpts walk;
+    MgVisitSet visited;
+    MgHitFn fn;
+    void *ctx;
+
+    MgStealPool pool;
+    atomic_int stop;           // callback 이 멈추라고 함 (또는 실패)
+    atomic_int failed;         // 메모리가 부족해서 일부를 검색하지 못함 -> mg_search_tree 가 -1
+} MgTree;
+
+typedef struct {
+    MgTree *t;
+    int id;
+    char *rbuf;                // 파일 읽기용 재사용 버퍼
+    size_t rcap;
+    char *pbuf;                // 작업 경로 조립용 재사용 버퍼
+    size_t pcap;
+    MgTask batch[MG_TASK_BATCH_MAX]; // 디렉터리 하나의 항목 (모아서 push)
+    size_t nbatch;
+    MgPathBlock *cur;          // 채우는 중인 자식 이름 블록
+    size_t local_done;         // 아직 pending 에 반영하지 않은 완료 수
+    MgTreeStats stats;
+} MgWorker;
+
+// 메모리가 부족해도 검색은 멈추기만 하고 프로세스는 그대로 (보고는 frontend 가)
+static void mg_tree_fail(MgTree *t) {
+    atomic_store(&t->failed, 1);
+    atomic_store(&t->stop, 1);
+    mg_pool_cancel(&t->pool);
+}
+
+// 거꾸로 넣음: owner 는 bottom 에서 꺼내므로 스레드 1개면 readdir 순서로 처리
+// 실패하면 -1 (넣지 못한 작업은 스케줄러가 버림)
+static int mg_tree_flush(MgWorker *w) {
+    for (size_t i = 0, j = w->nbatch; i + 1 < j; i++, j--) {
+        MgTask tmp = w->batch[i];
+        w->batch[i] = w->batch[j - 1];
+        w->batch[j - 1] = tmp;
+    }
+    int rc = mg_pool_push_batch(&w->t->pool, w->id, w->batch, w->nbatch);
+    w->nbatch = 0;
+    return rc;
+}
+
+// 이름은 dir 의 자식 이름 블록에 복사, 작업이 블록 참조 1개를 가짐
+// 실패하면 -1
+static int mg_tree_add(MgWorker *w, const MgTask *dir, const char *name, MgTaskKind kind) {
+    size_t len = strlen(name);
+    if (!w->cur || w->cur->used + len + 1 > w->cur->cap) {
+        uint32_t prev_cap = w->cur ? w->cur->cap : 0;
+        mg_path_release(w->cur);
+        w->cur = mg_path_block_new(sizeof(MgPathBlock), dir->blk, dir->off, len + 1, prev_cap, NULL);
+        if (!w->cur) return -1;
+    }
+
+    MgTask *nt = &w->batch[w->nbatch++];
+    nt->blk = w->cur;
+    nt->off = mg_path_block_put(w->cur, name, len);
+    nt->seq = 0;
+    nt->kind = kind;
+    nt->meta.size = -1;
+    nt->meta.mtime = 0;
+    nt->meta.mtime_nsec = 0;
+    mg_path_retain(w->cur);
+
+    if (w->nbatch == MG_TASK_BATCH_MAX) return mg_tree_flush(w);
+    return 0;
+}
+
+// path = task 의 전체 경로 (w->pbuf)
+static void mg_tree_dir(MgWorker *w, const MgTask *task, const char *path) {
+    MgTree *t = w->t;
+    struct stat st;
+    int dfd = -1;
+    DIR *dir = NULL;
+    MgWalkResult r = mg_walk_open_dir(path, &t->walk, &t->visited, NULL, &dfd, &st);
+    if (r == MG_WALK_NOMEM) {
+        mg_tree_fail(t);
+        return;
+    }
+    if (r == MG_WALK_DUP || r == MG_WALK_OTHER_FS) {
+        if (r == MG_WALK_DUP) w->stats.dirs_dup++; else w->stats.other_fs++;
+        return;
+    }
+    if (r == MG_WALK_DIR) dir = fdopendir(dfd);
+    if (!dir) {
+        if (dfd >= 0) close(dfd);
+        w->stats.errors++;          // 경고 출력은 frontend 가 (stats.errors)
+        return;
+    }
+
+    int ok = 1;
+    struct dirent *entry;
+    while (ok && (entry = readdir(dir)) != NULL) {
+        const char *name = entry->d_name;
+        int has_st;
+        r = mg_walk_classify(dirfd(dir), entry, &t->walk, 0, &st, &has_st, NULL);
+        if (r == MG_WALK_SYMLINK) {
+            w->stats.symlinks_skipped++;
+        } else if (r == MG_WALK_OTHER_FS) {
+            w->stats.other_fs++;
+        } else if (r == MG_WALK_DIR) {
+            if (!mg_filter_excluded_dir(t->filter, name)) ok = mg_tree_add(w, task, name, MG_TASK_DIR) == 0;
+        } else if (r == MG_WALK_FILE && mg_filter_target(t->filter, name, 0)) {
+            ok = mg_tree_add(w, task, name, MG_TASK_FILE) == 0;
+        }
+    }
+    closedir(dir);
+
+    if (!ok) {
+        mg_task_drop(w->batch, w->nbatch);
+        w->nbatch = 0;
+    } else if (mg_tree_flush(w) != 0) {
+        ok = 0;
+    }
+    mg_path_release(w->cur);    // 이후 블록 수명은 작업들이 결정
+    w->cur = NULL;
+    if (!ok) mg_tree_fail(t);
+}
+
+static void mg_tree_file(MgWorker *w, const char *path) {
+    MgTree *t = w->t;
+    w->stats.files++;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        w->stats.errors++;
+        return;
+    }
+
+    struct stat st;
+    MgFileBuf fb;
+    if (fstat(fd, &st) != 0 || mg_file_load(fd, st.st_size, &w->rbuf, &w->rcap, &fb) != 0) {
+        close(fd);
+        w->stats.errors++;
+        return;
+    }
+    close(fd);      // mmap은 fd를 닫아도 유지됨
+
+    if (!t->opts.binary && mg_is_binary(&fb)) {
+        mg_file_release(&fb);
+        return;
+    }
+
+    MgHit hit = { path, &st, NULL, 0, { 0, 0, 0, 0, 0, 0 }, 0, w->id };
+    MgCursor cur = { 0, 1 };
+    while (mg_next_match(t->p, fb.data, fb.len, &cur, &hit.match)) {
+        hit.line = fb.data + hit.match.line_off;
+        hit.len = hit.match.line_len;
+        if (hit.index == 0) w->stats.files_matched++;
+        w->stats.lines_matched++;
+
+        if (t->fn(t->ctx, &hit) != 0) {
+            atomic_store(&t->stop, 1);
+            mg_pool_cancel(&t->pool);
+            break;
+        }
+        if (atomic_load_explicit(&t->stop, memory_order_relaxed)) break;
+        hit.index++;
+    }
+
+    mg_file_release(&fb);
+}
+
+static void *mg_tree_worker(void *arg) {
+    MgWorker *w = (MgWorker*)arg;
+    MgTree *t = w->t;
+    MgTask task;
+    int finished = 0;
+
+    // 멈추면 스케줄러가 남은 작업을 버림 (mg_pool_cancel)
+    while (mg_pool_next(&t->pool, w->id, MG_ROLE_MATCH, &task, finished, &w->local_done)) {
+        if (!atomic_load_explicit(&t->stop, memory_order_relaxed)) {
+            if (mg_path_build(task.blk, task.off, &w->pbuf, &w->pcap) == SIZE_MAX) {
+                mg_tree_fail(t);
+            } else if (task.kind == MG_TASK_DIR) {
+                mg_tree_dir(w, &task, w->pbuf);
+            } else {
+                mg_tree_file(w, w->pbuf);
+            }
+        }
+        mg_path_release(task.blk);
+        finished = 1;
+    }
+
+    mg_re_thread_cleanup();
+    return NULL;
+}
+
+// root 아래 (root 가 파일이면 그 파일만) 를 검색, 매칭 줄마다 fn(ctx, hit)
+// opts == NULL 이면 기본값 (모두 0), stats 는 NULL 이어도 됨
+// root 는 symlink 여도 따라감 (mini-grep 의 [경로]와 같음), 열지 못한 디렉터리 / 파일은 stats.errors 로만
+// 반환: 0, root 를 stat 할 수 없거나 메모리가 부족하면 -1 (errno, 메모리 부족이면 ENOMEM + 그때까지의 stats)
+MG_API int mg_search_tree(const MgPattern *p, const char *root, const MgTreeOpts *opts,
+                          MgHitFn fn, void *ctx, MgTreeStats *stats) {
+    if (stats) memset(stats, 0, sizeof(*stats));
+
+    struct stat st;
+    if (stat(root, &st) != 0) return -1;
+
+    MgTree t;
+    memset(&t, 0, sizeof(t));
+    t.p = p;
+    if (opts) t.opts = *opts;
+    t.fn = fn;
+    t.ctx = ctx;
+
+    MgFileFilter def_filter;
+    memset(&def_filter, 0, sizeof(def_filter));
+    t.filter = t.opts.filter;
+    if (!t.filter) {
+        if (mg_filter_finish(&def_filter) != 0) {
+            mg_filter_free(&def_filter);
+            errno = ENOMEM;
+            return -1;
+        }
+        t.filter = &def_filter;
+    }
+    t.walk.follow = t.opts.follow;
+    t.walk.one_fs = t.opts.one_file_system;
+    t.walk.root_dev = st.st_dev;
+    mg_visit_init(&t.visited);
+    atomic_init(&t.stop, 0);
+    atomic_init(&t.failed, 0);
+
+    int nthreads = t.opts.threads;
+    if (nthreads <= 0) nthreads = mg_detect_cpu_count();
+
+    // 루트: root 이름 하나를 담은 부모 없는 블록
+    int have_pool = 0;
+    MgWorker *ws = (MgWorker*)calloc((size_t)nthreads, sizeof(MgWorker));
+    pthread_t *tids = (pthread_t*)malloc((size_t)nthreads * sizeof(pthread_t));
+    MgTask first;
+    memset(&first, 0, sizeof(first));
+    first.kind = S_ISDIR(st.st_mode) ? MG_TASK_DIR : MG_TASK_FILE;
+    first.meta.size = -1;
+    if (ws && tids && mg_pool_init(&t.pool, nthreads, NULL, 0, 0) == 0) {
+        have_pool = 1;
+        size_t len = strlen(root);
+        first.blk = mg_path_block_new(sizeof(MgPathBlock), NULL, 0, len + 1, 0, NULL);
+        if (first.blk) first.off = mg_path_block_put(first.blk, root, len);
+    }
+    if (!first.blk || mg_pool_push_batch(&t.pool, 0, &first, 1) != 0) {
+        atomic_store(&t.failed, 1);
+        nthreads = 0;
+        goto out;
+    }
+
+    // worker 0 은 호출한 스레드, 스레드를 못 만들면 만든 만큼으로 검색
+    for (int i = 0; i < nthreads; i++) {
+        ws[i].t = &t;
+        ws[i].id = i;
+        if (i > 0 && pthread_create(&tids[i], NULL, mg_tree_worker, &ws[i]) != 0) {
+            nthreads = i;
+            break;
+        }
+    }
+    mg_tree_worker(&ws[0]);
+
+out:;
+    MgTreeStats total = { 0, 0, 0, 0, 0, 0, 0 };
+    for (int i = 0; i < nthreads; i++) {
+        if (i > 0) pthread_join(tids[i], NULL);
+        total.files += ws[i].stats.files;
+        total.files_matched += ws[i].stats.files_matched;
+        total.lines_matched += ws[i].stats.lines_matched;
+        total.errors += ws[i].stats.errors;
+        total.dirs_dup += ws[i].stats.dirs_dup;
+        total.symlinks_skipped += ws[i].stats.symlinks_skipped;
+        total.other_fs += ws[i].stats.other_fs;
+        free(ws[i].rbuf);
+        free(ws[i].pbuf);
+    }
+    if (stats) *stats = total;
+
+    if (have_pool) mg_pool_destroy(&t.pool);   // 멈춰서 남은 작업의 블록도 여기서 해제
+    free(ws);
+    free(tids);
+    mg_visit_free(&t.visited);
+    mg_filter_free(&def_filter);
+
+    if (atomic_load(&t.failed)) {
+        errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
+
+#endif // MINI_GREP_LIB_H
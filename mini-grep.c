@@ -2,10 +2,28 @@
  * 멀티스레드 파일 검색기 (mini-grep, unlimited queue)
  *
  * 기능:
- * - 디렉터리 재귀 탐색 (Main thread: Producer)
- * - Thread pool (기본 8개 Worker: Consumer)
- * - 동적 Queue (파일 개수 제한 없음에 가깝게)
- * - Mutex + Condition Variable
+ * - 병렬 디렉터리 탐색 (디렉터리도 작업 단위로 Queue에 들어감)
+ * - Thread pool (기본: 사용 가능한 CPU 수만큼 Worker, 탐색 + 검색 모두 수행)
+ *   -j N 으로 검색 worker 수, --walk-threads M 으로 탐색 전용 worker 수 지정
+ * - 동적 Queue (자동 확장, --queue-limit 를 넘으면 탐색하는 쪽이 직접 검색하거나 대기)
+ * - Mutex + Condition Variable, pending 카운터로 종료 감지
+ * - Work-stealing 스케줄러 (--scheduler=steal, worker별 deque)
+ * - NUMA 인지 배치 (--pin): worker를 CPU/노드에 고정, 같은 노드에서 먼저 훔치고, worker 버퍼는 자기 노드 메모리에
+ * - 파일 통째로 읽기 (mmap / read) + SIMD 부분 문자열 검색 (SSE2/AVX2/NEON)
+ *   (검색 코어는 mini-grep-lib.h: single-mini-grep 과 공유, 다른 프로그램에 포함해서 바로 검색 가능)
+ * - io_uring 비동기 open/read (--io-uring, Linux 5.6+)
+ * - 반복 검색용 trigram 인덱스 (--index / --use-index)
+ * - 구간별 지연 프로파일: 파일 open/read/match, 디렉터리 탐색, 작업 대기의 p50/p99/max + 느린 파일 목록 (--profile),
+ *   Chrome trace JSON (--trace)
+ * - 대소문자 무시 (-i) / 단어 단위 (-w) 매칭, 파일 버퍼를 변환하지 않고 검색
+ * - 매칭 줄 앞뒤 문맥 (-A / -B / -C), 줄을 복사해 두지 않고 파일 버퍼에서 바로 출력
+ * - 기계용 출력: ripgrep 호환 JSON Lines (--json), grep -Z 형식 (--null), 터미널이 아니면 강조 끔 (--color)
+ * - symlink 는 --follow 일 때만 따라감, 디렉터리는 (st_dev, st_ino) 로 한 번만 (고리 / bind mount 중복 없음),
+ *   --one-file-system 으로 다른 마운트 제외
+ * - 압축 파일(.gz .zst .lz4 .xz .bz2)을 해제 프로그램 파이프로 풀면서 검색 (-z)
+ * - 큰 파일은 줄 경계로 나눠 여러 worker가 같이 검색, 결과는 순서/줄 번호를 맞춰 합침 (--split-size)
+ * - 표준 입력 / 파이프 / 파일 하나 검색 (reader 스레드가 읽는 동안 검색, 조각마다 바로 출력)
+ * - 데몬 모드: worker + 디렉터리 캐시(inotify 로 바뀐 디렉터리만 다시 읽음)를 띄워두고 Unix 소켓으로 질의 (--daemon / --connect)
  * - 키워드 빨간색 강조 (grep 스타일)
  *
  * 빌드:
@@ -15,365 +33,6000 @@
  *   ./mini_grep_mt /path "TODO"
  */
 
-#define _XOPEN_SOURCE 700
+#define _GNU_SOURCE   // sched_getaffinity, CPU_COUNT
 
 #include <stdio.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <getopt.h>
 #include <dirent.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <time.h>
 #include <unistd.h>
+#include <sched.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <signal.h>
 
-#ifndef MAX_PATH
-#define MAX_PATH 10000
+// --io-uring: liburing 없이 syscall 직접 사용 (헤더가 있고 5.6+ opcode가 정의된 경우만)
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#ifdef IORING_FEAT_RW_CUR_POS
+#define HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+// --daemon: 디렉터리 변경 감지 (없으면 캐시된 디렉터리도 질의마다 다시 읽음)
+#ifdef __linux__
+#include <sys/inotify.h>
+#define HAVE_INOTIFY 1
 #endif
 
-#define MAX_THREADS 8
+// 검색 코어 (SIMD 커널, Aho-Corasick, 정규식 DFA, 파일 읽기): single-mini-grep 과 같이 씀
+#include "mini-grep-lib.h"
+
+#define MAX_THREADS 1024      // -j / --walk-threads 상한
 
 // -------------------- ANSI 색상 코드 --------------------
 #define COLOR_RED     "\033[1;31m"
 #define COLOR_RESET   "\033[0m"
 
-// -------------------- 전역 통계/출력 락 --------------------
+// 패턴이 여러 개일 때 패턴 번호별로 돌아가며 쓰는 색 (첫 패턴은 빨간색)
+static const char *const pattern_colors[] = {
+    COLOR_RED, "\033[1;32m", "\033[1;33m", "\033[1;34m", "\033[1;35m", "\033[1;36m"
+};
+#define NUM_PATTERN_COLORS (sizeof(pattern_colors) / sizeof(pattern_colors[0]))
+
+// -------------------- 전역 출력 락 --------------------
 static pthread_mutex_t print_lock = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t stat_lock  = PTHREAD_MUTEX_INITIALIZER;
 
-static long long scanned_files = 0;   // 스캔한 "대상 파일" 개수
-static long long total_matches = 0;   // 매칭된 "파일" 개수(파일 단위)
+// 통계는 worker별 카운터(WorkerStats)에 lock 없이 쌓고 종료 후 합산
+static int show_stats = 0;            // --stats: 스레드별 통계 출력 (시간/줄 수 측정 포함)
+static int io_uring_depth = 0;        // --io-uring: worker당 동시 I/O 요청 수 (0 = 동기 I/O)
+static int profile_top = 0;           // --profile[=N]: 구간별 지연 분포 + 가장 느린 파일/디렉터리 N개 (0 = 끔)
+static const char *trace_path = NULL; // --trace=FILE: Chrome trace JSON 기록
+static int profile_on = 0;            // --profile 또는 --trace: worker별 Profile 에 구간 시간 기록
+
+// --pin: worker를 CPU(또는 NUMA 노드)에 고정, 자리는 CPU 배치 절에서 정함
+typedef enum {
+    PIN_OFF  = 0,
+    PIN_CORE = 1,          // worker 하나당 CPU 하나
+    PIN_NODE = 2           // worker를 자기 NUMA 노드의 CPU 전체에 (노드 안에서는 커널이 옮김)
+} PinMode;
+static PinMode pin_mode = PIN_OFF;
+static int numa_nodes = 1;            // 사용 가능한 CPU가 있는 NUMA 노드 수 (--pin 일 때만 확인)
+static int *worker_cpu = NULL;        // --pin: worker i 의 CPU (NULL = 고정하지 않음)
+static int *worker_node = NULL;       // --pin: worker i 의 NUMA 노드 (0부터 다시 매긴 번호)
+
+// trigram 인덱스 사용 방식
+typedef enum {
+    INDEX_OFF   = 0,
+    INDEX_BUILD = 1,       // --index: 검색 대신 인덱스 생성/갱신
+    INDEX_QUERY = 2        // --use-index: 인덱스로 후보 파일만 검색
+} IndexMode;
+static IndexMode index_mode = INDEX_OFF;
+
+static int binary_as_text = 0;        // -a: 바이너리 파일도 텍스트로 검색
+static int all_files = 0;             // --all-files: 확장자와 관계없이 모든 일반 파일 검색
+static int use_ignore_files = 0;      // --gitignore: .gitignore / .ignore 규칙 적용
+static int sort_output = 0;           // --sort=path: 경로 순서대로 출력
+static int ignore_case = 0;           // -i: 대소문자 무시 (ASCII + 일부 UTF-8 문자)
+static int word_match = 0;            // -w: 단어 경계에 놓인 매칭만 인정
+static int search_zip = 0;            // -z: 압축 파일(.gz .zst .lz4 .xz .bz2)을 풀면서 검색
+static MgWalkOpts walk_opts;          // --follow: 탐색 중 만난 symlink 도 따라감 (기본: 명령줄 [경로]만)
+                                      // --one-file-system: [경로]와 다른 파일 시스템(마운트)으로 내려가지 않음
+
+// 결과 출력 방식
+typedef enum {
+    OUT_LINES = 0,         // 매칭된 줄 출력 (기본)
+    OUT_FILES = 1,         // -l: 매칭된 파일 경로만, 파일당 첫 매칭에서 멈춤
+    OUT_COUNT = 2,         // -c: 파일별 매칭 줄 수
+    OUT_QUIET = 3          // -q: 출력 없음, 처음 매칭되면 전체 검색 중단
+} OutputMode;
+static OutputMode output_mode = OUT_LINES;
+
+// 결과를 쓰는 형식 (후처리 프로그램이 사람용 출력을 파싱하지 않도록)
+typedef enum {
+    FMT_TEXT = 0,          // 기본: 파일 헤더(경로/크기/수정 시각) + "  줄 번호: 줄"
+    FMT_NULL = 1,          // --null: grep -rnZ 형식 "경로\0줄 번호:줄", -l 은 "경로\0", -c 는 "경로\0개수"
+    FMT_JSON = 2           // --json: ripgrep --json 과 같은 JSON Lines (begin / match / context / end / summary)
+} OutputFormat;
+static OutputFormat out_format = FMT_TEXT;
+static int use_color = 0;             // --color=auto|always|never: 키워드 강조 (auto: stdout 이 터미널일 때만)
+static long max_count = -1;           // -m N: 파일당 매칭 줄 수 상한 (-1 = 없음)
+static size_t before_context = 0;     // -B N / -C N: 매칭 줄 앞에 같이 출력할 줄 수
+static size_t after_context = 0;      // -A N / -C N: 매칭 줄 뒤에 같이 출력할 줄 수
+
+// --queue-limit: 쌓아둘 파일 작업 수 상한 (0 = 무제한)
+// 탐색이 검색보다 빠르면 넘지 않도록 탐색하는 쪽을 늦춤 (backpressure) -> 메모리가 트리 크기와 무관
+#define QUEUE_LIMIT_DEFAULT 65536
+static size_t queue_limit = QUEUE_LIMIT_DEFAULT;
+static atomic_int search_stopped;     // -q: 매칭을 찾아서 남은 작업을 취소함
+
+// --split-size: 이 크기 이상인 파일은 줄 경계에 맞춘 조각으로 나눠 여러 검색 worker가 같이 검색
+#define SPLIT_MIN_DEFAULT_MB 64
+static size_t split_min = (size_t)SPLIT_MIN_DEFAULT_MB << 20;   // 0 = 나누지 않음
+static int split_helpers = 0;         // 조각을 도울 수 있는 다른 검색 worker 수 (-j N 이면 N - 1)
+
+// -------------------- 메모리 할당 --------------------
+// 할당 실패는 복구하지 않음: 메시지를 찍고 grep 처럼 2로 종료
+// (라이브러리 mini-grep-lib.h 는 실패를 돌려주기만 하고, 종료는 여기서만 함)
+__attribute__((noreturn)) static void die_nomem(const char *what) {
+    perror(what);
+    exit(2);
+}
+
+static void *xmalloc(size_t n) {
+    void *p = malloc(n);
+    if (!p) die_nomem("malloc");
+    return p;
+}
+
+static void *xcalloc(size_t n, size_t size) {
+    void *p = calloc(n, size);
+    if (!p) die_nomem("calloc");
+    return p;
+}
+
+static void *xrealloc(void *old, size_t n) {
+    void *p = realloc(old, n);
+    if (!p) die_nomem("realloc");
+    return p;
+}
+
+static void *xaligned_alloc(size_t align, size_t n) {
+    void *p = aligned_alloc(align, n);
+    if (!p) die_nomem("aligned_alloc");
+    return p;
+}
+
+static void xbuf_reserve(char **buf, size_t *cap, size_t need) {
+    if (mg_buf_reserve(buf, cap, need) != 0) die_nomem("realloc");
+}
+
+// -------------------- 작업 경로 블록 (디렉터리별 arena) --------------------
+// 블록과 작업(MgTask)은 mini-grep-lib.h 의 것을 씀 (mg_search_tree 와 같은 구현)
+// mini-grep 은 블록마다 ignore 규칙과 출력 순서 노드를 덧붙임 (MgPathBlock 이 첫 멤버)
+
+// --gitignore: 디렉터리별 ignore 규칙 (ignore 파일 절에서 정의), 블록이 참조 1개를 가짐
+typedef struct IgnoreNode IgnoreNode;
+static void ignore_retain(IgnoreNode *n);
+static void ignore_release(IgnoreNode *n);
+// --sort=path: 디렉터리별 출력 순서 노드 (출력 순서 절에서 정의)
+typedef struct OrderDir OrderDir;
+
+typedef struct {
+    MgPathBlock b;
+    IgnoreNode *ign;           // 이 블록 항목들에 적용할 ignore 규칙 (NULL = 없음)
+    OrderDir *ord;             // --sort=path: 이 블록 항목들이 속한 디렉터리의 순서 노드
+} PathBlock;
+
+static inline PathBlock *path_data(const MgPathBlock *b) {
+    return (PathBlock*)b;
+}
+
+static void path_block_freed(MgPathBlock *b) {
+    ignore_release(path_data(b)->ign);
+}
+
+static MgPathBlock *path_block_new(MgPathBlock *parent, uint32_t parent_off, IgnoreNode *ign,
+                                   OrderDir *ord, size_t need, uint32_t prev_cap) {
+    MgPathBlock *b = mg_path_block_new(sizeof(PathBlock), parent, parent_off, need, prev_cap,
+                                       path_block_freed);
+    if (!b) die_nomem("malloc");
+    path_data(b)->ign = ign;
+    path_data(b)->ord = ord;
+    if (ign) ignore_retain(ign);
+    return b;
+}
+
+static size_t path_build(const MgPathBlock *b, uint32_t off, char **buf, size_t *cap) {
+    size_t len = mg_path_build(b, off, buf, cap);
+    if (len == SIZE_MAX) die_nomem("realloc");
+    return len;
+}
 
 // -------------------- 동적 링버퍼 Queue --------------------
+// 작업 종류는 MgTaskKind (mini-grep-lib.h) + 큰 파일 조각
+#define TASK_CHUNK MG_TASK_USER   // 큰 파일 조각 검색 돕기 (파일 작업과 같은 Queue, blk 없음, data = SplitFile)
+
+typedef struct SplitFile SplitFile;
+typedef struct DirCache DirCache;     // --daemon: 캐시된 디렉터리 (디렉터리 캐시 절에서 정의)
+
+// MgTask.data: TASK_CHUNK -> 나눠 검색 중인 파일, MG_TASK_DIR -> 캐시된 디렉터리 노드 (NULL = 디스크에서 읽음)
+static inline SplitFile *task_split(const MgTask *t) { return (SplitFile*)t->data; }
+static inline DirCache *task_cache(const MgTask *t) { return (DirCache*)t->data; }
+
 typedef struct {
-    char **buf;            // 파일 경로 문자열 포인터 배열
+    MgTask *buf;           // 작업 배열
     size_t cap;            // 버퍼 용량
     size_t head;           // pop 위치
     size_t tail;           // push 위치
     size_t count;          // 현재 원소 수
-    int scan_done;         // producer 종료 플래그
+} TaskRing;
+
+typedef struct {
+    TaskRing files;        // 파일 작업
+    TaskRing dirs;         // 디렉터리 작업
+    size_t pending;        // push 됐지만 아직 처리 완료되지 않은 작업 수
+    size_t waiters;        // cond_wait 중인 검색 worker 수 (깨울 개수 계산용)
+    size_t walk_waiters;   // walk_cond 에서 대기 중인 탐색 전용 worker 수
+    size_t space_waiters;  // space_cond 에서 대기 중인 탐색 전용 worker 수 (--queue-limit)
+    size_t peak_files;     // 가장 많이 쌓였던 파일 작업 수 (--stats)
+    int cancelled;         // queue_cancel 이후: 남은 작업은 버리고 모든 worker 종료
 
     pthread_mutex_t lock;
     pthread_cond_t  cond;
+    pthread_cond_t  walk_cond;
+    pthread_cond_t  space_cond;   // 파일 작업이 queue_limit 아래로 내려감
 } TaskQueue;
 
-static void queue_init(TaskQueue *q) {
-    q->cap = 1024; // 시작 용량 (필요시 자동 증가)      
-    q->buf = (char**)calloc(q->cap, sizeof(char*));
-    if (!q->buf) {
-        perror("calloc");
-        exit(1);
-    }
-    q->head = q->tail = q->count = 0;
-    q->scan_done = 0;
-    pthread_mutex_init(&q->lock, NULL);
-    pthread_cond_init(&q->cond, NULL);
+// 종료 조건: pending == 0
+// 디렉터리 작업은 자식들을 모두 push 한 뒤에 완료 처리되므로,
+// pending이 0이 되는 순간 더 이상 생길 작업이 없다는 것이 보장됨.
+
+static void ring_init(TaskRing *r) {
+    r->cap = 1024; // 시작 용량 (필요시 자동 증가)      
+    r->buf = (MgTask*)xcalloc(r->cap, sizeof(MgTask));
+    r->head = r->tail = r->count = 0;
 }
 
-static void queue_destroy(TaskQueue *q) {
+static void ring_destroy(TaskRing *r) {
     // 남아있는 아이템 정리
-    for (size_t i = 0; i < q->count; i++) {
-        size_t idx = (q->head + i) % q->cap;
-        free(q->buf[idx]);
+    for (size_t i = 0; i < r->count; i++) {
+        size_t idx = (r->head + i) % r->cap;
+        mg_path_release(r->buf[idx].blk);
     }
-    free(q->buf);
-
-    pthread_mutex_destroy(&q->lock);
-    pthread_cond_destroy(&q->cond);
+    free(r->buf);
 }
 
 // cap을 2배로 늘리고 순서를 head부터 재배열
-static void queue_grow(TaskQueue *q) {      
-    size_t new_cap = q->cap * 2;
-    char **new_buf = (char**)calloc(new_cap, sizeof(char*));
-    if (!new_buf) {
-        perror("calloc(grow)");
-        exit(1);
+static void ring_grow(TaskRing *r) {      
+    size_t new_cap = r->cap * 2;
+    MgTask *new_buf = (MgTask*)xcalloc(new_cap, sizeof(MgTask));
+
+    for (size_t i = 0; i < r->count; i++) {
+        size_t idx = (r->head + i) % r->cap;
+        new_buf[i] = r->buf[idx];
     }
 
-    for (size_t i = 0; i < q->count; i++) {
-        size_t idx = (q->head + i) % q->cap;
-        new_buf[i] = q->buf[idx];
+    free(r->buf);
+    r->buf = new_buf;
+    r->cap = new_cap;
+    r->head = 0;
+    r->tail = r->count;
+}
+
+static void ring_push(TaskRing *r, const MgTask *t) {
+    if (r->count == r->cap) {
+        ring_grow(r);
     }
+    r->buf[r->tail] = *t;
+    r->tail = (r->tail + 1) % r->cap;
+    r->count++;
+}
 
-    free(q->buf);
-    q->buf = new_buf;
-    q->cap = new_cap;
-    q->head = 0;
-    q->tail = q->count;
+static int ring_pop(TaskRing *r, MgTask *out) {
+    if (r->count == 0) return 0;
+
+    *out = r->buf[r->head];
+    r->buf[r->head].blk = NULL;
+    r->head = (r->head + 1) % r->cap;      // Queue 기반 작업 분배
+    r->count--;
+    return 1;
 }
 
-// push: 문자열은 strdup 해서 queue가 소유
-static void queue_push(TaskQueue *q, const char *path) {
-    pthread_mutex_lock(&q->lock);
+static void queue_init(TaskQueue *q) {
+    ring_init(&q->files);
+    ring_init(&q->dirs);
+    q->pending = 0;
+    q->waiters = 0;
+    q->walk_waiters = 0;
+    q->space_waiters = 0;
+    q->peak_files = 0;
+    q->cancelled = 0;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->cond, NULL);
+    pthread_cond_init(&q->walk_cond, NULL);
+    pthread_cond_init(&q->space_cond, NULL);
+}
 
-    if (q->count == q->cap) {
-        queue_grow(q);
-    }
+static void queue_destroy(TaskQueue *q) {
+    ring_destroy(&q->files);
+    ring_destroy(&q->dirs);
+
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->cond);
+    pthread_cond_destroy(&q->walk_cond);
+    pthread_cond_destroy(&q->space_cond);
+}
 
-    q->buf[q->tail] = strdup(path);
-    if (!q->buf[q->tail]) {
-        perror("strdup");
+// 배치 push: items의 path 소유권은 queue로 넘어감
+// lock 1회 + 필요한 만큼만 깨우기 (항목당 signal 하지 않음)
+static void queue_push_batch(TaskQueue *q, const MgTask *items, size_t n) {
+    if (n == 0) return;
+
+    pthread_mutex_lock(&q->lock);
+    if (q->cancelled) {
+        // 취소 뒤에 나온 작업은 넣지 않고 바로 버림
         pthread_mutex_unlock(&q->lock);
-        exit(1);
+        for (size_t i = 0; i < n; i++) mg_path_release(items[i].blk);
+        return;
+    }
+
+    size_t ndirs = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (items[i].kind == MG_TASK_DIR) {
+            ring_push(&q->dirs, &items[i]);
+            ndirs++;
+        } else {
+            ring_push(&q->files, &items[i]);
+        }
     }
+    q->pending += n;
+    if (q->files.count > q->peak_files) q->peak_files = q->files.count;
 
-    q->tail = (q->tail + 1) % q->cap;
-    q->count++;
+    // 작업 생김 -> 대기 중인 worker를 작업 수만큼만 깨우기
+    // 디렉터리는 탐색 전용 worker 먼저, 남은 작업은 검색 worker에게
+    size_t woken = mg_wake_some(&q->walk_cond, q->walk_waiters, ndirs);
+    mg_wake_some(&q->cond, q->waiters, n - woken);
 
-    // 작업 생김 -> 깨우기
-    pthread_cond_signal(&q->cond);      // 작업이 생기면 스레드 깨우기 
     pthread_mutex_unlock(&q->lock);
 }
 
-// pop: 성공하면 char* 반환(호출자가 free), 없으면 NULL
-static char* queue_pop(TaskQueue *q) {
-    char *ret = NULL;
+// 파일 작업 pop (lock 잡은 상태), 상한에 걸려 기다리는 탐색 worker가 있으면 자리가 났을 때 깨움
+static int queue_pop_file(TaskQueue *q, MgTask *out) {
+    if (!ring_pop(&q->files, out)) return 0;
+    if (q->space_waiters > 0 && q->files.count < queue_limit) {
+        pthread_cond_broadcast(&q->space_cond);
+    }
+    return 1;
+}
 
+// pop: 성공하면 1 반환(out->blk 참조는 호출자가 release), 없으면 0
+static int queue_pop(TaskQueue *q, MgTask *out, MgWorkerRole role) {
     // lock은 worker에서 잡고 들어올 수도 있지만,
     // 여기서는 단순화 위해 pop 내부에서 lock을 잡지 않고,
     // worker가 lock 잡은 상태에서만 호출하도록 설계할 수도 있음.
     // -> 하지만 실수 방지 위해 pop 자체는 lock 없이 쓰지 않도록 "외부에서 lock 잡고 호출"로 통일.
-    if (q->count == 0) return NULL;
+    if (role == MG_ROLE_WALK) {
+        return ring_pop(&q->dirs, out);
+    }
+    // 검색 worker는 파일 먼저 (쌓인 경로를 빨리 소비해서 Queue가 커지지 않게)
+    return queue_pop_file(q, out) || ring_pop(&q->dirs, out);
+}
 
-    ret = q->buf[q->head];
-    q->buf[q->head] = NULL;
-    q->head = (q->head + 1) % q->cap;      // Queue 기반 작업 분배
-    q->count--;
+static int queue_has_work(TaskQueue *q, MgWorkerRole role) {
+    if (role == MG_ROLE_WALK) return q->dirs.count > 0;
+    return q->files.count > 0 || q->dirs.count > 0;
+}
 
-    return ret;
+// 대기하지 않는 pop (io_uring worker가 진행 중인 I/O가 있을 때 사용)
+static int queue_try_next(TaskQueue *q, MgTask *out, MgWorkerRole role) {
+    pthread_mutex_lock(&q->lock);
+    int ok = !q->cancelled && queue_pop(q, out, role);
+    pthread_mutex_unlock(&q->lock);
+    return ok;
 }
 
-// -------------------- 키워드 강조 출력 --------------------
-// 키워드를 빨간색으로 강조해서 출력하는 함수
-static void print_line_with_highlight(const char *line, const char *keyword) {
-    const char *pos = line;
-    const char *found;
-    int keyword_len = strlen(keyword);
-    
-    while ((found = strstr(pos, keyword)) != NULL) {
-        // 키워드 이전 부분 출력
-        fwrite(pos, 1, found - pos, stdout);
-        // 키워드를 빨간색으로 출력
-        printf("%s%s%s", COLOR_RED, keyword, COLOR_RESET);
-        pos = found + keyword_len;
+// 파일 작업만 대기 없이 pop (--queue-limit 에 걸린 검색 worker가 직접 검색할 때)
+static int queue_try_file(TaskQueue *q, MgTask *out) {
+    pthread_mutex_lock(&q->lock);
+    int ok = !q->cancelled && queue_pop_file(q, out);
+    pthread_mutex_unlock(&q->lock);
+    return ok;
+}
+
+static size_t queue_files_queued(TaskQueue *q) {
+    pthread_mutex_lock(&q->lock);
+    size_t n = q->files.count;
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+// 탐색 전용 worker: 파일 작업이 queue_limit 아래로 내려갈 때까지 대기
+// (파일 작업은 검색 worker가 새 작업을 만들지 않고 소비하므로 반드시 줄어듦)
+static void queue_wait_space(TaskQueue *q) {
+    pthread_mutex_lock(&q->lock);
+    while (!q->cancelled && q->files.count >= queue_limit) {
+        q->space_waiters++;
+        pthread_cond_wait(&q->space_cond, &q->lock);
+        q->space_waiters--;
     }
-    // 나머지 부분 출력
-    printf("%s", pos);
+    pthread_mutex_unlock(&q->lock);
 }
 
-// -------------------- 검색 로직 --------------------
-static int is_target_extension(const char *filename) {
-    const char *ext = strrchr(filename, '.');
-    if (!ext) return 0;
+// 작업 n개 완료 처리 (queue_next의 finished_prev 와 같은 역할을 한 번에 여러 개)
+static void queue_finish(TaskQueue *q, size_t n) {
+    if (n == 0) return;
+    pthread_mutex_lock(&q->lock);
+    q->pending -= n;
+    if (q->pending == 0) {
+        pthread_cond_broadcast(&q->cond);
+        pthread_cond_broadcast(&q->walk_cond);
+    }
+    pthread_mutex_unlock(&q->lock);
+}
+
+// 다음 작업 가져오기 (직전 작업 완료 처리 + pop을 lock 한 번으로)
+// 반환: 1 = 작업 있음, 0 = 전체 작업 종료
+static int queue_next(TaskQueue *q, MgTask *out, int finished_prev, MgWorkerRole role) {
+    pthread_mutex_lock(&q->lock);
+
+    if (finished_prev) {
+        q->pending--;
+        if (q->pending == 0) {
+            // 모든 작업 완료 -> 대기 중인 worker 모두 깨워서 종료
+            pthread_cond_broadcast(&q->cond);
+            pthread_cond_broadcast(&q->walk_cond);
+        }
+    }
+
+    while (!q->cancelled && !queue_has_work(q, role) && q->pending > 0) {
+        // Condition Variable : 작업 없으면 스레드를 대기 상태로 전환
+        if (role == MG_ROLE_WALK) {
+            q->walk_waiters++;
+            pthread_cond_wait(&q->walk_cond, &q->lock);
+            q->walk_waiters--;
+        } else {
+            q->waiters++;
+            pthread_cond_wait(&q->cond, &q->lock);
+            q->waiters--;
+        }
+    }
 
-    return (strcmp(ext, ".c") == 0 ||
-            strcmp(ext, ".txt") == 0 ||
-            strcmp(ext, ".h") == 0 ||
-            strcmp(ext, ".py") == 0 ||
-            strcmp(ext, ".md") == 0);
+    int ok = !q->cancelled && queue_pop(q, out, role);
+    pthread_mutex_unlock(&q->lock);
+    return ok;
 }
 
-static void search_in_file(const char *filepath, const char *keyword, int thread_id) {
-    FILE *fp = fopen(filepath, "r");
-    if (!fp) return;
+// 검색 조기 종료 (-q): 쌓인 작업을 모두 버리고 대기 중인 worker를 깨움
+// 처리 중이던 작업은 각 worker가 마치고 나면 queue_next 가 0을 돌려줘서 종료
+static void queue_cancel(TaskQueue *q) {
+    MgTask t;
+    pthread_mutex_lock(&q->lock);
+    if (!q->cancelled) {
+        q->cancelled = 1;
+        while (ring_pop(&q->files, &t) || ring_pop(&q->dirs, &t)) {
+            mg_path_release(t.blk);
+            q->pending--;
+        }
+        pthread_cond_broadcast(&q->cond);
+        pthread_cond_broadcast(&q->walk_cond);
+        pthread_cond_broadcast(&q->space_cond);
+    }
+    pthread_mutex_unlock(&q->lock);
+}
 
-    struct stat st;
-    if (stat(filepath, &st) != 0) {
-        fclose(fp);
-        return;
+// -------------------- 스케줄러 선택 --------------------
+typedef enum {
+    SCHED_QUEUE = 0,       // 전역 링버퍼 Queue (mutex 1개)
+    SCHED_STEAL = 1        // worker별 deque + work stealing
+} SchedKind;
+
+typedef struct {
+    SchedKind kind;
+    TaskQueue q;
+    MgStealPool pool;
+} Scheduler;
+
+static void sched_init(Scheduler *s, SchedKind kind, int nworkers) {
+    s->kind = kind;
+    if (kind == SCHED_STEAL) {
+        // --pin + 노드 2개 이상이면 노드별 훔칠 순서, --stats 면 쌓인 파일 작업의 최댓값 측정
+        if (mg_pool_init(&s->pool, nworkers, numa_nodes > 1 ? worker_node : NULL, queue_limit, show_stats) != 0) {
+            die_nomem("malloc");
+        }
+    } else {
+        queue_init(&s->q);
+    }
+}
+
+static void sched_cancel(Scheduler *s) {
+    if (s->kind == SCHED_STEAL) {
+        mg_pool_cancel(&s->pool);
+    } else {
+        queue_cancel(&s->q);
     }
+}
 
-    char line[1024];
-    int line_num = 0;
-    int found = 0;
+static void sched_destroy(Scheduler *s) {
+    if (s->kind == SCHED_STEAL) {
+        mg_pool_destroy(&s->pool);
+    } else {
+        queue_destroy(&s->q);
+    }
+}
 
-    while (fgets(line, sizeof(line), fp)) {
-        line_num++;
+// -------------------- 출력 버퍼 (worker별) --------------------
+// 파일 하나의 결과(헤더 + 매칭 줄)를 worker 전용 버퍼에 모두 만든 뒤
+// print_lock 을 1번만 잡고 write 1번으로 내보냄
+// -> 매칭이 많은 검색어에서도 stdout 경합은 "파일당 1회"
+// 결과가 OUT_FLUSH_LIMIT 를 넘는 큰 파일은 print_lock 을 잡은 채로 중간중간 내보내서
+// 메모리를 제한하면서도 파일 단위로 연속된 출력을 유지
+#define OUT_FLUSH_LIMIT (1024 * 1024)
 
-        if (strstr(line, keyword)) {
-            if (!found) {
-                pthread_mutex_lock(&print_lock);
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    int locked;            // 큰 출력 때문에 print_lock 을 잡고 있는 중
+    size_t written;        // 지금까지 내보낸 바이트 (--json 의 bytes_printed = written + len 의 차이)
+} OutBuf;
 
-                printf("\n[Thread %d] 매칭: %s\n", thread_id, filepath);
-                printf("  크기: %ld bytes\n", (long)st.st_size);
+static void ob_reserve(OutBuf *ob, size_t extra) {
+    if (ob->len + extra <= ob->cap) return;
 
-                char time_buf[64];
-                struct tm *tm_info = localtime(&st.st_mtime);
-                strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", tm_info);
-                printf("  수정: %s\n", time_buf);
+    size_t new_cap = ob->cap ? ob->cap : 16 * 1024;
+    while (new_cap < ob->len + extra) new_cap *= 2;
 
-                pthread_mutex_unlock(&print_lock);
+    char *nd = (char*)xrealloc(ob->data, new_cap);
+    ob->data = nd;
+    ob->cap = new_cap;
+}
 
-                found = 1;
+static void ob_append(OutBuf *ob, const char *s, size_t n) {
+    if (n == 0) return;     // 아직 할당 전인 버퍼(data == NULL)에 memcpy 하지 않도록
+    ob_reserve(ob, n);
+    memcpy(ob->data + ob->len, s, n);
+    ob->len += n;
+}
 
-                pthread_mutex_lock(&stat_lock);
-                total_matches++;
-                pthread_mutex_unlock(&stat_lock);
-            }
+static void ob_putc(OutBuf *ob, char c) {
+    ob_reserve(ob, 1);
+    ob->data[ob->len++] = c;
+}
 
-            pthread_mutex_lock(&print_lock);
-            printf("  %4d: ", line_num+1);
-            print_line_with_highlight(line, keyword);
-            pthread_mutex_unlock(&print_lock);
-        }
-    }
+#define ob_lit(ob, s) ob_append((ob), (s), sizeof(s) - 1)
 
-    fclose(fp);
+static void ob_uint(OutBuf *ob, unsigned long long v) {
+    char tmp[24];
+    int i = (int)sizeof(tmp);
+    do {
+        tmp[--i] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    ob_append(ob, tmp + i, sizeof(tmp) - (size_t)i);
 }
 
-// -------------------- 디렉터리 스캔 (Producer) --------------------
-static void scan_directory(const char *path, TaskQueue *q) {
-    DIR *dir = opendir(path);
-    if (!dir) {
-        fprintf(stderr, "경고: 디렉터리를 열 수 없습니다: %s\n", path);
-        return;
+__attribute__((format(printf, 2, 3)))
+static void ob_printf(OutBuf *ob, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(ob->data ? ob->data + ob->len : NULL, ob->cap - ob->len, fmt, ap);
+    va_end(ap);
+    if (n < 0) return;
+
+    if ((size_t)n >= ob->cap - ob->len) {
+        ob_reserve(ob, (size_t)n + 1);
+        va_start(ap, fmt);
+        vsnprintf(ob->data + ob->len, ob->cap - ob->len, fmt, ap);
+        va_end(ap);
     }
+    ob->len += (size_t)n;
+}
 
-    struct dirent *entry;
-    while ((entry = readdir(dir)) != NULL) {
+// "  %4zu: " 와 같은 형식 (printf 없이), sep: 매칭 줄 ':' / 문맥 줄 '-' (grep 과 같은 구분)
+static void ob_line_number(OutBuf *ob, size_t num, char sep) {
+    char tmp[32];
+    int i = (int)sizeof(tmp);
+    tmp[--i] = ' ';
+    tmp[--i] = sep;
+    int digits = 0;
+    do {
+        tmp[--i] = (char)('0' + num % 10);
+        num /= 10;
+        digits++;
+    } while (num);
+    while (digits++ < 4) tmp[--i] = ' ';
+    tmp[--i] = ' ';
+    tmp[--i] = ' ';
+    ob_append(ob, tmp + i, sizeof(tmp) - (size_t)i);
+}
+
+// ---- --json 값 ----
+// 줄 내용은 파일 버퍼에서 출력 버퍼로 바로 이스케이프 (이스케이프할 문자가 없는 8바이트는 한 번에 건너뜀)
+#define SWAR_ONES 0x0101010101010101ULL
+#define SWAR_HIGH 0x8080808080808080ULL
 
-        if (strcmp(entry->d_name, ".") == 0 ||  // 현재 디렉토리
-            strcmp(entry->d_name, "..") == 0) { // 부모 디렉토리
+// UTF-8 로 올바른지 (overlong, surrogate, U+10FFFF 초과는 아님)
+static int utf8_valid(const unsigned char *s, size_t n) {
+    size_t i = 0;
+    while (i < n) {
+        if (i + 8 <= n) {
+            uint64_t w;
+            memcpy(&w, s + i, 8);
+            if ((w & SWAR_HIGH) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+        unsigned char c = s[i];
+        if (c < 0x80) {
+            i++;
             continue;
         }
+        size_t k;
+        uint32_t cp;
+        if (c >= 0xc2 && c <= 0xdf) {
+            k = 1;
+            cp = c & 0x1f;
+        } else if (c >= 0xe0 && c <= 0xef) {
+            k = 2;
+            cp = c & 0x0f;
+        } else if (c >= 0xf0 && c <= 0xf4) {
+            k = 3;
+            cp = c & 0x07;
+        } else {
+            return 0;
+        }
+        if (i + k >= n) return 0;
+        for (size_t j = 1; j <= k; j++) {
+            if ((s[i + j] & 0xc0) != 0x80) return 0;
+            cp = cp << 6 | (s[i + j] & 0x3f);
+        }
+        if (k == 2 && (cp < 0x800 || (cp >= 0xd800 && cp <= 0xdfff))) return 0;
+        if (k == 3 && (cp < 0x10000 || cp > 0x10ffff)) return 0;
+        i += k + 1;
+    }
+    return 1;
+}
 
-        char fullpath[MAX_PATH];
-        snprintf(fullpath, sizeof(fullpath), "%s/%s", path, entry->d_name);
-
-        struct stat st;
-        // symlink 루프 방지 목적이면 lstat 고려 가능.
-        if (stat(fullpath, &st) != 0) {
+// JSON 문자열 안에 그대로 쓸 수 없는 바이트: 제어 문자, '"', '\\'
+static void ob_json_escape(OutBuf *ob, const char *s, size_t n) {
+    static const char hex[] = "0123456789abcdef";
+    size_t run = 0, i = 0;
+    while (i < n) {
+        if (i + 8 <= n) {
+            uint64_t w;
+            memcpy(&w, s + i, 8);
+            uint64_t q = w ^ (SWAR_ONES * '"'), b = w ^ (SWAR_ONES * '\\');
+            uint64_t special = ((w - SWAR_ONES * 0x20) & ~w) | ((q - SWAR_ONES) & ~q) | ((b - SWAR_ONES) & ~b);
+            if ((special & SWAR_HIGH) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+        unsigned char c = (unsigned char)s[i];
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            i++;
             continue;
         }
+        ob_append(ob, s + run, i - run);
+        char esc = c == '"' ? '"' : c == '\\' ? '\\' : c == '\n' ? 'n' : c == '\t' ? 't' : c == '\r' ? 'r' : 0;
+        if (esc) {
+            char t[2] = { '\\', esc };
+            ob_append(ob, t, 2);
+        } else {
+            char t[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 15] };
+            ob_append(ob, t, 6);
+        }
+        run = ++i;
+    }
+    ob_append(ob, s + run, n - run);
+}
 
-        if (S_ISDIR(st.st_mode)) {
-            scan_directory(fullpath, q);
-        } else if (S_ISREG(st.st_mode)) {
-            if (is_target_extension(entry->d_name)) {
-                // 스캔 카운트 증가 (대상 파일 기준)
-                pthread_mutex_lock(&stat_lock);
-                scanned_files++;
-                pthread_mutex_unlock(&stat_lock);
+static void ob_base64(OutBuf *ob, const unsigned char *s, size_t n) {
+    static const char tbl[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    ob_reserve(ob, (n + 2) / 3 * 4);
+    char *o = ob->data + ob->len;
+    size_t i = 0;
+    for (; i + 3 <= n; i += 3) {
+        uint32_t v = (uint32_t)s[i] << 16 | (uint32_t)s[i + 1] << 8 | s[i + 2];
+        *o++ = tbl[v >> 18];
+        *o++ = tbl[(v >> 12) & 63];
+        *o++ = tbl[(v >> 6) & 63];
+        *o++ = tbl[v & 63];
+    }
+    if (i < n) {
+        uint32_t v = (uint32_t)s[i] << 16 | (i + 1 < n ? (uint32_t)s[i + 1] << 8 : 0);
+        *o++ = tbl[v >> 18];
+        *o++ = tbl[(v >> 12) & 63];
+        *o++ = i + 1 < n ? tbl[(v >> 6) & 63] : '=';
+        *o++ = '=';
+    }
+    ob->len = (size_t)(o - ob->data);
+}
 
-                // 작업 큐에 추가
-                queue_push(q, fullpath);
-            }
+// ripgrep 의 데이터 값: UTF-8 이면 {"text":"..."}, 아니면 {"bytes":"base64"}
+static void ob_json_data(OutBuf *ob, const char *s, size_t n) {
+    if (utf8_valid((const unsigned char*)s, n)) {
+        ob_lit(ob, "{\"text\":\"");
+        ob_json_escape(ob, s, n);
+    } else {
+        ob_lit(ob, "{\"bytes\":\"");
+        ob_base64(ob, (const unsigned char*)s, n);
+    }
+    ob_lit(ob, "\"}");
+}
+
+// ripgrep 의 시간 값: {"secs":..,"nanos":..,"human":"0.001234s"}
+static void ob_json_duration(OutBuf *ob, long long ns) {
+    if (ns < 0) ns = 0;
+    ob_printf(ob, "{\"secs\":%lld,\"nanos\":%lld,\"human\":\"%.6fs\"}", ns / 1000000000, ns % 1000000000, ns / 1e9);
+}
+
+static void write_all(int fd, const char *p, size_t n) {
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            // EPIPE 등: 더 쓸 곳이 없음 (SIGPIPE 를 무시하는 데몬에서는 남은 검색도 그만둠)
+            if (errno == EPIPE) atomic_store(&search_stopped, 1);
+            return;
         }
+        p += w;
+        n -= (size_t)w;
     }
+}
 
-    closedir(dir);
+// 파일 결과 중간 배출: 한계를 넘었을 때만, print_lock 은 파일 끝(ob_flush)까지 유지
+static void ob_maybe_spill(OutBuf *ob) {
+    if (ob->len < OUT_FLUSH_LIMIT || sort_output) return;
+    if (!ob->locked) {
+        pthread_mutex_lock(&print_lock);
+        ob->locked = 1;
+    }
+    write_all(STDOUT_FILENO, ob->data, ob->len);
+    ob->written += ob->len;
+    ob->len = 0;
 }
 
-// -------------------- Worker --------------------
+// 파일 하나의 결과를 한 번에 내보냄
+// --sort=path 에서는 버퍼에 남겨두고 order_file_done 이 가져감
+static void ob_flush(OutBuf *ob) {
+    if (sort_output) return;
+    if (ob->len == 0 && !ob->locked) return;
+
+    if (!ob->locked) {
+        pthread_mutex_lock(&print_lock);
+    }
+    write_all(STDOUT_FILENO, ob->data, ob->len);
+    pthread_mutex_unlock(&print_lock);
+    ob->written += ob->len;
+    ob->len = 0;
+    ob->locked = 0;
+}
+
+// -------------------- Worker별 통계 --------------------
+// 각 worker만 자기 카운터를 쓰므로 lock/atomic 불필요, 종료(join) 후 main에서 합산
+// 서로 다른 worker의 카운터가 같은 cache line을 공유하지 않도록 정렬
 typedef struct {
-    TaskQueue *q;
-    const char *keyword;
-    int thread_id;
-} WorkerArg;
+    _Alignas(64) long long files_scanned;   // 탐색 중 찾은 "대상 파일" 개수
+    long long files_matched;  // 매칭된 "파일" 개수(파일 단위)
+    long long dirs_scanned;   // 확장한 디렉터리 수
+    long long bytes_read;     // 검색한 바이트 수
+    long long lines_scanned;  // 검색한 줄 수 (--stats 일 때만 계산)
+    long long stat_calls;     // stat/fstat 호출 수
+    long long open_failures;  // open/opendir 실패 수
+    long long walk_ns;        // 탐색에 쓴 시간 (--stats 일 때만 측정)
+    long long match_ns;       // 검색에 쓴 시간 (--stats 일 때만 측정)
+    long long index_skipped;  // --use-index: 후보가 아니라서 읽지 않은 파일 수
+    long long binary_skipped; // NUL이 있어서 검색하지 않은 파일 수
+    long long ignored;        // --gitignore: ignore 규칙으로 건너뛴 파일/디렉터리 수
+    long long bp_searched;    // --queue-limit: 탐색 도중 상한에 걸려 직접 검색한 파일 수
+    long long bp_waits;       // --queue-limit: 탐색 전용 worker가 상한에 걸려 기다린 횟수
+    long long zip_files;      // -z: 풀면서 검색한 압축 파일 수
+    long long dirs_cached;    // --daemon: 다시 읽지 않고 캐시로 펼친 디렉터리 수
+    long long dirs_dup;       // 이미 다른 경로(symlink / bind mount)로 읽어서 건너뛴 디렉터리 수
+    long long symlinks_skipped; // --follow 가 아니라서 따라가지 않은 symlink 수
+    long long other_fs;       // --one-file-system: 다른 파일 시스템이라 건너뛴 항목 수
+    long long lines_matched;  // --json summary: 출력한 매칭 줄 수
+    long long matches;        // --json summary: 출력한 매칭(submatch) 수
+    long long bytes_printed;  // --json summary: 매칭된 파일들의 출력 바이트 수
+} WorkerStats;
 
-static void* worker_thread(void *arg) {
-    WorkerArg *wa = (WorkerArg*)arg;
-    TaskQueue *q = wa->q;
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
 
-    while (1) {
-        pthread_mutex_lock(&q->lock);   // Mutex로 동기화
+// -------------------- 프로파일 (--profile / --trace) --------------------
+// 파일마다 open / read / match 지연, 작업 대기 시간, 디렉터리 탐색 시간을
+// worker별 히스토그램에 lock 없이 쌓고 (WorkerStats 와 같이 종료 후 main 에서 합산)
+// 전체 시간 하나로는 안 보이는 "어느 파일 / 디렉터리가 느린지"를 p50 / p99 / max 와 느린 순 목록으로 출력
+// --trace=FILE: 같은 구간을 Chrome trace JSON (chrome://tracing, Perfetto) 으로도 기록
+typedef enum {
+    PROF_OPEN  = 0,        // open + (탐색 때 못 얻었으면) fstat
+    PROF_READ  = 1,        // read / mmap (-z: 해제와 검색이 겹치므로 0, 모두 match)
+    PROF_MATCH = 2,        // 검색 + 출력 버퍼에 쓰기
+    PROF_FILE  = 3,        // 파일 하나 전체 (open ~ match)
+    PROF_DIR   = 4,        // 디렉터리 하나 탐색 (readdir + 필터 + push)
+    PROF_WAIT  = 5,        // 작업을 기다린 시간 (sched_next)
+    PROF_KINDS = 6
+} ProfKind;
 
-        while (q->count == 0 && !q->scan_done) {
-            pthread_cond_wait(&q->cond, &q->lock);      // Condition Variable : 작업 없으면 스레드를 대기 상태로 전환
-        }
+static const char *const prof_names[PROF_KINDS] = { "open", "read", "match", "file", "dir", "wait" };
 
-        // 작업도 없고, 스캔도 끝났으면 종료
-        if (q->count == 0 && q->scan_done) {
-            pthread_mutex_unlock(&q->lock);
-            break;
-        }
+// 로그-선형 버킷: 2의 거듭제곱 구간마다 8칸 (값의 12.5% 이내), 8ns 미만은 1ns 단위
+#define PROF_SUB_BITS 3
+#define PROF_BUCKETS  (64 << PROF_SUB_BITS)
+#define PROF_TOP_DEFAULT 10
+#define TRACE_MIN_WAIT_NS 10000   // --trace: 이보다 짧은 대기는 이벤트로 남기지 않음 (히스토그램에는 셈)
 
-        // 작업 하나 pop
-        char *filepath = queue_pop(q);
-        pthread_mutex_unlock(&q->lock);
+typedef struct {
+    long long n;
+    long long sum;
+    long long max;
+    uint64_t counts[PROF_BUCKETS];
+} ProfHist;
 
-        if (filepath) {
-            search_in_file(filepath, wa->keyword, wa->thread_id);       // 검색
-            free(filepath);
-        }
+typedef struct {
+    long long ns;
+    long long part[3];     // 파일: open / read / match (디렉터리는 0)
+    char *path;
+} ProfSlow;
+
+typedef struct {
+    long long ts;          // 시작 시각 (now_ns)
+    long long dur;
+    uint32_t name;         // Profile.names 안 위치 (대기 이벤트는 쓰지 않음)
+    uint8_t kind;          // ProfKind
+} TraceEvent;
+
+typedef struct {
+    ProfHist hist[PROF_KINDS];
+    ProfSlow *slow_files;  // 가장 느린 profile_top 개 (min-heap: [0] 이 그중 가장 빠름)
+    int nslow_files;
+    ProfSlow *slow_dirs;
+    int nslow_dirs;
+    TraceEvent *ev;        // --trace
+    size_t nev;
+    size_t evcap;
+    char *names;           // 이벤트 경로 저장소 (NUL 로 구분)
+    size_t names_len;
+    size_t names_cap;
+    char *pbuf;            // 디렉터리 경로 조립용
+    size_t pcap;
+} Profile;
+
+static Profile *profile_new(void) {
+    Profile *pf = (Profile*)xcalloc(1, sizeof(Profile));
+    if (profile_top > 0) {
+        pf->slow_files = (ProfSlow*)xcalloc((size_t)profile_top, sizeof(ProfSlow));
+        pf->slow_dirs = (ProfSlow*)xcalloc((size_t)profile_top, sizeof(ProfSlow));
     }
+    return pf;
+}
 
-    return NULL;
+static void profile_free(Profile *pf) {
+    if (!pf) return;
+    for (int i = 0; i < pf->nslow_files; i++) free(pf->slow_files[i].path);
+    for (int i = 0; i < pf->nslow_dirs; i++) free(pf->slow_dirs[i].path);
+    free(pf->slow_files);
+    free(pf->slow_dirs);
+    free(pf->ev);
+    free(pf->names);
+    free(pf->pbuf);
+    free(pf);
 }
 
-// -------------------- main --------------------
-int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        printf("사용법: %s [경로] [키워드]\n", argv[0]);
-        printf("예시: %s /home/pi/project \"TODO\"\n", argv[0]);
-        return 1;
+static int prof_bucket(long long ns) {
+    uint64_t v = ns > 0 ? (uint64_t)ns : 0;
+    if (v < (1u << PROF_SUB_BITS)) return (int)v;
+    int e = 63 - __builtin_clzll(v);
+    int sub = (int)((v >> (e - PROF_SUB_BITS)) & ((1u << PROF_SUB_BITS) - 1));
+    return ((e - PROF_SUB_BITS + 1) << PROF_SUB_BITS) + sub;
+}
+
+// 버킷에 들어가는 가장 큰 값 (백분위수는 이 값으로 보고 -> 실제보다 작게 나오지 않음)
+static long long prof_bucket_high(int b) {
+    if (b < (1 << PROF_SUB_BITS)) return b;
+    int e = (b >> PROF_SUB_BITS) + PROF_SUB_BITS - 1;
+    uint64_t lo = (uint64_t)((1 << PROF_SUB_BITS) + (b & ((1 << PROF_SUB_BITS) - 1))) << (e - PROF_SUB_BITS);
+    return (long long)(lo + ((uint64_t)1 << (e - PROF_SUB_BITS)) - 1);   // ns 는 2^63 미만이라 e <= 62
+}
+
+static void prof_add(Profile *pf, ProfKind k, long long ns) {
+    ProfHist *h = &pf->hist[k];
+    h->counts[prof_bucket(ns)]++;
+    h->n++;
+    h->sum += ns;
+    if (ns > h->max) h->max = ns;
+}
+
+// 느린 순 상위 profile_top 개 유지: 꽉 찼으면 [0] (그중 가장 빠른 것) 보다 느릴 때만 바꿈
+// 경로는 목록에 들어갈 때만 복사
+static void prof_slow_add(ProfSlow *heap, int *n, long long ns, const long long part[3],
+                          const char *path, size_t len) {
+    if (*n == profile_top && ns <= heap[0].ns) return;
+
+    ProfSlow e = { ns, { part[0], part[1], part[2] }, strndup(path, len) };
+    if (!e.path) {
+        perror("strndup");
+        exit(2);
+    }
+    int i;
+    if (*n < profile_top) {
+        i = (*n)++;
+        while (i > 0 && heap[(i - 1) / 2].ns > e.ns) {     // 위로
+            heap[i] = heap[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+    } else {
+        free(heap[0].path);
+        i = 0;
+        while (1) {                                         // 아래로
+            int c = 2 * i + 1;
+            if (c >= *n) break;
+            if (c + 1 < *n && heap[c + 1].ns < heap[c].ns) c++;
+            if (heap[c].ns >= e.ns) break;
+            heap[i] = heap[c];
+            i = c;
+        }
     }
+    heap[i] = e;
+}
 
-    const char *search_path = argv[1];
-    const char *keyword = argv[2];
+static uint32_t trace_name(Profile *pf, const char *path, size_t len) {
+    xbuf_reserve(&pf->names, &pf->names_cap, pf->names_len + len + 1);
+    uint32_t off = (uint32_t)pf->names_len;
+    memcpy(pf->names + off, path, len);
+    pf->names[off + len] = '\0';
+    pf->names_len += len + 1;
+    return off;
+}
 
-    struct stat st;
-    if (stat(search_path, &st) != 0 || !S_ISDIR(st.st_mode)) {
-        fprintf(stderr, "에러: '%s'는 유효한 디렉터리가 아닙니다.\n", search_path);
-        return 1;
+static void trace_add(Profile *pf, ProfKind k, long long t0, long long t1, uint32_t name) {
+    if (pf->nev == pf->evcap) {
+        size_t cap = pf->evcap ? pf->evcap * 2 : 4096;
+        TraceEvent *ev = (TraceEvent*)xrealloc(pf->ev, cap * sizeof(TraceEvent));
+        pf->ev = ev;
+        pf->evcap = cap;
     }
+    TraceEvent *e = &pf->ev[pf->nev++];
+    e->ts = t0;
+    e->dur = t1 - t0;
+    e->name = name;
+    e->kind = (uint8_t)k;
+}
 
-    printf("=== 멀티스레드 파일 검색기 ===\n");
-    printf("검색 경로: %s\n", search_path);
-    printf("검색 키워드: \"%s\"\n", keyword);
-    printf("스레드 개수: %d\n\n", MAX_THREADS);
+// 파일 하나: t[0] 시작, t[1] open 끝, t[2] read 끝, t[3] 검색 끝
+static void prof_file(Profile *pf, const char *path, size_t len, const long long t[4]) {
+    long long part[3] = { t[1] - t[0], t[2] - t[1], t[3] - t[2] };
+    for (int k = 0; k < 3; k++) prof_add(pf, (ProfKind)k, part[k]);
+    prof_add(pf, PROF_FILE, t[3] - t[0]);
+    if (profile_top > 0) prof_slow_add(pf->slow_files, &pf->nslow_files, t[3] - t[0], part, path, len);
+    if (trace_path) {
+        uint32_t name = trace_name(pf, path, len);
+        trace_add(pf, PROF_FILE, t[0], t[3], name);
+        for (int k = 0; k < 3; k++) trace_add(pf, (ProfKind)k, t[k], t[k + 1], name);
+    }
+}
 
-    TaskQueue q;
-    queue_init(&q);
+// 디렉터리 하나 (경로는 느린 목록에 들어가거나 trace 를 쓸 때만 조립)
+static void prof_dir(Profile *pf, const MgTask *task, long long t0, long long t1) {
+    long long ns = t1 - t0;
+    prof_add(pf, PROF_DIR, ns);
+    int slow = profile_top > 0 && (pf->nslow_dirs < profile_top || ns > pf->slow_dirs[0].ns);
+    if (!slow && !trace_path) return;
 
-    // 시간 측정 시작
-    struct timespec start, end;
-    clock_gettime(CLOCK_MONOTONIC, &start);
+    size_t len = path_build(task->blk, task->off, &pf->pbuf, &pf->pcap);
+    static const long long none[3] = { 0, 0, 0 };
+    if (slow) prof_slow_add(pf->slow_dirs, &pf->nslow_dirs, ns, none, pf->pbuf, len);
+    if (trace_path) trace_add(pf, PROF_DIR, t0, t1, trace_name(pf, pf->pbuf, len));
+}
 
-    // Worker 생성
-    pthread_t threads[MAX_THREADS];
-    WorkerArg args[MAX_THREADS];
+static void prof_wait(Profile *pf, long long t0, long long t1) {
+    prof_add(pf, PROF_WAIT, t1 - t0);
+    if (trace_path && t1 - t0 >= TRACE_MIN_WAIT_NS) trace_add(pf, PROF_WAIT, t0, t1, 0);
+}
 
-    for (int i = 0; i < MAX_THREADS; i++) {
-        args[i].q = &q;
-        args[i].keyword = keyword;
-        args[i].thread_id = i + 1;
-        if (pthread_create(&threads[i], NULL, worker_thread, &args[i]) != 0) {
-            perror("pthread_create");
-            exit(1);
+// 합친 히스토그램에서 p (0~1) 백분위수
+static long long prof_percentile(const ProfHist *h, double p) {
+    if (h->n == 0) return 0;
+    uint64_t want = (uint64_t)(p * (double)h->n + 0.5);
+    if (want == 0) want = 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < PROF_BUCKETS; b++) {
+        seen += h->counts[b];
+        if (seen >= want) {
+            long long v = prof_bucket_high(b);
+            return v < h->max ? v : h->max;
         }
     }
+    return h->max;
+}
 
-    // Producer: 디렉터리 스캔하면서 작업 push
-    printf("📁 파일 탐색 + 검색 중...\n");
-    scan_directory(search_path, &q);
+static int prof_slow_cmp(const void *a, const void *b) {
+    long long x = ((const ProfSlow*)a)->ns, y = ((const ProfSlow*)b)->ns;
+    return (x < y) - (x > y);    // 느린 것 먼저
+}
 
-    // 스캔 완료 신호
-    pthread_mutex_lock(&q.lock);
-    q.scan_done = 1;
-    pthread_cond_broadcast(&q.cond);
-    pthread_mutex_unlock(&q.lock);
+// worker들의 느린 목록을 모아서 느린 순으로 상위 profile_top 개 출력
+static void print_prof_slow(const char *title, Profile *const *pfs, int n, int files) {
+    size_t total = 0;
+    for (int i = 0; i < n; i++) total += (size_t)(files ? pfs[i]->nslow_files : pfs[i]->nslow_dirs);
+    if (total == 0) return;
 
-    // Worker 종료 대기
-    for (int i = 0; i < MAX_THREADS; i++) {
-        pthread_join(threads[i], NULL);
+    ProfSlow *all = (ProfSlow*)xmalloc(total * sizeof(ProfSlow));
+    size_t k = 0;
+    for (int i = 0; i < n; i++) {
+        int cnt = files ? pfs[i]->nslow_files : pfs[i]->nslow_dirs;
+        memcpy(all + k, files ? pfs[i]->slow_files : pfs[i]->slow_dirs, (size_t)cnt * sizeof(ProfSlow));
+        k += (size_t)cnt;
     }
+    qsort(all, total, sizeof(ProfSlow), prof_slow_cmp);
 
-    // 시간 측정 종료
-    clock_gettime(CLOCK_MONOTONIC, &end);
-    double elapsed = (end.tv_sec - start.tv_sec) +
-                     (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+    fprintf(stderr, "\n가장 느린 %s %zu개 (ms)\n", title, total < (size_t)profile_top ? total : (size_t)profile_top);
+    for (size_t i = 0; i < total && i < (size_t)profile_top; i++) {
+        if (files) {
+            fprintf(stderr, "%10.3f  (open %.3f / read %.3f / match %.3f)  %s\n", all[i].ns / 1e6,
+                    all[i].part[0] / 1e6, all[i].part[1] / 1e6, all[i].part[2] / 1e6, all[i].path);
+        } else {
+            fprintf(stderr, "%10.3f  %s\n", all[i].ns / 1e6, all[i].path);
+        }
+    }
+    free(all);
+}
 
-    printf("\n");
-    printf("========================================\n");
-    printf("검색 완료!\n");
-    printf("총 %lld개 파일 스캔, %lld개 파일에서 매칭\n", scanned_files, total_matches);
-    printf("소요 시간: %.3f초\n", elapsed);
-    printf("========================================\n");
+// --profile: 구간별 분포 + 가장 느린 파일 / 디렉터리 (결과 출력과 섞이지 않게 stderr)
+static void print_profile(Profile *const *pfs, int n) {
+    fprintf(stderr, "\n[프로파일] 구간별 지연 (시간 단위: ms, 스레드 %d개 합산)\n", n);
+    fprintf(stderr, "%-6s %10s %10s %10s %10s %12s\n", "phase", "count", "p50", "p99", "max", "total");
+    for (int k = 0; k < PROF_KINDS; k++) {
+        ProfHist h;
+        memset(&h, 0, sizeof(h));
+        for (int i = 0; i < n; i++) {
+            const ProfHist *src = &pfs[i]->hist[k];
+            h.n += src->n;
+            h.sum += src->sum;
+            if (src->max > h.max) h.max = src->max;
+            for (int b = 0; b < PROF_BUCKETS; b++) h.counts[b] += src->counts[b];
+        }
+        fprintf(stderr, "%-6s %10lld %10.3f %10.3f %10.3f %12.1f\n", prof_names[k], h.n,
+                prof_percentile(&h, 0.50) / 1e6, prof_percentile(&h, 0.99) / 1e6, h.max / 1e6, h.sum / 1e6);
+    }
+    print_prof_slow("파일", pfs, n, 1);
+    print_prof_slow("디렉터리", pfs, n, 0);
+}
 
-    queue_destroy(&q);
-    pthread_mutex_destroy(&print_lock);
-    pthread_mutex_destroy(&stat_lock);
+// --trace=FILE: Chrome trace 형식 {"traceEvents":[...]}, 시각은 t0 기준 마이크로초
+// 파일은 경로 이름의 이벤트 안에 open / read / match 이벤트가 겹쳐 보임 (스레드마다 한 줄)
+static int trace_write(const char *path, Profile *const *pfs, const int *tids, const MgWorkerRole *roles,
+                       int n, long long t0) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
 
-    return 0;
+    OutBuf ob;
+    memset(&ob, 0, sizeof(ob));
+    ob_lit(&ob, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    int first = 1;
+    for (int i = 0; i < n; i++) {
+        const Profile *pf = pfs[i];
+        ob_printf(&ob, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"#%d %s\"}}",
+                  first ? "" : ",\n", tids[i], tids[i], roles[i] == MG_ROLE_WALK ? "walk" : "match");
+        first = 0;
+        for (size_t j = 0; j < pf->nev; j++) {
+            const TraceEvent *e = &pf->ev[j];
+            long long ts = e->ts - t0;
+            ob_lit(&ob, ",\n{\"name\":\"");
+            if (e->kind == PROF_FILE || e->kind == PROF_DIR) {
+                const char *name = pf->names + e->name;
+                ob_json_escape(&ob, name, strlen(name));
+            } else {
+                ob_append(&ob, prof_names[e->kind], strlen(prof_names[e->kind]));
+            }
+            ob_printf(&ob, "\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld.%03lld,\"dur\":%lld.%03lld",
+                      prof_names[e->kind], tids[i], ts / 1000, ts % 1000, e->dur / 1000, e->dur % 1000);
+            if (e->kind <= PROF_MATCH) {
+                const char *name = pf->names + e->name;
+                ob_lit(&ob, ",\"args\":{\"path\":\"");
+                ob_json_escape(&ob, name, strlen(name));
+                ob_lit(&ob, "\"}");
+            }
+            ob_lit(&ob, "}");
+            if (ob.len >= OUT_FLUSH_LIMIT) {
+                write_all(fd, ob.data, ob.len);
+                ob.len = 0;
+            }
+        }
+    }
+    ob_lit(&ob, "\n]}\n");
+    write_all(fd, ob.data, ob.len);
+    free(ob.data);
+    return close(fd);
+}
+
+// -------------------- Trigram 인덱스 (--index / --use-index) --------------------
+// 같은 트리를 반복해서 검색할 때 파일을 매번 다시 읽지 않도록 파일별 trigram(연속 3바이트) 집합을 저장
+// - --index: 트리를 탐색하며 인덱스 생성, 기존 인덱스가 있으면 크기/수정 시각이 바뀐 파일만 다시 읽음
+// - --use-index: 패턴에 반드시 들어가는 리터럴의 trigram posting을 교집합해서 후보 파일만 검색
+//   인덱스에 없거나 바뀐 파일은 그냥 읽어서 검색 -> 결과는 인덱스 없이 검색한 것과 같음
+// 매칭은 줄 단위라 '\n' 이 들어간 trigram은 저장하지 않음
+//
+// 파일 형식 (같은 기계에서 쓰고 읽는 캐시라 host byte order 그대로):
+//   IndexHeader
+//   파일 목록: (int64 size, int64 mtime_ns, uint32 경로 길이, 루트 기준 상대 경로) x nfiles, 8바이트 정렬
+//   IndexTri x ntris (trigram 순 정렬)
+//   posting: trigram마다 파일 번호 차이를 varint로
+#define INDEX_MAGIC        "MGIDX001"
+#define INDEX_DEFAULT_NAME ".mini-grep.idx"
+#define TRIGRAM_SPACE      (1u << 24)
+
+typedef struct {
+    char magic[8];
+    uint32_t nfiles;
+    uint32_t ntris;
+    uint64_t files_off;
+    uint64_t tris_off;
+    uint64_t post_off;
+    uint64_t file_size;
+} IndexHeader;
+
+typedef struct {
+    uint32_t tri;
+    uint32_t count;        // 이 trigram이 들어 있는 파일 수
+    uint64_t off;          // posting 시작 (post_off 기준)
+} IndexTri;
+
+typedef struct {
+    const char *path;      // 루트 기준 상대 경로 (map 안, NUL 없음)
+    uint32_t path_len;
+    int64_t size;
+    int64_t mtime_ns;
+} IndexFile;
+
+typedef struct {
+    size_t root_len;       // 검색 경로 길이 (작업 경로에서 상대 경로를 자를 때)
+
+    const uint8_t *map;    // 인덱스 파일 mmap (없으면 NULL)
+    size_t map_len;
+    uint32_t nfiles;
+    IndexFile *files;
+    uint32_t *table;       // 상대 경로 -> 파일 번호 + 1 (open addressing, 0 = 빈 칸)
+    size_t table_mask;
+    const IndexTri *tris;
+    uint32_t ntris;
+    const uint8_t *post;
+    const uint8_t *post_end;
+
+    uint8_t *cand;         // --use-index: 후보 파일 비트맵 (NULL = 거를 수 없음 -> 모든 파일 검색)
+    uint32_t ncand;
+} TrigramIndex;
+
+static inline int64_t meta_mtime_ns(const MgFileMeta *meta) {
+    return (int64_t)meta->mtime * 1000000000LL + meta->mtime_nsec;
+}
+
+static uint64_t index_hash(const char *s, size_t n) {
+    uint64_t h = 1469598103934665603ull;     // FNV-1a
+    for (size_t i = 0; i < n; i++) {
+        h ^= (uint8_t)s[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// 작업의 전체 경로 -> 루트 기준 상대 경로 ("root//a" 처럼 '/' 가 겹쳐도 같은 키)
+static const char *index_rel_path(const TrigramIndex *idx, const char *path, size_t len, size_t *rel_len) {
+    size_t off = idx->root_len < len ? idx->root_len : len;
+    while (off < len && path[off] == '/') off++;
+    *rel_len = len - off;
+    return path + off;
+}
+
+// 파일 번호, 없으면 -1
+static long index_find(const TrigramIndex *idx, const char *rel, size_t len) {
+    if (!idx->table) return -1;
+    size_t i = (size_t)index_hash(rel, len) & idx->table_mask;
+    while (idx->table[i]) {
+        const IndexFile *f = &idx->files[idx->table[i] - 1];
+        if (f->path_len == len && memcmp(f->path, rel, len) == 0) return (long)idx->table[i] - 1;
+        i = (i + 1) & idx->table_mask;
+    }
+    return -1;
+}
+
+static int varint_get(const uint8_t **p, const uint8_t *end, uint32_t *out) {
+    uint32_t v = 0;
+    for (int shift = 0; shift < 35 && *p < end; shift += 7) {
+        uint8_t b = *(*p)++;
+        v |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *out = v;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static void varint_put(FILE *fp, uint32_t v) {
+    while (v >= 0x80) {
+        putc((int)(v & 0x7f) | 0x80, fp);
+        v >>= 7;
+    }
+    putc((int)v, fp);
+}
+
+// posting 하나를 순서대로 꺼내는 커서
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    uint32_t left;
+    uint32_t prev;
+    int started;           // 첫 번호를 꺼냈는지 (첫 차이만 0 이어도 됨)
+} PostingIter;
+
+static void posting_begin(const TrigramIndex *idx, const IndexTri *t, PostingIter *it) {
+    it->p = idx->post + t->off;
+    it->end = idx->post_end;
+    it->left = t->count;
+    it->prev = 0;
+    it->started = 0;
+}
+
+// 1 = *id 에 다음 파일 번호, 0 = 끝 (손상된 posting도 끝으로 처리)
+// 번호는 엄격히 증가 (교집합이 기대함): 두 번째부터 차이 0 이나 uint32 넘침은 손상
+static int posting_next(PostingIter *it, uint32_t *id) {
+    uint32_t d;
+    if (it->left == 0 || varint_get(&it->p, it->end, &d) != 0) return 0;
+    if (it->started && (d == 0 || it->prev + d < it->prev)) {
+        it->left = 0;
+        return 0;
+    }
+    it->left--;
+    it->prev += d;
+    it->started = 1;
+    *id = it->prev;
+    return 1;
+}
+
+static const IndexTri *index_find_tri(const TrigramIndex *idx, uint32_t tri) {
+    size_t lo = 0, hi = idx->ntris;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (idx->tris[mid].tri < tri) lo = mid + 1;
+        else hi = mid;
+    }
+    return (lo < idx->ntris && idx->tris[lo].tri == tri) ? &idx->tris[lo] : NULL;
+}
+
+static void index_free(TrigramIndex *idx) {
+    if (idx->map) munmap((void*)idx->map, idx->map_len);
+    free(idx->files);
+    free(idx->table);
+    free(idx->cand);
+    size_t root_len = idx->root_len;
+    memset(idx, 0, sizeof(*idx));
+    idx->root_len = root_len;
+}
+
+// 0 = 성공, -1 = 파일 없음, -2 = 형식이 맞지 않음 (다른 버전/손상)
+static int index_load(TrigramIndex *idx, const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(IndexHeader)) {
+        close(fd);
+        return -2;
+    }
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return -2;
+
+    idx->map = (const uint8_t*)p;
+    idx->map_len = (size_t)st.st_size;
+
+    IndexHeader h;
+    memcpy(&h, idx->map, sizeof(h));
+    if (memcmp(h.magic, INDEX_MAGIC, 8) != 0 || h.file_size != idx->map_len ||
+        h.files_off > h.tris_off || h.tris_off % 8 != 0 ||
+        h.tris_off + (uint64_t)h.ntris * sizeof(IndexTri) > h.post_off || h.post_off > h.file_size ||
+        (uint64_t)h.nfiles * 20 > h.tris_off - h.files_off) {
+        index_free(idx);
+        return -2;
+    }
+
+    // trigram 목록: 범위 안 + 엄격히 증가 (index_find_tri 의 이분 탐색, 재생성 시 pos[tri]),
+    // posting 시작은 posting 영역 안, 파일 수는 전체 파일 수 이하
+    // -> 잘리거나 손상된 인덱스는 여기서 -2 (없는 것으로 보고 다시 생성)
+    const IndexTri *tris = (const IndexTri*)(idx->map + h.tris_off);
+    uint64_t post_len = h.file_size - h.post_off;
+    for (uint32_t i = 0; i < h.ntris; i++) {
+        const IndexTri *t = &tris[i];
+        if (t->tri >= TRIGRAM_SPACE || (i > 0 && t->tri <= tris[i - 1].tri) ||
+            t->off > post_len || t->count > h.nfiles) {
+            index_free(idx);
+            return -2;
+        }
+    }
+
+    idx->nfiles = h.nfiles;
+    idx->files = (IndexFile*)xcalloc(h.nfiles ? h.nfiles : 1, sizeof(IndexFile));
+    size_t tsize = 16;
+    while (tsize < (size_t)h.nfiles * 2) tsize *= 2;
+    idx->table = (uint32_t*)xcalloc(tsize, sizeof(uint32_t));
+    idx->table_mask = tsize - 1;
+
+    const uint8_t *q = idx->map + h.files_off;
+    const uint8_t *qend = idx->map + h.tris_off;
+    for (uint32_t i = 0; i < h.nfiles; i++) {
+        IndexFile *f = &idx->files[i];
+        if ((size_t)(qend - q) < 20) {
+            index_free(idx);
+            return -2;
+        }
+        memcpy(&f->size, q, 8);
+        memcpy(&f->mtime_ns, q + 8, 8);
+        memcpy(&f->path_len, q + 16, 4);
+        q += 20;
+        if ((size_t)(qend - q) < f->path_len) {
+            index_free(idx);
+            return -2;
+        }
+        f->path = (const char*)q;
+        q += f->path_len;
+
+        size_t j = (size_t)index_hash(f->path, f->path_len) & idx->table_mask;
+        while (idx->table[j]) j = (j + 1) & idx->table_mask;
+        idx->table[j] = i + 1;
+    }
+
+    idx->tris = tris;
+    idx->ntris = h.ntris;
+    idx->post = idx->map + h.post_off;
+    idx->post_end = idx->map + h.file_size;
+    return 0;
+}
+
+// ids[0..n) (오름차순) 중 t의 posting에도 있는 것만 남김
+static size_t index_intersect(const TrigramIndex *idx, const IndexTri *t, uint32_t *ids, size_t n) {
+    PostingIter it;
+    posting_begin(idx, t, &it);
+    size_t out = 0;
+    uint32_t id;
+    int have = posting_next(&it, &id);
+    for (size_t i = 0; i < n && have; i++) {
+        while (have && id < ids[i]) have = posting_next(&it, &id);
+        if (have && id == ids[i]) ids[out++] = ids[i];
+    }
+    return out;
+}
+
+static int index_tri_cmp_count(const void *a, const void *b) {
+    const IndexTri *x = *(const IndexTri *const *)a;
+    const IndexTri *y = *(const IndexTri *const *)b;
+    return (x->count > y->count) - (x->count < y->count);
+}
+
+// 리터럴 하나의 모든 trigram을 가진 파일을 cand에 추가 (posting이 짧은 trigram부터 교집합)
+static void index_add_literal(TrigramIndex *idx, const char *lit, size_t len) {
+    size_t nt = len - 2;
+    const IndexTri **ts = (const IndexTri**)xmalloc(nt * sizeof(*ts));
+    for (size_t i = 0; i < nt; i++) {
+        uint32_t tri = ((uint32_t)(uint8_t)lit[i] << 16) | ((uint32_t)(uint8_t)lit[i + 1] << 8) |
+                       (uint8_t)lit[i + 2];
+        ts[i] = index_find_tri(idx, tri);
+        if (!ts[i]) {       // 어떤 파일에도 없는 trigram -> 이 리터럴은 후보 없음
+            free(ts);
+            return;
+        }
+    }
+    qsort(ts, nt, sizeof(*ts), index_tri_cmp_count);
+
+    uint32_t *ids = (uint32_t*)xmalloc((ts[0]->count ? ts[0]->count : 1) * sizeof(uint32_t));
+    size_t n = 0;
+    PostingIter it;
+    posting_begin(idx, ts[0], &it);
+    while (n < ts[0]->count && posting_next(&it, &ids[n])) n++;
+
+    for (size_t i = 1; i < nt && n > 0; i++) {
+        n = index_intersect(idx, ts[i], ids, n);
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (ids[i] < idx->nfiles && !(idx->cand[ids[i] >> 3] & (1u << (ids[i] & 7)))) {
+            idx->cand[ids[i] >> 3] |= (uint8_t)(1u << (ids[i] & 7));
+            idx->ncand++;
+        }
+    }
+    free(ids);
+    free(ts);
+}
+
+// 리터럴들 중 하나라도 들어 있을 수 있는 파일 = 후보
+// 3바이트보다 짧은 리터럴이 있거나 리터럴이 없으면 거를 수 없음 (cand = NULL)
+static void index_prepare_query(TrigramIndex *idx, const char *const *lits, const size_t *lens, int n) {
+    if (!idx->map || n == 0) return;
+    for (int i = 0; i < n; i++) {
+        if (lens[i] < 3) return;
+    }
+
+    idx->cand = (uint8_t*)xcalloc((idx->nfiles + 7) / 8 + 1, 1);
+    for (int i = 0; i < n; i++) {
+        index_add_literal(idx, lits[i], lens[i]);
+    }
+}
+
+// ---- 인덱스 생성 (worker별로 모은 뒤 main에서 합쳐서 기록) ----
+typedef struct {
+    char *path;            // 상대 경로 (malloc)
+    uint32_t path_len;
+    int64_t size;
+    int64_t mtime_ns;
+    uint32_t *tris;        // 정렬된 trigram 목록
+    uint32_t ntris;
+    long old_id;           // >= 0 이면 기존 인덱스에서 그대로 가져옴 (파일을 읽지 않음)
+} IndexEntry;
+
+typedef struct {
+    IndexEntry *items;
+    size_t count;
+    size_t cap;
+    uint64_t *seen;        // trigram 중복 제거용 2^24 비트 (worker별, 쓴 비트만 다시 지움)
+    uint32_t *scratch;
+    size_t scratch_cap;
+    long long reused;      // 기존 인덱스에서 가져온 파일 수
+} IndexBuilder;
+
+static int u32_cmp(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+// buf의 서로 다른 trigram을 정렬해서 새로 할당한 배열로
+static uint32_t *index_collect_trigrams(IndexBuilder *ib, const char *buf, size_t len, uint32_t *count) {
+    if (!ib->seen) {
+        ib->seen = (uint64_t*)xcalloc(TRIGRAM_SPACE / 64, sizeof(uint64_t));
+    }
+
+    size_t n = 0;
+    const uint8_t *p = (const uint8_t*)buf;
+    for (size_t i = 0; i + 2 < len; i++) {
+        if (p[i] == '\n' || p[i + 1] == '\n' || p[i + 2] == '\n') continue;
+        uint32_t tri = ((uint32_t)p[i] << 16) | ((uint32_t)p[i + 1] << 8) | p[i + 2];
+        uint64_t bit = 1ull << (tri & 63);
+        if (ib->seen[tri >> 6] & bit) continue;
+        ib->seen[tri >> 6] |= bit;
+
+        if (n == ib->scratch_cap) {
+            ib->scratch_cap = ib->scratch_cap ? ib->scratch_cap * 2 : 4096;
+            ib->scratch = (uint32_t*)xrealloc(ib->scratch, ib->scratch_cap * sizeof(uint32_t));
+        }
+        ib->scratch[n++] = tri;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        ib->seen[ib->scratch[i] >> 6] &= ~(1ull << (ib->scratch[i] & 63));
+    }
+    qsort(ib->scratch, n, sizeof(uint32_t), u32_cmp);
+
+    uint32_t *out = (uint32_t*)xmalloc((n ? n : 1) * sizeof(uint32_t));
+    memcpy(out, ib->scratch, n * sizeof(uint32_t));
+    *count = (uint32_t)n;
+    return out;
+}
+
+static IndexEntry *index_builder_add(IndexBuilder *ib, const char *rel, size_t len) {
+    if (ib->count == ib->cap) {
+        ib->cap = ib->cap ? ib->cap * 2 : 256;
+        ib->items = (IndexEntry*)xrealloc(ib->items, ib->cap * sizeof(IndexEntry));
+    }
+    IndexEntry *e = &ib->items[ib->count++];
+    memset(e, 0, sizeof(*e));
+    e->path = (char*)xmalloc(len + 1);
+    memcpy(e->path, rel, len);
+    e->path[len] = '\0';
+    e->path_len = (uint32_t)len;
+    e->old_id = -1;
+    return e;
+}
+
+static void index_builder_free(IndexBuilder *ib) {
+    for (size_t i = 0; i < ib->count; i++) {
+        free(ib->items[i].path);
+        free(ib->items[i].tris);
+    }
+    free(ib->items);
+    free(ib->seen);
+    free(ib->scratch);
+}
+
+static int index_entry_cmp(const void *a, const void *b) {
+    return strcmp(((const IndexEntry*)a)->path, ((const IndexEntry*)b)->path);
+}
+
+// 기존 인덱스에서 가져온 파일들의 trigram 목록을 posting을 뒤집어서 복원
+static void index_restore_old(IndexEntry *ents, size_t n, const TrigramIndex *old) {
+    long *remap = (long*)xmalloc((old->nfiles ? old->nfiles : 1) * sizeof(long));
+    for (uint32_t i = 0; i < old->nfiles; i++) remap[i] = -1;
+    for (size_t i = 0; i < n; i++) {
+        if (ents[i].old_id >= 0) remap[ents[i].old_id] = (long)i;
+    }
+
+    // 1회차: 개수, 2회차: 채우기 (trigram 순으로 돌기 때문에 목록은 저절로 정렬됨)
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1) {
+            for (size_t i = 0; i < n; i++) {
+                if (ents[i].old_id < 0) continue;
+                ents[i].tris = (uint32_t*)xmalloc((ents[i].ntris ? ents[i].ntris : 1) * sizeof(uint32_t));
+                ents[i].ntris = 0;
+            }
+        }
+        for (uint32_t t = 0; t < old->ntris; t++) {
+            PostingIter it;
+            posting_begin(old, &old->tris[t], &it);
+            uint32_t id;
+            while (posting_next(&it, &id)) {
+                if (id >= old->nfiles || remap[id] < 0) continue;
+                IndexEntry *e = &ents[remap[id]];
+                if (pass == 1) e->tris[e->ntris] = old->tris[t].tri;
+                e->ntris++;
+            }
+        }
+    }
+    free(remap);
+}
+
+// ents를 경로 순으로 정렬해서 번호를 매기고 기록 (임시 파일에 쓴 뒤 rename)
+// 반환: 0 성공, -1 실패 (errno), *ntris_out 에 trigram 종류 수
+static int index_write(const char *path, IndexEntry *ents, size_t n, const TrigramIndex *old,
+                       uint32_t *ntris_out) {
+    qsort(ents, n, sizeof(IndexEntry), index_entry_cmp);
+    if (old && old->map) index_restore_old(ents, n, old);
+
+    // trigram별 파일 수 -> 시작 위치 (counting sort, 2^24칸이지만 닿은 페이지만 실제로 할당됨)
+    uint32_t *pos = (uint32_t*)xcalloc(TRIGRAM_SPACE, sizeof(uint32_t));
+    size_t total = 0;
+    for (size_t i = 0; i < n; i++) {
+        for (uint32_t k = 0; k < ents[i].ntris; k++) pos[ents[i].tris[k]]++;
+        total += ents[i].ntris;
+    }
+
+    uint32_t ntris = 0;
+    for (uint32_t t = 0; t < TRIGRAM_SPACE; t++) {
+        if (pos[t]) ntris++;
+    }
+    IndexTri *tris = (IndexTri*)xcalloc(ntris ? ntris : 1, sizeof(IndexTri));
+    uint32_t *ids = (uint32_t*)xmalloc((total ? total : 1) * sizeof(uint32_t));
+    uint32_t k = 0;
+    uint32_t start = 0;
+    for (uint32_t t = 0; t < TRIGRAM_SPACE; t++) {
+        if (!pos[t]) continue;
+        tris[k].tri = t;
+        tris[k].count = pos[t];
+        k++;
+        uint32_t c = pos[t];
+        pos[t] = start;
+        start += c;
+    }
+    // 파일 번호 순으로 넣으므로 posting마다 오름차순
+    for (size_t i = 0; i < n; i++) {
+        for (uint32_t j = 0; j < ents[i].ntris; j++) ids[pos[ents[i].tris[j]]++] = (uint32_t)i;
+    }
+    free(pos);
+
+    char tmp[4096 + 128];
+    snprintf(tmp, sizeof(tmp), "%s.tmp.%ld", path, (long)getpid());
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp) {
+        free(tris);
+        free(ids);
+        return -1;
+    }
+
+    IndexHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, INDEX_MAGIC, 8);
+    h.nfiles = (uint32_t)n;
+    h.ntris = ntris;
+    h.files_off = sizeof(IndexHeader);
+    fwrite(&h, sizeof(h), 1, fp);
+
+    uint64_t off = h.files_off;
+    for (size_t i = 0; i < n; i++) {
+        fwrite(&ents[i].size, 8, 1, fp);
+        fwrite(&ents[i].mtime_ns, 8, 1, fp);
+        fwrite(&ents[i].path_len, 4, 1, fp);
+        fwrite(ents[i].path, 1, ents[i].path_len, fp);
+        off += 20 + ents[i].path_len;
+    }
+    while (off % 8) {
+        putc(0, fp);
+        off++;
+    }
+    h.tris_off = off;
+    h.post_off = off + (uint64_t)ntris * sizeof(IndexTri);
+
+    // posting을 먼저 기록하면서 각 trigram의 시작 위치 계산
+    if (fseek(fp, (long)h.post_off, SEEK_SET) != 0) {
+        fclose(fp);
+        unlink(tmp);
+        free(tris);
+        free(ids);
+        return -1;
+    }
+    uint64_t poff = 0;
+    size_t at = 0;
+    for (uint32_t t = 0; t < ntris; t++) {
+        tris[t].off = poff;
+        uint32_t prev = 0;
+        for (uint32_t j = 0; j < tris[t].count; j++) {
+            uint32_t id = ids[at++];
+            uint32_t d = id - prev;
+            prev = id;
+            poff += d < (1u << 7) ? 1 : d < (1u << 14) ? 2 : d < (1u << 21) ? 3 : d < (1u << 28) ? 4 : 5;
+            varint_put(fp, d);
+        }
+    }
+    h.file_size = h.post_off + poff;
+
+    fseek(fp, (long)h.tris_off, SEEK_SET);
+    fwrite(tris, sizeof(IndexTri), ntris, fp);
+    fseek(fp, 0, SEEK_SET);
+    fwrite(&h, sizeof(h), 1, fp);
+
+    free(tris);
+    free(ids);
+    int err = ferror(fp);
+    if (fclose(fp) != 0 || err || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    *ntris_out = ntris;
+    return 0;
+}
+
+// -------------------- Worker 인자 / 작업 배치 --------------------
+// --sort=path: 디렉터리 항목을 이름 순으로 정렬하기 위해 worker별로 모아두는 목록
+typedef struct {
+    size_t name_off;       // WorkerArg.snames 안 위치 (모으는 동안 realloc 될 수 있음)
+    const char *name;      // 정렬 직전에 채움
+    MgTaskKind kind;
+    int has_meta;
+    MgFileMeta meta;
+} SortEntry;
+
+static int sort_entry_cmp(const void *a, const void *b) {
+    return strcmp(((const SortEntry*)a)->name, ((const SortEntry*)b)->name);
+}
+
+typedef struct {
+    WorkerStats stats;     // worker별 통계 (첫 멤버: cache line 정렬)
+    Scheduler *s;
+    const MgMatcher *m;    // 공유 (읽기 전용)
+    TrigramIndex *idx;     // 공유 (읽기 전용), --use-index 또는 --index 갱신 시 기존 인덱스
+    IndexBuilder ib;       // --index: 이 worker가 만든 항목
+    int thread_id;         // 1부터 시작 (출력용)
+    int index;             // 0부터 시작 (deque 번호)
+    MgWorkerRole role;     // 검색 worker / 탐색 전용 worker
+    size_t local_done;     // 아직 pending에 반영하지 않은 완료 수 (steal 모드)
+    int pinned;            // --pin: 이미 자기 CPU에 고정함 (데몬 worker는 질의마다 worker_thread 를 다시 부름)
+
+    char *rbuf;            // 파일 읽기용 재사용 버퍼 (worker별)
+    size_t rcap;
+    char *pbuf;            // 작업 경로 조립용 재사용 버퍼 (worker별)
+    size_t pcap;
+    char *hbuf;            // --queue-limit: 탐색 도중 검색할 때 pbuf 대신 쓰는 버퍼
+    size_t hcap;
+    SortEntry *sents;      // --sort=path: 읽고 있는 디렉터리 항목 (재사용)
+    size_t nsents;
+    size_t sents_cap;
+    char *snames;          // sents 이름 저장소
+    size_t snames_len;
+    size_t snames_cap;
+    OutBuf out;            // 출력 버퍼 (worker별)
+    OutBuf opath;          // --json / --null: 출력 형식에 맞춘 지금 파일의 경로 (파일마다 1번 만듦)
+    long long file_t0;     // --json: 지금 파일 검색을 시작한 시각 (end 이벤트의 elapsed)
+    size_t file_out0;      // --json: begin 이벤트 직전의 out.written + out.len
+    Profile *prof;         // --profile / --trace: 이 worker의 구간 시간 (profile_on 일 때만)
+} WorkerArg;
+
+static void sched_push_batch(WorkerArg *wa, const MgTask *items, size_t n) {
+    Scheduler *s = wa->s;
+    if (s->kind == SCHED_STEAL) {
+        if (mg_pool_push_batch(&s->pool, wa->index, items, n) != 0) die_nomem("calloc");
+    } else {
+        queue_push_batch(&s->q, items, n);
+    }
+}
+
+static int sched_next(WorkerArg *wa, MgTask *out, int finished_prev) {
+    Scheduler *s = wa->s;
+    if (s->kind == SCHED_STEAL) {
+        return mg_pool_next(&s->pool, wa->index, wa->role, out, finished_prev, &wa->local_done);
+    }
+    return queue_next(&s->q, out, finished_prev, wa->role);
+}
+
+// 대기 없이 작업 하나 (없으면 0), io_uring worker가 I/O 진행 중일 때 사용
+static int sched_try_next(WorkerArg *wa, MgTask *out) {
+    Scheduler *s = wa->s;
+    if (s->kind == SCHED_STEAL) {
+        return mg_pool_try_next(&s->pool, wa->index, wa->role, out);
+    }
+    return queue_try_next(&s->q, out, wa->role);
+}
+
+// 작업 n개 완료 처리 (sched_next의 finished_prev를 여러 개 한 번에)
+static void sched_finish(WorkerArg *wa, size_t n) {
+    Scheduler *s = wa->s;
+    if (s->kind == SCHED_STEAL) {
+        mg_pool_finish(&s->pool, n, &wa->local_done);
+    } else {
+        queue_finish(&s->q, n);
+    }
+}
+
+static size_t sched_files_queued(Scheduler *s) {
+    return s->kind == SCHED_STEAL ? mg_pool_files_queued(&s->pool) : queue_files_queued(&s->q);
+}
+
+static size_t sched_peak_files(Scheduler *s) {
+    return s->kind == SCHED_STEAL ? atomic_load(&s->pool.peak_files) : s->q.peak_files;
+}
+
+static size_t sched_remote_steals(Scheduler *s) {
+    return s->kind == SCHED_STEAL ? atomic_load(&s->pool.remote_steals) : 0;
+}
+
+static void run_file_task(const MgTask *task, WorkerArg *wa); // Worker 절에서 정의
+
+// push 전에 호출: 쌓인 파일 작업이 queue_limit 이상이면 탐색하는 쪽을 늦춤
+// - 검색 worker: 쌓인 파일 작업을 직접 꺼내 절반(queue_limit / 2)까지 검색
+//   (읽던 디렉터리의 경로가 pbuf 에 있으므로 검색은 hbuf 로)
+// - 탐색 전용 worker: 검색 worker가 소비할 때까지 대기
+// 파일 작업은 새 작업을 만들지 않으므로 어느 쪽이든 반드시 줄어듦 (디렉터리 작업은 상한에 세지 않음)
+static void sched_backpressure(WorkerArg *wa) {
+    Scheduler *s = wa->s;
+    if (queue_limit == 0 || sched_files_queued(s) < queue_limit) return;
+
+    if (wa->role == MG_ROLE_WALK) {
+        wa->stats.bp_waits++;
+        if (s->kind == SCHED_STEAL) mg_pool_wait_space(&s->pool);
+        else queue_wait_space(&s->q);
+        return;
+    }
+
+    char *saved = wa->pbuf;
+    size_t saved_cap = wa->pcap;
+    wa->pbuf = wa->hbuf;
+    wa->pcap = wa->hcap;
+
+    MgTask t;
+    long long t0 = show_stats ? now_ns() : 0;
+    while (!atomic_load_explicit(&search_stopped, memory_order_relaxed) &&
+           sched_files_queued(s) > queue_limit / 2 &&
+           (s->kind == SCHED_STEAL ? mg_pool_try_file(&s->pool, wa->index, &t) : queue_try_file(&s->q, &t))) {
+        run_file_task(&t, wa);
+        mg_path_release(t.blk);
+        sched_finish(wa, 1);
+        wa->stats.bp_searched++;
+    }
+    if (show_stats) wa->stats.match_ns += now_ns() - t0;
+
+    wa->hbuf = wa->pbuf;
+    wa->hcap = wa->pcap;
+    wa->pbuf = saved;
+    wa->pcap = saved_cap;
+}
+
+// 디렉터리 하나를 읽는 동안 자식 작업을 모아뒀다가 한 번에 push
+// -> lock/signal 횟수를 "항목당 1회"에서 "배치당 1회"로 줄임
+// 자식 이름은 이 디렉터리의 경로 블록(cur)에 이어 붙임
+typedef struct {
+    MgTask items[MG_TASK_BATCH_MAX];
+    size_t count;
+    MgPathBlock *dir;      // 읽고 있는 디렉터리 이름이 있는 블록 (NULL = 루트 작업 만들기)
+    uint32_t dir_off;
+    MgPathBlock *cur;      // 채우는 중인 자식 이름 블록
+    IgnoreNode *ign;       // 자식 블록에 달아줄 ignore 규칙 (--gitignore)
+    OrderDir *ord;         // 자식 블록에 달아줄 순서 노드 (--sort=path)
+    uint32_t next_seq;     // 다음 자식 작업의 순번
+} TaskBatch;
+
+static void batch_init(TaskBatch *b, MgPathBlock *dir, uint32_t dir_off) {
+    b->count = 0;
+    b->dir = dir;
+    b->dir_off = dir_off;
+    b->cur = NULL;
+    b->ign = NULL;
+    b->ord = NULL;
+    b->next_seq = 0;
+}
+
+static void batch_flush(WorkerArg *wa, TaskBatch *b) {
+    if (b->count > 0) sched_backpressure(wa);
+    sched_push_batch(wa, b->items, b->count);
+    b->count = 0;
+}
+
+// 남은 작업 push + 채우던 블록의 참조 놓기 (이후 블록 수명은 작업들이 결정)
+static void batch_close(WorkerArg *wa, TaskBatch *b) {
+    batch_flush(wa, b);
+    mg_path_release(b->cur);
+    b->cur = NULL;
+}
+
+// 이름은 경로 블록에 복사 (항목당 malloc 없음), 작업이 블록 참조 1개를 가짐
+static void batch_add(WorkerArg *wa, TaskBatch *b, const char *name, MgTaskKind kind, const MgFileMeta *meta) {
+    size_t len = strlen(name);
+    if (!b->cur || b->cur->used + len + 1 > b->cur->cap) {
+        uint32_t prev_cap = b->cur ? b->cur->cap : 0;
+        mg_path_release(b->cur);
+        b->cur = path_block_new(b->dir, b->dir_off, b->ign, b->ord, len + 1, prev_cap);
+    }
+
+    MgTask *t = &b->items[b->count++];
+    t->blk = b->cur;
+    t->off = mg_path_block_put(b->cur, name, len);
+    t->seq = b->next_seq++;
+    t->kind = kind;
+    if (meta) {
+        t->meta = *meta;
+    } else {
+        t->meta.size = -1;
+        t->meta.mtime = 0;
+        t->meta.mtime_nsec = 0;
+    }
+    if (kind == MG_TASK_DIR) t->data = NULL;
+    mg_path_retain(b->cur);
+
+    if (b->count == MG_TASK_BATCH_MAX) {
+        batch_flush(wa, b);   // 큰 디렉터리는 중간중간 내보내서 다른 worker가 바로 시작
+    }
+}
+
+// -------------------- 경로 순서 출력 (--sort=path) --------------------
+// 검색은 평소처럼 병렬로 하고, 출력만 "이름 순으로 정렬한 깊이 우선 순서"로 내보냄
+// - 디렉터리를 읽을 때 항목을 이름 순으로 정렬한 뒤 순번(seq)을 붙여 push
+//   -> (부모 디렉터리의 순서 노드, 순번) 이 실행 타이밍과 관계없는 고정 위치
+// - 파일 결과는 자기 칸(OrderSlot)에 맡겨두고, 출력 커서가 그 칸에 오면 내보냄 (reorder buffer)
+//   커서 위치의 결과는 맡기지 않고 바로 출력, 매칭이 없는 파일은 칸 상태만 바뀜
+// - 맡겨둔 결과가 ORDER_MEM_LIMIT 를 넘으면 임시 파일에 써두고 차례가 오면 다시 읽음
+//   -> worker를 기다리게 하지 않으면서 메모리 상한 유지
+// - 다 출력한 디렉터리 노드는 그 자리에서 해제
+#define ORDER_MEM_LIMIT (64 * 1024 * 1024)
+
+typedef enum {
+    SLOT_PENDING = 0,      // 아직 처리 중
+    SLOT_FILE    = 1,      // 파일 결과 맡겨둠 (없으면 len 0)
+    SLOT_DIR     = 2,      // 디렉터리 탐색 끝남 -> dir 로 내려가서 계속
+    SLOT_EMPTY   = 3       // 출력할 것 없음 (열기 실패, 빈 디렉터리)
+} SlotState;
+
+typedef struct {
+    uint8_t state;
+    uint8_t spilled;       // data 대신 임시 파일의 spill_off 위치에 있음
+    size_t len;
+    char *data;
+    off_t spill_off;
+    OrderDir *dir;         // SLOT_DIR: 자식 디렉터리 노드
+} OrderSlot;
+
+struct OrderDir {
+    OrderDir *parent;
+    uint32_t nslots;
+    uint32_t next;         // 다음에 출력할 칸
+    OrderSlot *slots;
+};
+
+typedef struct {
+    pthread_mutex_t lock;
+    OrderDir root;         // 검색 경로 하나만 칸으로 가진 가상 노드
+    OrderSlot root_slot;
+    OrderDir *cur;         // 출력 커서가 있는 노드 (NULL = 모두 출력함)
+    size_t buffered;       // 메모리에 맡겨둔 결과 바이트
+    int spill_fd;          // -1 = 아직 안 만듦
+    off_t spill_end;
+} OrderState;
+
+static OrderState order;
+
+static void order_init(void) {
+    pthread_mutex_init(&order.lock, NULL);
+    memset(&order.root_slot, 0, sizeof(order.root_slot));
+    order.root.parent = NULL;
+    order.root.nslots = 1;
+    order.root.next = 0;
+    order.root.slots = &order.root_slot;
+    order.cur = &order.root;
+    order.buffered = 0;
+    order.spill_fd = -1;
+    order.spill_end = 0;
+}
+
+static void order_destroy(void) {
+    if (order.spill_fd >= 0) close(order.spill_fd);
+    pthread_mutex_destroy(&order.lock);
+}
+
+static OrderDir *order_dir_new(OrderDir *parent, uint32_t nslots) {
+    OrderDir *d = (OrderDir*)xmalloc(sizeof(OrderDir));
+    OrderSlot *slots = (OrderSlot*)xcalloc(nslots, sizeof(OrderSlot));
+    d->parent = parent;
+    d->nslots = nslots;
+    d->next = 0;
+    d->slots = slots;
+    return d;
+}
+
+// 한계 안이면 메모리에, 넘으면 임시 파일에 (order.lock 잡은 상태)
+static void order_store(OrderSlot *sl, const char *data, size_t len) {
+    sl->len = len;
+    sl->spilled = 0;
+    sl->data = NULL;
+    if (len == 0) return;
+
+    if (order.buffered + len > ORDER_MEM_LIMIT) {
+        if (order.spill_fd < 0) {
+            FILE *fp = tmpfile();
+            if (fp) {
+                order.spill_fd = dup(fileno(fp));
+                fclose(fp);     // 이름 없는 파일, dup 한 fd로만 접근
+            }
+        }
+        if (order.spill_fd >= 0) {
+            size_t done = 0;
+            while (done < len) {
+                ssize_t w = pwrite(order.spill_fd, data + done, len - done, order.spill_end + (off_t)done);
+                if (w < 0 && errno == EINTR) continue;
+                if (w <= 0) break;
+                done += (size_t)w;
+            }
+            if (done == len) {
+                sl->spilled = 1;
+                sl->spill_off = order.spill_end;
+                order.spill_end += (off_t)len;
+                return;
+            }
+        }
+        // 임시 파일을 못 쓰면 한계를 넘더라도 메모리에
+    }
+
+    sl->data = (char*)xmalloc(len);
+    memcpy(sl->data, data, len);
+    order.buffered += len;
+}
+
+static void order_emit(OrderSlot *sl) {
+    if (sl->spilled) {
+        char chunk[64 * 1024];
+        off_t off = sl->spill_off;
+        size_t left = sl->len;
+        while (left > 0) {
+            ssize_t r = pread(order.spill_fd, chunk, left < sizeof(chunk) ? left : sizeof(chunk), off);
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) break;
+            write_all(STDOUT_FILENO, chunk, (size_t)r);
+            off += r;
+            left -= (size_t)r;
+        }
+    } else if (sl->len > 0) {
+        write_all(STDOUT_FILENO, sl->data, sl->len);
+        free(sl->data);
+        order.buffered -= sl->len;
+    }
+    sl->data = NULL;
+}
+
+// 커서를 끝난 칸들 너머로 옮기면서 출력 (order.lock 잡은 상태)
+static void order_advance(void) {
+    OrderDir *d = order.cur;
+    while (d) {
+        if (d->next == d->nslots) {
+            // 이 디렉터리는 다 출력함 -> 부모로
+            OrderDir *parent = d->parent;
+            if (d != &order.root) {
+                free(d->slots);
+                free(d);
+            }
+            d = parent;
+            continue;
+        }
+        OrderSlot *sl = &d->slots[d->next];
+        if (sl->state == SLOT_PENDING) break;
+        d->next++;
+        if (sl->state == SLOT_FILE) {
+            order_emit(sl);
+        } else if (sl->state == SLOT_DIR) {
+            d = sl->dir;
+        }
+    }
+    order.cur = d;
+}
+
+// 파일 작업 끝: worker 출력 버퍼 내용을 (커서 위치면 바로 출력, 아니면 맡겨둠) 가져감
+static void order_file_done(WorkerArg *wa, const MgTask *task) {
+    OrderDir *d = path_data(task->blk)->ord;
+    OutBuf *ob = &wa->out;
+
+    pthread_mutex_lock(&order.lock);
+    OrderSlot *sl = &d->slots[task->seq];
+    if (d == order.cur && d->next == task->seq) {
+        write_all(STDOUT_FILENO, ob->data, ob->len);
+        sl->state = SLOT_EMPTY;
+        d->next++;
+        order_advance();
+    } else {
+        order_store(sl, ob->data, ob->len);
+        sl->state = SLOT_FILE;
+    }
+    pthread_mutex_unlock(&order.lock);
+    ob->written += ob->len;
+    ob->len = 0;
+}
+
+// 디렉터리 작업 끝: 자식 노드(od, 항목이 없거나 못 열었으면 NULL)를 부모 칸에 연결
+static void order_dir_done(const MgTask *task, OrderDir *od) {
+    OrderDir *d = path_data(task->blk)->ord;
+
+    pthread_mutex_lock(&order.lock);
+    OrderSlot *sl = &d->slots[task->seq];
+    sl->dir = od;
+    sl->state = od ? SLOT_DIR : SLOT_EMPTY;
+    if (d == order.cur && d->next == task->seq) order_advance();
+    pthread_mutex_unlock(&order.lock);
+}
+
+// -------------------- 키워드 강조 출력 --------------------
+// 키워드를 강조해서 출력 버퍼에 쓰는 함수 (패턴별로 색을 다르게, 첫 패턴은 빨간색)
+// line[0..len) 는 줄바꿈을 포함하지 않음
+static void print_line_with_highlight(OutBuf *ob, const char *line, size_t len, const MgMatcher *m) {
+    size_t pos = 0;
+    size_t off, mlen;
+    int pat;
+
+    if (!use_color) {       // 파이프 / 파일로 나갈 때는 색 코드 없이 (매칭 위치도 찾지 않음)
+        ob_append(ob, line, len);
+        ob_putc(ob, '\n');
+        return;
+    }
+
+    while (pos < len && mg_matcher_next_span(m, line, len, pos, &off, &mlen, &pat)) {
+        const char *color = pattern_colors[(size_t)pat % NUM_PATTERN_COLORS];
+        // 키워드 이전 부분 출력
+        ob_append(ob, line + pos, off - pos);
+        // 키워드를 색깔로 출력
+        ob_append(ob, color, strlen(color));
+        ob_append(ob, line + off, mlen);
+        ob_append(ob, COLOR_RESET, sizeof(COLOR_RESET) - 1);
+        pos = off + mlen;
+    }
+    // 나머지 부분 출력
+    ob_append(ob, line + pos, len - pos);
+    ob_putc(ob, '\n');
+}
+
+// -------------------- 압축 파일 형식 (-z) --------------------
+// 확장자로 형식을 정하고, 해당 프로그램을 자식 프로세스로 띄워 표준 입력 -> 표준 출력으로 풂 (검색 로직 절)
+// 라이브러리를 링크하지 않으므로 빌드 명령은 그대로, 프로그램이 없는 형식만 건너뜀
+typedef struct {
+    const char *ext;       // 확장자 (점 포함)
+    const char *prog;      // "-dc" 로 표준 입력을 풀어 표준 출력에 쓰는 프로그램
+} ZipFormat;
+
+static const ZipFormat zip_formats[] = {
+    { ".gz",  "gzip"  },
+    { ".zst", "zstd"  },
+    { ".lz4", "lz4"   },
+    { ".xz",  "xz"    },
+    { ".bz2", "bzip2" },
+};
+#define NUM_ZIP_FORMATS (sizeof(zip_formats) / sizeof(zip_formats[0]))
+static atomic_int zip_missing[NUM_ZIP_FORMATS];    // 프로그램이 없다는 경고는 형식마다 한 번만
+
+static const ZipFormat *zip_format(const char *name, size_t len) {
+    const char *dot = (const char*)memrchr(name, '.', len);
+    if (!dot) return NULL;
+    for (size_t i = 0; i < NUM_ZIP_FORMATS; i++) {
+        if ((size_t)(name + len - dot) == strlen(zip_formats[i].ext) &&
+            memcmp(dot, zip_formats[i].ext, (size_t)(name + len - dot)) == 0) {
+            return &zip_formats[i];
+        }
+    }
+    return NULL;
+}
+
+// -------------------- 파일 필터 (--type / --include / --exclude) --------------------
+// 필터 자체 (확장자 집합, glob, --exclude) 는 mini-grep-lib.h, 여기는 옵션으로 만든 전역 하나 + -z / -F
+static MgFileFilter file_filter;
+
+static int is_target_file(const char *name) {
+    const MgFileFilter *f = &file_filter;
+    if (mg_filter_target(f, name, all_files)) return 1;
+
+    // -z: 압축 확장자를 뗀 이름으로 다시 확인 (app.txt.gz -> app.txt, --include='*.log' 는 app.log.gz 에도)
+    if (search_zip && !(f->nexclude > 0 && mg_filter_excluded(f, name, 0))) {
+        size_t len = strlen(name);
+        const ZipFormat *zf = zip_format(name, len);
+        char inner[256];
+        size_t n = zf ? len - strlen(zf->ext) : 0;
+        if (n > 0 && n < sizeof(inner)) {
+            memcpy(inner, name, n);
+            inner[n] = '\0';
+            return mg_name_selected(f, inner);
+        }
+    }
+    return 0;
+}
+
+// 내려가지 않을 디렉터리인지
+static inline int is_excluded_dir(const char *name) {
+    return mg_filter_excluded_dir(&file_filter, name);
+}
+
+static void print_type_list(void) {
+    for (size_t i = 0; i < MG_NUM_FILE_TYPES; i++) {
+        printf("%-8s %s\n", mg_file_types[i].name, mg_file_types[i].exts);
+    }
+}
+
+// -------------------- ignore 파일 (--gitignore) --------------------
+// 디렉터리를 읽을 때 그 디렉터리의 .gitignore / .ignore 를 1번만 읽어 IgnoreNode 로 컴파일
+// -> 자식 이름 블록(PathBlock)이 노드를 참조, 하위 디렉터리는 부모 규칙을 다시 읽지 않고 물려받음
+// - 노드는 parent 로 상위 디렉터리의 노드를 가리킴 (규칙 파일이 없는 디렉터리는 부모 노드를 그대로 씀)
+// - 판정은 가까운 디렉터리부터, 같은 노드 안에서는 뒤쪽 규칙부터 -> 처음 맞는 규칙이 결과 (git과 같은 우선순위)
+//   .ignore 는 .gitignore 뒤에 이어 붙여서 우선
+// - 대부분의 규칙("*.o", "node_modules/")은 길이 비교 + memcmp 로 끝나게 미리 분류
+// - 무시된 디렉터리는 작업으로 만들지 않으므로 아래로 내려가지 않음 (git처럼 하위에서 '!' 로 되살릴 수 없음)
+// - 검색 경로보다 위쪽의 .gitignore, .git/info/exclude, core.excludesFile 은 읽지 않음
+typedef enum {
+    IGN_GLOB    = 0,       // 일반 glob (*, **, ?, [...])
+    IGN_LITERAL = 1,       // 메타 문자 없는 이름 -> 길이 + memcmp
+    IGN_SUFFIX  = 2        // "*.o" 처럼 앞의 '*' 하나 + 리터럴 -> 끝부분 비교
+} IgnoreKind;
+
+typedef struct {
+    const char *pat;       // node->text 안, NUL로 끝남
+    uint32_t len;
+    uint8_t kind;
+    uint8_t negate;        // '!' 로 시작
+    uint8_t dir_only;      // '/' 로 끝남
+    uint8_t anchored;      // 앞/중간에 '/' -> 이름이 아니라 노드 디렉터리 기준 상대 경로로 비교
+} IgnoreRule;
+
+struct IgnoreNode {
+    IgnoreNode *parent;
+    atomic_uint refs;
+    uint32_t dir_len;      // 이 디렉터리 전체 경로 길이 (anchored 규칙의 기준 위치)
+    int nrules;
+    IgnoreRule *rules;
+    char *text;            // 규칙 파일 내용 (규칙 문자열이 이 안을 가리킴)
+};
+
+static void ignore_retain(IgnoreNode *n) {
+    atomic_fetch_add_explicit(&n->refs, 1, memory_order_relaxed);
+}
+
+static void ignore_release(IgnoreNode *n) {
+    while (n && atomic_fetch_sub_explicit(&n->refs, 1, memory_order_acq_rel) == 1) {
+        IgnoreNode *parent = n->parent;
+        free(n->rules);
+        free(n->text);
+        free(n);
+        n = parent;
+    }
+}
+
+// gitignore 방식 glob: '*' / '?' / [...] 는 '/' 를 넘지 않고, "**" 는 디렉터리 여러 단계와 맞음
+static int ignore_glob(const char *p, const char *pe, const char *s, const char *se) {
+    while (p < pe) {
+        if (*p == '*') {
+            if (p + 1 < pe && p[1] == '*') {
+                p += 2;
+                if (p == pe) return 1;                 // 끝의 "**": 나머지 전부
+                if (*p == '/') {
+                    // "**/": 디렉터리 0개 이상
+                    p++;
+                    if (ignore_glob(p, pe, s, se)) return 1;
+                    for (const char *q = s; q < se; q++) {
+                        if (*q == '/' && ignore_glob(p, pe, q + 1, se)) return 1;
+                    }
+                    return 0;
+                }
+                for (const char *q = s; q <= se; q++) {
+                    if (ignore_glob(p, pe, q, se)) return 1;
+                }
+                return 0;
+            }
+            p++;
+            for (const char *q = s; ; q++) {
+                if (ignore_glob(p, pe, q, se)) return 1;
+                if (q == se || *q == '/') return 0;
+            }
+        }
+        if (s == se) return 0;
+        if (*p == '?') {
+            if (*s == '/') return 0;
+            p++;
+            s++;
+            continue;
+        }
+        if (*p == '[') {
+            const char *q = p + 1;
+            int r = mg_glob_class(&q, pe, (unsigned char)*s);
+            if (r == 1 && *s != '/') {
+                p = q;
+                s++;
+                continue;
+            }
+            if (r != -1) return 0;
+            // 닫는 ']' 없음 -> '[' 를 글자 그대로
+        } else if (*p == '\\' && p + 1 < pe) {
+            p++;
+        }
+        if (*p != *s) return 0;
+        p++;
+        s++;
+    }
+    return s == se;
+}
+
+// 한 줄을 규칙으로 (line 은 제자리에서 잘라 씀), 규칙이 아니면 0
+static int ignore_parse_line(char *line, size_t len, IgnoreRule *r) {
+    if (len > 0 && line[len - 1] == '\r') len--;
+    while (len > 0 && line[len - 1] == ' ' && !(len > 1 && line[len - 2] == '\\')) len--;
+    if (len == 0 || line[0] == '#') return 0;
+
+    memset(r, 0, sizeof(*r));
+    if (line[0] == '!') {
+        r->negate = 1;
+        line++;
+        len--;
+    } else if (line[0] == '\\' && len > 1 && (line[1] == '!' || line[1] == '#')) {
+        line++;
+        len--;
+    }
+    if (len > 0 && line[len - 1] == '/') {
+        r->dir_only = 1;
+        len--;
+    }
+    if (len == 0) return 0;
+
+    if (memchr(line, '/', len)) {
+        r->anchored = 1;
+        if (line[0] == '/') {
+            line++;
+            len--;
+        } else if (len > 3 && memcmp(line, "**/", 3) == 0 && !memchr(line + 3, '/', len - 3)) {
+            // "**/name" 은 어느 깊이의 name 과도 맞음 -> 이름 비교와 같음
+            r->anchored = 0;
+            line += 3;
+            len -= 3;
+        }
+        if (len == 0) return 0;
+    }
+    line[len] = '\0';
+    r->pat = line;
+    r->len = (uint32_t)len;
+
+    if (!r->anchored) {
+        if (!strpbrk(line, "*?[\\")) {
+            r->kind = IGN_LITERAL;
+        } else if (line[0] == '*' && len > 1 && !strpbrk(line + 1, "*?[\\")) {
+            r->kind = IGN_SUFFIX;
+        }
+    }
+    return 1;
+}
+
+// dfd 안의 name 내용을 *text 뒤에 이어 붙임 (없으면 그대로), 파일마다 끝에 줄바꿈 보장
+static void ignore_append_file(int dfd, const char *name, WorkerArg *wa, char **text, size_t *len) {
+    int fd = openat(dfd, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;        // 대부분 ENOENT
+
+    MgFileBuf fb;
+    if (mg_file_load(fd, 0, &wa->rbuf, &wa->rcap, &fb) == 0 && fb.len > 0) {
+        char *nt = (char*)xrealloc(*text, *len + fb.len + 1);
+        memcpy(nt + *len, fb.data, fb.len);
+        *len += fb.len;
+        nt[(*len)++] = '\n';
+        *text = nt;
+    }
+    mg_file_release(&fb);
+    close(fd);
+}
+
+// 디렉터리(dfd, 경로 길이 dir_len)의 ignore 규칙 노드 (참조 1개를 넘겨줌)
+// 규칙 파일이 없으면 물려받은 parent 를 그대로 (참조만 늘림)
+static IgnoreNode *ignore_load(int dfd, uint32_t dir_len, IgnoreNode *parent, WorkerArg *wa) {
+    char *text = NULL;
+    size_t len = 0;
+    ignore_append_file(dfd, ".gitignore", wa, &text, &len);
+    ignore_append_file(dfd, ".ignore", wa, &text, &len);
+
+    IgnoreRule *rules = NULL;
+    int nrules = 0, cap = 0;
+    for (size_t pos = 0; pos < len; ) {
+        char *line = text + pos;
+        char *nl = (char*)memchr(line, '\n', len - pos);  // 항상 있음 (ignore_append_file)
+        size_t n = (size_t)(nl - line);
+        pos += n + 1;
+
+        IgnoreRule r;
+        if (!ignore_parse_line(line, n, &r)) continue;
+        if (nrules == cap) {
+            cap = cap ? cap * 2 : 16;
+            rules = (IgnoreRule*)xrealloc(rules, (size_t)cap * sizeof(IgnoreRule));
+        }
+        rules[nrules++] = r;
+    }
+
+    if (nrules == 0) {
+        free(text);
+        if (parent) ignore_retain(parent);
+        return parent;
+    }
+
+    IgnoreNode *n = (IgnoreNode*)xmalloc(sizeof(IgnoreNode));
+    n->parent = parent;
+    if (parent) ignore_retain(parent);
+    atomic_init(&n->refs, 1);
+    n->dir_len = dir_len;
+    n->nrules = nrules;
+    n->rules = rules;
+    n->text = text;
+    return n;
+}
+
+static int ignore_rule_match(const IgnoreRule *r, const char *name, size_t name_len,
+                             const char *rel, size_t rel_len) {
+    switch (r->kind) {
+    case IGN_LITERAL:
+        return r->len == name_len && memcmp(r->pat, name, name_len) == 0;
+    case IGN_SUFFIX:
+        return name_len >= r->len - 1 &&
+               memcmp(name + name_len - (r->len - 1), r->pat + 1, r->len - 1) == 0;
+    default:
+        if (r->anchored) return ignore_glob(r->pat, r->pat + r->len, rel, rel + rel_len);
+        return ignore_glob(r->pat, r->pat + r->len, name, name + name_len);
+    }
+}
+
+// 항목이 무시 대상인지
+// full[0..full_len) = 항목 전체 경로 (끝부분이 name), 노드 디렉터리 경로는 모두 full 의 앞부분
+static int ignore_check(const IgnoreNode *n, const char *full, size_t full_len,
+                        const char *name, size_t name_len, int is_dir) {
+    for (; n; n = n->parent) {
+        const char *rel = full + n->dir_len + 1;
+        size_t rel_len = full_len - n->dir_len - 1;
+        for (int i = n->nrules - 1; i >= 0; i--) {
+            const IgnoreRule *r = &n->rules[i];
+            if (r->dir_only && !is_dir) continue;
+            if (ignore_rule_match(r, name, name_len, rel, rel_len)) return !r->negate;
+        }
+    }
+    return 0;
+}
+
+// -------------------- 검색 로직 --------------------
+// 바이너리 판정 (mg_is_binary) 과 매칭 줄 찾기 (mg_matcher_next_line) 는 mini-grep-lib.h
+
+// 큰 파일 조각 하나의 결과: 줄 번호는 조각 안 기준으로만 기록, 파일을 연 worker가 합칠 때 앞 조각들의 줄 수를 더함
+typedef struct {
+    OutBuf out;            // 매칭 줄 (강조까지 끝낸 줄, 줄 번호 없음)
+    size_t *marks;         // 매칭 줄마다 (out 안 시작 위치, 조각 안 줄 번호, --json submatch 수) 3개씩
+    size_t nmarks;
+    size_t marks_cap;
+    size_t lines;          // 조각의 줄바꿈 수 (OUT_LINES / --stats 일 때만 계산)
+    long count;
+    int found;
+} SplitPart;
+
+// 줄 단위 검색 상태: 파일 하나, 또는 스트림 입력 전체에 걸쳐 유지
+typedef struct {
+    size_t line_num;       // 다음에 검색할 구간 첫 줄의 번호
+    long count;            // 매칭된 줄 수
+    int found;
+    int stopped;           // -l / -q / -m 으로 끝까지 보지 않고 멈춤
+    int stream;            // 스트림 입력: 파일 헤더 없이 매칭 줄만 출력
+    SplitPart *part;       // 큰 파일 조각: 결과를 조각 버퍼에 (헤더/줄 번호/통계는 합칠 때)
+    // -A / -B / -C 문맥 줄 (OUT_LINES, 조각으로 나누지 않은 검색만)
+    size_t printed;        // 마지막으로 출력한 줄 번호 (0 = 아직 없음) -> 겹치는 줄 / "--" 구분선 판정
+    size_t after_left;     // 마지막 매칭 줄 뒤로 더 출력할 줄 수 (다음 구간으로 이어짐)
+    const char *hist;      // 스트림: 검색 구간 바로 앞의 줄들 (앞 조각에서 복사해 둔 최대 -B 줄)
+    size_t hist_len;
+    unsigned long long base_off;   // --json: buf 의 파일(스트림) 안 위치 (absolute_offset)
+    size_t matches;        // --json: 출력한 submatch 수
+} LineScan;
+
+// 매칭된 파일의 헤더 (경로, 크기, 수정 시각), --json 은 begin 이벤트, 스트림은 기본 형식에서 헤더 없음
+// --json / --null 은 줄마다 붙일 경로를 여기서 한 번 만들어 둠
+static void print_file_header(OutBuf *ob, const char *filepath, const MgFileMeta *meta, int stream, WorkerArg *wa) {
+    if (out_format != FMT_TEXT) {
+        wa->opath.len = 0;
+        if (out_format == FMT_JSON) {
+            ob_json_data(&wa->opath, filepath, strlen(filepath));
+            wa->file_out0 = ob->written + ob->len;
+            ob_lit(ob, "{\"type\":\"begin\",\"data\":{\"path\":");
+            ob_append(ob, wa->opath.data, wa->opath.len);
+            ob_lit(ob, "}}\n");
+        } else {
+            ob_append(&wa->opath, filepath, strlen(filepath));
+        }
+        return;
+    }
+    if (stream) return;
+
+    if (sort_output) {
+        ob_printf(ob, "\n매칭: %s\n", filepath);     // 실행마다 같은 출력 (스레드 번호 없음)
+    } else {
+        ob_printf(ob, "\n[Thread %d] 매칭: %s\n", wa->thread_id, filepath);
+    }
+    ob_printf(ob, "  크기: %ld bytes\n", (long)meta->size);
+
+    char time_buf[64];
+    struct tm tm_info;
+    localtime_r(&meta->mtime, &tm_info);
+    strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", &tm_info);
+    ob_printf(ob, "  수정: %s\n", time_buf);
+}
+
+// --json: 매칭된 파일의 end 이벤트 (ripgrep 과 같은 통계), 합계는 summary 용으로 worker 통계에
+static void print_file_footer(OutBuf *ob, long lines, size_t matches, unsigned long long bytes, WorkerArg *wa) {
+    ob_lit(ob, "{\"type\":\"end\",\"data\":{\"path\":");
+    ob_append(ob, wa->opath.data, wa->opath.len);
+    ob_lit(ob, ",\"binary_offset\":null,\"stats\":{\"elapsed\":");
+    ob_json_duration(ob, now_ns() - wa->file_t0);
+    ob_lit(ob, ",\"searches\":1,\"searches_with_match\":1,\"bytes_searched\":");
+    ob_uint(ob, bytes);
+    ob_lit(ob, ",\"bytes_printed\":");
+    ob_uint(ob, ob->written + ob->len - wa->file_out0);
+    ob_lit(ob, ",\"matched_lines\":");
+    ob_uint(ob, (unsigned long long)lines);
+    ob_lit(ob, ",\"matches\":");
+    ob_uint(ob, matches);
+    ob_lit(ob, "}}}\n");
+
+    wa->stats.lines_matched += lines;
+    wa->stats.matches += (long long)matches;
+    wa->stats.bytes_printed += (long long)(ob->written + ob->len - wa->file_out0);
+}
+
+// -l / -c 결과 한 줄 (--null: 경로 뒤에 ':' / 줄바꿈 대신 NUL)
+static void print_path_result(OutBuf *ob, const char *filepath, long count) {
+    ob_append(ob, filepath, strlen(filepath));
+    if (count < 0) {
+        ob_putc(ob, out_format == FMT_NULL ? '\0' : '\n');
+    } else {
+        ob_putc(ob, out_format == FMT_NULL ? '\0' : ':');
+        ob_uint(ob, (unsigned long long)count);
+        ob_putc(ob, '\n');
+    }
+}
+
+// ---- 줄 출력 (기본 / --null / --json 공용) ----
+// 줄 하나 = 앞부분(줄 번호까지) + 뒷부분(내용): 큰 파일 조각은 뒷부분만 조각 버퍼에 쓰고, 합칠 때 줄 번호와 앞부분을 붙임
+// 내용은 파일 버퍼에서 출력 버퍼로 바로 (--json 도 이스케이프하면서 한 번 복사)
+static void emit_line_head(OutBuf *ob, const OutBuf *path, size_t num, int match) {
+    if (out_format == FMT_TEXT) {
+        ob_line_number(ob, num, match ? ':' : '-');
+    } else if (out_format == FMT_NULL) {
+        ob_append(ob, path->data, path->len);
+        ob_putc(ob, '\0');
+        ob_uint(ob, num);
+        ob_putc(ob, match ? ':' : '-');
+    } else {
+        if (match) ob_lit(ob, "{\"type\":\"match\",\"data\":{\"path\":");
+        else ob_lit(ob, "{\"type\":\"context\",\"data\":{\"path\":");
+        ob_append(ob, path->data, path->len);
+        ob_lit(ob, ",\"line_number\":");
+        ob_uint(ob, num);
+    }
+}
+
+// line[0..len) = 줄 내용 (줄바꿈 제외), nl: 뒤에 줄바꿈이 있음 (--json 의 lines 에 포함), off: 줄 시작의 파일 안 위치
+// m 이 있으면 매칭 줄 (강조 / submatches), 반환: --json 의 submatch 수
+static size_t emit_line_body(OutBuf *ob, const char *line, size_t len, int nl, unsigned long long off,
+                             const MgMatcher *m) {
+    if (out_format != FMT_JSON) {
+        if (m && out_format == FMT_TEXT) {
+            print_line_with_highlight(ob, line, len, m);
+        } else {
+            ob_append(ob, line, len);
+            ob_putc(ob, '\n');
+        }
+        return 0;
+    }
+
+    ob_lit(ob, ",\"absolute_offset\":");
+    ob_uint(ob, off);
+    ob_lit(ob, ",\"lines\":");
+    ob_json_data(ob, line, len + (nl != 0));
+    ob_lit(ob, ",\"submatches\":[");
+    size_t n = 0, pos = 0, moff, mlen;
+    int pat;
+    while (m && pos < len && mg_matcher_next_span(m, line, len, pos, &moff, &mlen, &pat)) {
+        if (n++) ob_putc(ob, ',');
+        ob_lit(ob, "{\"match\":");
+        ob_json_data(ob, line + moff, mlen);
+        ob_lit(ob, ",\"start\":");
+        ob_uint(ob, moff);
+        ob_lit(ob, ",\"end\":");
+        ob_uint(ob, moff + mlen);
+        ob_putc(ob, '}');
+        pos = moff + mlen;
+    }
+    ob_lit(ob, "]}}\n");
+    return n;
+}
+
+// 떨어진 문맥 묶음 사이 (--json 은 구분선 없음)
+static void emit_group_sep(OutBuf *ob) {
+    if (out_format == FMT_TEXT) ob_lit(ob, "  --\n");
+    else if (out_format == FMT_NULL) ob_lit(ob, "--\n");
+}
+
+static void split_mark(SplitPart *sp, size_t line_num) {
+    if (sp->nmarks * 3 + 3 > sp->marks_cap) {
+        size_t nc = sp->marks_cap ? sp->marks_cap * 2 : 64;
+        size_t *nm = (size_t*)xrealloc(sp->marks, nc * sizeof(size_t));
+        sp->marks = nm;
+        sp->marks_cap = nc;
+    }
+    sp->marks[sp->nmarks * 3] = sp->out.len;
+    sp->marks[sp->nmarks * 3 + 1] = line_num;
+    sp->marks[sp->nmarks * 3 + 2] = 0;
+    sp->nmarks++;
+}
+
+// ---- 문맥 줄 (-A / -B / -C) ----
+// 줄 사본을 링 버퍼에 모아두지 않고 파일 버퍼에서 바로 출력
+// - 앞 줄(-B)은 매칭 줄이 정해진 뒤에 그 자리에서 memrchr 로 N줄만 거슬러 올라감
+// - 뒤 줄(-A)은 다음 매칭을 찾기 전이나 구간 끝에서 memchr 로 N줄만 앞으로
+// -> 매칭 주변이 아닌 구간은 지금처럼 매처만 지나가고, 줄 경계를 찾거나 복사하지 않음
+
+// line(줄 시작) 앞으로 최대 *n 줄 거슬러 올라감 ([floor, line) 안에서만)
+// 반환: 가장 앞 줄의 시작, *n 은 floor 에 막혀 못 간 줄 수
+static const char *lines_back(const char *floor, const char *line, size_t *n) {
+    const char *p = line;
+    while (*n > 0 && p > floor) {
+        const char *nl = p - 1 > floor ? (const char*)memrchr(floor, '\n', (size_t)(p - 1 - floor)) : NULL;
+        p = nl ? nl + 1 : floor;
+        (*n)--;
+    }
+    return p;
+}
+
+// from(줄 시작, 파일 안 위치 off)부터 to 앞까지 최대 max 줄을 문맥 줄로 출력 (강조 없음), 반환: 출력한 줄 수
+static size_t print_context(OutBuf *ob, const OutBuf *path, const char *from, const char *to,
+                            size_t first, size_t max, unsigned long long off) {
+    size_t n = 0;
+    while (n < max && from < to) {
+        const char *nl = (const char*)memchr(from, '\n', (size_t)(to - from));
+        const char *line_end = nl ? nl : to;
+        emit_line_head(ob, path, first + n, 0);
+        emit_line_body(ob, from, (size_t)(line_end - from), nl != NULL, off, NULL);
+        n++;
+        const char *next = line_end + (nl != NULL);
+        off += (unsigned long long)(next - from);
+        from = next;
+    }
+    return n;
+}
+
+// 매칭 줄(line_num, line_start 에서 시작) 앞에 올 문맥: 앞 매칭의 남은 -A 줄, 건너뛴 줄이 있으면 "--", -B 줄
+// next: 마지막으로 출력한 줄 다음 줄의 시작 (after_left > 0 일 때만 의미), buf 앞 줄은 ls->hist 에서
+static void print_leading_context(OutBuf *ob, const OutBuf *path, LineScan *ls, const char *buf, const char *next,
+                                  const char *line_start, size_t line_num) {
+    if (ls->after_left > 0) {
+        ls->printed += print_context(ob, path, next, line_start, ls->printed + 1, ls->after_left,
+                                     ls->base_off + (unsigned long long)(next - buf));
+        ls->after_left = 0;
+    }
+
+    size_t want = line_num - 1 - ls->printed;       // 아직 출력하지 않은 앞 줄 수
+    if (want > before_context) want = before_context;
+    size_t n = want;
+    const char *from = lines_back(buf, line_start, &n);
+    const char *hfrom = NULL, *hend = NULL;
+    if (n > 0 && ls->hist_len > 0) {
+        hend = ls->hist + ls->hist_len;
+        hfrom = lines_back(ls->hist, hend, &n);
+    }
+
+    size_t first = line_num - (want - n);
+    if (ls->printed > 0 && first > ls->printed + 1) emit_group_sep(ob);
+    if (hfrom) {
+        first += print_context(ob, path, hfrom, hend, first, SIZE_MAX,
+                               ls->base_off - (unsigned long long)(hend - hfrom));
+    }
+    print_context(ob, path, from, line_start, first, SIZE_MAX, ls->base_off + (unsigned long long)(from - buf));
+}
+
+// buf[0..end) 검색 + 결과 출력, 반환값은 마지막으로 본 줄 다음 위치 (ls->line_num 이 그 줄 번호)
+// 줄 경계는 매칭 위치 주변에서만 찾음
+static const char *scan_lines(const char *filepath, const MgFileMeta *meta, const char *buf, const char *end,
+                              LineScan *ls, WorkerArg *wa) {
+    const MgMatcher *m = wa->m;
+    OutBuf *ob = ls->part ? &ls->part->out : &wa->out;
+
+    // pos는 항상 줄의 시작, line_num은 pos가 속한 줄 번호
+    const char *pos = buf;
+    size_t line_num = ls->line_num;
+    int context = output_mode == OUT_LINES && !ls->part && (before_context > 0 || after_context > 0);
+    const char *ctx_next = buf;        // 마지막으로 출력한 줄 다음 줄 (-A 가 남았으면 구간 첫 줄)
+
+    const char *line_start, *line_end;
+    while (mg_matcher_next_line(m, &pos, end, &line_num, &line_start, &line_end)) {
+        if (!ls->found && !ls->part) {
+            wa->stats.files_matched++;
+            if (output_mode == OUT_LINES) print_file_header(ob, filepath, meta, ls->stream, wa);
+        }
+        ls->found = 1;
+        ls->count++;
+
+        if (output_mode == OUT_QUIET) {
+            // 하나라도 찾으면 결과가 정해짐 -> 쌓인 작업 취소
+            if (!atomic_exchange(&search_stopped, 1) && wa->s) sched_cancel(wa->s);
+            ls->stopped = 1;
+            break;
+        }
+        if (output_mode == OUT_FILES) {
+            if (!ls->part) print_path_result(ob, filepath, -1);
+            ls->stopped = 1;
+            break;
+        }
+        if (output_mode == OUT_LINES) {
+            size_t len = (size_t)(line_end - line_start);
+            unsigned long long off = ls->base_off + (unsigned long long)(line_start - buf);
+            if (ls->part) {
+                split_mark(ls->part, line_num);
+                size_t nsub = emit_line_body(ob, line_start, len, line_end < end, off, m);
+                ls->part->marks[ls->part->nmarks * 3 - 1] = nsub;
+            } else {
+                if (context) print_leading_context(ob, &wa->opath, ls, buf, ctx_next, line_start, line_num);
+                emit_line_head(ob, &wa->opath, line_num, 1);
+                ls->matches += emit_line_body(ob, line_start, len, line_end < end, off, m);
+                ob_maybe_spill(ob);
+                if (context) {
+                    ls->printed = line_num;
+                    ls->after_left = after_context;
+                    ctx_next = line_end < end ? line_end + 1 : end;
+                }
+            }
+        }
+
+        if (ls->count == max_count) {
+            ls->stopped = 1;
+            break;
+        }
+        pos = line_end + 1;
+        line_num++;
+    }
+
+    // 구간 안에서 끝나는 -A 줄 (-m 으로 멈춰도 grep 처럼 뒤 문맥까지), 남은 줄은 다음 구간(스트림)에서
+    if (context && ls->after_left > 0) {
+        size_t n = print_context(ob, &wa->opath, ctx_next, end, ls->printed + 1, ls->after_left,
+                                 ls->base_off + (unsigned long long)(ctx_next - buf));
+        ls->printed += n;
+        ls->after_left -= n;
+    }
+
+    ls->line_num = line_num;
+    return pos;
+}
+
+// ---- 큰 파일 나눠 검색 (--split-size) ----
+// 파일 하나가 worker 하나를 오래 잡고 있으면 나머지가 놀게 됨 (수십 GB 로그 하나가 전체 시간을 결정)
+// - 파일을 연 worker(opener)가 줄 경계에 맞춰 조각을 나누고, 다른 검색 worker 수만큼 TASK_CHUNK 작업을 push
+// - opener 와 helper 모두 atomic 번호표로 조각을 하나씩 가져가서 검색 (늦게 온 helper는 할 일 없이 끝남)
+// - 조각 결과는 조각 안 줄 번호로 기록 -> opener 가 모든 조각이 끝난 뒤 순서대로 합치면서 줄 번호를 맞춤
+// - mmap 은 opener 가 소유: 모든 조각 번호가 나간 뒤 검색 중인 조각이 끝나기를 기다렸다가 해제
+// 구조체는 늦게 꺼내진 helper 작업이 참조할 수 있어서 프로그램 끝에 한꺼번에 해제 (파일당 수십 바이트)
+#define SPLIT_CHUNK_MAX (16 * 1024 * 1024)
+#define SPLIT_CHUNK_MIN (64 * 1024)
+
+struct SplitFile {
+    const char *data;      // 파일 내용 (opener 가 소유)
+    size_t *starts;        // 조각 i = [starts[i], starts[i + 1]), 모두 줄의 시작
+    SplitPart *parts;
+    long nparts;
+    atomic_long next;      // 다음에 가져갈 조각 번호
+    atomic_long stop_at;   // 이 번호보다 뒤 조각은 결과에 영향 없음 (-l: -1, -m N: N줄을 채운 조각)
+    long finished;         // 끝난 조각 수 (lock)
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    SplitFile *next_file;  // 전체 목록 (split_free_all)
+};
+
+static pthread_mutex_t split_list_lock = PTHREAD_MUTEX_INITIALIZER;
+static SplitFile *split_list = NULL;
+
+// 조각을 가져갈 수 없을 때까지 검색 (opener / helper 공용)
+static void split_work(SplitFile *sf, WorkerArg *wa) {
+    long i;
+    while ((i = atomic_fetch_add(&sf->next, 1)) < sf->nparts) {
+        SplitPart *sp = &sf->parts[i];
+        const char *p = sf->data + sf->starts[i];
+        const char *end = sf->data + sf->starts[i + 1];
+
+        if (i <= atomic_load(&sf->stop_at) && !atomic_load_explicit(&search_stopped, memory_order_relaxed)) {
+            LineScan ls = { 1, 0, 0, 0, 1, sp, 0, 0, NULL, 0, sf->starts[i], 0 };
+            const char *pos = scan_lines(NULL, NULL, p, end, &ls, wa);
+            sp->count = ls.count;
+            sp->found = ls.found;
+            wa->stats.bytes_read += (long long)(end - p);
+
+            // 다음 조각들의 줄 번호 기준 (멈춘 조각 뒤는 출력하지 않으므로 필요 없음)
+            if (!ls.stopped && (output_mode == OUT_LINES || show_stats)) {
+                const char *last_nl = NULL;
+                sp->lines = ls.line_num - 1 + mg_count_newlines(pos, end, &last_nl);
+                if (show_stats) wa->stats.lines_scanned += (long long)sp->lines + (end > pos && end[-1] != '\n');
+            }
+            if (ls.stopped) {
+                long limit = output_mode == OUT_FILES ? -1 : i;
+                long cur = atomic_load(&sf->stop_at);
+                while (limit < cur && !atomic_compare_exchange_weak(&sf->stop_at, &cur, limit)) {}
+            }
+        }
+
+        pthread_mutex_lock(&sf->lock);
+        if (++sf->finished == sf->nparts) pthread_cond_broadcast(&sf->cond);
+        pthread_mutex_unlock(&sf->lock);
+    }
+}
+
+// 조각 결과를 순서대로 합쳐서 opener 의 출력 버퍼로
+static void split_merge(SplitFile *sf, const char *filepath, const MgFileMeta *meta, WorkerArg *wa) {
+    OutBuf *ob = &wa->out;
+    long total = 0;
+    size_t matches = 0;    // --json: 출력한 줄들의 submatch 수
+    int found = 0;
+    size_t base = 0;       // 조각 i 의 첫 줄 = base + 1
+
+    for (long i = 0; i < sf->nparts && total != max_count; i++) {
+        const SplitPart *sp = &sf->parts[i];
+        if (sp->found && !found) {
+            found = 1;
+            wa->stats.files_matched++;
+            if (output_mode == OUT_LINES) print_file_header(ob, filepath, meta, 0, wa);
+            if (output_mode == OUT_FILES) {
+                print_path_result(ob, filepath, -1);
+                break;
+            }
+        }
+        if (output_mode == OUT_LINES) {
+            for (size_t k = 0; k < sp->nmarks && total != max_count; k++) {
+                size_t from = sp->marks[k * 3];
+                size_t to = k + 1 < sp->nmarks ? sp->marks[k * 3 + 3] : sp->out.len;
+                emit_line_head(ob, &wa->opath, base + sp->marks[k * 3 + 1], 1);
+                ob_append(ob, sp->out.data + from, to - from);
+                matches += sp->marks[k * 3 + 2];
+                ob_maybe_spill(ob);
+                total++;
+            }
+        } else {
+            total += sp->count;
+            if (max_count >= 0 && total > max_count) total = max_count;
+        }
+        base += sp->lines;
+    }
+
+    if (output_mode == OUT_COUNT && total > 0) print_path_result(ob, filepath, total);
+    if (out_format == FMT_JSON && output_mode == OUT_LINES && found) {
+        print_file_footer(ob, total, matches, sf->starts[sf->nparts], wa);
+    }
+}
+
+static void search_split(const char *filepath, const MgFileMeta *meta, const MgFileBuf *fb, WorkerArg *wa) {
+    size_t chunk = split_min / 4;
+    if (chunk > SPLIT_CHUNK_MAX) chunk = SPLIT_CHUNK_MAX;
+    if (chunk < SPLIT_CHUNK_MIN) chunk = SPLIT_CHUNK_MIN;
+    long n = (long)((fb->len + chunk - 1) / chunk);
+
+    SplitFile *sf = (SplitFile*)xcalloc(1, sizeof(SplitFile));
+    sf->starts = (size_t*)xmalloc(((size_t)n + 1) * sizeof(size_t));
+    sf->parts = (SplitPart*)xcalloc((size_t)n, sizeof(SplitPart));
+    sf->data = fb->data;
+    sf->nparts = n;
+    atomic_init(&sf->next, 0);
+    atomic_init(&sf->stop_at, n);
+    pthread_mutex_init(&sf->lock, NULL);
+    pthread_cond_init(&sf->cond, NULL);
+
+    // 조각 경계: chunk 배수 위치 다음 줄의 시작
+    sf->starts[0] = 0;
+    for (long i = 1; i < n; i++) {
+        size_t at = (size_t)i * chunk;
+        if (at < sf->starts[i - 1]) at = sf->starts[i - 1];
+        const char *nl = (const char*)memchr(fb->data + at, '\n', fb->len - at);
+        sf->starts[i] = nl ? (size_t)(nl - fb->data) + 1 : fb->len;
+    }
+    sf->starts[n] = fb->len;
+
+    pthread_mutex_lock(&split_list_lock);
+    sf->next_file = split_list;
+    split_list = sf;
+    pthread_mutex_unlock(&split_list_lock);
+
+    // helper 작업: 조각 수와 다른 검색 worker 수 중 작은 쪽
+    MgTask helpers[64];
+    long nh = n - 1 < split_helpers ? n - 1 : split_helpers;
+    while (nh > 0) {
+        size_t k = nh < 64 ? (size_t)nh : 64;
+        for (size_t j = 0; j < k; j++) {
+            memset(&helpers[j], 0, sizeof(MgTask));
+            helpers[j].kind = TASK_CHUNK;
+            helpers[j].data = sf;
+        }
+        sched_push_batch(wa, helpers, k);
+        nh -= (long)k;
+    }
+
+    split_work(sf, wa);
+    pthread_mutex_lock(&sf->lock);
+    while (sf->finished < sf->nparts) pthread_cond_wait(&sf->cond, &sf->lock);
+    pthread_mutex_unlock(&sf->lock);
+
+    split_merge(sf, filepath, meta, wa);
+
+    // 조각 번호는 모두 나갔으므로 이후에 오는 helper는 parts/data 를 보지 않음
+    for (long i = 0; i < n; i++) {
+        free(sf->parts[i].out.data);
+        free(sf->parts[i].marks);
+    }
+    free(sf->parts);
+    free(sf->starts);
+    sf->parts = NULL;
+    sf->starts = NULL;
+    sf->data = NULL;
+}
+
+static void split_free_all(void) {
+    while (split_list) {
+        SplitFile *sf = split_list;
+        split_list = sf->next_file;
+        pthread_mutex_destroy(&sf->lock);
+        pthread_cond_destroy(&sf->cond);
+        free(sf);
+    }
+}
+
+// 메모리에 올라온 파일 내용 검색 + 결과 출력 (동기 read 경로와 io_uring 경로 공용)
+static void search_buffer(const char *filepath, const MgFileMeta *meta, const MgFileBuf *fb, WorkerArg *wa) {
+    if (max_count == 0) return;
+    if (out_format == FMT_JSON) wa->file_t0 = now_ns();
+
+    if (!binary_as_text && mg_is_binary(fb)) {
+        wa->stats.binary_skipped++;
+        wa->stats.bytes_read += (long long)(fb->len < MG_BINARY_PROBE ? fb->len : MG_BINARY_PROBE);
+        return;
+    }
+    // 문맥 줄은 조각 경계 너머의 줄까지 필요해서 나누지 않음 (-c / -l / -q 는 문맥 없음 -> 나눔)
+    int context = output_mode == OUT_LINES && (before_context > 0 || after_context > 0);
+    if (split_min > 0 && split_helpers > 0 && fb->len >= split_min && wa->s && !context) {
+        search_split(filepath, meta, fb, wa);
+        ob_flush(&wa->out);
+        return;
+    }
+    wa->stats.bytes_read += (long long)fb->len;
+
+    const char *end = fb->data + fb->len;
+    LineScan ls = { 1, 0, 0, 0, 0, NULL, 0, 0, NULL, 0, 0, 0 };
+    const char *pos = scan_lines(filepath, meta, fb->data, end, &ls, wa);
+
+    if (output_mode == OUT_COUNT && ls.count > 0) print_path_result(&wa->out, filepath, ls.count);
+    if (out_format == FMT_JSON && output_mode == OUT_LINES && ls.found) {
+        print_file_footer(&wa->out, ls.count, ls.matches, fb->len, wa);
+    }
+
+    if (show_stats && ls.stopped) {
+        wa->stats.lines_scanned += (long long)ls.line_num;     // 멈춘 줄까지만 봄
+    } else if (show_stats) {
+        // pos 이전 줄 수 + 나머지 구간의 줄 수 (마지막 줄에 줄바꿈이 없어도 1줄)
+        const char *last_nl = NULL;
+        long long lines = (long long)ls.line_num - 1 + (long long)mg_count_newlines(pos, end, &last_nl);
+        if (end > pos && end[-1] != '\n') lines++;
+        wa->stats.lines_scanned += lines;
+    }
+
+    ob_flush(&wa->out);   // 파일 결과를 한 번에 출력
+}
+
+// 탐색 때 크기/수정 시각을 못 얻은 파일만 fstat
+static int meta_fill(int fd, MgFileMeta *meta, WorkerArg *wa) {
+    if (meta->size >= 0) return 0;
+
+    struct stat st;
+    wa->stats.stat_calls++;
+    if (fstat(fd, &st) != 0) return -1;
+    meta->size = st.st_size;
+    meta->mtime = st.st_mtime;
+    meta->mtime_nsec = st.st_mtim.tv_nsec;
+    return 0;
+}
+
+static void search_compressed(int fd, const char *path, const MgFileMeta *meta, const ZipFormat *zf,
+                              WorkerArg *wa);   // 스트림 입력 절에서 정의
+
+static void search_in_file(const MgTask *task, WorkerArg *wa) {
+    if (atomic_load_explicit(&search_stopped, memory_order_relaxed)) return;   // 취소 전에 꺼낸 작업
+    size_t len = path_build(task->blk, task->off, &wa->pbuf, &wa->pcap);
+    const char *path = wa->pbuf;
+    long long t[4] = { profile_on ? now_ns() : 0, 0, 0, 0 };   // --profile: open / read / match 경계
+
+    // -z 에서는 해제 프로그램을 띄우므로 다른 worker의 자식에게 fd 가 새지 않게
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        wa->stats.open_failures++;
+        return;
+    }
+
+    MgFileMeta meta = task->meta;
+    if (meta_fill(fd, &meta, wa) != 0) {
+        close(fd);
+        return;
+    }
+
+    if (profile_on) t[1] = t[2] = now_ns();
+
+    const ZipFormat *zf = search_zip ? zip_format(path, len) : NULL;
+    if (zf) {
+        search_compressed(fd, path, &meta, zf, wa);
+        close(fd);
+        if (profile_on) {
+            t[3] = now_ns();
+            prof_file(wa->prof, path, len, t);
+        }
+        return;
+    }
+
+    MgFileBuf fb;
+    int rc = mg_file_load(fd, meta.size, &wa->rbuf, &wa->rcap, &fb);
+    close(fd);      // mmap은 fd를 닫아도 유지됨
+    if (rc != 0) return;
+    if (profile_on) t[2] = now_ns();
+
+    search_buffer(path, &meta, &fb, wa);
+    mg_file_release(&fb);
+    if (profile_on) {
+        t[3] = now_ns();
+        prof_file(wa->prof, path, len, t);
+    }
+}
+
+// -------------------- 스트림 입력 (표준 입력 / 파이프) --------------------
+// zcat ... | mini-grep, tail -F log | mini-grep 처럼 끝을 모르는 입력
+// - reader 스레드가 조각 2개를 번갈아 채움 -> main 이 한 조각을 검색하는 동안 다음 조각을 읽음
+// - 조각 안의 완전한 줄들은 복사 없이 그 자리에서 검색 (파일 검색과 같은 매처/커널)
+//   조각 경계에 걸친 줄만 carry 버퍼에 이어 붙여서 검색
+// - 조각이 가득 차지 않아도 지금 읽을 데이터가 없으면 바로 넘김 (느린 입력은 줄이 오는 즉시 출력)
+#define STREAM_CHUNK (4 * 1024 * 1024)
+
+typedef struct {
+    int fd;
+    char *data[2];
+    size_t len[2];
+    int ready[2];          // reader 가 채워서 넘긴 조각 (main 이 검색을 끝내면 0)
+    int eof[2];            // 이 조각 뒤로 입력 끝 (또는 읽기 에러)
+    int err;               // 읽기 에러의 errno
+    int stop;              // main: 더 읽을 필요 없음 (-q / -l / -m)
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} StreamReader;
+
+// 읽을 데이터가 바로 있는지 (파이프가 비었으면 0)
+static int stream_has_input(int fd) {
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    return poll(&pfd, 1, 0) > 0;
+}
+
+// 취소는 read/poll 중에만 허용 (lock 을 잡은 상태로 취소되지 않게)
+static void *stream_reader_thread(void *arg) {
+    StreamReader *sr = (StreamReader*)arg;
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+    for (int w = 0;; w ^= 1) {
+        pthread_mutex_lock(&sr->lock);
+        while (sr->ready[w] && !sr->stop) pthread_cond_wait(&sr->cond, &sr->lock);
+        int stop = sr->stop;
+        pthread_mutex_unlock(&sr->lock);
+        if (stop) return NULL;
+
+        size_t len = 0;
+        int eof = 0;
+        while (len < STREAM_CHUNK) {
+            pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+            ssize_t n = read(sr->fd, sr->data[w] + len, STREAM_CHUNK - len);
+            int more = n > 0 && len + (size_t)n < STREAM_CHUNK && stream_has_input(sr->fd);
+            pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                if (n < 0) sr->err = errno;
+                eof = 1;
+                break;
+            }
+            len += (size_t)n;
+            if (!more) break;
+        }
+
+        pthread_mutex_lock(&sr->lock);
+        sr->len[w] = len;
+        sr->eof[w] = eof;
+        sr->ready[w] = 1;
+        pthread_cond_broadcast(&sr->cond);
+        pthread_mutex_unlock(&sr->lock);
+        if (eof) return NULL;
+    }
+}
+
+// 끝을 모르는 입력을 조각 단위로 이어서 검색하는 상태 (표준 입력 / 압축 해제 출력 공용)
+typedef struct {
+    LineScan ls;
+    const char *label;     // 출력할 이름
+    const MgFileMeta *meta; // 파일 헤더용 (스트림 입력은 헤더 없음)
+    char *carry;           // 조각 경계에 걸친 줄 (앞 조각의 마지막 줄 + 다음 조각의 첫 줄)
+    size_t clen;
+    size_t ccap;
+    char *hist;            // -B: 다음 구간 바로 앞의 줄들 (앞 조각 버퍼는 reader 가 다시 채우므로 복사)
+    size_t hlen;
+    size_t hcap;
+    unsigned long long consumed;   // 검색을 끝낸 바이트 수 (다음 구간의 스트림 안 위치)
+} StreamCursor;
+
+// -B: 검색을 끝낸 구간 [p, end) 까지 합쳐서 마지막 before_context 줄만 hist 에 남김
+// 구간마다 끝의 N줄만 복사 (구간 안의 앞 줄은 scan_lines 가 그 자리에서 출력)
+static void stream_keep_history(StreamCursor *sc, const char *p, const char *end) {
+    if (end == p || end[-1] != '\n') return;       // 입력 끝의 미완성 줄 (뒤에 올 구간 없음)
+    size_t n = before_context;
+    const char *from = lines_back(p, end, &n);
+    size_t keep = 0;
+    if (n > 0 && sc->hlen > 0) {
+        const char *hfrom = lines_back(sc->hist, sc->hist + sc->hlen, &n);
+        keep = (size_t)(sc->hist + sc->hlen - hfrom);
+        memmove(sc->hist, hfrom, keep);
+    }
+    xbuf_reserve(&sc->hist, &sc->hcap, keep + (size_t)(end - from));
+    memcpy(sc->hist + keep, from, (size_t)(end - from));
+    sc->hlen = keep + (size_t)(end - from);
+}
+
+// 완전한 줄들 [p, end) 검색, 다음 구간의 줄 번호까지 맞춰둠
+static void stream_scan(StreamCursor *sc, const char *p, const char *end, WorkerArg *wa) {
+    LineScan *ls = &sc->ls;
+    ls->hist = sc->hist;
+    ls->hist_len = sc->hlen;
+    ls->base_off = sc->consumed;
+    sc->consumed += (unsigned long long)(end - p);
+    const char *pos = scan_lines(sc->label, sc->meta, p, end, ls, wa);
+    if (!ls->stopped && output_mode == OUT_LINES && pos < end) {
+        const char *last_nl = NULL;
+        ls->line_num += mg_count_newlines(pos, end, &last_nl);
+    }
+    if (!ls->stopped && output_mode == OUT_LINES && before_context > 0) stream_keep_history(sc, p, end);
+}
+
+static void stream_carry(StreamCursor *sc, const char *p, size_t n) {
+    xbuf_reserve(&sc->carry, &sc->ccap, sc->clen + n);
+    memcpy(sc->carry + sc->clen, p, n);
+    sc->clen += n;
+}
+
+// 조각 [p, end) 를 이어서 검색, eof 면 마지막 미완성 줄까지
+// 완전한 줄들은 조각 안에서 바로 검색, 앞뒤 조각에 걸친 줄만 carry 로 복사
+static void stream_feed(StreamCursor *sc, const char *p, const char *end, int eof, WorkerArg *wa) {
+    // 앞 조각에서 넘어온 줄: 이번 조각의 첫 줄바꿈까지 붙여서 검색
+    if (sc->clen > 0) {
+        const char *nl = (const char*)memchr(p, '\n', (size_t)(end - p));
+        const char *cut = nl ? nl + 1 : end;
+        stream_carry(sc, p, (size_t)(cut - p));
+        p = cut;
+        if (nl || eof) {
+            stream_scan(sc, sc->carry, sc->carry + sc->clen, wa);
+            sc->clen = 0;
+        }
+    }
+    if (sc->ls.stopped || p >= end) return;
+
+    const char *last = end;
+    if (!eof) {
+        const char *nl = (const char*)memrchr(p, '\n', (size_t)(end - p));
+        last = nl ? nl + 1 : p;
+    }
+    if (last > p) stream_scan(sc, p, last, wa);
+    if (last < end) stream_carry(sc, last, (size_t)(end - last));
+}
+
+// grep과 같은 종료 코드: 매칭 있음 0, 없음 1, 열거나 읽지 못한 입력이 있었으면 2
+// -q 는 하나라도 찾았으면 오류가 있어도 0 (grep -q 와 같음)
+static int exit_code(int found, int errors) {
+    if (found && (!errors || output_mode == OUT_QUIET)) return 0;
+    return errors ? 2 : 1;
+}
+
+// fd 를 끝까지 검색, 반환: exit_code (읽기 실패는 오류)
+static int search_stream(int fd, const char *label, WorkerArg *wa) {
+    if (out_format == FMT_JSON) wa->file_t0 = now_ns();
+    StreamReader sr;
+    memset(&sr, 0, sizeof(sr));
+    sr.fd = fd;
+    sr.data[0] = (char*)xmalloc(STREAM_CHUNK);
+    sr.data[1] = (char*)xmalloc(STREAM_CHUNK);
+    pthread_mutex_init(&sr.lock, NULL);
+    pthread_cond_init(&sr.cond, NULL);
+
+    pthread_t reader;
+    if (pthread_create(&reader, NULL, stream_reader_thread, &sr) != 0) {
+        perror("pthread_create");
+        exit(2);
+    }
+
+    const char *skip_msg = NULL;      // 바이너리로 보고 건너뛸 때 알림
+    StreamCursor sc;
+    memset(&sc, 0, sizeof(sc));
+    sc.ls.line_num = 1;
+    sc.ls.stream = 1;
+    sc.label = label;
+    int first = 1, done = max_count == 0;
+
+    for (int i = 0; !done; i ^= 1) {
+        pthread_mutex_lock(&sr.lock);
+        while (!sr.ready[i]) pthread_cond_wait(&sr.cond, &sr.lock);
+        pthread_mutex_unlock(&sr.lock);
+
+        const char *p = sr.data[i];
+        int eof = sr.eof[i];
+        wa->stats.bytes_read += (long long)sr.len[i];
+
+        if (first && !binary_as_text && memchr(p, '\0', sr.len[i] < MG_BINARY_PROBE ? sr.len[i] : MG_BINARY_PROBE)) {
+            skip_msg = "바이너리 입력이라 검색하지 않습니다 (-a 로 텍스트로 검색)";
+            done = 1;
+        }
+        first = 0;
+        if (!done) stream_feed(&sc, p, p + sr.len[i], eof, wa);
+
+        pthread_mutex_lock(&sr.lock);
+        sr.ready[i] = 0;
+        pthread_cond_broadcast(&sr.cond);
+        pthread_mutex_unlock(&sr.lock);
+
+        ob_flush(&wa->out);     // 조각마다 출력 -> 느린 입력은 줄 단위로 바로 보임
+        if (sc.ls.stopped || eof) done = 1;
+    }
+
+    // 끝까지 읽지 않았으면 reader 를 멈춤 (read 에서 막혀 있을 수 있음 -> 취소)
+    pthread_mutex_lock(&sr.lock);
+    sr.stop = 1;
+    pthread_cond_broadcast(&sr.cond);
+    pthread_mutex_unlock(&sr.lock);
+    pthread_cancel(reader);
+    pthread_join(reader, NULL);
+
+    if (output_mode == OUT_COUNT) {
+        ob_printf(&wa->out, "%ld\n", sc.ls.count);
+        ob_flush(&wa->out);
+    }
+    if (out_format == FMT_JSON && output_mode == OUT_LINES && sc.ls.found) {
+        print_file_footer(&wa->out, sc.ls.count, sc.ls.matches, sc.consumed, wa);
+        ob_flush(&wa->out);
+    }
+    if (skip_msg) fprintf(stderr, "%s: %s\n", label, skip_msg);
+    if (sr.err) fprintf(stderr, "에러: %s 읽기 실패: %s\n", label, strerror(sr.err));
+
+    free(sc.carry);
+    free(sc.hist);
+    free(sr.data[0]);
+    free(sr.data[1]);
+    pthread_mutex_destroy(&sr.lock);
+    pthread_cond_destroy(&sr.cond);
+    return exit_code(sc.ls.found, sr.err != 0);
+}
+
+// ---- 압축 파일 (-z) ----
+// 파일 fd 를 해제 프로그램의 표준 입력으로 넘기고, 표준 출력 파이프를 읽으면서 검색
+// - 디스크에 풀어두지 않음: 메모리는 파이프(ZIP_PIPE_SIZE) + 읽기 버퍼 + 조각 경계에 걸친 줄
+// - 해제(자식 프로세스)와 검색(worker)이 동시에 진행 -> 파이프가 차 있는 동안 해제는 다음 구간을 준비
+// - -l / -q / -m 으로 멈추면 파이프를 닫음 -> 해제 프로그램은 SIGPIPE 로 끝남
+#define ZIP_PIPE_SIZE (1024 * 1024)
+
+static void search_compressed(int fd, const char *path, const MgFileMeta *meta, const ZipFormat *zf,
+                              WorkerArg *wa) {
+    if (out_format == FMT_JSON) wa->file_t0 = now_ns();
+    int pfd[2];
+    if (pipe2(pfd, O_CLOEXEC) != 0) {
+        wa->stats.open_failures++;
+        return;
+    }
+    fcntl(pfd[0], F_SETPIPE_SZ, ZIP_PIPE_SIZE);     // 실패하면 기본 크기 (64KB)
+
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_adddup2(&fa, fd, STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&fa, pfd[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addopen(&fa, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    char *argv[] = { (char*)zf->prog, (char*)"-dc", NULL };
+    pid_t pid;
+    int rc = posix_spawnp(&pid, zf->prog, &fa, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&fa);
+    close(pfd[1]);
+    if (rc != 0) {
+        close(pfd[0]);
+        wa->stats.open_failures++;
+        if (!atomic_exchange(&zip_missing[zf - zip_formats], 1)) {
+            fprintf(stderr, "경고: %s 를 실행할 수 없어 %s 파일은 건너뜁니다 (%s)\n", zf->prog, zf->ext, strerror(rc));
+        }
+        return;
+    }
+    wa->stats.zip_files++;
+
+    xbuf_reserve(&wa->rbuf, &wa->rcap, ZIP_PIPE_SIZE);
+
+    StreamCursor sc;
+    memset(&sc, 0, sizeof(sc));
+    sc.ls.line_num = 1;
+    sc.label = path;
+    sc.meta = meta;
+    int first = 1, binary = 0;
+
+    while (max_count != 0 && !sc.ls.stopped && !atomic_load_explicit(&search_stopped, memory_order_relaxed)) {
+        ssize_t n = read(pfd[0], wa->rbuf, ZIP_PIPE_SIZE);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) n = 0;
+
+        if (first && !binary_as_text && memchr(wa->rbuf, '\0', (size_t)n < MG_BINARY_PROBE ? (size_t)n : MG_BINARY_PROBE)) {
+            binary = 1;
+            wa->stats.binary_skipped++;
+            break;
+        }
+        first = 0;
+        wa->stats.bytes_read += (long long)n;
+        stream_feed(&sc, wa->rbuf, wa->rbuf + n, n == 0, wa);
+        if (n == 0) break;
+    }
+    int early = sc.ls.stopped || binary || max_count == 0;
+    close(pfd[0]);
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+    if (!early && !(WIFEXITED(status) && WEXITSTATUS(status) == 0)) {
+        wa->stats.open_failures++;      // 손상된 압축 파일 (앞부분 결과는 이미 출력 버퍼에)
+    }
+
+    if (output_mode == OUT_COUNT && sc.ls.count > 0) print_path_result(&wa->out, path, sc.ls.count);
+    if (out_format == FMT_JSON && output_mode == OUT_LINES && sc.ls.found) {
+        print_file_footer(&wa->out, sc.ls.count, sc.ls.matches, sc.consumed, wa);
+    }
+    if (show_stats && output_mode == OUT_LINES) {
+        wa->stats.lines_scanned += (long long)sc.ls.line_num - 1;
+    }
+    free(sc.carry);
+    free(sc.hist);
+    ob_flush(&wa->out);
+}
+
+// -------------------- 인덱스 작업 (Worker) --------------------
+// --use-index: 인덱스에 같은 크기/수정 시각으로 있는데 후보가 아니면 읽지 않고 건너뜀
+static int index_skip(const MgTask *task, WorkerArg *wa) {
+    const TrigramIndex *idx = wa->idx;
+    if (!idx || !idx->cand || task->meta.size < 0) return 0;
+
+    size_t len = path_build(task->blk, task->off, &wa->pbuf, &wa->pcap);
+    if (search_zip && zip_format(wa->pbuf, len)) return 0;        // 인덱스에는 압축된 바이트가 들어 있음
+    size_t rel_len;
+    const char *rel = index_rel_path(idx, wa->pbuf, len, &rel_len);
+    long id = index_find(idx, rel, rel_len);
+    if (id < 0) return 0;
+
+    const IndexFile *f = &idx->files[id];
+    if (f->size != (int64_t)task->meta.size || f->mtime_ns != meta_mtime_ns(&task->meta)) return 0;
+    if (idx->cand[id >> 3] & (1u << (id & 7))) return 0;
+
+    wa->stats.index_skipped++;
+    return 1;
+}
+
+// --index: 파일 하나의 trigram 수집, 기존 인덱스와 크기/수정 시각이 같으면 읽지 않고 재사용
+static void index_add_file(const MgTask *task, WorkerArg *wa) {
+    size_t len = path_build(task->blk, task->off, &wa->pbuf, &wa->pcap);
+    const char *path = wa->pbuf;
+    size_t rel_len;
+    const char *rel = index_rel_path(wa->idx, path, len, &rel_len);
+
+    MgFileMeta meta = task->meta;
+    int fd = -1;
+    if (meta.size < 0) {
+        fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            wa->stats.open_failures++;
+            return;
+        }
+        if (meta_fill(fd, &meta, wa) != 0) {
+            close(fd);
+            return;
+        }
+    }
+
+    long old_id = index_find(wa->idx, rel, rel_len);
+    if (old_id >= 0 && wa->idx->files[old_id].size == (int64_t)meta.size &&
+        wa->idx->files[old_id].mtime_ns == meta_mtime_ns(&meta)) {
+        IndexEntry *e = index_builder_add(&wa->ib, rel, rel_len);
+        e->size = (int64_t)meta.size;
+        e->mtime_ns = meta_mtime_ns(&meta);
+        e->old_id = old_id;
+        wa->ib.reused++;
+        if (fd >= 0) close(fd);
+        return;
+    }
+
+    if (fd < 0) {
+        fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            wa->stats.open_failures++;
+            return;
+        }
+    }
+    MgFileBuf fb;
+    int rc = mg_file_load(fd, meta.size, &wa->rbuf, &wa->rcap, &fb);
+    close(fd);
+    if (rc != 0) return;
+    wa->stats.bytes_read += (long long)fb.len;
+
+    IndexEntry *e = index_builder_add(&wa->ib, rel, rel_len);
+    e->size = (int64_t)meta.size;
+    e->mtime_ns = meta_mtime_ns(&meta);
+    if (!binary_as_text && mg_is_binary(&fb)) {
+        // trigram 없이 기록 -> --use-index 에서 열지도 않고 건너뜀
+        wa->stats.binary_skipped++;
+        e->tris = NULL;
+        e->ntris = 0;
+    } else {
+        e->tris = index_collect_trigrams(&wa->ib, fb.data, fb.len, &e->ntris);
+    }
+    mg_file_release(&fb);
+}
+
+// -------------------- 방문한 디렉터리 (symlink 고리 / bind mount 중복) --------------------
+// 집합 (MgVisitSet) 과 항목 분류는 mini-grep-lib.h, 실행 / 데몬 하나에 전역 집합 하나
+static MgVisitSet visited;
+
+// -------------------- 디렉터리 스캔 (Worker가 디렉터리 작업 처리) --------------------
+// 하위 디렉터리는 재귀 대신 Queue에 작업으로 넣어서 다른 worker도 확장할 수 있게 함
+// 종류는 readdir의 d_type으로 판단 -> 대부분의 파일시스템에서 항목당 stat 0회
+// d_type을 모르거나 (--follow 의) symlink면 열어둔 디렉터리 fd 기준 fstatat (전체 경로 재탐색 없음),
+// 이때 얻은 크기/수정 시각은 작업에 실어 보내서 검색할 때 다시 stat 하지 않음
+// pbuf[0..dir_len] 은 "디렉터리 경로/" 상태 -> 이름을 붙여 전체 경로로 판정
+static int is_ignored(WorkerArg *wa, const IgnoreNode *ign, size_t dir_len, const char *name, int is_dir) {
+    if (!ign) return 0;
+    size_t name_len = strlen(name);
+    memcpy(wa->pbuf + dir_len + 1, name, name_len);
+    if (!ignore_check(ign, wa->pbuf, dir_len + 1 + name_len, name, name_len, is_dir)) return 0;
+    wa->stats.ignored++;
+    return 1;
+}
+
+// 이름 순 정렬을 위해 항목 하나를 wa->sents 에 모아둠 (--sort=path, 디렉터리 캐시)
+static void sort_entry_push(WorkerArg *wa, const char *name, MgTaskKind kind, const MgFileMeta *meta) {
+    size_t len = strlen(name) + 1;
+    xbuf_reserve(&wa->snames, &wa->snames_cap, wa->snames_len + len);
+    if (wa->nsents == wa->sents_cap) {
+        wa->sents_cap = wa->sents_cap ? wa->sents_cap * 2 : 256;
+        wa->sents = (SortEntry*)xrealloc(wa->sents, wa->sents_cap * sizeof(SortEntry));
+    }
+    SortEntry *e = &wa->sents[wa->nsents++];
+    e->name_off = wa->snames_len;
+    e->kind = kind;
+    e->has_meta = meta != NULL;
+    if (meta) e->meta = *meta;
+    memcpy(wa->snames + wa->snames_len, name, len);
+    wa->snames_len += len;
+}
+
+// 모아둔 항목을 이름 순으로 (정렬 직전에 name 포인터를 채움)
+static void sort_entries(WorkerArg *wa) {
+    for (size_t i = 0; i < wa->nsents; i++) {
+        wa->sents[i].name = wa->snames + wa->sents[i].name_off;
+    }
+    qsort(wa->sents, wa->nsents, sizeof(SortEntry), sort_entry_cmp);
+}
+
+// 자식 작업 하나: 보통은 바로 배치에, --sort=path 면 이름 순 정렬을 위해 모아둠
+static void scan_add(WorkerArg *wa, TaskBatch *batch, const char *name, MgTaskKind kind, const MgFileMeta *meta) {
+    if (sort_output) {
+        sort_entry_push(wa, name, kind, meta);
+    } else {
+        batch_add(wa, batch, name, kind, meta);
+    }
+}
+
+// --sort=path: 모아둔 항목을 이름 순으로 순번을 붙여 push, 순서 노드를 부모 칸에 연결
+static void scan_flush_sorted(const MgTask *task, WorkerArg *wa, TaskBatch *batch) {
+    size_t n = wa->nsents;
+    sort_entries(wa);
+
+    // 자식이 push 되자마자 끝날 수 있으므로 칸부터 만들어 둠
+    OrderDir *od = n > 0 ? order_dir_new(path_data(task->blk)->ord, (uint32_t)n) : NULL;
+    batch->ord = od;
+    for (size_t i = 0; i < n; i++) {
+        const SortEntry *e = &wa->sents[i];
+        batch_add(wa, batch, e->name, e->kind, e->has_meta ? &e->meta : NULL);
+    }
+    wa->nsents = 0;
+    wa->snames_len = 0;
+    batch_close(wa, batch);
+    order_dir_done(task, od);
+}
+
+// 디렉터리 열기 (실패하면 경고 후 NULL), 경로는 wa->pbuf 에 조립, 길이는 *path_len
+// 이미 다른 경로로 읽은 디렉터리 / --one-file-system 으로 벗어난 디렉터리도 NULL (경고 없음)
+// key: 연 디렉터리의 (st_dev, st_ino) (--daemon 캐시 노드가 기억해 둠)
+static DIR *scan_open(const MgTask *task, WorkerArg *wa, size_t *path_len, MgVisitKey *key) {
+    *path_len = path_build(task->blk, task->off, &wa->pbuf, &wa->pcap);
+    struct stat st;
+    int dfd = -1;
+    DIR *dir = NULL;
+    MgWalkResult r = mg_walk_open_dir(wa->pbuf, &walk_opts, &visited, task_cache(task), &dfd, &st);
+    if (r != MG_WALK_ERROR) wa->stats.stat_calls++;
+    if (r == MG_WALK_NOMEM) die_nomem("calloc");
+    if (r == MG_WALK_OTHER_FS) {
+        wa->stats.other_fs++;
+        return NULL;
+    }
+    if (r == MG_WALK_DUP) {
+        wa->stats.dirs_dup++;
+        return NULL;
+    }
+    if (r == MG_WALK_DIR) {
+        if (key) {
+            key->dev = st.st_dev;
+            key->ino = st.st_ino;
+        }
+        dir = fdopendir(dfd);
+    }
+    if (!dir) {
+        if (dfd >= 0) close(dfd);
+        wa->stats.open_failures++;
+        fprintf(stderr, "경고: 디렉터리를 열 수 없습니다: %s\n", wa->pbuf);
+        return NULL;
+    }
+    wa->stats.dirs_scanned++;
+    return dir;
+}
+
+// --gitignore: 이 디렉터리 규칙 (없으면 부모 것), pbuf 뒤에 "/이름" 을 붙여 항목 경로로 씀
+static IgnoreNode *scan_ignore(const MgTask *task, DIR *dir, size_t path_len, WorkerArg *wa) {
+    if (!use_ignore_files) return NULL;
+    IgnoreNode *ign = ignore_load(dirfd(dir), (uint32_t)path_len, path_data(task->blk)->ign, wa);
+    xbuf_reserve(&wa->pbuf, &wa->pcap, path_len + 2 + 256);   // d_name 은 최대 255바이트
+    wa->pbuf[path_len] = '/';
+    return ign;
+}
+
+// 항목 하나의 종류 판정 + 필터: 작업 종류 반환, 건너뛸 항목은 -1
+// fstatat 으로 크기/수정 시각을 얻었으면 *meta 에 채우고 *has_meta = 1
+static int scan_classify(WorkerArg *wa, int dfd, const struct dirent *entry, const IgnoreNode *ign,
+                         size_t path_len, MgFileMeta *meta, int *has_meta) {
+    const char *name = entry->d_name;
+
+    // 인덱스를 쓰면 변경 감지에 크기/수정 시각이 필요 -> 대상 파일은 여기서 fstatat
+    int reg_stat = index_mode != INDEX_OFF && entry->d_type == DT_REG && is_target_file(name);
+    struct stat st;
+    MgWalkResult r = mg_walk_classify(dfd, entry, &walk_opts, reg_stat, &st, has_meta, &wa->stats.stat_calls);
+    if (r == MG_WALK_SYMLINK) {
+        wa->stats.symlinks_skipped++;
+        return -1;
+    }
+    if (r == MG_WALK_OTHER_FS) {
+        wa->stats.other_fs++;
+        return -1;
+    }
+    if (*has_meta) {
+        meta->size = st.st_size;
+        meta->mtime = st.st_mtime;
+        meta->mtime_nsec = st.st_mtim.tv_nsec;
+    }
+
+    if (r == MG_WALK_DIR) {
+        if (is_excluded_dir(name)) return -1;     // 제외된 하위 트리는 내려가지 않음
+        if (use_ignore_files && (strcmp(name, ".git") == 0 || is_ignored(wa, ign, path_len, name, 1))) {
+            return -1;
+        }
+        return MG_TASK_DIR;
+    }
+    if (r == MG_WALK_FILE && is_target_file(name) && !is_ignored(wa, ign, path_len, name, 0)) {
+        return MG_TASK_FILE;
+    }
+    return -1;
+}
+
+static void scan_directory(const MgTask *task, WorkerArg *wa) {
+    size_t path_len;
+    DIR *dir = scan_open(task, wa, &path_len, NULL);
+    if (!dir) {
+        if (sort_output) order_dir_done(task, NULL);
+        return;
+    }
+
+    TaskBatch batch;
+    batch_init(&batch, task->blk, task->off);
+    IgnoreNode *ign = scan_ignore(task, dir, path_len, wa);
+    batch.ign = ign;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (atomic_load_explicit(&search_stopped, memory_order_relaxed)) break;   // -q: 이미 찾음
+
+        MgFileMeta meta;
+        int has_meta;
+        int kind = scan_classify(wa, dirfd(dir), entry, ign, path_len, &meta, &has_meta);
+        if (kind < 0) continue;
+        if (kind == MG_TASK_FILE) wa->stats.files_scanned++; // 스캔 카운트 (대상 파일 기준)
+        scan_add(wa, &batch, entry->d_name, (MgTaskKind)kind, has_meta ? &meta : NULL);
+    }
+
+    closedir(dir);      // dfd도 함께 닫힘
+    if (sort_output) {
+        scan_flush_sorted(task, wa, &batch);
+    } else {
+        batch_close(wa, &batch);
+    }
+    ignore_release(ign);
+}
+
+// -------------------- 디렉터리 캐시 (--daemon) --------------------
+// 데몬은 탐색 결과를 디렉터리마다 노드(DirCache)로 들고 있다가 질의마다 그대로 다시 씀
+// - 노드 = 자식 이름 블록(PathBlock, 캐시가 참조 1개) + 이름 순으로 미리 만든 자식 작업 배열
+//   -> 펼칠 때는 작업을 push 만 함 (open/readdir/fstatat 0회), MG_TASK_DIR 작업의 data 가 자식 노드
+// - 디렉터리마다 inotify 감시: 항목이 생기거나 없어지면 그 노드만 dirty -> 다음에 펼칠 때 그 디렉터리만 다시 읽음
+//   파일 내용 변경은 목록과 무관 (크기/수정 시각은 캐시하지 않고 검색할 때 fstat)
+// - .gitignore / .ignore 가 바뀌면 규칙을 물려받는 하위 트리 전체를 다시 읽음
+// - 감시를 못 단 디렉터리(watch 상한)와 이미 다른 경로로 읽은 디렉터리(방문 집합)는 펼칠 때마다 다시 확인
+// 질의는 한 번에 하나이고 노드를 펼치는 것은 그 질의의 worker 하나뿐 -> 노드에는 lock 없음,
+// 여러 worker가 같이 고치는 wd -> 노드 표만 lock
+struct DirCache {
+    DirCache *parent;
+    MgPathBlock *blk;      // 자식 이름 블록 (NULL = 아직 안 읽음), 작업은 push 할 때 참조를 더함
+    MgTask *items;         // 자식 작업 (이름 순, seq = 배열 위치)
+    uint32_t nitems;
+    int wd;                // inotify watch (-1 = 감시 없음)
+    int dirty;             // 펼칠 때 디스크에서 다시 읽음
+    int visited;           // key 를 방문 집합에 넣어둠 (노드가 없어지면 뺌)
+    MgVisitKey key;        // 마지막으로 읽은 디렉터리의 (st_dev, st_ino)
+};
+
+#ifdef HAVE_INOTIFY
+#define CACHE_WATCH_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+                          IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+#endif
+
+static struct {
+    int fd;                // inotify (-1 = 쓸 수 없음 -> 모든 노드를 매번 다시 읽음)
+    pthread_mutex_t lock;  // by_wd
+    DirCache **by_wd;      // watch 번호 -> 노드
+    size_t cap;
+    int warned;            // watch 상한 경고는 1번만
+} dcache = { -1, PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0 };
+
+static int daemon_warmup = 0;         // 데몬 시작: 트리만 읽고 파일 작업은 만들지 않음
+
+static DirCache *cache_node_new(DirCache *parent) {
+    DirCache *d = (DirCache*)xcalloc(1, sizeof(DirCache));
+    d->parent = parent;
+    d->wd = -1;
+    d->dirty = 1;
+    return d;
+}
+
+// readdir 전에 감시부터 (읽는 도중의 변경은 다음 질의에서 다시 읽게 됨)
+static void cache_watch(DirCache *d, const char *path) {
+#ifdef HAVE_INOTIFY
+    if (dcache.fd < 0) return;
+    uint32_t mask = CACHE_WATCH_MASK | (use_ignore_files ? IN_CLOSE_WRITE : 0);
+    int wd = inotify_add_watch(dcache.fd, path, mask);
+    if (wd < 0) {
+        if (errno == ENOSPC && !__atomic_exchange_n(&dcache.warned, 1, __ATOMIC_RELAXED)) {
+            fprintf(stderr, "경고: inotify watch 상한에 걸렸습니다 (fs.inotify.max_user_watches), "
+                            "감시하지 못한 디렉터리는 질의마다 다시 읽습니다.\n");
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&dcache.lock);
+    if ((size_t)wd >= dcache.cap) {
+        size_t cap = dcache.cap ? dcache.cap : 1024;
+        while (cap <= (size_t)wd) cap *= 2;
+        DirCache **nb = (DirCache**)xrealloc(dcache.by_wd, cap * sizeof(DirCache*));
+        memset(nb + dcache.cap, 0, (cap - dcache.cap) * sizeof(DirCache*));
+        dcache.by_wd = nb;
+        dcache.cap = cap;
+    }
+    if (!dcache.by_wd[wd]) {        // 이미 있으면 같은 디렉터리를 다른 경로로 만난 것 -> 먼저 단 노드가 감시
+        dcache.by_wd[wd] = d;
+        d->wd = wd;
+    }
+    pthread_mutex_unlock(&dcache.lock);
+#else
+    (void)d;
+    (void)path;
+#endif
+}
+
+static void cache_unwatch(DirCache *d) {
+#ifdef HAVE_INOTIFY
+    if (d->wd < 0) return;
+    pthread_mutex_lock(&dcache.lock);
+    dcache.by_wd[d->wd] = NULL;
+    pthread_mutex_unlock(&dcache.lock);
+    inotify_rm_watch(dcache.fd, d->wd);
+    d->wd = -1;
+#else
+    (void)d;
+#endif
+}
+
+static void cache_free(DirCache *d) {
+    for (uint32_t i = 0; i < d->nitems; i++) {
+        if (d->items[i].kind == MG_TASK_DIR) cache_free(task_cache(&d->items[i]));
+    }
+    cache_unwatch(d);
+    if (d->visited) mg_visit_release(&visited, d->key.dev, d->key.ino, d);
+    free(d->items);
+    mg_path_release(d->blk);
+    free(d);
+}
+
+// d 와 그 아래 읽어둔 노드를 모두 dirty 로
+static void cache_mark_tree(DirCache *d) {
+    d->dirty = 1;
+    for (uint32_t i = 0; i < d->nitems; i++) {
+        if (d->items[i].kind == MG_TASK_DIR) cache_mark_tree(task_cache(&d->items[i]));
+    }
+}
+
+// 쌓인 inotify 이벤트를 읽어서 노드에 반영 (질의 시작 전, worker가 쉬는 동안 main 에서)
+static void cache_drain(DirCache *root) {
+#ifdef HAVE_INOTIFY
+    if (dcache.fd < 0) return;
+    char buf[64 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (1) {
+        ssize_t n = read(dcache.fd, buf, sizeof(buf));
+        if (n <= 0) break;      // EAGAIN: 다 읽음
+
+        for (char *p = buf; p < buf + n; ) {
+            const struct inotify_event *ev = (const struct inotify_event*)p;
+            p += sizeof(struct inotify_event) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW) {   // 이벤트를 놓침 -> 전부 다시 읽음
+                cache_mark_tree(root);
+                continue;
+            }
+            DirCache *d = ev->wd >= 0 && (size_t)ev->wd < dcache.cap ? dcache.by_wd[ev->wd] : NULL;
+            if (!d) continue;
+
+            if (ev->mask & IN_IGNORED) {      // 감시가 없어짐 (디렉터리 삭제 등)
+                dcache.by_wd[ev->wd] = NULL;
+                d->wd = -1;
+                d->dirty = 1;
+            } else if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+                d->dirty = 1;
+                if (d->parent) d->parent->dirty = 1;
+            } else if (ev->len > 0 && use_ignore_files &&
+                       (strcmp(ev->name, ".gitignore") == 0 || strcmp(ev->name, ".ignore") == 0)) {
+                cache_mark_tree(d);           // 하위 트리가 물려받은 규칙이 바뀜
+            } else if (!(ev->mask & IN_CLOSE_WRITE)) {
+                d->dirty = 1;
+            }
+        }
+    }
+#else
+    cache_mark_tree(root);
+#endif
+}
+
+// 노드 d 를 디스크에서 다시 읽음 (task = d 를 가리키는 작업: 경로와 부모 ignore 규칙)
+// 이름이 같은 하위 디렉터리 노드는 그대로 옮겨서 그 아래 캐시를 유지
+static void cache_refresh(DirCache *d, const MgTask *task, WorkerArg *wa) {
+    size_t nold = d->nitems;
+    MgTask *old = d->items;
+    MgPathBlock *old_blk = d->blk;
+    d->items = NULL;
+    d->nitems = 0;
+    d->blk = NULL;
+
+    size_t path_len;
+    MgVisitKey key;
+    DIR *dir = scan_open(task, wa, &path_len, &key);
+    if (dir) {
+        // 같은 경로가 다른 디렉터리로 바뀌었으면 예전 것은 방문 집합에서 뺌
+        if (d->visited && (d->key.dev != key.dev || d->key.ino != key.ino)) {
+            mg_visit_release(&visited, d->key.dev, d->key.ino, d);
+        }
+        d->key = key;
+        d->visited = 1;
+        if (d->wd < 0) cache_watch(d, wa->pbuf);
+        d->dirty = d->wd < 0;
+        IgnoreNode *ign = scan_ignore(task, dir, path_len, wa);
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            MgFileMeta meta;
+            int has_meta;
+            int kind = scan_classify(wa, dirfd(dir), entry, ign, path_len, &meta, &has_meta);
+            if (kind >= 0) sort_entry_push(wa, entry->d_name, (MgTaskKind)kind, NULL);
+        }
+        closedir(dir);
+        sort_entries(wa);
+
+        size_t n = wa->nsents;
+        d->items = (MgTask*)xmalloc((n ? n : 1) * sizeof(MgTask));
+        d->blk = path_block_new(task->blk, task->off, ign, NULL, wa->snames_len ? wa->snames_len : 1, 0);
+        ignore_release(ign);    // 블록이 참조를 가짐
+
+        size_t j = 0;           // old 도 이름 순 -> 한 번 훑으며 같은 이름의 디렉터리 노드를 찾음
+        for (size_t i = 0; i < n; i++) {
+            const SortEntry *e = &wa->sents[i];
+            MgTask *t = &d->items[i];
+            t->blk = d->blk;
+            t->off = mg_path_block_put(d->blk, e->name, strlen(e->name));
+            t->seq = (uint32_t)i;
+            t->kind = e->kind;
+            if (e->kind == MG_TASK_FILE) {
+                t->meta.size = -1;
+                t->meta.mtime = 0;
+                t->meta.mtime_nsec = 0;
+                continue;
+            }
+            t->data = NULL;
+            while (j < nold) {
+                int cmp = strcmp(old[j].blk->names + old[j].off, e->name);
+                if (cmp > 0) break;
+                j++;
+                if (cmp == 0 && old[j - 1].kind == MG_TASK_DIR) {
+                    t->data = old[j - 1].data;
+                    old[j - 1].kind = MG_TASK_FILE;  // 옮김 (아래에서 해제하지 않음)
+                    break;
+                }
+            }
+            if (!t->data) t->data = cache_node_new(d);
+        }
+        d->nitems = (uint32_t)n;
+        wa->nsents = 0;
+        wa->snames_len = 0;
+    } else {
+        d->dirty = 1;           // 못 열면 다음에 다시 시도
+    }
+
+    for (size_t i = 0; i < nold; i++) {
+        if (old[i].kind == MG_TASK_DIR) cache_free(task_cache(&old[i])); // 없어진 디렉터리
+    }
+    free(old);
+    mg_path_release(old_blk);   // 옮긴 하위 노드의 블록이 아직 참조하면 이름은 남아 있음
+}
+
+// 캐시된 디렉터리 작업: (필요하면 다시 읽고) 자식 작업을 push
+static void cache_expand(const MgTask *task, WorkerArg *wa) {
+    DirCache *d = task_cache(task);
+    if (d->dirty) {
+        cache_refresh(d, task, wa);
+    } else {
+        wa->stats.dirs_cached++;
+    }
+
+    OrderDir *od = NULL;
+    if (sort_output && d->nitems > 0) {
+        od = order_dir_new(path_data(task->blk)->ord, d->nitems);
+        path_data(d->blk)->ord = od; // 이번 질의의 순서 노드 (push 전에 달아둠)
+    }
+
+    MgTask items[MG_TASK_BATCH_MAX];
+    uint32_t i = 0;
+    while (i < d->nitems && !atomic_load_explicit(&search_stopped, memory_order_relaxed)) {
+        size_t k = 0;
+        for (; i < d->nitems && k < MG_TASK_BATCH_MAX; i++) {
+            const MgTask *t = &d->items[i];
+            if (t->kind == MG_TASK_FILE) {
+                wa->stats.files_scanned++;
+                if (daemon_warmup) continue;
+            }
+            items[k++] = *t;
+        }
+        if (k == 0) continue;
+        atomic_fetch_add_explicit(&d->blk->refs, (unsigned)k, memory_order_relaxed);   // 작업마다 참조 1개
+        sched_backpressure(wa);
+        sched_push_batch(wa, items, k);
+    }
+    if (sort_output) order_dir_done(task, od);
+}
+
+// 디렉터리 작업 하나 (worker 루프와 io_uring worker 공용)
+static void run_dir_task(const MgTask *task, WorkerArg *wa) {
+    if (task_cache(task)) {
+        cache_expand(task, wa);
+    } else {
+        scan_directory(task, wa);
+    }
+}
+
+// -------------------- io_uring 파일 읽기 (--io-uring) --------------------
+// 캐시가 비어 있거나 네트워크 디스크일 때는 open()/read() 대기가 대부분이라
+// 동기 I/O로는 동시에 진행되는 I/O 수 = 스레드 수로 묶임
+// -> 검색 worker마다 ring 1개를 두고 파일 여러 개의 open/read를 한꺼번에 제출,
+//    완료된 파일부터 검색 (적은 스레드로도 디스크 큐를 깊게 유지)
+// liburing 없이 io_uring_setup / io_uring_enter 시스템 콜을 직접 사용
+// 작은 파일만 ring으로 읽고, MG_MMAP_THRESHOLD 이상은 open만 ring으로 한 뒤 기존 mmap 경로
+#ifdef HAVE_IO_URING
+#define URING_DEFAULT_DEPTH 32
+#define URING_MAX_DEPTH     4096
+
+typedef struct {
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    unsigned sq_local_tail;    // 아직 커널에 보이지 않은 tail (제출 시 반영)
+    unsigned to_submit;
+
+    void *sq_ptr, *cq_ptr;
+    size_t sq_size, cq_size, sqes_size;
+} Uring;
+
+static void uring_unmap(Uring *u) {
+    if (u->sqes && u->sqes != MAP_FAILED) munmap(u->sqes, u->sqes_size);
+    if (u->cq_ptr && u->cq_ptr != MAP_FAILED && u->cq_ptr != u->sq_ptr) munmap(u->cq_ptr, u->cq_size);
+    if (u->sq_ptr && u->sq_ptr != MAP_FAILED) munmap(u->sq_ptr, u->sq_size);
+}
+
+// 성공 0, 실패 -1 (커널 미지원 / seccomp 차단 / 5.6 미만)
+static int uring_init(Uring *u, unsigned entries) {
+    memset(u, 0, sizeof(*u));
+
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (fd < 0) return -1;
+    // OPENAT / READ opcode는 5.6부터, 같은 버전에 생긴 feature 비트로 확인
+    if (!(p.features & IORING_FEAT_RW_CUR_POS)) {
+        close(fd);
+        return -1;
+    }
+    u->fd = fd;
+
+    u->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (u->cq_size > u->sq_size) u->sq_size = u->cq_size;
+        u->cq_size = u->sq_size;
+    }
+    u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    u->sq_ptr = mmap(NULL, u->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     fd, IORING_OFF_SQ_RING);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        u->cq_ptr = u->sq_ptr;
+    } else {
+        u->cq_ptr = mmap(NULL, u->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         fd, IORING_OFF_CQ_RING);
+    }
+    u->sqes = (struct io_uring_sqe*)mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE,
+                                         MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (u->sq_ptr == MAP_FAILED || u->cq_ptr == MAP_FAILED || u->sqes == MAP_FAILED) {
+        uring_unmap(u);
+        close(fd);
+        return -1;
+    }
+
+    char *sq = (char*)u->sq_ptr;
+    char *cq = (char*)u->cq_ptr;
+    u->sq_head  = (unsigned*)(sq + p.sq_off.head);
+    u->sq_tail  = (unsigned*)(sq + p.sq_off.tail);
+    u->sq_mask  = (unsigned*)(sq + p.sq_off.ring_mask);
+    u->sq_array = (unsigned*)(sq + p.sq_off.array);
+    u->cq_head  = (unsigned*)(cq + p.cq_off.head);
+    u->cq_tail  = (unsigned*)(cq + p.cq_off.tail);
+    u->cq_mask  = (unsigned*)(cq + p.cq_off.ring_mask);
+    u->cqes     = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    u->sq_local_tail = *u->sq_tail;
+    return 0;
+}
+
+static void uring_destroy(Uring *u) {
+    uring_unmap(u);
+    close(u->fd);
+}
+
+// SQE 하나 채우기 (worker당 진행 중인 요청 <= depth <= SQ 크기라 자리가 모자라지 않음)
+static struct io_uring_sqe *uring_prep(Uring *u, int op, int fd, const void *addr, unsigned len,
+                                       uint64_t off, uint64_t user_data) {
+    unsigned idx = u->sq_local_tail & *u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = (uint8_t)op;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)addr;
+    sqe->len = len;
+    sqe->off = off;
+    sqe->user_data = user_data;
+    u->sq_array[idx] = idx;
+    u->sq_local_tail++;
+    u->to_submit++;
+    return sqe;
+}
+
+// 쌓인 SQE 제출 + 완료가 min_complete개 이상 생길 때까지 대기
+static int uring_submit_wait(Uring *u, unsigned min_complete) {
+    __atomic_store_n(u->sq_tail, u->sq_local_tail, __ATOMIC_RELEASE);
+    while (1) {
+        int r = (int)syscall(__NR_io_uring_enter, u->fd, u->to_submit, min_complete,
+                             min_complete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (r >= 0) {
+            u->to_submit -= (unsigned)r;
+            return 0;
+        }
+        if (errno != EINTR) return -1;
+    }
+}
+
+// 파일 하나의 진행 상태 (slot 번호가 user_data)
+typedef enum {
+    URING_OPEN = 0,
+    URING_READ = 1
+} UringStep;
+
+typedef struct {
+    MgTask task;
+    UringStep step;
+    int fd;
+    MgFileMeta meta;
+    char *path;            // OPENAT 이 끝날 때까지 유지되는 전체 경로 (재사용)
+    size_t path_cap;
+    char *buf;             // slot별 read 버퍼 (재사용)
+    size_t cap;
+    size_t len;
+    long long t[4];        // --profile: open 제출 / open 완료 처리 / 검색 시작 (read 완료) / 검색 끝
+} UringSlot;
+
+typedef struct {
+    Uring ring;
+    UringSlot *slots;
+    unsigned *free_slots;  // 비어 있는 slot 번호 stack
+    unsigned nfree;
+    unsigned depth;
+    size_t done;           // 끝났지만 아직 스케줄러에 완료 처리하지 않은 작업 수
+} UringWorker;
+
+static void uring_submit_read(UringWorker *uw, unsigned i) {
+    UringSlot *sl = &uw->slots[i];
+    size_t want = sl->cap - sl->len;
+    if (want > UINT32_MAX) want = UINT32_MAX;
+    uring_prep(&uw->ring, IORING_OP_READ, sl->fd, sl->buf + sl->len, (unsigned)want,
+               (uint64_t)sl->len, i);
+}
+
+static void uring_slot_done(UringWorker *uw, unsigned i, WorkerArg *wa) {
+    UringSlot *sl = &uw->slots[i];
+    if (sl->fd >= 0) {
+        close(sl->fd);
+        sl->fd = -1;
+    }
+    if (sort_output) order_file_done(wa, &sl->task);
+    mg_path_release(sl->task.blk);
+    sl->task.blk = NULL;
+    uw->free_slots[uw->nfree++] = i;
+    uw->done++;
+}
+
+static void uring_search(UringWorker *uw, unsigned i, const MgFileBuf *fb, WorkerArg *wa) {
+    UringSlot *sl = &uw->slots[i];
+    long long t0 = (show_stats || profile_on) ? now_ns() : 0;
+    search_buffer(sl->path, &sl->meta, fb, wa);
+    if (show_stats) wa->stats.match_ns += now_ns() - t0;
+    if (profile_on) {
+        sl->t[2] = t0;
+        sl->t[3] = now_ns();
+        prof_file(wa->prof, sl->path, strlen(sl->path), sl->t);
+    }
+}
+
+// open 완료: (탐색 때 못 얻었으면) fstat 후 read 제출, 큰 파일은 mmap 경로
+static void uring_on_open(UringWorker *uw, unsigned i, int res, WorkerArg *wa) {
+    UringSlot *sl = &uw->slots[i];
+    if (res < 0) {
+        wa->stats.open_failures++;
+        uring_slot_done(uw, i, wa);
+        return;
+    }
+    sl->fd = res;
+
+    sl->meta = sl->task.meta;
+    if (meta_fill(sl->fd, &sl->meta, wa) != 0) {
+        uring_slot_done(uw, i, wa);
+        return;
+    }
+    if (profile_on) sl->t[1] = now_ns();
+
+    if (sl->meta.size >= MG_MMAP_THRESHOLD) {
+        MgFileBuf fb;
+        if (mg_file_load(sl->fd, sl->meta.size, &wa->rbuf, &wa->rcap, &fb) == 0) {
+            uring_search(uw, i, &fb, wa);
+            mg_file_release(&fb);
+        }
+        uring_slot_done(uw, i, wa);
+        return;
+    }
+
+    // mg_file_load 와 같이 size + 1: 보통 read 1번에 EOF까지 확인
+    if (mg_buf_reserve(&sl->buf, &sl->cap, (size_t)sl->meta.size + 1) != 0) {
+        uring_slot_done(uw, i, wa);
+        return;
+    }
+    sl->len = 0;
+    sl->step = URING_READ;
+    uring_submit_read(uw, i);
+}
+
+static void uring_on_read(UringWorker *uw, unsigned i, int res, WorkerArg *wa) {
+    UringSlot *sl = &uw->slots[i];
+    if (res == -EINTR || res == -EAGAIN) {
+        uring_submit_read(uw, i);
+        return;
+    }
+    if (res < 0) {
+        uring_slot_done(uw, i, wa);
+        return;
+    }
+    sl->len += (size_t)res;
+
+    // 버퍼가 꽉 찼거나(파일이 커짐) 크기만큼 못 읽었거나 size가 0으로 보고되는 파일이면 더 읽기
+    int more = res > 0 &&
+               (sl->len == sl->cap || sl->len < (size_t)sl->meta.size || sl->meta.size == 0);
+    if (more) {
+        if (sl->len == sl->cap && mg_buf_reserve(&sl->buf, &sl->cap, sl->cap * 2) != 0) {
+            uring_slot_done(uw, i, wa);
+            return;
+        }
+        uring_submit_read(uw, i);
+        return;
+    }
+
+    MgFileBuf fb = { sl->buf, sl->len, 0 };
+    uring_search(uw, i, &fb, wa);
+    uring_slot_done(uw, i, wa);
+}
+
+// 디렉터리는 그 자리에서 탐색, 파일은 빈 slot에 open 제출
+static void uring_dispatch(UringWorker *uw, MgTask *task, WorkerArg *wa) {
+    if (task->kind == MG_TASK_DIR) {
+        long long t0 = (show_stats || profile_on) ? now_ns() : 0;
+        run_dir_task(task, wa);
+        if (show_stats) wa->stats.walk_ns += now_ns() - t0;
+        if (profile_on) prof_dir(wa->prof, task, t0, now_ns());
+        mg_path_release(task->blk);
+        uw->done++;
+        return;
+    }
+
+    if (task->kind == TASK_CHUNK) {
+        long long t0 = show_stats ? now_ns() : 0;
+        run_file_task(task, wa);
+        if (show_stats) wa->stats.match_ns += now_ns() - t0;
+        uw->done++;
+        return;
+    }
+
+    // -z: 압축 파일은 해제 프로그램의 파이프를 읽어야 하므로 동기 경로로
+    size_t len = search_zip ? path_build(task->blk, task->off, &wa->pbuf, &wa->pcap) : 0;
+    if (search_zip && zip_format(wa->pbuf, len)) {
+        long long t0 = show_stats ? now_ns() : 0;
+        run_file_task(task, wa);
+        if (show_stats) wa->stats.match_ns += now_ns() - t0;
+        mg_path_release(task->blk);
+        uw->done++;
+        return;
+    }
+
+    if (index_skip(task, wa)) {
+        if (sort_output) order_file_done(wa, task);
+        mg_path_release(task->blk);
+        uw->done++;
+        return;
+    }
+
+    unsigned i = uw->free_slots[--uw->nfree];
+    UringSlot *sl = &uw->slots[i];
+    sl->task = *task;
+    sl->step = URING_OPEN;
+    sl->fd = -1;
+    sl->t[0] = profile_on ? now_ns() : 0;
+    path_build(task->blk, task->off, &sl->path, &sl->path_cap);
+    struct io_uring_sqe *sqe = uring_prep(&uw->ring, IORING_OP_OPENAT, AT_FDCWD, sl->path, 0, 0, i);
+    sqe->open_flags = O_RDONLY;
+}
+
+static void uring_reap(UringWorker *uw, WorkerArg *wa) {
+    Uring *u = &uw->ring;
+    unsigned head = *u->cq_head;
+    unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+
+    while (head != tail) {
+        const struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+        unsigned i = (unsigned)cqe->user_data;
+        int res = cqe->res;
+        head++;
+
+        if (uw->slots[i].step == URING_OPEN) {
+            uring_on_open(uw, i, res, wa);
+        } else {
+            uring_on_read(uw, i, res, wa);
+        }
+    }
+    __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+}
+
+// 이 스레드에서 io_uring을 쓸 수 있는지 (main에서 시작 전에 1번 확인)
+static int uring_available(void) {
+    Uring u;
+    if (uring_init(&u, 1) != 0) return 0;
+    uring_destroy(&u);
+    return 1;
+}
+
+// io_uring 검색 worker 루프, ring을 못 만들면 -1 (호출자가 동기 루프로 대체)
+// 진행 중인 I/O가 있는 동안은 대기 없는 pop만 사용: 자기 작업이 끝나지 않은 채로
+// sched_next에서 잠들면 pending이 0이 될 수 없어서 종료 감지가 멈춤
+static int uring_worker(WorkerArg *wa) {
+    UringWorker uw;
+    uw.depth = (unsigned)io_uring_depth;
+    if (uring_init(&uw.ring, uw.depth) != 0) return -1;
+
+    uw.slots = (UringSlot*)xcalloc(uw.depth, sizeof(UringSlot));
+    uw.free_slots = (unsigned*)xcalloc(uw.depth, sizeof(unsigned));
+    for (unsigned i = 0; i < uw.depth; i++) {
+        uw.free_slots[i] = uw.depth - 1 - i;
+    }
+    uw.nfree = uw.depth;
+    uw.done = 0;
+
+    while (1) {
+        MgTask task;
+        while (uw.nfree > 0 && sched_try_next(wa, &task)) {
+            uring_dispatch(&uw, &task, wa);
+        }
+
+        if (uw.nfree == uw.depth) {
+            // 진행 중인 I/O 없음 -> 완료 처리 후 다음 작업을 기다림
+            sched_finish(wa, uw.done);
+            uw.done = 0;
+            long long tw = profile_on ? now_ns() : 0;
+            if (!sched_next(wa, &task, 0)) break;
+            if (profile_on) prof_wait(wa->prof, tw, now_ns());
+            uring_dispatch(&uw, &task, wa);
+            continue;
+        }
+
+        if (uring_submit_wait(&uw.ring, 1) != 0) {
+            perror("io_uring_enter");
+            exit(2);
+        }
+        uring_reap(&uw, wa);
+
+        sched_finish(wa, uw.done);
+        uw.done = 0;
+    }
+
+    for (unsigned i = 0; i < uw.depth; i++) {
+        free(uw.slots[i].buf);
+        free(uw.slots[i].path);
+    }
+    free(uw.slots);
+    free(uw.free_slots);
+    uring_destroy(&uw.ring);
+    return 0;
+}
+#endif
+
+// -------------------- CPU 배치 (--pin) --------------------
+// /sys/devices/system/node/nodeN/cpulist 로 NUMA 노드별 CPU를 읽어 (libnuma 없이)
+// affinity mask 안의 CPU만 남기고, worker를 노드마다 번갈아 한 CPU씩 배치
+// -> worker 수가 CPU보다 적어도 모든 노드의 메모리 대역폭을 씀
+#define MAX_NUMA_NODES 64
+
+typedef struct {
+    int ncpus;
+    int cpu[CPU_SETSIZE];      // 배치 순서 (worker i -> cpu[i % ncpus])
+    int node[CPU_SETSIZE];     // cpu[k] 의 노드 (0부터 다시 매긴 번호)
+    int nnodes;
+    cpu_set_t node_set[MAX_NUMA_NODES];   // 노드별 사용 가능 CPU (--pin=node)
+} CpuLayout;
+static CpuLayout cpu_layout;
+
+// "0-3,8-11" 형식을 set 에 더함
+static void parse_cpulist(const char *s, cpu_set_t *set) {
+    while (*s) {
+        char *end;
+        long lo = strtol(s, &end, 10);
+        if (end == s) break;
+        long hi = lo;
+        s = end;
+        if (*s == '-') {
+            hi = strtol(s + 1, &end, 10);
+            if (end == s + 1) break;
+            s = end;
+        }
+        for (long c = lo; c <= hi && c < CPU_SETSIZE; c++) {
+            if (c >= 0) CPU_SET((int)c, set);
+        }
+        if (*s != ',') break;
+        s++;
+    }
+}
+
+static int int_cmp(const void *a, const void *b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+static void cpu_layout_detect(void) {
+    CpuLayout *L = &cpu_layout;
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        for (long c = 0; c < (online > 0 ? online : 1) && c < CPU_SETSIZE; c++) CPU_SET((int)c, &allowed);
+    }
+
+    // 노드 번호 (readdir 순서는 정렬되어 있지 않고 번호가 비어 있을 수도 있음)
+    int ids[MAX_NUMA_NODES];
+    int nids = 0;
+    DIR *dir = opendir("/sys/devices/system/node");
+    if (dir) {
+        struct dirent *e;
+        while ((e = readdir(dir)) != NULL && nids < MAX_NUMA_NODES) {
+            if (strncmp(e->d_name, "node", 4) == 0 && isdigit((unsigned char)e->d_name[4])) {
+                ids[nids++] = atoi(e->d_name + 4);
+            }
+        }
+        closedir(dir);
+    }
+    qsort(ids, (size_t)nids, sizeof(int), int_cmp);
+
+    cpu_set_t seen;
+    CPU_ZERO(&seen);
+    L->nnodes = 0;
+    for (int i = 0; i < nids; i++) {
+        char path[96], list[4096];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", ids[i]);
+        FILE *fp = fopen(path, "r");
+        if (!fp) continue;
+        int ok = fgets(list, sizeof(list), fp) != NULL;
+        fclose(fp);
+        if (!ok) continue;
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        parse_cpulist(list, &set);
+        CPU_AND(&set, &set, &allowed);
+        if (CPU_COUNT(&set) == 0) continue;     // 메모리만 있는 노드 / 쓸 수 없는 노드
+        L->node_set[L->nnodes++] = set;
+        CPU_OR(&seen, &seen, &set);
+    }
+
+    // sysfs 에 노드 정보가 없거나 어느 노드에도 없는 CPU -> 노드 하나로 묶음
+    cpu_set_t rest;
+    CPU_XOR(&rest, &allowed, &seen);
+    if (CPU_COUNT(&rest) > 0) {
+        if (L->nnodes == 0) L->node_set[L->nnodes++] = rest;
+        else CPU_OR(&L->node_set[L->nnodes - 1], &L->node_set[L->nnodes - 1], &rest);
+    }
+
+    // 노드를 번갈아 한 CPU씩 (번호 순이라 SMT 형제보다 다른 물리 코어가 먼저 나옴)
+    int next[MAX_NUMA_NODES] = { 0 };
+    L->ncpus = 0;
+    for (int added = 1; added; ) {
+        added = 0;
+        for (int n = 0; n < L->nnodes; n++) {
+            int c = next[n];
+            while (c < CPU_SETSIZE && !CPU_ISSET(c, &L->node_set[n])) c++;
+            if (c >= CPU_SETSIZE) continue;
+            L->cpu[L->ncpus] = c;
+            L->node[L->ncpus] = n;
+            L->ncpus++;
+            next[n] = c + 1;
+            added = 1;
+        }
+    }
+}
+
+// worker i 의 자리 정하기 (sched_init 전에: steal 스케줄러가 노드별 훔칠 순서를 만듦)
+static void pin_plan(int nthreads) {
+    cpu_layout_detect();
+    numa_nodes = cpu_layout.nnodes;
+    worker_cpu = (int*)xmalloc(sizeof(int) * (size_t)nthreads);
+    worker_node = (int*)xmalloc(sizeof(int) * (size_t)nthreads);
+    for (int i = 0; i < nthreads; i++) {
+        int k = i % cpu_layout.ncpus;
+        worker_cpu[i] = cpu_layout.cpu[k];
+        worker_node[i] = cpu_layout.node[k];
+    }
+}
+
+static void print_pin_plan(int nthreads) {
+    printf("CPU 배치: worker %d개를 %s, NUMA 노드 %d개 (CPU %d개)\n", nthreads,
+           pin_mode == PIN_NODE ? "노드 단위로 고정" : "CPU 하나씩 고정", numa_nodes, cpu_layout.ncpus);
+}
+
+// -------------------- Worker --------------------
+// 파일 작업 하나 처리 (worker 루프와 sched_backpressure 공용)
+static void run_file_task(const MgTask *task, WorkerArg *wa) {
+    if (task->kind == TASK_CHUNK) {
+        split_work(task_split(task), wa);                               // 큰 파일 조각 (합치기는 opener)
+        return;
+    }
+    if (index_mode == INDEX_BUILD) {
+        index_add_file(task, wa);                                       // 인덱스 생성
+    } else if (!index_skip(task, wa)) {
+        search_in_file(task, wa);                                       // 검색
+    }
+    if (sort_output) order_file_done(wa, task);                         // 순서대로 출력
+}
+
+// --pin: 자기 자리에 고정한 뒤 worker별 버퍼를 만들어야 first-touch 로 그 노드의 메모리에 놓임
+// (rbuf / out 등은 처음 쓸 때 worker가 할당, deque 버퍼만 main이 만들어 둔 것을 바꿈)
+static void worker_place(WorkerArg *wa) {
+    if (!worker_cpu) return;
+    if (!wa->pinned) {
+        cpu_set_t set;
+        if (pin_mode == PIN_NODE) {
+            set = cpu_layout.node_set[worker_node[wa->index]];
+        } else {
+            CPU_ZERO(&set);
+            CPU_SET(worker_cpu[wa->index], &set);
+        }
+        int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (rc != 0 && wa->index == 0) {
+            fprintf(stderr, "경고: worker를 CPU에 고정하지 못했습니다: %s\n", strerror(rc));
+        }
+        wa->pinned = 1;
+    }
+    if (wa->s->kind == SCHED_STEAL) mg_pool_localize(&wa->s->pool, wa->index);
+}
+
+static void* worker_thread(void *arg) {
+    WorkerArg *wa = (WorkerArg*)arg;
+    worker_place(wa);
+
+#ifdef HAVE_IO_URING
+    // 파일을 읽는 검색 worker만 ring 사용 (탐색 전용 worker는 동기 readdir)
+    if (io_uring_depth > 0 && wa->role == MG_ROLE_MATCH && uring_worker(wa) == 0) {
+        mg_re_thread_cleanup();
+        return NULL;
+    }
+#endif
+
+    MgTask task;
+    int finished = 0;
+    long long tw = profile_on ? now_ns() : 0;      // --profile: 작업을 기다리기 시작한 시각
+
+    // 작업도 없고, pending도 0이면 sched_next가 0 반환 -> 종료
+    while (sched_next(wa, &task, finished)) {
+        long long t0 = (show_stats || profile_on) ? now_ns() : 0;
+        if (profile_on) prof_wait(wa->prof, tw, t0);
+
+        if (task.kind == MG_TASK_DIR) {
+            long long helped_ns = wa->stats.match_ns;
+            run_dir_task(&task, wa);                                    // 탐색 (자식 작업 push)
+            // 탐색 도중 backpressure 로 검색한 시간은 match 쪽에 이미 더해짐
+            if (show_stats) wa->stats.walk_ns += now_ns() - t0 - (wa->stats.match_ns - helped_ns);
+            if (profile_on) prof_dir(wa->prof, &task, t0, now_ns());
+        } else {
+            run_file_task(&task, wa);
+            if (show_stats) wa->stats.match_ns += now_ns() - t0;
+        }
+        mg_path_release(task.blk);
+        finished = 1;
+        if (profile_on) tw = now_ns();
+    }
+
+    mg_re_thread_cleanup();
+    return NULL;
+}
+
+// worker 인자 배열: 검색 worker [0, match_threads) + 탐색 전용 worker [match_threads, nthreads)
+static WorkerArg *worker_args_new(Scheduler *s, int nthreads, int match_threads) {
+    // WorkerStats가 cache line 정렬이라 aligned_alloc 사용
+    size_t size = ((sizeof(WorkerArg) * (size_t)nthreads + 63) / 64) * 64;
+    WorkerArg *args = (WorkerArg*)xaligned_alloc(64, size);
+    memset(args, 0, size);
+    for (int i = 0; i < nthreads; i++) {
+        args[i].s = s;
+        args[i].thread_id = i + 1;
+        args[i].index = i;
+        args[i].role = (i < match_threads) ? MG_ROLE_MATCH : MG_ROLE_WALK;
+        if (profile_on) args[i].prof = profile_new();
+    }
+    return args;
+}
+
+static void worker_args_free(WorkerArg *args, int nthreads) {
+    for (int i = 0; i < nthreads; i++) {
+        free(args[i].rbuf);
+        free(args[i].pbuf);
+        free(args[i].hbuf);
+        free(args[i].sents);
+        free(args[i].snames);
+        index_builder_free(&args[i].ib);
+        free(args[i].out.data);
+        free(args[i].opath.data);
+        profile_free(args[i].prof);
+    }
+    free(args);
+}
+
+// -------------------- 통계 출력 (--stats) --------------------
+static void stats_add(WorkerStats *dst, const WorkerStats *src) {
+    dst->files_scanned += src->files_scanned;
+    dst->files_matched += src->files_matched;
+    dst->dirs_scanned  += src->dirs_scanned;
+    dst->bytes_read    += src->bytes_read;
+    dst->lines_scanned += src->lines_scanned;
+    dst->stat_calls    += src->stat_calls;
+    dst->open_failures += src->open_failures;
+    dst->walk_ns       += src->walk_ns;
+    dst->match_ns      += src->match_ns;
+    dst->index_skipped += src->index_skipped;
+    dst->binary_skipped += src->binary_skipped;
+    dst->ignored       += src->ignored;
+    dst->bp_searched   += src->bp_searched;
+    dst->bp_waits      += src->bp_waits;
+    dst->zip_files     += src->zip_files;
+    dst->dirs_cached   += src->dirs_cached;
+    dst->dirs_dup      += src->dirs_dup;
+    dst->symlinks_skipped += src->symlinks_skipped;
+    dst->other_fs      += src->other_fs;
+    dst->lines_matched += src->lines_matched;
+    dst->matches       += src->matches;
+    dst->bytes_printed += src->bytes_printed;
+}
+
+// --json: 마지막 summary 이벤트 (ripgrep 과 같은 모양), searches = 검색한 파일(입력) 수
+static void print_json_summary(const WorkerStats *total, long long searches, long long elapsed_ns) {
+    OutBuf ob;
+    memset(&ob, 0, sizeof(ob));
+    ob_lit(&ob, "{\"data\":{\"elapsed_total\":");
+    ob_json_duration(&ob, elapsed_ns);
+    ob_printf(&ob, ",\"stats\":{\"bytes_printed\":%lld,\"bytes_searched\":%lld,\"elapsed\":",
+              total->bytes_printed, total->bytes_read);
+    ob_json_duration(&ob, elapsed_ns);
+    ob_printf(&ob, ",\"matched_lines\":%lld,\"matches\":%lld,\"searches\":%lld,\"searches_with_match\":%lld}},"
+              "\"type\":\"summary\"}\n",
+              total->lines_matched, total->matches, searches, total->files_matched);
+    write_all(STDOUT_FILENO, ob.data, ob.len);
+    free(ob.data);
+}
+
+static void print_stats_row(const char *name, const char *role, const WorkerStats *st) {
+    printf("%-8s %-5s %9lld %9lld %8lld %14lld %11lld %9lld %8lld %10.1f %10.1f\n",
+           name, role, st->dirs_scanned, st->files_scanned, st->files_matched,
+           st->bytes_read, st->lines_scanned, st->stat_calls, st->open_failures,
+           st->walk_ns / 1e6, st->match_ns / 1e6);
+}
+
+static void print_stats(const WorkerArg *args, int nthreads, const WorkerStats *total) {
+    // 한글은 터미널 폭이 달라 정렬이 깨지므로 열 이름은 영문 약어
+    // dirs: 디렉터리, files: 대상 파일, matched: 매칭 파일, openfail: 열기 실패
+    // walk/match: 탐색/검색에 쓴 시간
+    printf("\n[통계] 스레드별 (시간 단위: ms)\n");
+    printf("%-8s %-5s %9s %9s %8s %14s %11s %9s %8s %10s %10s\n",
+           "thread", "role", "dirs", "files", "matched", "bytes", "lines", "stat", "openfail",
+           "walk", "match");
+    for (int i = 0; i < nthreads; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "#%d", args[i].thread_id);
+        print_stats_row(name, args[i].role == MG_ROLE_WALK ? "walk" : "match", &args[i].stats);
+    }
+    print_stats_row("total", "", total);
+}
+
+// --profile / --trace: worker별 Profile 을 모아서 요약 출력 / trace 기록
+static void profile_report(const WorkerArg *args, int nthreads, long long t0) {
+    Profile **pfs = (Profile**)xmalloc(sizeof(Profile*) * (size_t)nthreads);
+    int *tids = (int*)xmalloc(sizeof(int) * (size_t)nthreads);
+    MgWorkerRole *roles = (MgWorkerRole*)xmalloc(sizeof(MgWorkerRole) * (size_t)nthreads);
+    for (int i = 0; i < nthreads; i++) {
+        pfs[i] = args[i].prof;
+        tids[i] = args[i].thread_id;
+        roles[i] = args[i].role;
+    }
+    if (profile_top > 0) print_profile(pfs, nthreads);
+    if (trace_path && trace_write(trace_path, pfs, tids, roles, nthreads, t0) != 0) {
+        fprintf(stderr, "에러: trace 파일을 쓸 수 없습니다: %s (%s)\n", trace_path, strerror(errno));
+    }
+    free(pfs);
+    free(tids);
+    free(roles);
+}
+
+// 검색 결과 요약 중 건너뛴 / 풀어서 검색한 파일 (일반 실행과 데몬 질의 공용)
+static void print_skip_summary(const WorkerStats *total) {
+    if (total->ignored > 0) {
+        printf("ignore 규칙으로 %lld개 항목 건너뜀\n", total->ignored);
+    }
+    if (total->binary_skipped > 0) {
+        printf("바이너리 %lld개 파일 건너뜀\n", total->binary_skipped);
+    }
+    if (total->zip_files > 0) {
+        printf("압축 파일 %lld개 풀어서 검색\n", total->zip_files);
+    }
+    if (total->dirs_dup > 0) {
+        printf("이미 검색한 디렉터리 %lld개 건너뜀 (symlink / bind mount 로 다시 만남)\n", total->dirs_dup);
+    }
+    if (total->symlinks_skipped > 0) {
+        printf("symlink %lld개 따라가지 않음 (--follow 로 따라감)\n", total->symlinks_skipped);
+    }
+    if (total->other_fs > 0) {
+        printf("다른 파일 시스템 %lld개 항목 건너뜀 (--one-file-system)\n", total->other_fs);
+    }
+}
+
+// -------------------- 패턴 목록 (-e / -f) --------------------
+typedef struct {
+    char **items;
+    size_t *lens;
+    int count;
+    int cap;
+} PatternList;
+
+static void patterns_add(PatternList *pl, const char *s, size_t n) {
+    if (pl->count == pl->cap) {
+        pl->cap = pl->cap ? pl->cap * 2 : 8;
+        pl->items = (char**)xrealloc(pl->items, (size_t)pl->cap * sizeof(char*));
+        pl->lens = (size_t*)xrealloc(pl->lens, (size_t)pl->cap * sizeof(size_t));
+    }
+    char *copy = (char*)xmalloc(n + 1);
+    memcpy(copy, s, n);
+    copy[n] = '\0';
+    pl->items[pl->count] = copy;
+    pl->lens[pl->count] = n;
+    pl->count++;
+}
+
+// 줄바꿈으로 나눠서 각 줄을 패턴 하나로 (grep -e / -f 와 같은 규칙)
+// 마지막 줄바꿈 뒤의 빈 조각은 패턴으로 치지 않음
+static void patterns_add_lines(PatternList *pl, const char *s, size_t n) {
+    const char *end = s + n;
+    while (s < end) {
+        const char *nl = (const char*)memchr(s, '\n', (size_t)(end - s));
+        const char *line_end = nl ? nl : end;
+        patterns_add(pl, s, (size_t)(line_end - s));
+        if (!nl) return;
+        s = nl + 1;
+    }
+}
+
+static int patterns_load_file(PatternList *pl, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    char *buf = NULL;
+    size_t cap = 0;
+    MgFileBuf fb;
+    int rc = mg_file_load(fd, 0, &buf, &cap, &fb);
+    close(fd);
+    if (rc == 0) {
+        patterns_add_lines(pl, fb.data, fb.len);
+    }
+    free(buf);
+    return rc;
+}
+
+static void patterns_free(PatternList *pl) {
+    for (int i = 0; i < pl->count; i++) {
+        free(pl->items[i]);
+    }
+    free(pl->items);
+    free(pl->lens);
+}
+
+// -E / -i / -w -> mg_matcher_init 의 flags (데몬은 질의마다 다시 만듦)
+static int match_flags(int extended) {
+    return (extended ? MG_EXTENDED : 0) | (ignore_case ? MG_IGNORE_CASE : 0) | (word_match ? MG_WORD : 0);
+}
+
+// mg_matcher_init 실패 메시지 (MG_ERR_NOMEM 이 아니면 정규식 오류)
+static void report_matcher_error(const char *err) {
+    if (strcmp(err, MG_ERR_NOMEM) == 0) fprintf(stderr, "에러: %s\n", err);
+    else fprintf(stderr, "에러: 잘못된 정규식: %s\n", err);
+}
+
+// -------------------- 출력 옵션 (-A / -B / -C, --json, --null, --color) --------------------
+// 문맥 줄: grep 과 같이 -A / -B 는 지정한 순서와 관계없이 -C 보다 우선
+typedef struct {
+    int after;             // -A (-1 = 지정 안 함)
+    int before;            // -B (-1 = 지정 안 함)
+    int both;              // -C
+} ContextOpts;
+
+static int context_parse(ContextOpts *co, int opt, const char *arg) {
+    char *endp;
+    errno = 0;
+    long v = strtol(arg, &endp, 10);
+    if (errno != 0 || endp == arg || *endp != '\0' || v < 0 || v > (1L << 30)) {
+        fprintf(stderr, "에러: 문맥 줄 수는 0~%ld 사이여야 합니다: %s\n", 1L << 30, arg);
+        return -1;
+    }
+    if (opt == 'A') co->after = (int)v;
+    else if (opt == 'B') co->before = (int)v;
+    else co->both = (int)v;
+    return 0;
+}
+
+static void context_apply(const ContextOpts *co) {
+    after_context = (size_t)(co->after >= 0 ? co->after : co->both);
+    before_context = (size_t)(co->before >= 0 ? co->before : co->both);
+}
+
+// --color=WHEN, 반환: 0 = never, 1 = always, 2 = auto, -1 = 잘못된 값
+static int color_parse(const char *arg) {
+    if (strcmp(arg, "never") == 0) return 0;
+    if (strcmp(arg, "always") == 0) return 1;
+    if (strcmp(arg, "auto") == 0) return 2;
+    fprintf(stderr, "에러: 알 수 없는 --color 값: %s (auto, always, never)\n", arg);
+    return -1;
+}
+
+// 출력 형식 검사 + 강조 여부 결정 (auto 는 지금의 stdout 기준 -> 데몬은 질의마다 클라이언트 stdout 으로)
+static int output_finish(int color) {
+    if (out_format == FMT_JSON && (output_mode == OUT_FILES || output_mode == OUT_COUNT)) {
+        fprintf(stderr, "에러: --json 은 -l / -c 와 함께 쓸 수 없습니다 (매칭 줄 이벤트만 출력)\n");
+        return -1;
+    }
+    use_color = out_format == FMT_TEXT && (color == 1 || (color == 2 && isatty(STDOUT_FILENO)));
+    return 0;
+}
+
+// -------------------- 데몬 모드 (--daemon / --connect) --------------------
+// IDE처럼 같은 트리를 계속 검색할 때 실행마다 드는 비용(스레드 생성, 전체 탐색, 메타데이터 읽기)을 없앰
+// - 서버 (--daemon=SOCKET 디렉터리): worker 스레드와 디렉터리 캐시를 띄워둔 채 Unix 소켓에서 질의를 받음
+//   질의마다 Scheduler 만 새로 만들고 캐시 노드 작업 1개를 넣어 쉬고 있던 worker들을 깨움
+// - 클라이언트 (--connect=SOCKET): 인자와 현재 디렉터리를 보내면서 자기 stdout/stderr fd 를 넘김 (SCM_RIGHTS)
+//   -> 데몬 worker가 결과를 클라이언트 stdout 에 바로 씀 (중계 복사 없음), 끝나면 종료 코드 1바이트
+// - 질의는 한 번에 하나 (검색 옵션 전역 변수와 캐시를 질의마다 다시 씀), 클라이언트가 끊기면 그 질의는 취소
+// - 질의에서는 검색 옵션과 [경로] [키워드]만, 탐색 옵션(--type/--include/--exclude/--gitignore/-z ...)과
+//   스레드 수는 데몬을 띄울 때 정함
+// - 소켓은 0600 으로 만들고 같은 uid 의 연결만 받음
+#define DAEMON_MAGIC    0x3151474du   // "MGQ1"
+#define DAEMON_REQ_MAX  (1 << 20)     // 요청 크기 상한
+
+typedef struct {
+    uint32_t magic;
+    uint32_t len;          // 뒤따르는 내용 길이: "현재 디렉터리\0인자1\0인자2\0..."
+} DaemonHeader;
+
+// 쉬고 있는 worker를 질의마다 깨우는 상태
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    unsigned gen;          // 질의 번호 (바뀌면 worker가 깨어나 worker_thread 실행)
+    int running;           // 아직 이번 질의를 처리 중인 worker 수
+    int quit;
+    int done_fd[2];        // 마지막 worker가 1바이트 씀 -> main 은 클라이언트 소켓과 함께 poll
+} dpool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0, 0, { -1, -1 } };
+
+typedef struct {
+    Scheduler sched;       // 질의마다 sched_init / sched_destroy (worker는 주소만 들고 있음)
+    SchedKind kind;
+    WorkerArg *args;
+    pthread_t *threads;
+    int nthreads;
+    DirCache *root;
+    MgTask root_task;      // 루트 노드를 가리키는 작업 (블록에는 루트 절대 경로)
+    char *root_path;
+    size_t root_len;
+} Daemon;
+
+static volatile sig_atomic_t daemon_quit = 0;
+
+static void daemon_on_signal(int sig) {
+    (void)sig;
+    daemon_quit = 1;
+}
+
+static void *daemon_worker(void *arg) {
+    unsigned seen = 0;
+    pthread_mutex_lock(&dpool.lock);
+    while (1) {
+        while (dpool.gen == seen && !dpool.quit) {
+            pthread_cond_wait(&dpool.cond, &dpool.lock);
+        }
+        if (dpool.quit) break;
+        seen = dpool.gen;
+        pthread_mutex_unlock(&dpool.lock);
+
+        worker_thread(arg);     // 이번 질의의 작업이 모두 끝나면 돌아옴
+
+        pthread_mutex_lock(&dpool.lock);
+        if (--dpool.running == 0) write_all(dpool.done_fd[1], "x", 1);
+    }
+    pthread_mutex_unlock(&dpool.lock);
+    return NULL;
+}
+
+static void daemon_reset_stats(Daemon *dm) {
+    for (int i = 0; i < dm->nthreads; i++) {
+        memset(&dm->args[i].stats, 0, sizeof(WorkerStats));
+        dm->args[i].local_done = 0;
+    }
+}
+
+// start 작업부터 검색 1번: worker들을 깨우고 끝날 때까지 대기, 그 사이 클라이언트가 끊기면 취소
+static void daemon_run(Daemon *dm, const MgTask *start, int client_fd) {
+    sched_init(&dm->sched, dm->kind, dm->nthreads);
+    atomic_store(&search_stopped, 0);
+    order_init();
+
+    MgTask t = *start;
+    t.seq = 0;                  // --sort=path: 가상 루트 노드의 0번 칸
+    path_data(t.blk)->ord = &order.root;
+    mg_path_retain(t.blk);
+    sched_push_batch(&dm->args[0], &t, 1);
+    fflush(stdout);             // worker는 write()로 직접 출력
+
+    pthread_mutex_lock(&dpool.lock);
+    dpool.running = dm->nthreads;
+    dpool.gen++;
+    pthread_cond_broadcast(&dpool.cond);
+    pthread_mutex_unlock(&dpool.lock);
+
+    // 클라이언트는 요청 뒤에 보내는 것이 없음 -> 읽을 것이 생기면 연결이 끊긴 것 (Ctrl-C 등)
+    struct pollfd pfd[2] = { { dpool.done_fd[0], POLLIN, 0 }, { client_fd, POLLIN, 0 } };
+    nfds_t nfds = client_fd >= 0 ? 2 : 1;
+    while (1) {
+        if (poll(pfd, nfds, -1) < 0) continue;      // EINTR: 종료 신호는 질의가 끝난 뒤에 처리
+        if (pfd[0].revents) break;
+        if (nfds == 2 && pfd[1].revents) {
+            if (!atomic_exchange(&search_stopped, 1)) sched_cancel(&dm->sched);
+            nfds = 1;
+        }
+    }
+    char c;
+    while (read(dpool.done_fd[0], &c, 1) < 0 && errno == EINTR) {}
+
+    sched_destroy(&dm->sched);
+    order_destroy();
+    split_free_all();
+}
+
+// 질의 경로 -> 그 디렉터리의 캐시 노드를 가리키는 작업 (데몬 디렉터리 아래만)
+// 상대 경로는 클라이언트의 현재 디렉터리 기준, 가는 길의 dirty 노드는 여기서 다시 읽음
+static int daemon_locate(Daemon *dm, const char *path, const char *cwd, MgTask *out) {
+    char *full;
+    if (path[0] == '/') {
+        full = realpath(path, NULL);
+    } else {
+        size_t n = strlen(cwd) + strlen(path) + 2;
+        char *joined = (char*)xmalloc(n);
+        snprintf(joined, n, "%s/%s", cwd, path);
+        full = realpath(joined, NULL);
+        free(joined);
+    }
+    if (!full) {
+        fprintf(stderr, "에러: '%s'를 찾을 수 없습니다.\n", path);
+        return -1;
+    }
+
+    size_t rl = dm->root_len;
+    int inside = strncmp(full, dm->root_path, rl) == 0 && (full[rl] == '\0' || full[rl] == '/' || rl == 1);
+    MgTask t = dm->root_task;
+    const char *p = full + rl;
+    while (inside && *p) {
+        while (*p == '/') p++;
+        if (!*p) break;
+        const char *slash = strchr(p, '/');
+        size_t n = slash ? (size_t)(slash - p) : strlen(p);
+
+        DirCache *d = task_cache(&t);
+        if (d->dirty) cache_refresh(d, &t, &dm->args[0]);
+
+        // 자식 작업은 이름 순 -> 이분 탐색
+        const MgTask *found = NULL;
+        uint32_t lo = 0, hi = d->nitems;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            const char *name = d->items[mid].blk->names + d->items[mid].off;
+            int cmp = strncmp(name, p, n);
+            if (cmp == 0) cmp = name[n] != '\0';
+            if (cmp == 0) {
+                found = &d->items[mid];
+                break;
+            }
+            if (cmp < 0) lo = mid + 1;
+            else hi = mid;
+        }
+        if (!found || found->kind != MG_TASK_DIR) inside = 0;
+        else t = *found;
+        p += n;
+    }
+    if (!inside) {
+        fprintf(stderr, "에러: 데몬이 캐시한 디렉터리가 아닙니다 (%s 아래의 제외되지 않은 디렉터리만): %s\n",
+                dm->root_path, path);
+        free(full);
+        return -1;
+    }
+    free(full);
+    *out = t;
+    return 0;
+}
+
+// 질의 하나: 출력은 클라이언트 stdout/stderr (이미 dup2 해둠), 종료 코드 반환
+static int daemon_query(Daemon *dm, int argc, char **argv, const char *cwd, int client_fd) {
+    // 검색 옵션은 질의마다 기본값에서 시작
+    ignore_case = 0;
+    word_match = 0;
+    binary_as_text = 0;
+    output_mode = OUT_LINES;
+    max_count = -1;
+    sort_output = 0;
+    show_stats = 0;
+    out_format = FMT_TEXT;
+    ContextOpts ctx = { -1, -1, 0 };
+    int color = 2;
+
+    static const struct option query_opts[] = {
+        {"regexp",       required_argument, NULL, 'e'},
+        {"extended-regexp", no_argument,    NULL, 'E'},
+        {"ignore-case",  no_argument,       NULL, 'i'},
+        {"word-regexp",  no_argument,       NULL, 'w'},
+        {"text",         no_argument,       NULL, 'a'},
+        {"files-with-matches", no_argument, NULL, 'l'},
+        {"count",        no_argument,       NULL, 'c'},
+        {"max-count",    required_argument, NULL, 'm'},
+        {"quiet",        no_argument,       NULL, 'q'},
+        {"after-context",  required_argument, NULL, 'A'},
+        {"before-context", required_argument, NULL, 'B'},
+        {"context",      required_argument, NULL, 'C'},
+        {"json",         no_argument,       NULL, 'J'},
+        {"null",         no_argument,       NULL, 'Z'},
+        {"color",        required_argument, NULL, 'R'},
+        {"sort",         required_argument, NULL, 'O'},
+        {"stats",        no_argument,       NULL, 's'},
+        {"connect",      required_argument, NULL, 'K'},     // 클라이언트 자신의 옵션
+        {NULL, 0, NULL, 0}
+    };
+
+    PatternList patterns = { NULL, NULL, 0, 0 };
+    int extended = 0;
+    int rc = 2;
+    int c;
+    optind = 0;                 // getopt 다시 초기화 (GNU)
+    while ((c = getopt_long(argc, argv, "e:Eiwalcm:qA:B:C:Z", query_opts, NULL)) != -1) {
+        switch (c) {
+        case 'e':
+            patterns_add_lines(&patterns, optarg, strlen(optarg));
+            if (optarg[0] == '\0') patterns_add(&patterns, "", 0);
+            break;
+        case 'E': extended = 1; break;
+        case 'i': ignore_case = 1; break;
+        case 'w': word_match = 1; break;
+        case 'a': binary_as_text = 1; break;
+        case 'l': output_mode = OUT_FILES; break;
+        case 'c': output_mode = OUT_COUNT; break;
+        case 'q': output_mode = OUT_QUIET; break;
+        case 's': show_stats = 1; break;
+        case 'K': break;
+        case 'J': out_format = FMT_JSON; break;
+        case 'Z': out_format = FMT_NULL; break;
+        case 'R':
+            if ((color = color_parse(optarg)) < 0) goto out;
+            break;
+        case 'A':
+        case 'B':
+        case 'C':
+            if (context_parse(&ctx, c, optarg) != 0) goto out;
+            break;
+        case 'm': {
+            char *endp;
+            errno = 0;
+            max_count = strtol(optarg, &endp, 10);
+            if (errno != 0 || endp == optarg || *endp != '\0' || max_count < 0) {
+                fprintf(stderr, "에러: 매칭 줄 수 상한은 0 이상이어야 합니다: %s\n", optarg);
+                goto out;
+            }
+            break;
+        }
+        case 'O':
+            if (strcmp(optarg, "path") == 0) {
+                sort_output = 1;
+            } else if (strcmp(optarg, "none") != 0) {
+                fprintf(stderr, "에러: 알 수 없는 정렬 방식: %s (path 또는 none)\n", optarg);
+                goto out;
+            }
+            break;
+        default:
+            fprintf(stderr, "에러: 데몬 질의에는 검색 옵션(-e -E -i -w -a -l -c -m -q -A -B -C -Z --json --color --sort --stats)만 쓸 수 있습니다.\n"
+                            "      탐색 옵션과 스레드 수는 --daemon 을 띄울 때 지정합니다.\n");
+            goto out;
+        }
+    }
+
+    // main 과 같은 규칙: -e 가 없으면 마지막 인자가 키워드, 경로를 빼면 데몬 디렉터리 전체
+    int need_args = patterns.count > 0 ? 1 : 2;
+    int nargs = argc - optind;
+    if (nargs != need_args && nargs != need_args - 1) {
+        fprintf(stderr, "사용법: %s --connect=SOCKET [검색 옵션] [경로] [키워드]\n", argv[0]);
+        goto out;
+    }
+    if (patterns.count == 0) patterns_add(&patterns, argv[argc - 1], strlen(argv[argc - 1]));
+    if (output_mode == OUT_QUIET) sort_output = 0;
+    context_apply(&ctx);
+    if (output_finish(color) != 0) goto out;
+
+    daemon_reset_stats(dm);
+    MgTask start = dm->root_task;
+    if (nargs == need_args && daemon_locate(dm, argv[optind], cwd, &start) != 0) goto out;
+
+    MgMatcher matcher;
+    memset(&matcher, 0, sizeof(matcher));
+    const char *re_err = NULL;
+    if (mg_matcher_init(&matcher, (const char *const *)patterns.items, patterns.lens, patterns.count,
+                     match_flags(extended), &re_err) != 0) {
+        report_matcher_error(re_err);
+        goto out;
+    }
+    for (int i = 0; i < dm->nthreads; i++) dm->args[i].m = &matcher;
+
+    int verbose = output_mode == OUT_LINES && out_format == FMT_TEXT;
+    if (verbose) {
+        char *label = NULL;
+        size_t cap = 0;
+        path_build(start.blk, start.off, &label, &cap);
+        printf("=== 멀티스레드 파일 검색기 (데몬) ===\n");
+        printf("검색 경로: %s\n", label);
+        printf("검색 키워드: ");
+        for (int i = 0; i < patterns.count; i++) {
+            printf("%s\"%s\"", i ? ", " : "", patterns.items[i]);
+        }
+        printf("\n");
+        if (ignore_case || word_match) {
+            printf("매칭 옵션:%s%s\n", ignore_case ? " 대소문자 무시" : "", word_match ? " 단어 단위" : "");
+        }
+        printf("\n");
+        free(label);
+    }
+
+    long long t0 = now_ns();
+    daemon_run(dm, &start, client_fd);
+    long long elapsed_ns = now_ns() - t0;
+    double elapsed = elapsed_ns / 1e9;
+
+    WorkerStats total;
+    memset(&total, 0, sizeof(total));
+    for (int i = 0; i < dm->nthreads; i++) {
+        stats_add(&total, &dm->args[i].stats);
+    }
+    if (out_format == FMT_JSON && output_mode == OUT_LINES) print_json_summary(&total, total.files_scanned, elapsed_ns);
+    if (verbose) {
+        printf("\n");
+        printf("========================================\n");
+        printf("검색 완료!\n");
+        printf("총 %lld개 파일 스캔, %lld개 파일에서 매칭\n", total.files_scanned, total.files_matched);
+        print_skip_summary(&total);
+        printf("디렉터리 캐시: %lld개 그대로, %lld개 다시 읽음\n", total.dirs_cached, total.dirs_scanned);
+        printf("소요 시간: %.3f초\n", elapsed);
+        printf("========================================\n");
+    }
+    if (show_stats) print_stats(dm->args, dm->nthreads, &total);
+
+    mg_matcher_free(&matcher);
+    rc = exit_code(total.files_matched > 0, total.open_failures > 0);
+out:
+    patterns_free(&patterns);
+    return rc;
+}
+
+// 연결 하나: 요청과 fd 받기 -> stdout/stderr 를 클라이언트 것으로 바꿔서 질의 -> 종료 코드 보내기
+static void daemon_handle(Daemon *dm, int cfd, int saved_out, int saved_err) {
+    struct ucred cred;
+    socklen_t cred_len = sizeof(cred);
+    if (getsockopt(cfd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) != 0 || cred.uid != geteuid()) return;
+    struct timeval tv = { 5, 0 };   // 요청을 보내지 않는 클라이언트가 데몬을 붙잡지 않도록
+    setsockopt(cfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    DaemonHeader h;
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(2 * sizeof(int))];
+    } ctl;
+    struct iovec iov = { &h, sizeof(h) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctl.buf;
+    msg.msg_controllen = sizeof(ctl.buf);
+
+    int fds[2] = { -1, -1 };
+    ssize_t r = recvmsg(cfd, &msg, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+        if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS &&
+            cm->cmsg_len == CMSG_LEN(sizeof(fds))) {
+            memcpy(fds, CMSG_DATA(cm), sizeof(fds));
+        }
+    }
+
+    char *req = NULL;
+    char **argv = NULL;
+    if (r != (ssize_t)sizeof(h) || h.magic != DAEMON_MAGIC || h.len == 0 || h.len > DAEMON_REQ_MAX ||
+        fds[0] < 0 || fds[1] < 0) {
+        goto out;
+    }
+    req = (char*)xmalloc(h.len);
+    if (recv(cfd, req, h.len, MSG_WAITALL) != (ssize_t)h.len || req[h.len - 1] != '\0') goto out;
+
+    // 인자 배열: argv[0] 은 getopt 메시지용 이름, 첫 문자열은 현재 디렉터리
+    int argc = 0;
+    for (uint32_t i = 0; i < h.len; i++) argc += req[i] == '\0';
+    argv = (char**)xmalloc(((size_t)argc + 1) * sizeof(char*));
+    const char *cwd = req;
+    argv[0] = (char*)"mini-grep";
+    char *p = req + strlen(req) + 1;
+    for (int i = 1; i < argc; i++) {
+        argv[i] = p;
+        p += strlen(p) + 1;
+    }
+    argv[argc] = NULL;
+
+    dup2(fds[0], STDOUT_FILENO);
+    dup2(fds[1], STDERR_FILENO);
+    unsigned char rc = (unsigned char)daemon_query(dm, argc, argv, cwd, cfd);
+    fflush(stdout);
+    dup2(saved_out, STDOUT_FILENO);
+    dup2(saved_err, STDERR_FILENO);
+    send(cfd, &rc, 1, MSG_NOSIGNAL);
+
+out:
+    if (fds[0] >= 0) close(fds[0]);
+    if (fds[1] >= 0) close(fds[1]);
+    free(argv);
+    free(req);
+}
+
+// 소켓 만들기: 남은 소켓 파일은 살아 있는 데몬이 아닐 때만 지움, 권한 0600
+static int daemon_listen(const char *sock_path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(sock_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "에러: 소켓 경로가 너무 깁니다: %s\n", sock_path);
+        return -1;
+    }
+    strcpy(addr.sun_path, sock_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    mode_t old_mask = umask(077);
+    int rc = bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+    if (rc != 0 && errno == EADDRINUSE) {
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int alive = probe >= 0 && connect(probe, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+        if (probe >= 0) close(probe);
+        if (alive) {
+            umask(old_mask);
+            fprintf(stderr, "에러: 이미 데몬이 실행 중입니다: %s\n", sock_path);
+            close(fd);
+            return -1;
+        }
+        unlink(sock_path);
+        rc = bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+    }
+    umask(old_mask);
+    if (rc != 0 || listen(fd, 64) != 0) {
+        fprintf(stderr, "에러: 소켓을 열 수 없습니다: %s (%s)\n", sock_path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int daemon_serve(const char *sock_path, const char *root, SchedKind kind,
+                        int match_threads, int walk_threads) {
+    struct stat st;
+    char *root_path = realpath(root, NULL);
+    if (!root_path || stat(root_path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        fprintf(stderr, "에러: 데몬은 디렉터리만 검색합니다: %s\n", root);
+        free(root_path);
+        return 2;
+    }
+    walk_opts.root_dev = st.st_dev;
+    mg_visit_init(&visited);
+    int lfd = daemon_listen(sock_path);
+    if (lfd < 0) {
+        free(root_path);
+        return 2;
+    }
+#ifdef HAVE_INOTIFY
+    dcache.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+    if (dcache.fd < 0) {
+        fprintf(stderr, "경고: inotify 를 쓸 수 없어 디렉터리를 질의마다 다시 읽습니다.\n");
+    }
+    if (pipe2(dpool.done_fd, O_CLOEXEC) != 0) {
+        perror("pipe2");
+        exit(2);
+    }
+
+    Daemon dm;
+    memset(&dm, 0, sizeof(dm));
+    dm.kind = kind;
+    dm.nthreads = match_threads + walk_threads;
+    dm.root_path = root_path;
+    dm.root_len = strlen(root_path);
+    split_helpers = match_threads - 1;
+    dm.args = worker_args_new(&dm.sched, dm.nthreads, match_threads);
+    dm.threads = (pthread_t*)xcalloc((size_t)dm.nthreads, sizeof(pthread_t));
+
+    // 루트: 절대 경로 하나를 담은 블록 (출력 경로는 절대 경로)
+    dm.root = cache_node_new(NULL);
+    dm.root_task.blk = path_block_new(NULL, 0, NULL, NULL, dm.root_len + 1, 0);
+    dm.root_task.off = mg_path_block_put(dm.root_task.blk, root_path, dm.root_len);
+    dm.root_task.seq = 0;
+    dm.root_task.kind = MG_TASK_DIR;
+    dm.root_task.data = dm.root;
+
+    for (int i = 0; i < dm.nthreads; i++) {
+        if (pthread_create(&dm.threads[i], NULL, daemon_worker, &dm.args[i]) != 0) {
+            perror("pthread_create");
+            exit(2);
+        }
+    }
+
+    printf("=== 멀티스레드 파일 검색기 (데몬) ===\n");
+    printf("검색 경로: %s\n", root_path);
+    printf("소켓: %s\n", sock_path);
+    if (walk_threads > 0) {
+        printf("스레드 개수: %d (검색) + %d (탐색 전용)\n", match_threads, walk_threads);
+    } else {
+        printf("스레드 개수: %d\n", match_threads);
+    }
+    if (worker_cpu) print_pin_plan(dm.nthreads);
+
+    // 처음 한 번은 트리 전체를 읽어서 캐시를 채움 (파일 작업은 만들지 않음)
+    daemon_reset_stats(&dm);
+    daemon_warmup = 1;
+    long long t0 = now_ns();
+    daemon_run(&dm, &dm.root_task, -1);
+    daemon_warmup = 0;
+    WorkerStats total;
+    memset(&total, 0, sizeof(total));
+    for (int i = 0; i < dm.nthreads; i++) {
+        stats_add(&total, &dm.args[i].stats);
+    }
+    printf("디렉터리 %lld개, 대상 파일 %lld개 캐시 (%.3f초), 질의 대기 중\n",
+           total.dirs_scanned, total.files_scanned, (now_ns() - t0) / 1e9);
+    fflush(stdout);
+
+    // 클라이언트가 먼저 끊으면 그 stdout 쓰기가 EPIPE 로 끝나도록
+    signal(SIGPIPE, SIG_IGN);
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = daemon_on_signal;   // SA_RESTART 없음 -> accept 가 EINTR 로 돌아옴
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    int saved_out = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 3);
+    int saved_err = fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, 3);
+    while (!daemon_quit) {
+        int cfd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+        if (cfd < 0) continue;      // EINTR (종료 신호) 등
+        cache_drain(dm.root);
+        daemon_handle(&dm, cfd, saved_out, saved_err);
+        close(cfd);
+    }
+
+    pthread_mutex_lock(&dpool.lock);
+    dpool.quit = 1;
+    pthread_cond_broadcast(&dpool.cond);
+    pthread_mutex_unlock(&dpool.lock);
+    for (int i = 0; i < dm.nthreads; i++) {
+        pthread_join(dm.threads[i], NULL);
+    }
+    printf("데몬 종료: %s\n", sock_path);
+
+    close(lfd);
+    unlink(sock_path);
+    close(saved_out);
+    close(saved_err);
+    close(dpool.done_fd[0]);
+    close(dpool.done_fd[1]);
+    cache_free(dm.root);
+    mg_visit_free(&visited);
+    mg_path_release(dm.root_task.blk);
+    if (dcache.fd >= 0) close(dcache.fd);
+    free(dcache.by_wd);
+    worker_args_free(dm.args, dm.nthreads);
+    free(dm.threads);
+    free(root_path);
+    return 0;
+}
+
+// 클라이언트: 요청을 보내고 종료 코드만 기다림 (결과는 데몬이 이 프로세스의 stdout 에 직접 씀)
+static int daemon_connect(const char *sock_path, int argc, char **argv) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(sock_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "에러: 소켓 경로가 너무 깁니다: %s\n", sock_path);
+        return 2;
+    }
+    strcpy(addr.sun_path, sock_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "에러: 데몬에 연결할 수 없습니다: %s (%s)\n", sock_path, strerror(errno));
+        if (fd >= 0) close(fd);
+        return 2;
+    }
+
+    // 요청 내용: 현재 디렉터리 (상대 경로 해석용) + 인자 전부
+    char *cwd = getcwd(NULL, 0);
+    if (!cwd) {
+        perror("getcwd");
+        close(fd);
+        return 2;
+    }
+    size_t len = strlen(cwd) + 1;
+    for (int i = 1; i < argc; i++) len += strlen(argv[i]) + 1;
+    if (len > DAEMON_REQ_MAX) {
+        fprintf(stderr, "에러: 질의가 너무 깁니다 (%zu바이트, 상한 %d)\n", len, DAEMON_REQ_MAX);
+        free(cwd);
+        close(fd);
+        return 2;
+    }
+    char *req = (char*)xmalloc(len);
+    size_t at = strlen(cwd) + 1;
+    memcpy(req, cwd, at);
+    for (int i = 1; i < argc; i++) {
+        size_t n = strlen(argv[i]) + 1;
+        memcpy(req + at, argv[i], n);
+        at += n;
+    }
+    free(cwd);
+
+    // 헤더와 함께 stdout / stderr fd 를 넘김
+    DaemonHeader h = { DAEMON_MAGIC, (uint32_t)len };
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(2 * sizeof(int))];
+    } ctl;
+    memset(&ctl, 0, sizeof(ctl));
+    struct iovec iov = { &h, sizeof(h) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctl.buf;
+    msg.msg_controllen = sizeof(ctl.buf);
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(2 * sizeof(int));
+    int fds[2] = { STDOUT_FILENO, STDERR_FILENO };
+    memcpy(CMSG_DATA(cm), fds, sizeof(fds));
+
+    unsigned char rc = 2;
+    ssize_t r = -1;
+    if (sendmsg(fd, &msg, MSG_NOSIGNAL) == (ssize_t)sizeof(h) &&
+        send(fd, req, len, MSG_NOSIGNAL) == (ssize_t)len) {
+        while ((r = read(fd, &rc, 1)) < 0 && errno == EINTR) {}
+    }
+    free(req);
+    close(fd);
+    if (r != 1) {
+        fprintf(stderr, "에러: 데몬이 응답 없이 연결을 끊었습니다: %s\n", sock_path);
+        return 2;
+    }
+    return rc;
+}
+
+// -------------------- main --------------------
+static int parse_count(const char *s, int min, int max, int *out) {
+    char *endp;
+    long v = strtol(s, &endp, 10);
+    if (*s == '\0' || *endp != '\0' || v < min || v > max) return -1;
+    *out = (int)v;
+    return 0;
+}
+
+static void print_usage(const char *prog) {
+    printf("사용법: %s [옵션] [경로] [키워드]\n", prog);
+    printf("        %s [옵션] -e 패턴 [-e 패턴 ...] [경로]\n", prog);
+    printf("        %s --index [경로]\n", prog);
+    printf("        %s --daemon=SOCKET [탐색 옵션] 디렉터리\n", prog);
+    printf("        %s --connect=SOCKET [검색 옵션] [경로] [키워드]\n", prog);
+    printf("예시: %s /home/pi/project \"TODO\"\n", prog);
+    printf("      %s -e TODO -e FIXME -e XXX /home/pi/project\n", prog);
+    printf("      zcat app.log.gz | %s ERROR          (경로가 없거나 '-' 이면 표준 입력)\n", prog);
+    printf("\n[경로]가 일반 파일이면 그 파일만, 파이프/FIFO/표준 입력은 줄 단위로 바로 출력 (헤더 없이 줄 번호: 줄)\n");
+    printf("\n옵션:\n");
+    printf("  -e, --regexp=패턴        검색할 패턴 (여러 번 지정 가능, 한 번에 모두 검색)\n");
+    printf("  -f, --file=파일          파일에서 패턴 읽기 (한 줄에 하나)\n");
+    printf("  -E, --extended-regexp    패턴을 확장 정규식(ERE, grep -E)으로 해석 (DFA, 역참조/\\b 미지원)\n");
+    printf("  -i, --ignore-case        대소문자 무시 (ASCII, 라틴/그리스/키릴 문자의 UTF-8 대소문자 포함)\n");
+    printf("  -w, --word-regexp        앞뒤가 단어 문자(영숫자, '_', 비ASCII)가 아닌 매칭만 인정\n");
+    printf("  -a, --text               바이너리 파일(앞 8KB에 NUL 포함)도 텍스트로 검색 (기본: 건너뜀)\n");
+    printf("  -z, --search-zip         압축 파일(.gz .zst .lz4 .xz .bz2)을 풀면서 검색 (디스크에 풀지 않음)\n");
+    printf("                           gzip/zstd/lz4/xz/bzip2 프로그램 사용, 확장자 필터는 압축 확장자를 뗀 이름에 적용\n");
+    printf("      --all-files          확장자(.c .h .txt .py .md)와 관계없이 모든 일반 파일 검색\n");
+    printf("  -t, --type=NAME          파일 종류로 고르기 (cpp, rust, go, ...), 여러 번 지정 가능\n");
+    printf("      --type-list          --type 이름과 확장자 목록 출력\n");
+    printf("      --include=GLOB       이름이 GLOB과 맞는 파일도 검색 (--type/--include 를 쓰면 기본 확장자 목록 대신)\n");
+    printf("      --exclude=GLOB       이름이 GLOB과 맞는 파일/디렉터리 제외, '/' 로 끝나면 디렉터리만 (예: build/)\n");
+    printf("                           제외된 디렉터리는 아래로 내려가지 않음\n");
+    printf("  -l, --files-with-matches 매칭된 파일 경로만 출력 (파일마다 첫 매칭에서 멈춤)\n");
+    printf("  -c, --count              파일별 매칭 줄 수 출력 (경로:개수)\n");
+    printf("  -m, --max-count=N        파일마다 N줄 매칭되면 그 파일은 그만 읽음\n");
+    printf("  -q, --quiet              출력 없이 종료 코드로만 알림, 첫 매칭에서 전체 검색 중단\n");
+    printf("                           (종료 코드: 매칭 있음 0, 없음 1, 사용법 / 입출력 오류 2)\n");
+    printf("  -A, --after-context=N    매칭 줄 뒤의 N줄도 출력 (줄 번호 뒤 '-', 떨어진 묶음 사이에 \"--\")\n");
+    printf("  -B, --before-context=N   매칭 줄 앞의 N줄도 출력\n");
+    printf("  -C, --context=N          -A N -B N 과 같음 (-A / -B 가 우선), 문맥을 쓰면 --split-size 로 나누지 않음\n");
+    printf("      --json               ripgrep --json 과 같은 JSON Lines 출력 (begin/match/context/end/summary, -l / -c 와는 불가)\n");
+    printf("  -Z, --null               grep -Z 처럼 경로 뒤에 NUL: \"경로\\0줄 번호:줄\", -l 은 \"경로\\0\", -c 는 \"경로\\0개수\"\n");
+    printf("      --color=WHEN         키워드 강조 auto|always|never (기본 auto: stdout 이 터미널일 때만)\n");
+    printf("      --sort=path|none     path: 실행할 때마다 같은 순서(디렉터리별 이름 순, 깊이 우선)로 출력 (기본: none)\n");
+    printf("                           검색은 그대로 병렬, 앞선 결과를 기다리는 동안 뒤 결과는 버퍼에 모아둠\n");
+    printf("      --gitignore          디렉터리마다 .gitignore / .ignore 규칙을 적용 (하위 디렉터리로 상속), .git 은 건너뜀\n");
+    printf("      --follow             탐색 중 만난 symlink 도 따라감 (기본: [경로]만 따라가고 안의 symlink 는 건너뜀)\n");
+    printf("                           같은 디렉터리(st_dev, st_ino)는 한 번만 검색 -> symlink 고리 / bind mount 중복 없음\n");
+    printf("      --one-file-system    [경로]와 다른 파일 시스템(NFS 등 마운트)으로 내려가지 않음\n");
+    printf("      --io-uring[=N]       io_uring으로 open/read를 worker당 N개씩 한꺼번에 제출 (기본 N: 32, Linux 5.6+)\n");
+    printf("                           캐시가 비어 있거나 네트워크 디스크처럼 I/O 대기가 긴 경우 효과적\n");
+    printf("      --index              검색 대신 [경로]의 trigram 인덱스 생성 (있으면 바뀐 파일만 갱신)\n");
+    printf("      --use-index          인덱스로 후보 파일만 골라서 검색 (인덱스 이후 바뀐/새 파일은 그냥 검색)\n");
+    printf("      --index-file=FILE    인덱스 파일 위치 (기본: [경로]/%s)\n", INDEX_DEFAULT_NAME);
+    printf("      --stats              스레드별 통계 출력 (디렉터리/파일/바이트/줄/stat/열기 실패, 탐색/검색 시간)\n");
+    printf("      --profile[=N]        파일별 open/read/match, 디렉터리 탐색, 작업 대기 시간의 p50/p99/max 와\n");
+    printf("                           가장 느린 파일/디렉터리 N개 (기본 N: %d) 를 stderr 에 출력\n", PROF_TOP_DEFAULT);
+    printf("      --trace=FILE         같은 구간을 Chrome trace JSON 으로 기록 (chrome://tracing, Perfetto 에서 열기)\n");
+    printf("  -j, --threads=N          검색 worker 수 (기본: 사용 가능한 CPU 수, cgroup quota 반영)\n");
+    printf("      --walk-threads=M     탐색(디렉터리) 전용 worker 수 (기본: 0 = 검색 worker가 탐색도 수행)\n");
+    printf("                           느린 저장소/NFS처럼 메타데이터 대기가 긴 경우 늘리면 효과적\n");
+    printf("      --queue-limit=N      쌓아둘 파일 작업 수 상한 (기본: %d, 0 = 무제한)\n", QUEUE_LIMIT_DEFAULT);
+    printf("                           넘으면 탐색하던 검색 worker는 쌓인 파일을 직접 검색, 탐색 전용 worker는 대기\n");
+    printf("      --split-size=MB      이 크기 이상인 파일은 줄 경계로 나눠 검색 worker들이 같이 검색 (기본: %d, 0 = 끔)\n",
+           SPLIT_MIN_DEFAULT_MB);
+    printf("      --daemon=SOCKET      worker 스레드와 디렉터리 캐시를 띄워둔 채 Unix 소켓 SOCKET 에서 질의를 받음\n");
+    printf("                           inotify 로 바뀐 디렉터리만 다시 읽음, 탐색 옵션과 스레드 수는 여기서 지정\n");
+    printf("      --connect=SOCKET     데몬에 질의 (검색 옵션 -e -E -i -w -a -l -c -m -q -A -B -C -Z --json --color --sort --stats 만)\n");
+    printf("                           [경로]는 데몬 디렉터리 아래만, 출력 경로는 절대 경로\n");
+    printf("  --scheduler=queue|steal  작업 분배 방식 (기본: queue)\n");
+    printf("                           queue: 전역 Queue 1개, steal: worker별 deque + work stealing\n");
+    printf("      --pin[=core|node]    worker를 CPU에 고정 (core: CPU 하나씩, node: 자기 NUMA 노드의 CPU 전체에)\n");
+    printf("                           노드를 번갈아 배치, 훔치기는 같은 노드 먼저 (노드가 여럿이면 기본 스케줄러 steal)\n");
+}
+
+int main(int argc, char *argv[]) {
+    SchedKind sched_kind = SCHED_QUEUE;
+    int sched_explicit = 0;
+    int cpu_count = mg_detect_cpu_count();
+    int match_threads = cpu_count;
+    int walk_threads = 0;
+    PatternList patterns = { NULL, NULL, 0, 0 };
+    int extended = 0;
+    const char *index_file = NULL;
+    const char *daemon_path = NULL;
+    const char *connect_path = NULL;
+    ContextOpts ctx = { -1, -1, 0 };
+    int color = 2;
+
+    static const struct option long_opts[] = {
+        {"regexp",       required_argument, NULL, 'e'},
+        {"file",         required_argument, NULL, 'f'},
+        {"extended-regexp", no_argument,    NULL, 'E'},
+        {"threads",      required_argument, NULL, 'j'},
+        {"walk-threads", required_argument, NULL, 'W'},
+        {"scheduler",    required_argument, NULL, 'S'},
+        {"pin",          optional_argument, NULL, 'N'},
+        {"stats",        no_argument,       NULL, 's'},
+        {"profile",      optional_argument, NULL, 'Y'},
+        {"trace",        required_argument, NULL, 'V'},
+        {"io-uring",     optional_argument, NULL, 'U'},
+        {"text",         no_argument,       NULL, 'a'},
+        {"all-files",    no_argument,       NULL, 'F'},
+        {"type",         required_argument, NULL, 't'},
+        {"type-list",    no_argument,       NULL, 'T'},
+        {"ignore-case",  no_argument,       NULL, 'i'},
+        {"word-regexp",  no_argument,       NULL, 'w'},
+        {"include",      required_argument, NULL, 'n'},
+        {"exclude",      required_argument, NULL, 'x'},
+        {"gitignore",    no_argument,       NULL, 'G'},
+        {"follow",       no_argument,       NULL, 'H'},
+        {"one-file-system", no_argument,    NULL, 'y'},
+        {"files-with-matches", no_argument, NULL, 'l'},
+        {"count",        no_argument,       NULL, 'c'},
+        {"max-count",    required_argument, NULL, 'm'},
+        {"quiet",        no_argument,       NULL, 'q'},
+        {"after-context",  required_argument, NULL, 'A'},
+        {"before-context", required_argument, NULL, 'B'},
+        {"context",      required_argument, NULL, 'C'},
+        {"json",         no_argument,       NULL, 'J'},
+        {"null",         no_argument,       NULL, 'Z'},
+        {"color",        required_argument, NULL, 'R'},
+        {"sort",         required_argument, NULL, 'O'},
+        {"queue-limit",  required_argument, NULL, 'L'},
+        {"split-size",   required_argument, NULL, 'P'},
+        {"search-zip",   no_argument,       NULL, 'z'},
+        {"index",        no_argument,       NULL, 'I'},
+        {"use-index",    no_argument,       NULL, 'Q'},
+        {"index-file",   required_argument, NULL, 'X'},
+        {"daemon",       required_argument, NULL, 'D'},
+        {"connect",      required_argument, NULL, 'K'},
+        {"help",         no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "e:f:Eiwazt:j:lcm:qA:B:C:Zh", long_opts, NULL)) != -1) {
+        switch (c) {
+        case 'e':
+            patterns_add_lines(&patterns, optarg, strlen(optarg));
+            if (optarg[0] == '\0') patterns_add(&patterns, "", 0);
+            break;
+        case 'f':
+            if (patterns_load_file(&patterns, optarg) != 0) {
+                fprintf(stderr, "에러: 패턴 파일을 읽을 수 없습니다: %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'E':
+            extended = 1;
+            break;
+        case 'i':
+            ignore_case = 1;
+            break;
+        case 'w':
+            word_match = 1;
+            break;
+        case 'j':
+            if (parse_count(optarg, 1, MAX_THREADS, &match_threads) != 0) {
+                fprintf(stderr, "에러: 스레드 개수는 1~%d 사이여야 합니다: %s\n", MAX_THREADS, optarg);
+                return 2;
+            }
+            break;
+        case 'W':
+            if (parse_count(optarg, 0, MAX_THREADS, &walk_threads) != 0) {
+                fprintf(stderr, "에러: 탐색 스레드 개수는 0~%d 사이여야 합니다: %s\n", MAX_THREADS, optarg);
+                return 2;
+            }
+            break;
+        case 'S':
+            if (strcmp(optarg, "queue") == 0) {
+                sched_kind = SCHED_QUEUE;
+            } else if (strcmp(optarg, "steal") == 0) {
+                sched_kind = SCHED_STEAL;
+            } else {
+                fprintf(stderr, "에러: 알 수 없는 스케줄러: %s\n", optarg);
+                return 2;
+            }
+            sched_explicit = 1;
+            break;
+        case 'N':
+            if (!optarg || strcmp(optarg, "core") == 0) {
+                pin_mode = PIN_CORE;
+            } else if (strcmp(optarg, "node") == 0) {
+                pin_mode = PIN_NODE;
+            } else if (strcmp(optarg, "none") == 0) {
+                pin_mode = PIN_OFF;
+            } else {
+                fprintf(stderr, "에러: --pin 은 core|node|none 중 하나입니다: %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 's':
+            show_stats = 1;
+            break;
+        case 'Y':
+            profile_top = PROF_TOP_DEFAULT;
+            if (optarg && parse_count(optarg, 1, 100000, &profile_top) != 0) {
+                fprintf(stderr, "에러: --profile 의 목록 개수는 1~100000 사이여야 합니다: %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'V':
+            trace_path = optarg;
+            break;
+        case 'U':
+#ifdef HAVE_IO_URING
+            io_uring_depth = URING_DEFAULT_DEPTH;
+            if (optarg && parse_count(optarg, 1, URING_MAX_DEPTH, &io_uring_depth) != 0) {
+                fprintf(stderr, "에러: io_uring 요청 수는 1~%d 사이여야 합니다: %s\n", URING_MAX_DEPTH, optarg);
+                return 2;
+            }
+#else
+            fprintf(stderr, "경고: io_uring 미지원 빌드, 동기 I/O를 사용합니다.\n");
+#endif
+            break;
+        case 'a':
+            binary_as_text = 1;
+            break;
+        case 'z':
+            search_zip = 1;
+            break;
+        case 'H':
+            walk_opts.follow = 1;
+            break;
+        case 'y':
+            walk_opts.one_fs = 1;
+            break;
+        case 'F':
+            all_files = 1;
+            break;
+        case 't':
+            if (mg_filter_add_type(&file_filter, optarg) != 0) {
+                if (errno == ENOMEM) die_nomem("malloc");
+                fprintf(stderr, "에러: 알 수 없는 파일 종류: %s (--type-list 로 목록 확인)\n", optarg);
+                return 2;
+            }
+            break;
+        case 'T':
+            print_type_list();
+            return 0;
+        case 'n':
+            if (mg_filter_add_include(&file_filter, optarg) != 0) die_nomem("malloc");
+            break;
+        case 'x':
+            if (mg_filter_add_exclude(&file_filter, optarg) != 0) die_nomem("realloc");
+            break;
+        case 'G':
+            use_ignore_files = 1;
+            break;
+        case 'l':
+            output_mode = OUT_FILES;
+            break;
+        case 'c':
+            output_mode = OUT_COUNT;
+            break;
+        case 'm': {
+            char *endp;
+            errno = 0;
+            max_count = strtol(optarg, &endp, 10);
+            if (errno != 0 || endp == optarg || *endp != '\0' || max_count < 0) {
+                fprintf(stderr, "에러: 매칭 줄 수 상한은 0 이상이어야 합니다: %s\n", optarg);
+                return 2;
+            }
+            break;
+        }
+        case 'q':
+            output_mode = OUT_QUIET;
+            break;
+        case 'A':
+        case 'B':
+        case 'C':
+            if (context_parse(&ctx, c, optarg) != 0) return 2;
+            break;
+        case 'J':
+            out_format = FMT_JSON;
+            break;
+        case 'Z':
+            out_format = FMT_NULL;
+            break;
+        case 'R':
+            if ((color = color_parse(optarg)) < 0) return 2;
+            break;
+        case 'O':
+            if (strcmp(optarg, "path") == 0) {
+                sort_output = 1;
+            } else if (strcmp(optarg, "none") == 0) {
+                sort_output = 0;
+            } else {
+                fprintf(stderr, "에러: 알 수 없는 정렬 방식: %s (path 또는 none)\n", optarg);
+                return 2;
+            }
+            break;
+        case 'L': {
+            int v;
+            if (parse_count(optarg, 0, 1 << 30, &v) != 0) {
+                fprintf(stderr, "에러: 작업 상한은 0~%d 사이여야 합니다 (0 = 무제한): %s\n", 1 << 30, optarg);
+                return 2;
+            }
+            queue_limit = (size_t)v;
+            break;
+        }
+        case 'P': {
+            int mb;
+            if (parse_count(optarg, 0, 1 << 20, &mb) != 0) {
+                fprintf(stderr, "에러: 나눠 검색할 파일 크기(MB)는 0~%d 사이여야 합니다 (0 = 나누지 않음): %s\n",
+                        1 << 20, optarg);
+                return 2;
+            }
+            split_min = (size_t)mb << 20;
+            break;
+        }
+        case 'I':
+            index_mode = INDEX_BUILD;
+            break;
+        case 'Q':
+            index_mode = INDEX_QUERY;
+            break;
+        case 'X':
+            index_file = optarg;
+            break;
+        case 'D':
+            daemon_path = optarg;
+            break;
+        case 'K':
+            connect_path = optarg;
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+    context_apply(&ctx);
+    if (output_finish(color) != 0) return 2;
+    profile_on = profile_top > 0 || trace_path != NULL;
+
+    // --connect: 인자를 그대로 데몬에 넘기고 결과는 데몬이 stdout 에 씀
+    if (connect_path) {
+        patterns_free(&patterns);
+        return daemon_connect(connect_path, argc, argv);
+    }
+
+    // --pin: worker 자리를 먼저 정함 (steal 스케줄러가 sched_init 에서 노드별 훔칠 순서를 만듦)
+    // 노드가 여럿인데 스케줄러를 고르지 않았으면 steal: 전역 Queue 1개는 lock cache line 이 노드 사이를 오감
+    if (pin_mode != PIN_OFF) {
+        pin_plan(match_threads + walk_threads);
+        if (numa_nodes > 1 && !sched_explicit) sched_kind = SCHED_STEAL;
+    }
+    if (daemon_path) {
+        if (profile_on) {
+            fprintf(stderr, "에러: --profile / --trace 는 --daemon 과 함께 쓸 수 없습니다\n");
+            return 2;
+        }
+        if (argc - optind != 1 || patterns.count > 0 || index_mode != INDEX_OFF) {
+            fprintf(stderr, "에러: --daemon 에는 검색할 디렉터리 하나만 지정합니다 "
+                            "(패턴은 --connect 질의에서, --index / --use-index 와는 함께 쓸 수 없음)\n");
+            return 2;
+        }
+        if (mg_filter_finish(&file_filter) != 0) die_nomem("malloc");
+        mg_init();
+#ifdef HAVE_IO_URING
+        if (io_uring_depth > 0 && !uring_available()) {
+            fprintf(stderr, "경고: io_uring을 사용할 수 없습니다 (커널 5.6 미만 또는 차단됨), 동기 I/O를 사용합니다.\n");
+            io_uring_depth = 0;
+        }
+#endif
+        int rc = daemon_serve(daemon_path, argv[optind], sched_kind, match_threads, walk_threads);
+        free(worker_cpu);
+        free(worker_node);
+        mg_filter_free(&file_filter);
+        pthread_mutex_destroy(&print_lock);
+        return rc;
+    }
+
+    // -e / -f 가 없으면 두 번째 인자가 키워드 (--index 는 경로만)
+    // 경로를 빼면 표준 입력 검색 (경로 "-" 와 같음)
+    int need_args = (patterns.count > 0 || index_mode == INDEX_BUILD) ? 1 : 2;
+    int nargs = argc - optind;
+    if ((nargs != need_args && (nargs != need_args - 1 || index_mode == INDEX_BUILD)) ||
+        (index_mode == INDEX_BUILD && patterns.count > 0)) {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    const char *search_path = nargs == need_args ? argv[optind] : "-";
+    if (index_mode != INDEX_BUILD) {
+        if (patterns.count == 0) {
+            patterns_add(&patterns, argv[argc - 1], strlen(argv[argc - 1]));
+        }
+        if (patterns.count == 0) {
+            fprintf(stderr, "에러: 패턴 파일이 비어 있습니다.\n");
+            return 2;
+        }
+    }
+
+    if (mg_filter_finish(&file_filter) != 0) die_nomem("malloc");
+    mg_init();
+    if (output_mode == OUT_QUIET || index_mode == INDEX_BUILD) {
+        sort_output = 0;        // 출력이 없으니 순서도 필요 없음
+    }
+    order_init();
+
+    MgMatcher matcher;
+    memset(&matcher, 0, sizeof(matcher));
+    const char *re_err = NULL;
+    if (index_mode != INDEX_BUILD &&
+        mg_matcher_init(&matcher, (const char *const *)patterns.items, patterns.lens, patterns.count,
+                     match_flags(extended), &re_err) != 0) {
+        report_matcher_error(re_err);
+        return 2;
+    }
+
+    // 디렉터리가 아니면: 일반 파일은 그 파일 하나만 (mmap 검색), 표준 입력/파이프/FIFO 는 스트림으로
+    struct stat st;
+    int is_stdin = strcmp(search_path, "-") == 0;
+    if (!is_stdin && stat(search_path, &st) != 0) {
+        fprintf(stderr, "에러: '%s'를 찾을 수 없습니다.\n", search_path);
+        return 2;
+    }
+    int root_is_dir = !is_stdin && S_ISDIR(st.st_mode);
+    if (root_is_dir) walk_opts.root_dev = st.st_dev;
+    mg_visit_init(&visited);
+    if (!root_is_dir && index_mode != INDEX_OFF) {
+        fprintf(stderr, "에러: 인덱스(--index / --use-index)는 디렉터리에서만 사용할 수 있습니다: %s\n", search_path);
+        return 2;
+    }
+    if (is_stdin || (!S_ISDIR(st.st_mode) && !S_ISREG(st.st_mode))) {
+        int fd = is_stdin ? STDIN_FILENO : open(search_path, O_RDONLY);
+        if (fd < 0) {
+            fprintf(stderr, "에러: '%s'를 열 수 없습니다: %s\n", search_path, strerror(errno));
+            return 2;
+        }
+        sort_output = 0;        // 입력이 하나뿐이라 순서가 정해져 있음
+
+        WorkerArg *wa = (WorkerArg*)xaligned_alloc(64, ((sizeof(WorkerArg) + 63) / 64) * 64);
+        memset(wa, 0, sizeof(*wa));
+        wa->m = &matcher;
+        wa->thread_id = 1;
+        wa->role = MG_ROLE_MATCH;
+
+        // --json 은 ripgrep 처럼 "<stdin>"
+        long long t0 = now_ns();
+        int rc = search_stream(fd, is_stdin ? (out_format == FMT_JSON ? "<stdin>" : "(표준 입력)") : search_path, wa);
+        if (!is_stdin) close(fd);
+        if (out_format == FMT_JSON && output_mode == OUT_LINES) print_json_summary(&wa->stats, 1, now_ns() - t0);
+
+        free(wa->out.data);
+        free(wa->opath.data);
+        free(wa);
+        mg_matcher_free(&matcher);
+        mg_filter_free(&file_filter);
+        order_destroy();
+        patterns_free(&patterns);
+        pthread_mutex_destroy(&print_lock);
+        return rc;
+    }
+
+    // 인덱스 파일 (기본: 검색 경로 아래 .mini-grep.idx)
+    char index_path[4096 + 64];
+    if (index_file) {
+        snprintf(index_path, sizeof(index_path), "%s", index_file);
+    } else {
+        snprintf(index_path, sizeof(index_path), "%s/%s", search_path, INDEX_DEFAULT_NAME);
+    }
+
+    TrigramIndex tindex;
+    memset(&tindex, 0, sizeof(tindex));
+    tindex.root_len = strlen(search_path);
+    if (index_mode != INDEX_OFF) {
+        int rc = index_load(&tindex, index_path);
+        if (rc == -2) {
+            fprintf(stderr, "경고: 인덱스 형식이 맞지 않습니다: %s\n", index_path);
+        }
+        if (index_mode == INDEX_QUERY) {
+            if (rc != 0) {
+                fprintf(stderr, "경고: 인덱스를 읽을 수 없어 전체 검색합니다: %s\n", index_path);
+                index_mode = INDEX_OFF;
+            } else if (ignore_case) {
+                // 인덱스의 trigram 은 대소문자를 구분 -> 후보를 거르지 않음 (파일은 전부 검색)
+            } else if (matcher.kind == MG_MATCH_REGEX) {
+                index_prepare_query(&tindex, (const char *const *)matcher.re.lits, matcher.re.lit_lens,
+                                    matcher.re.nlits);
+            } else {
+                index_prepare_query(&tindex, matcher.pats, matcher.lens, matcher.npats);
+            }
+        } else {
+            io_uring_depth = 0;     // 인덱스 생성은 동기 read 경로만 사용
+        }
+    }
+
+#ifdef HAVE_IO_URING
+    if (io_uring_depth > 0 && !uring_available()) {
+        fprintf(stderr, "경고: io_uring을 사용할 수 없습니다 (커널 5.6 미만 또는 차단됨), 동기 I/O를 사용합니다.\n");
+        io_uring_depth = 0;
+    }
+#endif
+
+    // -l / -c / -q / --json / --null 은 결과만 출력 (파이프로 넘기기 좋게)
+    int verbose = (output_mode == OUT_LINES && out_format == FMT_TEXT) || index_mode == INDEX_BUILD;
+    if (verbose) {
+        printf("=== 멀티스레드 파일 검색기 ===\n");
+        printf("검색 경로: %s\n", search_path);
+        if (index_mode != INDEX_BUILD) {
+            printf("검색 키워드: ");
+            for (int i = 0; i < patterns.count; i++) {
+                printf("%s\"%s\"", i ? ", " : "", patterns.items[i]);
+            }
+            printf("\n");
+        }
+        if (walk_threads > 0) {
+            printf("스레드 개수: %d (검색) + %d (탐색 전용)\n", match_threads, walk_threads);
+        } else {
+            printf("스레드 개수: %d\n", match_threads);
+        }
+        printf("사용 가능 CPU: %d\n", cpu_count);
+        printf("스케줄러: %s\n", sched_kind == SCHED_STEAL ? "work-stealing" : "queue");
+        if (worker_cpu) print_pin_plan(match_threads + walk_threads);
+        if (io_uring_depth > 0) {
+            printf("I/O: io_uring (worker당 최대 %d개 동시 요청)\n", io_uring_depth);
+        } else {
+            printf("I/O: 동기 (read/mmap)\n");
+        }
+        if (sort_output) {
+            printf("출력 순서: 경로 (디렉터리별 이름 순)\n");
+        }
+        if (use_ignore_files) {
+            printf("ignore 파일: .gitignore / .ignore 적용\n");
+        }
+        if (search_zip) {
+            printf("압축 파일: .gz .zst .lz4 .xz .bz2 풀면서 검색\n");
+        }
+        if (ignore_case || word_match) {
+            printf("매칭 옵션:%s%s\n", ignore_case ? " 대소문자 무시" : "", word_match ? " 단어 단위" : "");
+        }
+        if (index_mode == INDEX_QUERY) {
+            if (tindex.cand) {
+                printf("인덱스: %s (%u개 파일 중 후보 %u개)\n", index_path, tindex.nfiles, tindex.ncand);
+            } else if (ignore_case) {
+                printf("인덱스: %s (-i 에서는 후보를 거르지 않음)\n", index_path);
+            } else {
+                printf("인덱스: %s (3바이트 이상 리터럴이 없어 거를 수 없음)\n", index_path);
+            }
+        }
+        if (index_mode == INDEX_BUILD) {
+            printf("인덱스 생성: %s", index_path);
+            if (tindex.map) printf(" (기존 %u개 파일, 바뀐 파일만 다시 읽음)", tindex.nfiles);
+            printf("\n\n");
+        } else if (matcher.kind == MG_MATCH_REGEX) {
+            const MgRegex *re = &matcher.re;
+            printf("검색 커널: regex DFA (%u 상태, %u 바이트 클래스)", re->line.nstates, re->nclass);
+            if (re->nlits > 0) {
+                printf(" + 리터럴 prefilter ");
+                for (int i = 0; i < re->nlits; i++) printf("%s\"%s\"", i ? "|" : "", re->lits[i]);
+                printf(" (%s)\n\n", re->nlits > 1 ? "aho-corasick" : mg_kernel_name());
+            } else {
+                printf(", prefilter 없음\n\n");
+            }
+        } else if (matcher.kind == MG_MATCH_MULTI) {
+            printf("검색 커널: aho-corasick (%d개 패턴, %u 상태) + %s\n\n",
+                   matcher.npats, matcher.ac.nstates, mg_kernel_name());
+        } else {
+            printf("검색 커널: %s\n\n", mg_kernel_name());
+        }
+    }
+
+    // 검색 worker [0, match_threads) + 탐색 전용 worker [match_threads, nthreads)
+    int nthreads = match_threads + walk_threads;
+    split_helpers = match_threads - 1;      // 큰 파일 조각은 검색 worker끼리 나눔
+
+    Scheduler sched;
+    sched_init(&sched, sched_kind, nthreads);
+
+    pthread_t *threads = (pthread_t*)xcalloc((size_t)nthreads, sizeof(pthread_t));
+    WorkerArg *args = worker_args_new(&sched, nthreads, match_threads);
+    for (int i = 0; i < nthreads; i++) {
+        args[i].m = &matcher;
+        args[i].idx = &tindex;
+    }
+
+    // 루트 디렉터리를 첫 작업으로 넣음 (worker 0 의 deque) -> 이후 탐색은 worker들이 나눠서 수행
+    if (verbose) printf("📁 파일 탐색 + 검색 중...\n");
+    TaskBatch root;
+    batch_init(&root, NULL, 0);
+    root.ord = &order.root;     // 루트 작업은 가상 노드의 0번 칸
+    batch_add(&args[0], &root, search_path, root_is_dir ? MG_TASK_DIR : MG_TASK_FILE, NULL);
+    batch_close(&args[0], &root);
+    if (!root_is_dir) args[0].stats.files_scanned++;    // 파일 하나: 확장자 필터와 관계없이 검색
+
+    // worker는 write()로 직접 출력하므로 stdio 버퍼를 먼저 비워둠
+    fflush(stdout);
+
+    // 시간 측정 시작
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long long prof_t0 = profile_on ? now_ns() : 0;     // --trace: 이벤트 시각의 기준
+
+    // Worker 생성
+    for (int i = 0; i < nthreads; i++) {
+        if (pthread_create(&threads[i], NULL, worker_thread, &args[i]) != 0) {
+            perror("pthread_create");
+            exit(2);
+        }
+    }
+
+    // Worker 종료 대기 (pending == 0 이 되면 worker들이 스스로 종료)
+    for (int i = 0; i < nthreads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    // 시간 측정 종료
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) +
+                     (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+
+    if (verbose) {
+        printf("\n");
+        printf("========================================\n");
+        printf("검색 완료!\n");
+    }
+    WorkerStats total;
+    memset(&total, 0, sizeof(total));
+    for (int i = 0; i < nthreads; i++) {
+        stats_add(&total, &args[i].stats);
+    }
+    if (out_format == FMT_JSON && output_mode == OUT_LINES && index_mode != INDEX_BUILD) {
+        print_json_summary(&total, total.files_scanned,
+                           (long long)(end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec));
+    }
+
+    if (index_mode == INDEX_BUILD) {
+        // worker별 항목을 모아서 기록
+        size_t nents = 0;
+        long long reused = 0;
+        for (int i = 0; i < nthreads; i++) {
+            nents += args[i].ib.count;
+            reused += args[i].ib.reused;
+        }
+        IndexEntry *ents = (IndexEntry*)xmalloc((nents ? nents : 1) * sizeof(IndexEntry));
+        size_t at = 0;
+        for (int i = 0; i < nthreads; i++) {
+            memcpy(ents + at, args[i].ib.items, args[i].ib.count * sizeof(IndexEntry));
+            at += args[i].ib.count;
+            args[i].ib.count = 0;   // 항목 소유권은 ents로
+        }
+
+        uint32_t ntris = 0;
+        if (index_write(index_path, ents, nents, &tindex, &ntris) != 0) {
+            fprintf(stderr, "에러: 인덱스를 저장할 수 없습니다: %s (%s)\n", index_path, strerror(errno));
+        } else {
+            printf("인덱스 저장: %zu개 파일 (재사용 %lld개, 새로 읽음 %lld개), trigram %u종\n",
+                   nents, reused, (long long)nents - reused, ntris);
+        }
+        for (size_t i = 0; i < nents; i++) {
+            free(ents[i].path);
+            free(ents[i].tris);
+        }
+        free(ents);
+    } else if (verbose) {
+        printf("총 %lld개 파일 스캔, %lld개 파일에서 매칭\n", total.files_scanned, total.files_matched);
+        if (index_mode == INDEX_QUERY && tindex.cand) {
+            printf("인덱스로 %lld개 파일 건너뜀\n", total.index_skipped);
+        }
+        print_skip_summary(&total);
+    }
+    if (verbose) {
+        printf("소요 시간: %.3f초\n", elapsed);
+        printf("========================================\n");
+    }
+
+    if (show_stats) {
+        print_stats(args, nthreads, &total);
+        printf("파일 작업 최대 %zu개 대기 (상한: ", sched_peak_files(&sched));
+        if (queue_limit > 0) printf("%zu", queue_limit);
+        else printf("없음");
+        printf("), 상한 때문에 탐색 중 직접 검색 %lld개 / 탐색 worker 대기 %lld회\n",
+               total.bp_searched, total.bp_waits);
+        if (worker_cpu && numa_nodes > 1) {
+            printf("다른 NUMA 노드에서 훔쳐온 횟수: %zu\n", sched_remote_steals(&sched));
+        }
+    }
+    if (profile_on) profile_report(args, nthreads, prof_t0);
+
+    worker_args_free(args, nthreads);
+    free(threads);
+    sched_destroy(&sched);
+    free(worker_cpu);
+    free(worker_node);
+    split_free_all();
+    mg_visit_free(&visited);
+    mg_matcher_free(&matcher);
+    index_free(&tindex);
+    mg_filter_free(&file_filter);
+    order_destroy();
+    patterns_free(&patterns);
+    pthread_mutex_destroy(&print_lock);
+
+    return exit_code(index_mode == INDEX_BUILD || total.files_matched > 0, total.open_failures > 0);
 }
@@ -2,147 +2,71 @@
  * 싱글스레드 파일 검색기 (single-mini-grep)
  *
  * 기능:
- * - 디렉터리 재귀 탐색
+ * - 디렉터리 재귀 탐색 (symlink 는 따라가지 않음)
  * - 키워드 검색 및 매칭
+ * - 파일 통째로 읽기 (mmap / read) + SIMD 부분 문자열 검색 (SSE2/AVX2/NEON)
  * - 키워드 빨간색 강조 (grep 스타일)
+ * - 탐색 / 검색은 mini-grep-lib.h (mini-grep 과 같은 코어) 를 스레드 1개로 호출하는 얇은 frontend
  *
- * 빌드:
- *   gcc single_mini_grep.c -o single_mini_grep
+ * 빌드 (mini-grep-lib.h 는 헤더만이라 같은 디렉터리에 있으면 됨):
+ *   gcc single-mini-grep.c -o single-mini-grep -pthread
  *
  * 실행:
- *   ./single_mini_grep /path "TODO"
+ *   ./single-mini-grep /path "TODO"
  */
 
-#define _XOPEN_SOURCE 700
+#define _GNU_SOURCE   // mini-grep-lib.h (memrchr, fstatat)
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <dirent.h>
 #include <sys/stat.h>
 #include <time.h>
-#include <unistd.h>
 
-#ifndef MAX_PATH
-#define MAX_PATH 10000
-#endif
+#include "mini-grep-lib.h"
 
 // -------------------- ANSI 색상 코드 --------------------
 #define COLOR_RED     "\033[1;31m"
 #define COLOR_RESET   "\033[0m"
 
-// -------------------- 전역 통계 --------------------
-static long long scanned_files = 0;   // 스캔한 "대상 파일" 개수
-static long long total_matches = 0;   // 매칭된 "파일" 개수(파일 단위)
-
 // -------------------- 키워드 강조 출력 --------------------
 // 키워드를 빨간색으로 강조해서 출력하는 함수
-static void print_line_with_highlight(const char *line, const char *keyword) {
-    const char *pos = line;
-    const char *found;
-    int keyword_len = strlen(keyword);
-    
-    while ((found = strstr(pos, keyword)) != NULL) {
+// line[0..len) 는 줄바꿈을 포함하지 않음, 매칭 구간은 라이브러리 매처가 찾음 (mini-grep 과 같은 판정)
+static void print_line_with_highlight(const MgPattern *p, const char *line, size_t len) {
+    size_t pos = 0;
+    size_t off, mlen;
+    int pat;
+
+    while (pos < len && mg_next_span(p, line, len, pos, &off, &mlen, &pat)) {
         // 키워드 이전 부분 출력
-        fwrite(pos, 1, found - pos, stdout);
+        fwrite(line + pos, 1, off - pos, stdout);
         // 키워드를 빨간색으로 출력
-        printf("%s%s%s", COLOR_RED, keyword, COLOR_RESET);
-        pos = found + keyword_len;
+        printf("%s%.*s%s", COLOR_RED, (int)mlen, line + off, COLOR_RESET);
+        pos = off + mlen;
     }
     // 나머지 부분 출력
-    printf("%s", pos);
+    fwrite(line + pos, 1, len - pos, stdout);
+    putchar('\n');
 }
 
-// -------------------- 검색 로직 --------------------
-static int is_target_extension(const char *filename) {
-    const char *ext = strrchr(filename, '.');
-    if (!ext) return 0;
-
-    return (strcmp(ext, ".c") == 0 ||
-            strcmp(ext, ".txt") == 0 ||
-            strcmp(ext, ".h") == 0 ||
-            strcmp(ext, ".py") == 0 ||
-            strcmp(ext, ".md") == 0);
-}
+// -------------------- 검색 결과 (mg_search_tree callback) --------------------
+// 스레드 1개로 부르므로 출력에 lock 없음, 파일의 첫 매칭 줄에서 헤더 출력
+static int print_hit(void *ctx, const MgHit *hit) {
+    const MgPattern *p = (const MgPattern*)ctx;
 
-static void search_in_file(const char *filepath, const char *keyword) {
-    FILE *fp = fopen(filepath, "r");
-    if (!fp) return;
+    if (hit->index == 0) {
+        printf("\n매칭: %s\n", hit->path);
+        printf("  크기: %ld bytes\n", (long)hit->st->st_size);
 
-    struct stat st;
-    if (stat(filepath, &st) != 0) {
-        fclose(fp);
-        return;
+        char time_buf[64];
+        struct tm *tm_info = localtime(&hit->st->st_mtime);
+        strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", tm_info);
+        printf("  수정: %s\n", time_buf);
     }
 
-    char line[1024];
-    int line_num = 0;
-    int found = 0;
-
-    while (fgets(line, sizeof(line), fp)) {
-        line_num++;
-
-        if (strstr(line, keyword)) {
-            if (!found) {
-                printf("\n매칭: %s\n", filepath);
-                printf("  크기: %ld bytes\n", (long)st.st_size);
-
-                char time_buf[64];
-                struct tm *tm_info = localtime(&st.st_mtime);
-                strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", tm_info);
-                printf("  수정: %s\n", time_buf);
-
-                found = 1;
-                total_matches++;
-            }
-
-            printf("  %4d: ", line_num);
-            print_line_with_highlight(line, keyword);
-        }
-    }
-
-    fclose(fp);
-}
-
-// -------------------- 디렉터리 스캔 --------------------
-static void scan_directory(const char *path, const char *keyword) {
-    DIR *dir = opendir(path);
-    if (!dir) {
-        fprintf(stderr, "경고: 디렉터리를 열 수 없습니다: %s\n", path);
-        return;
-    }
-
-    struct dirent *entry;
-    while ((entry = readdir(dir)) != NULL) {
-
-        if (strcmp(entry->d_name, ".") == 0 ||
-            strcmp(entry->d_name, "..") == 0) {
-            continue;
-        }
-
-        char fullpath[MAX_PATH];
-        snprintf(fullpath, sizeof(fullpath), "%s/%s", path, entry->d_name);
-
-        struct stat st;
-        // symlink 루프 방지 목적이면 lstat 고려 가능.
-        if (stat(fullpath, &st) != 0) {
-            continue;
-        }
-
-        if (S_ISDIR(st.st_mode)) {
-            scan_directory(fullpath, keyword);
-        } else if (S_ISREG(st.st_mode)) {
-            if (is_target_extension(entry->d_name)) {
-                // 스캔 카운트 증가 (대상 파일 기준)
-                scanned_files++;
-                
-                // 파일 검색
-                search_in_file(fullpath, keyword);
-            }
-        }
-    }
-
-    closedir(dir);
+    printf("  %4zu: ", hit->match.line_num);
+    print_line_with_highlight(p, hit->line, hit->len);
+    return 0;
 }
 
 // -------------------- main --------------------
@@ -162,17 +86,28 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    const char *err;
+    size_t keyword_len = strlen(keyword);
+    MgPattern *pattern = mg_compile(&keyword, &keyword_len, 1, 0, &err);
+    if (!pattern) {
+        fprintf(stderr, "에러: %s\n", err);
+        return 1;
+    }
+
     printf("=== 싱글스레드 파일 검색기 ===\n");
     printf("검색 경로: %s\n", search_path);
-    printf("검색 키워드: \"%s\"\n\n", keyword);
+    printf("검색 키워드: \"%s\"\n", keyword);
+    printf("검색 커널: %s\n\n", mg_kernel_name());
 
     // 시간 측정 시작
     struct timespec start, end;
     clock_gettime(CLOCK_MONOTONIC, &start);
 
-    // 디렉터리 스캔 및 검색
+    // 디렉터리 스캔 및 검색 (스레드 1개: 호출한 스레드에서, 바이너리 파일도 검색)
     printf("📁 파일 탐색 + 검색 중...\n");
-    scan_directory(search_path, keyword);
+    MgTreeOpts opts = { 1, NULL, 1, 0, 0 };
+    MgTreeStats stats;
+    int rc = mg_search_tree(pattern, search_path, &opts, print_hit, pattern, &stats);
 
     // 시간 측정 종료
     clock_gettime(CLOCK_MONOTONIC, &end);
@@ -182,9 +117,15 @@ int main(int argc, char *argv[]) {
     printf("\n");
     printf("========================================\n");
     printf("검색 완료!\n");
-    printf("총 %lld개 파일 스캔, %lld개 파일에서 매칭\n", scanned_files, total_matches);
+    printf("총 %lld개 파일 스캔, %lld개 파일에서 매칭\n", stats.files, stats.files_matched);
     printf("소요 시간: %.3f초\n", elapsed);
     printf("========================================\n");
+    if (stats.errors > 0) {
+        fprintf(stderr, "경고: 열 수 없는 디렉터리 / 파일 %lld개 건너뜀\n", stats.errors);
+    }
 
-    return 0;
+    if (rc != 0) perror("에러: 검색 중단");    // stat 이후 경로가 없어짐 (ENOENT) 또는 메모리 부족 (ENOMEM)
+
+    mg_free(pattern);
+    return rc != 0 ? 1 : 0;
 }